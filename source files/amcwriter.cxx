@@ -0,0 +1,131 @@
+#include <cstring>
+#include <charconv>
+
+#include "amcwriter.h"
+
+//A frame line never gets close to this; the buffer is flushed when less space is left
+#define AMC_WRITER_MAX_FRAME (MAX_CHANNELS*32 + MAX_BONES_IN_ASF_FILE*260)
+
+
+/************************ AMCWriter class functions **********************************/
+AMCWriter::AMCWriter(Skeleton *pActor, float scale) : m_Layout(pActor)
+{
+	m_Scale = scale;
+	m_pFile = NULL;
+	m_pBuffer = new char [AMC_WRITER_BUFFER_SIZE];
+	m_Used = 0;
+	m_NumBytes = 0;
+	m_NumFrames = 0;
+	m_bError = false;
+
+	//group the channels by bone, one line per bone
+	m_NumLines = 0;
+	for (int c = 0; c < m_Layout.m_NumChannels; c++)
+	{
+		int bone = m_Layout.m_Channels[c].bone;
+		if (m_NumLines == 0 || m_Layout.m_Channels[m_Lines[m_NumLines - 1].firstChannel].bone != bone)
+		{
+			Line &line = m_Lines[m_NumLines++];
+			strcpy(line.name, pActor->idx2name(bone));
+			line.nameLength = (int)strlen(line.name);
+			line.firstChannel = c;
+			line.numChannels = 0;
+		}
+		m_Lines[m_NumLines - 1].numChannels++;
+	}
+}
+
+AMCWriter::~AMCWriter()
+{
+	if (m_pFile != NULL)
+		Close();
+	delete [] m_pBuffer;
+}
+
+int AMCWriter::Open(char const *filename)
+{
+	if (m_pFile != NULL)
+		Close();
+
+	m_pFile = fopen(filename, "wb");
+	if (m_pFile == NULL)
+		return -1;
+
+	m_Used = 0;
+	m_NumBytes = 0;
+	m_NumFrames = 0;
+	m_bError = false;
+
+	// header lines
+	static const char header[] = "#Unknow ASF file\n:FULLY-SPECIFIED\n:DEGREES\n";
+	PutString(header, sizeof(header) - 1);
+	return 0;
+}
+
+void AMCWriter::Flush()
+{
+	if (m_Used > 0 && fwrite(m_pBuffer, 1, m_Used, m_pFile) != (size_t)m_Used)
+		m_bError = true;
+	m_NumBytes += m_Used;
+	m_Used = 0;
+}
+
+inline void AMCWriter::PutString(char const *pStr, int nLength)
+{
+	memcpy(m_pBuffer + m_Used, pStr, nLength);
+	m_Used += nLength;
+}
+
+inline void AMCWriter::PutFloat(float fValue)
+{
+	m_pBuffer[m_Used++] = ' ';
+	std::to_chars_result result = std::to_chars(m_pBuffer + m_Used, m_pBuffer + AMC_WRITER_BUFFER_SIZE, fValue);
+	m_Used = (int)(result.ptr - m_pBuffer);
+}
+
+void AMCWriter::WriteFrame(float const *pValues, int nStride)
+{
+	if (m_pFile == NULL)
+		return;
+	if (m_Used > AMC_WRITER_BUFFER_SIZE - AMC_WRITER_MAX_FRAME)
+		Flush();
+
+	//frame number
+	m_NumFrames++;
+	std::to_chars_result result = std::to_chars(m_pBuffer + m_Used, m_pBuffer + AMC_WRITER_BUFFER_SIZE, m_NumFrames);
+	m_Used = (int)(result.ptr - m_pBuffer);
+	m_pBuffer[m_Used++] = '\n';
+
+	for (int l = 0; l < m_NumLines; l++)
+	{
+		Line const &line = m_Lines[l];
+		PutString(line.name, line.nameLength);
+		for (int c = line.firstChannel; c < line.firstChannel + line.numChannels; c++)
+		{
+			float v = pValues[c*nStride];
+			if (!m_Layout.IsAngle(c))
+				v /= m_Scale;
+			PutFloat(v);
+		}
+		m_pBuffer[m_Used++] = '\n';
+	}
+}
+
+void AMCWriter::WriteFrame(Posture const& posture)
+{
+	float values[MAX_CHANNELS];
+	m_Layout.Gather(posture, values);
+	WriteFrame(values, 1);
+}
+
+int AMCWriter::Close()
+{
+	if (m_pFile == NULL)
+		return -1;
+
+	Flush();
+	if (fclose(m_pFile) != 0)
+		m_bError = true;
+	m_pFile = NULL;
+	return m_bError ? -1 : 0;
+}
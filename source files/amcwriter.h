@@ -0,0 +1,77 @@
+/*
+	amcwriter.h
+
+	Buffered writer for AMC files.
+
+	Frames are formatted into a large memory buffer (shortest round-trip float text,
+	std::to_chars) and written to the file in blocks of AMC_WRITER_BUFFER_SIZE bytes.
+	A frame can be given as a Posture or as an array of channel values in ChannelLayout order,
+	with a stride, so motions kept in any layout (postures, frame-major or channel-major arrays)
+	can be written without converting them to a Motion first.
+*/
+
+#ifndef _AMCWRITER_H
+#define _AMCWRITER_H
+
+#include <cstdio>
+
+#include "types.h"
+#include "posture.h"
+#include "skeleton.h"
+#include "channels.h"
+
+#define AMC_WRITER_BUFFER_SIZE (1 << 20)
+
+class AMCWriter
+{
+	//member functions
+	public:
+		// scale is the same parameter that was used to read the motion (translations are divided by it)
+		AMCWriter(Skeleton *pActor, float scale);
+		~AMCWriter();
+
+		//Create the file and write the header. Returns 0 on success, -1 on error
+		int Open(char const *filename);
+
+		//Append the next frame (frames are numbered from 1)
+		void WriteFrame(Posture const& posture);
+		//pValues[c*nStride] is the value of channel c of the layout
+		void WriteFrame(float const *pValues, int nStride = 1);
+
+		//Flush the buffer and close the file. Returns 0 on success, -1 if a write failed
+		int Close();
+
+		//Number of frames and bytes written so far
+		int GetNumFrames() const { return m_NumFrames; }
+		long long GetNumBytes() const { return m_NumBytes + m_Used; }
+
+	private:
+		void Flush();
+		void PutFloat(float fValue);
+		void PutString(char const *pStr, int nLength);
+
+	//member variables
+	private:
+		ChannelLayout m_Layout;
+		float m_Scale;
+
+		//Every line of a frame: bone name and range of channels
+		struct Line
+		{
+			char name[256];
+			int nameLength;
+			int firstChannel;
+			int numChannels;
+		};
+		Line m_Lines[MAX_BONES_IN_ASF_FILE];
+		int m_NumLines;
+
+		FILE *m_pFile;
+		char *m_pBuffer;
+		int m_Used;
+		long long m_NumBytes;
+		int m_NumFrames;
+		bool m_bError;
+};
+
+#endif
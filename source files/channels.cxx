@@ -0,0 +1,202 @@
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+
+#include "channels.h"
+#include "transform.h"
+
+
+/************************ ChannelLayout class functions **********************************/
+ChannelLayout::ChannelLayout(Skeleton *pActor)
+{
+	m_pActor = pActor;
+	m_NumChannels = 0;
+
+	Bone *bone = pActor->getRoot();
+	int numbones = numBonesInSkel(bone[0]);
+
+	//Root position and orientation are always present (TX TY TZ RX RY RZ)
+	for (int a = 0; a < 3; a++)
+	{
+		m_Channels[m_NumChannels].type = CHANNEL_ROOT_POS;
+		m_Channels[m_NumChannels].bone = root;
+		m_Channels[m_NumChannels].axis = a;
+		m_NumChannels++;
+	}
+	for (int a = 0; a < 3; a++)
+	{
+		m_Channels[m_NumChannels].type = CHANNEL_ROTATION;
+		m_Channels[m_NumChannels].bone = root;
+		m_Channels[m_NumChannels].axis = a;
+		m_NumChannels++;
+	}
+
+	//Other bones in the order of their dof line
+	for (int j = 1; j < numbones; j++)
+	{
+		for (int x = 0; x < bone[j].dof; x++)
+		{
+			Channel &c = m_Channels[m_NumChannels];
+			c.bone = j;
+			switch (bone[j].dofo[x])
+			{
+				case 1: case 2: case 3:
+					c.type = CHANNEL_ROTATION;
+					c.axis = bone[j].dofo[x] - 1;
+					break;
+				case 4: case 5: case 6:
+					c.type = CHANNEL_TRANSLATION;
+					c.axis = bone[j].dofo[x] - 4;
+					break;
+				default:
+					//bone length (l) is not stored in a channel
+					continue;
+			}
+			m_NumChannels++;
+		}
+	}
+}
+
+float ChannelLayout::GetValue(Posture const& posture, int nChannel) const
+{
+	Channel const& c = m_Channels[nChannel];
+	switch (c.type)
+	{
+		case CHANNEL_ROOT_POS:
+			return posture.root_pos.p[c.axis];
+		case CHANNEL_TRANSLATION:
+			return posture.bone_translation[c.bone].p[c.axis];
+		case CHANNEL_ROTATION:
+		default:
+			return posture.bone_rotation[c.bone].p[c.axis];
+	}
+}
+
+void ChannelLayout::SetValue(Posture& posture, int nChannel, float fValue) const
+{
+	Channel const& c = m_Channels[nChannel];
+	switch (c.type)
+	{
+		case CHANNEL_ROOT_POS:
+			posture.root_pos.p[c.axis] = fValue;
+			//readAMCfile keeps the root translation in both places
+			posture.bone_translation[root].p[c.axis] = fValue;
+			break;
+		case CHANNEL_TRANSLATION:
+			posture.bone_translation[c.bone].p[c.axis] = fValue;
+			break;
+		case CHANNEL_ROTATION:
+		default:
+			posture.bone_rotation[c.bone].p[c.axis] = fValue;
+			break;
+	}
+}
+
+void ChannelLayout::Gather(Posture const& posture, float *pValues) const
+{
+	for (int i = 0; i < m_NumChannels; i++)
+		pValues[i] = GetValue(posture, i);
+}
+
+void ChannelLayout::Scatter(float const *pValues, Posture& posture) const
+{
+	for (int i = 0; i < m_NumChannels; i++)
+		SetValue(posture, i, pValues[i]);
+}
+
+void ChannelLayout::GetName(int nChannel, char *pName) const
+{
+	static const char *axisName[3] = { "x", "y", "z" };
+	Channel const& c = m_Channels[nChannel];
+
+	if (c.type == CHANNEL_ROOT_POS)
+		sprintf(pName, "root.t%s", axisName[c.axis]);
+	else if (c.type == CHANNEL_TRANSLATION)
+		sprintf(pName, "%s.t%s", m_pActor->idx2name(c.bone), axisName[c.axis]);
+	else
+		sprintf(pName, "%s.r%s", m_pActor->idx2name(c.bone), axisName[c.axis]);
+}
+
+
+/************************ FeatureLayout class functions **********************************/
+FeatureLayout::FeatureLayout(ChannelLayout const *pLayout)
+{
+	m_pLayout = pLayout;
+
+	int count[MAX_BONES_IN_ASF_FILE] = { 0 };
+	for (int c = 0; c < pLayout->m_NumChannels; c++)
+		if (pLayout->IsAngle(c))
+		{
+			Channel const& channel = pLayout->m_Channels[c];
+			m_QuatChannels[channel.bone][channel.axis] = c;
+			count[channel.bone]++;
+		}
+	m_NumFeatures = 0;
+	m_NumQuatBones = 0;
+	for (int c = 0; c < pLayout->m_NumChannels; c++)
+	{
+		int b = pLayout->m_Channels[c].bone;
+		if (pLayout->IsAngle(c) && count[b] == 3)
+		{
+			m_ChannelFeature[c] = -1;
+			continue;
+		}
+		m_Angle[m_NumFeatures] = pLayout->IsAngle(c);
+		m_ChannelFeature[c] = m_NumFeatures++;
+	}
+	for (int b = 0; b < MAX_BONES_IN_ASF_FILE; b++)
+		if (count[b] == 3)
+		{
+			m_QuatBones[m_NumQuatBones++] = b;
+			m_QuatFeature[b] = m_NumFeatures;
+			for (int k = 0; k < 4; k++)
+				m_Angle[m_NumFeatures++] = false;
+		}
+}
+
+void FeatureLayout::ToFeatures(Posture const& posture, float *pRow) const
+{
+	float values[MAX_CHANNELS];
+	m_pLayout->Gather(posture, values);
+	for (int c = 0; c < m_pLayout->m_NumChannels; c++)
+		if (m_ChannelFeature[c] >= 0)
+			pRow[m_ChannelFeature[c]] = values[c];
+	for (int i = 0; i < m_NumQuatBones; i++)
+	{
+		int b = m_QuatBones[i];
+		euler_to_quaternion(posture.bone_rotation[b].p, pRow + m_QuatFeature[b]);
+	}
+}
+
+//Angles within 180 degrees of the previous frame, quaternions in its hemisphere
+void FeatureLayout::MakeContinuous(float *pRow, float const *pPrevious) const
+{
+	for (int f = 0; f < m_NumFeatures; f++)
+		if (m_Angle[f])
+			pRow[f] = UnwrapAngle(pRow[f], pPrevious[f]);
+	for (int i = 0; i < m_NumQuatBones; i++)
+	{
+		float *q = pRow + m_QuatFeature[m_QuatBones[i]];
+		float const *p = pPrevious + m_QuatFeature[m_QuatBones[i]];
+		if (q[0]*p[0] + q[1]*p[1] + q[2]*p[2] + q[3]*p[3] < 0)
+			for (int k = 0; k < 4; k++)
+				q[k] = -q[k];
+	}
+}
+
+void FeatureLayout::FromFeatures(float const *pRow, float *pValues) const
+{
+	for (int c = 0; c < m_pLayout->m_NumChannels; c++)
+		if (m_ChannelFeature[c] >= 0)
+			pValues[c] = pRow[m_ChannelFeature[c]];
+	for (int i = 0; i < m_NumQuatBones; i++)
+	{
+		int b = m_QuatBones[i];
+		float const *p = pRow + m_QuatFeature[b];
+		float n = 1.0f/sqrtf(p[0]*p[0] + p[1]*p[1] + p[2]*p[2] + p[3]*p[3]);
+		float q[4] = { p[0]*n, p[1]*n, p[2]*n, p[3]*n }, angles[3];
+		quaternion_to_euler(q, angles);
+		for (int a = 0; a < 3; a++)
+			pValues[m_QuatChannels[b][a]] = angles[a];
+	}
+}
@@ -0,0 +1,103 @@
+/*
+	channels.h
+
+	Flat view of the active degrees of freedom of a skeleton.
+
+	A Posture stores 3 rotation values for every one of MAX_BONES_IN_ASF_FILE bones,
+	most of which are unused. ChannelLayout lists only the values that the ASF file
+	marks as degrees of freedom (root position, root rotation and the dof rx/ry/rz/tx/ty/tz
+	of each bone), in bone index order and, within a bone, in the dof order of the ASF file.
+	It is used wherever a posture has to be packed into a compact array of floats.
+
+	FeatureLayout turns the channels into a row of features that can be filtered linearly
+	(resampler, smoother): translations as they are, rotations of bones with one or two dofs as
+	angles unwrapped from frame to frame, rotations of bones with three dofs (the root among them)
+	as unit quaternions (w, x, y, z) kept in the hemisphere of the previous frame, so no gimbal
+	flip or wrap around gets blended.
+*/
+
+#ifndef _CHANNELS_H
+#define _CHANNELS_H
+
+#include "types.h"
+#include "posture.h"
+#include "skeleton.h"
+
+#define MAX_CHANNELS (6*MAX_BONES_IN_ASF_FILE + 3)
+#define MAX_FEATURES (MAX_CHANNELS + MAX_BONES_IN_ASF_FILE)
+
+enum ChannelType
+{
+	CHANNEL_ROOT_POS = 0, CHANNEL_ROTATION, CHANNEL_TRANSLATION
+};
+
+//One scalar degree of freedom of a Posture
+struct Channel
+{
+	ChannelType type;
+	int bone;				// Bone index (0 for the root position)
+	int axis;				// 0 = x, 1 = y, 2 = z
+};
+
+class ChannelLayout
+{
+	//member functions
+	public:
+		//Build the layout from the dof fields of the actor bones
+		ChannelLayout(Skeleton *pActor);
+
+		//Read/write a single channel of the posture
+		float GetValue(Posture const& posture, int nChannel) const;
+		void SetValue(Posture& posture, int nChannel, float fValue) const;
+
+		//Copy all channels of the posture into pValues (m_NumChannels floats) and back.
+		//Scatter leaves the values that are not degrees of freedom untouched.
+		void Gather(Posture const& posture, float *pValues) const;
+		void Scatter(float const *pValues, Posture& posture) const;
+
+		//Name of the channel, e.g. "lfemur.rx" or "root.ty"
+		void GetName(int nChannel, char *pName) const;
+
+		//True for rotation channels (degrees), false for translations (scaled units)
+		bool IsAngle(int nChannel) const { return m_Channels[nChannel].type == CHANNEL_ROTATION; }
+
+	//member variables
+	public:
+		int m_NumChannels;
+		Channel m_Channels[MAX_CHANNELS];
+
+	private:
+		Skeleton *m_pActor;
+};
+
+class FeatureLayout
+{
+	//member functions
+	public:
+		//Features of the channels of pLayout, which must outlive this
+		FeatureLayout(ChannelLayout const *pLayout);
+
+		//Row of m_NumFeatures features of the posture
+		void ToFeatures(Posture const& posture, float *pRow) const;
+		//Unwrap the angles of pRow onto pPrevious and flip its quaternions into their hemisphere
+		void MakeContinuous(float *pRow, float const *pPrevious) const;
+		//Channel values (m_NumChannels floats) of a filtered row: quaternions are normalized and
+		//turned back into Euler angles, the other angles are left as filtered (not wrapped)
+		void FromFeatures(float const *pRow, float *pValues) const;
+
+	//member variables
+	public:
+		//one feature per channel of a bone that is not a quaternion bone, 4 per quaternion bone
+		int m_NumFeatures;
+		bool m_Angle[MAX_FEATURES];						// per feature: an unwrapped angle
+		int m_ChannelFeature[MAX_CHANNELS];				// -1 for the rotations of quaternion bones
+		int m_NumQuatBones;
+		int m_QuatBones[MAX_BONES_IN_ASF_FILE];
+		int m_QuatFeature[MAX_BONES_IN_ASF_FILE];		// first of the 4 features of the bone
+		int m_QuatChannels[MAX_BONES_IN_ASF_FILE][3];	// its x, y, z rotation channels
+
+	private:
+		ChannelLayout const *m_pLayout;
+};
+
+#endif
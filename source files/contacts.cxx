@@ -0,0 +1,266 @@
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#include "contacts.h"
+
+static char const *contactBoneNames[NUM_CONTACT_JOINTS] = { "lfoot", "rfoot", "ltoes", "rtoes" };
+
+
+/************************ FootContacts class functions **********************************/
+FootContacts::FootContacts()
+{
+	m_NumFrames = 0;
+}
+
+FootContacts::~FootContacts()
+{
+}
+
+unsigned int FootContacts::GetMask(int nFrame) const
+{
+	unsigned int nMask = 0;
+	for (int j = 0; j < NUM_CONTACT_JOINTS; j++)
+		nMask |= (unsigned int)IsContact(nFrame, j) << j;
+	return nMask;
+}
+
+int FootContacts::Count(int nJoint) const
+{
+	int nCount = 0;
+	for (int i = 0; i < (int)m_Bits[nJoint].size(); i++)
+		for (unsigned long long w = m_Bits[nJoint][i]; w != 0; w &= w - 1)
+			nCount++;
+	return nCount;
+}
+
+int FootContacts::GetIntervals(int nJoint, std::vector<int> &firsts, std::vector<int> &lasts) const
+{
+	int nCount = 0;
+	bool bPrevious = false;
+	for (int f = 0; f < m_NumFrames; f++)
+	{
+		//skip the words without a change
+		unsigned long long w = m_Bits[nJoint][f >> 6];
+		if ((f & 63) == 0 && f + 64 <= m_NumFrames && w == (bPrevious ? ~0ULL : 0ULL))
+		{
+			f += 63;
+			continue;
+		}
+		bool bContact = (w >> (f & 63)) & 1;
+		if (bContact && !bPrevious)
+		{
+			firsts.push_back(f);
+			nCount++;
+		}
+		else if (!bContact && bPrevious)
+			lasts.push_back(f - 1);
+		bPrevious = bContact;
+	}
+	if (bPrevious)
+		lasts.push_back(m_NumFrames - 1);
+	return nCount;
+}
+
+void FootContacts::Clear()
+{
+	m_NumFrames = 0;
+	for (int j = 0; j < NUM_CONTACT_JOINTS; j++)
+		m_Bits[j].clear();
+}
+
+void FootContacts::Append(unsigned int nMask)
+{
+	int nBit = m_NumFrames & 63;
+	for (int j = 0; j < NUM_CONTACT_JOINTS; j++)
+	{
+		if (nBit == 0)
+			m_Bits[j].push_back(0);
+		m_Bits[j].back() |= (unsigned long long)((nMask >> j) & 1) << nBit;
+	}
+	m_NumFrames++;
+}
+
+int FootContacts::Write(char const *filename) const
+{
+	FILE *pFile = fopen(filename, "wb");
+	if (pFile == NULL)
+		return -1;
+
+	FootContactHeader header = { FOOT_CONTACT_MAGIC, FOOT_CONTACT_VERSION, m_NumFrames, NUM_CONTACT_JOINTS };
+	bool bOk = fwrite(&header, sizeof(header), 1, pFile) == 1;
+	size_t nWords = (m_NumFrames + 63)/64;
+	for (int j = 0; j < NUM_CONTACT_JOINTS && bOk; j++)
+		bOk = nWords == 0 || fwrite(m_Bits[j].data(), sizeof(unsigned long long), nWords, pFile) == nWords;
+	return fclose(pFile) == 0 && bOk ? 0 : -1;
+}
+
+int FootContacts::Read(char const *filename)
+{
+	Clear();
+	FILE *pFile = fopen(filename, "rb");
+	if (pFile == NULL)
+		return -1;
+
+	FootContactHeader header;
+	bool bOk = fread(&header, sizeof(header), 1, pFile) == 1 && header.magic == FOOT_CONTACT_MAGIC &&
+		header.version == FOOT_CONTACT_VERSION && header.numFrames >= 0 && header.numJoints == NUM_CONTACT_JOINTS;
+	size_t nWords = bOk ? (header.numFrames + 63)/64 : 0;
+	for (int j = 0; j < NUM_CONTACT_JOINTS && bOk; j++)
+	{
+		m_Bits[j].resize(nWords);
+		bOk = nWords == 0 || fread(m_Bits[j].data(), sizeof(unsigned long long), nWords, pFile) == nWords;
+	}
+	fclose(pFile);
+	if (!bOk)
+	{
+		printf("Error: '%s' is not a foot contact file\n", filename);
+		Clear();
+		return -1;
+	}
+	m_NumFrames = header.numFrames;
+	return 0;
+}
+
+
+/************************ ContactDetector class functions **********************************/
+ContactDetector::ContactDetector(Skeleton *pActor) : m_Kinematics(pActor)
+{
+	m_NumBones = m_Kinematics.GetNumBones();
+	Bone *pBones = pActor->getRoot();
+	for (int j = 0; j < NUM_CONTACT_JOINTS; j++)
+	{
+		m_Bones[j] = -1;
+		for (int b = 0; b < m_NumBones; b++)
+			if (strcmp(pBones[b].name, contactBoneNames[j]) == 0)
+				m_Bones[j] = b;
+	}
+
+	m_FrameRate = MOCAP_FRAME_RATE;
+	m_Ground = 0;
+	SetHeights(0.07f, 0.1f);
+	SetSpeeds(0.5f, 0.9f);
+	Reset();
+}
+
+ContactDetector::~ContactDetector()
+{
+}
+
+void ContactDetector::SetHeights(float fEnter, float fLeave)
+{
+	m_EnterHeight = fEnter;
+	m_LeaveHeight = std::max(fLeave, fEnter);
+}
+
+void ContactDetector::SetSpeeds(float fEnter, float fLeave)
+{
+	m_EnterSpeed = fEnter;
+	m_LeaveSpeed = std::max(fLeave, fEnter);
+}
+
+void ContactDetector::Reset()
+{
+	m_NumIn = 0;
+	for (int j = 0; j < NUM_CONTACT_JOINTS; j++)
+		m_State[j] = false;
+}
+
+void ContactDetector::Label(float const *pRows, int nRowBase, int nFirst, int nCount, int nEnd, FootContacts *pContacts)
+{
+	const int J = NUM_CONTACT_JOINTS, N = CONTACT_BLOCK;
+	float height[J][N], speed2[J][N];
+	unsigned char enter[J][N], leave[J][N];
+	float fEnter2 = m_EnterSpeed*m_EnterSpeed, fLeave2 = m_LeaveSpeed*m_LeaveSpeed;
+
+	for (int nBlock = nFirst; nBlock < nFirst + nCount; nBlock += N)
+	{
+		int n = std::min(N, nFirst + nCount - nBlock);
+		for (int j = 0; j < J; j++)
+			for (int k = 0; k < n; k++)
+			{
+				int f = nBlock + k, nPrev = std::max(f - 1, 0), nNext = std::min(f + 1, nEnd - 1);
+				float const *p = pRows + (size_t)(f - nRowBase)*J*3 + 3*j;
+				float const *a = pRows + (size_t)(nPrev - nRowBase)*J*3 + 3*j;
+				float const *b = pRows + (size_t)(nNext - nRowBase)*J*3 + 3*j;
+				float fScale = nNext > nPrev ? m_FrameRate/(nNext - nPrev) : 0.0f;
+				float vx = (b[0] - a[0])*fScale, vy = (b[1] - a[1])*fScale, vz = (b[2] - a[2])*fScale;
+				height[j][k] = p[1] - m_Ground;
+				speed2[j][k] = vx*vx + vy*vy + vz*vz;
+			}
+
+		for (int j = 0; j < J; j++)
+			for (int k = 0; k < n; k++)
+			{
+				enter[j][k] = height[j][k] < m_EnterHeight && speed2[j][k] < fEnter2;
+				leave[j][k] = height[j][k] > m_LeaveHeight || speed2[j][k] > fLeave2;
+			}
+
+		for (int k = 0; k < n; k++)
+		{
+			unsigned int nMask = 0;
+			for (int j = 0; j < J; j++)
+			{
+				m_State[j] = m_Bones[j] >= 0 && (m_State[j] ? !leave[j][k] : enter[j][k]);
+				nMask |= (unsigned int)m_State[j] << j;
+			}
+			pContacts->Append(nMask);
+		}
+	}
+}
+
+int ContactDetector::Push(Posture const *pFrames, int nCount, FootContacts *pContacts)
+{
+	const int J = NUM_CONTACT_JOINTS;
+	int nLabeled = 0;
+	for (int nBlock = 0; nBlock < nCount; nBlock += CONTACT_BLOCK)
+	{
+		int n = std::min(CONTACT_BLOCK, nCount - nBlock);
+		int nCarry = std::min(m_NumIn, 2);
+
+		//the joint rows of the two frames before the block and of the block
+		m_Positions.resize((size_t)n*m_NumBones*3);
+		m_Rows.resize((size_t)(nCarry + n)*J*3);
+		m_Kinematics.ForwardKinematics(pFrames + nBlock, n, NULL, m_Positions.data());
+		memcpy(m_Rows.data(), m_Carry[2 - nCarry], nCarry*J*3*sizeof(float));
+		for (int k = 0; k < n; k++)
+			for (int j = 0; j < J; j++)
+				for (int i = 0; i < 3; i++)
+					m_Rows[(size_t)(nCarry + k)*J*3 + 3*j + i] = m_Bones[j] < 0 ? 0.0f : m_Positions[((size_t)k*m_NumBones + m_Bones[j])*3 + i];
+
+		//every frame that has its next frame now
+		int nFirst = std::max(m_NumIn - 1, 0), nEnd = m_NumIn + n;
+		Label(m_Rows.data(), m_NumIn - nCarry, nFirst, nEnd - 1 - nFirst, nEnd, pContacts);
+		nLabeled += nEnd - 1 - nFirst;
+
+		int nKeep = std::min(nCarry + n, 2);
+		memcpy(m_Carry[2 - nKeep], &m_Rows[(size_t)(nCarry + n - nKeep)*J*3], nKeep*J*3*sizeof(float));
+		m_NumIn = nEnd;
+	}
+	return nLabeled;
+}
+
+int ContactDetector::Flush(FootContacts *pContacts)
+{
+	if (m_NumIn == 0)
+		return 0;
+	int nCarry = std::min(m_NumIn, 2);
+	Label(m_Carry[2 - nCarry], m_NumIn - nCarry, m_NumIn - 1, 1, m_NumIn, pContacts);
+	Reset();
+	return 1;
+}
+
+int ContactDetector::Detect(Motion *pMotion, FootContacts *pContacts)
+{
+	if (pMotion == NULL || pMotion->m_NumFrames <= 0 || pMotion->m_FrameRate <= 0)
+		return -1;
+
+	float fRate = m_FrameRate;
+	m_FrameRate = pMotion->m_FrameRate;
+	pContacts->Clear();
+	Reset();
+	Push(pMotion->m_pPostures, pMotion->m_NumFrames, pContacts);
+	Flush(pContacts);
+	m_FrameRate = fRate;
+	return 0;
+}
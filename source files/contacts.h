@@ -0,0 +1,132 @@
+/*
+	contacts.h
+
+	Foot contact labels: for every frame, whether lfoot, rfoot, ltoes and rtoes (the end points
+	of these bones, as computeJointPositions) touch the ground plane, the y = 0 plane that the
+	player draws, or another height set with SetGround.
+
+	A joint is near the ground when its height above the plane is below the enter height and
+	its speed below the enter speed; it leaves the ground when its height rises above the leave
+	height or its speed above the leave speed. Between the two it keeps the label of the previous
+	frame (hysteresis), so the labels do not flicker with the capture noise of a planted foot.
+	Speeds are central differences over the neighbouring frames, as in kinematics.h.
+
+	The detector is a stream: Push takes frames in blocks of any size and labels all frames but
+	the last (whose speed needs the next frame), Flush labels the last one. Frames run through the
+	block forward kinematics of MotionKinematics, and the heights, speeds and threshold tests of
+	CONTACT_BLOCK frames are loops over the frames that the compiler vectorizes; only the
+	hysteresis runs frame by frame, on bits. Detect labels a whole motion the same way.
+
+	Labels are kept as bitsets, one bit per frame and joint, and can be written to and read from
+	a small file. Motion::GetContacts labels a motion once and keeps the labels with it.
+
+	File: FootContactHeader, then for each joint (numFrames + 63)/64 words, frame f in bit f%64
+	of word f/64.
+*/
+
+#ifndef _CONTACTS_H
+#define _CONTACTS_H
+
+#include <vector>
+
+#include "motion.h"
+#include "skeleton.h"
+#include "posture.h"
+#include "kinematics.h"
+
+#define CONTACT_BLOCK 256
+#define FOOT_CONTACT_MAGIC 0x4E4F4346		// "FCON"
+#define FOOT_CONTACT_VERSION 1
+
+enum ContactJoint
+{
+	CONTACT_LFOOT = 0, CONTACT_RFOOT, CONTACT_LTOES, CONTACT_RTOES, NUM_CONTACT_JOINTS
+};
+
+struct FootContactHeader
+{
+	unsigned int magic;
+	unsigned int version;
+	int numFrames;
+	int numJoints;
+};
+
+class FootContacts
+{
+	//member functions
+	public:
+		FootContacts();
+		~FootContacts();
+
+		int GetNumFrames() const { return m_NumFrames; }
+		bool IsContact(int nFrame, int nJoint) const { return (m_Bits[nJoint][nFrame >> 6] >> (nFrame & 63)) & 1; }
+		//Bit j for joint j
+		unsigned int GetMask(int nFrame) const;
+		//(GetNumFrames() + 63)/64 words, frame f in bit f%64 of word f/64
+		unsigned long long const *GetBits(int nJoint) const { return m_Bits[nJoint].data(); }
+		//Frames in contact
+		int Count(int nJoint) const;
+		//Runs of contact as first and last frame. Returns their number
+		int GetIntervals(int nJoint, std::vector<int> &firsts, std::vector<int> &lasts) const;
+
+		void Clear();
+		//Labels of the next frame: bit j for joint j
+		void Append(unsigned int nMask);
+
+		//Returns 0, -1 on error
+		int Write(char const *filename) const;
+		int Read(char const *filename);
+
+	//member variables
+	private:
+		int m_NumFrames;
+		std::vector<unsigned long long> m_Bits[NUM_CONTACT_JOINTS];
+};
+
+class ContactDetector
+{
+	//member functions
+	public:
+		ContactDetector(Skeleton *pActor);
+		~ContactDetector();
+
+		//Frames per second of the motions (default MOCAP_FRAME_RATE)
+		void SetFrameRate(float fRate) { m_FrameRate = fRate; }
+		//Height of the ground plane (default 0)
+		void SetGround(float fHeight) { m_Ground = fHeight; }
+		//Heights above the ground in skeleton units (default 0.07, 0.1)
+		void SetHeights(float fEnter, float fLeave);
+		//Speeds in units per second (default 0.5, 0.9)
+		void SetSpeeds(float fEnter, float fLeave);
+		//Bone of the joint, -1 if the skeleton has none (then it never touches the ground)
+		int GetBone(int nJoint) const { return m_Bones[nJoint]; }
+
+		//Label the whole motion (at its frame rate) into pContacts. Returns 0, -1 on error
+		int Detect(Motion *pMotion, FootContacts *pContacts);
+
+		//Streaming: the frames that are labeled are appended to pContacts. Returns their number
+		int Push(Posture const *pFrames, int nCount, FootContacts *pContacts);
+		int Flush(FootContacts *pContacts);
+		void Reset();
+
+	private:
+		//Frames nFirst .. nFirst+nCount-1 of a stream of nEnd frames so far, from the joint rows
+		//(NUM_CONTACT_JOINTS*3 floats per frame) starting at frame nRowBase
+		void Label(float const *pRows, int nRowBase, int nFirst, int nCount, int nEnd, FootContacts *pContacts);
+
+	//member variables
+	private:
+		MotionKinematics m_Kinematics;
+		int m_NumBones;
+		int m_Bones[NUM_CONTACT_JOINTS];
+		float m_FrameRate, m_Ground;
+		float m_EnterHeight, m_LeaveHeight, m_EnterSpeed, m_LeaveSpeed;
+
+		//stream: joint rows of the last two frames, the label of the last labeled frame
+		int m_NumIn;
+		float m_Carry[2][NUM_CONTACT_JOINTS*3];
+		bool m_State[NUM_CONTACT_JOINTS];
+		std::vector<float> m_Positions, m_Rows;
+};
+
+#endif
@@ -6,13 +6,14 @@
 #include <cstdio>
 #include <cstring>
 #include <cmath>
-#include <FL/glut.H>
 #include <GL/gl.h>     
+#include <GL/glu.h>
 #include "skeleton.h"
 #include "motion.h"
 #include "display.h"
 #include "transform.h"
 #include "types.h"
+#include "profiler.h"
 
 
 Display::Display()
@@ -51,16 +52,6 @@ static void draw_bone_axis()
    glEnd();
 }
 
-//Draws a line from point a to point b
-static void draw_vector(float *a, float *b) 
-{
-   glBegin(GL_LINES);
-   glColor3f(.5, .5, .5);
-   glVertex3f(a[0], a[1], a[2]);
-   glVertex3f(b[0], b[1], b[2]);
-   glEnd();
-}
-
 
 //Pre-draw the bones using quadratic object drawing function
 //and store them in the display list
@@ -103,7 +94,7 @@ void set_display_list(Bone *bone, GLuint *pBoneList)
 void Display::drawBone(Bone *pBone,int skelNum)
 {
 	static float z_dir[3] = {0., 0., 1.};
-	float r_axis[3], mag, theta;
+	float r_axis[3], theta;
 
 	//Tranform (rotate) from the local coordinate system of this bone to it's parent
 	//This step corresponds to doing: ModelviewMatrix = M_k * (rot_parent_current)
@@ -184,6 +175,7 @@ void Display::traverse(Bone *ptr,int skelNum)
 //Draw the skeleton
 void Display::show()
 {
+	PROFILE_SCOPE("Display::show");
 	        static int showed = 0;
         if (showed == 0){
 				for (int i = 0; i < numActors; i++)
@@ -204,7 +196,10 @@ void Display::show()
 		glRotatef(m_pActor[i]->rx,1,0,0);
 		glRotatef(m_pActor[i]->ry,0,1,0);
 		glRotatef(m_pActor[i]->rz,0,0,1);
-	   traverse(m_pActor[i]->getRoot(),i);
+		{
+			PROFILE_SCOPE("traverse");
+			traverse(m_pActor[i]->getRoot(),i);
+		}
    
 		glPopMatrix();
    }
@@ -0,0 +1,245 @@
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define DIST_SIMD_WIDTH 8
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DIST_SIMD_WIDTH 4
+#else
+#define DIST_SIMD_WIDTH 1
+#endif
+
+#include "distmatrix.h"
+#include "threadpool.h"
+
+
+/************************ Distance kernels **********************************/
+
+//Squared distances of row a to the rows b0..b3. n is a multiple of DIST_SIMD_WIDTH
+static inline void distances_1x4(float const *a, float const *b0, float const *b1, float const *b2, float const *b3,
+								 int n, float *pOut)
+{
+#if DIST_SIMD_WIDTH == 8
+	__m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps(), s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+	for (int i = 0; i < n; i += 8)
+	{
+		__m256 va = _mm256_loadu_ps(a + i);
+		__m256 d0 = _mm256_sub_ps(va, _mm256_loadu_ps(b0 + i));
+		__m256 d1 = _mm256_sub_ps(va, _mm256_loadu_ps(b1 + i));
+		__m256 d2 = _mm256_sub_ps(va, _mm256_loadu_ps(b2 + i));
+		__m256 d3 = _mm256_sub_ps(va, _mm256_loadu_ps(b3 + i));
+		s0 = _mm256_add_ps(s0, _mm256_mul_ps(d0, d0));
+		s1 = _mm256_add_ps(s1, _mm256_mul_ps(d1, d1));
+		s2 = _mm256_add_ps(s2, _mm256_mul_ps(d2, d2));
+		s3 = _mm256_add_ps(s3, _mm256_mul_ps(d3, d3));
+	}
+	//transpose-add the four accumulators into one vector of four sums
+	__m256 h01 = _mm256_hadd_ps(s0, s1);
+	__m256 h23 = _mm256_hadd_ps(s2, s3);
+	__m256 h = _mm256_hadd_ps(h01, h23);
+	__m128 sum = _mm_add_ps(_mm256_castps256_ps128(h), _mm256_extractf128_ps(h, 1));
+	_mm_storeu_ps(pOut, sum);
+#elif DIST_SIMD_WIDTH == 4
+	__m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps(), s2 = _mm_setzero_ps(), s3 = _mm_setzero_ps();
+	for (int i = 0; i < n; i += 4)
+	{
+		__m128 va = _mm_loadu_ps(a + i);
+		__m128 d0 = _mm_sub_ps(va, _mm_loadu_ps(b0 + i));
+		__m128 d1 = _mm_sub_ps(va, _mm_loadu_ps(b1 + i));
+		__m128 d2 = _mm_sub_ps(va, _mm_loadu_ps(b2 + i));
+		__m128 d3 = _mm_sub_ps(va, _mm_loadu_ps(b3 + i));
+		s0 = _mm_add_ps(s0, _mm_mul_ps(d0, d0));
+		s1 = _mm_add_ps(s1, _mm_mul_ps(d1, d1));
+		s2 = _mm_add_ps(s2, _mm_mul_ps(d2, d2));
+		s3 = _mm_add_ps(s3, _mm_mul_ps(d3, d3));
+	}
+	//4x4 transpose, then the columns are added
+	_MM_TRANSPOSE4_PS(s0, s1, s2, s3);
+	_mm_storeu_ps(pOut, _mm_add_ps(_mm_add_ps(s0, s1), _mm_add_ps(s2, s3)));
+#else
+	float s[4] = { 0, 0, 0, 0 };
+	float const *b[4] = { b0, b1, b2, b3 };
+	for (int k = 0; k < 4; k++)
+		for (int i = 0; i < n; i++)
+			s[k] += (a[i] - b[k][i])*(a[i] - b[k][i]);
+	memcpy(pOut, s, sizeof(s));
+#endif
+}
+
+static inline float distance_1x1(float const *a, float const *b, int n)
+{
+	float out[4];
+	distances_1x4(a, b, b, b, b, n, out);
+	return out[0];
+}
+
+
+/************************ DistanceMatrix class functions **********************************/
+DistanceMatrix::DistanceMatrix()
+{
+	m_NumA = m_NumB = 0;
+	m_Dimension = m_Stride = 0;
+	m_pA = m_pB = NULL;
+}
+
+DistanceMatrix::~DistanceMatrix()
+{
+	delete [] m_pA;
+	delete [] m_pB;
+}
+
+float *DistanceMatrix::CopyPadded(float const *pFeatures, int nNum, int nDimension, int nStride)
+{
+	float *pCopy = new float [(size_t)nNum*nStride];
+	for (int i = 0; i < nNum; i++)
+	{
+		memcpy(pCopy + (size_t)i*nStride, pFeatures + (size_t)i*nDimension, nDimension*sizeof(float));
+		for (int d = nDimension; d < nStride; d++)
+			pCopy[(size_t)i*nStride + d] = 0;
+	}
+	return pCopy;
+}
+
+void DistanceMatrix::SetFeatures(float const *pA, int nNumA, float const *pB, int nNumB, int nDimension)
+{
+	delete [] m_pA;
+	delete [] m_pB;
+	m_NumA = nNumA;
+	m_NumB = nNumB;
+	m_Dimension = nDimension;
+	m_Stride = (nDimension + DIST_SIMD_WIDTH - 1)/DIST_SIMD_WIDTH*DIST_SIMD_WIDTH;
+	m_pA = CopyPadded(pA, nNumA, nDimension, m_Stride);
+	m_pB = CopyPadded(pB, nNumB, nDimension, m_Stride);
+}
+
+void DistanceMatrix::SetMotions(Motion *pA, Motion *pB, PoseFeatureType type)
+{
+	PoseFeatures features(pA->pActor, type);
+	int nDim = features.GetDimension();
+	float *pFeaturesA = new float [(size_t)pA->m_NumFrames*nDim];
+	float *pFeaturesB = new float [(size_t)pB->m_NumFrames*nDim];
+	features.Compute(pA, pFeaturesA);
+	features.Compute(pB, pFeaturesB);
+	SetFeatures(pFeaturesA, pA->m_NumFrames, pFeaturesB, pB->m_NumFrames, nDim);
+	delete [] pFeaturesA;
+	delete [] pFeaturesB;
+}
+
+float DistanceMatrix::GetDistance(int nA, int nB) const
+{
+	return sqrtf(distance_1x1(m_pA + (size_t)nA*m_Stride, m_pB + (size_t)nB*m_Stride, m_Stride));
+}
+
+//Distances of rows [nRow, nRow+nRows) of A to rows [nCol, nCol+nCols) of B.
+//The B rows of a tile stay in cache while every A row of the tile is compared with them
+void DistanceMatrix::ComputeTile(int nRow, int nRows, int nCol, int nCols, float *pOut, int nOutStride) const
+{
+	for (int i = 0; i < nRows; i++)
+	{
+		float const *a = m_pA + (size_t)(nRow + i)*m_Stride;
+		float const *b = m_pB + (size_t)nCol*m_Stride;
+		float *pRow = pOut + (size_t)i*nOutStride;
+
+		int j = 0;
+		for (; j + 4 <= nCols; j += 4, b += 4*m_Stride)
+			distances_1x4(a, b, b + m_Stride, b + 2*m_Stride, b + 3*m_Stride, m_Stride, pRow + j);
+		for (; j < nCols; j++, b += m_Stride)
+			pRow[j] = distance_1x1(a, b, m_Stride);
+
+		for (j = 0; j < nCols; j++)
+			pRow[j] = sqrtf(pRow[j]);
+	}
+}
+
+void DistanceMatrix::ComputeRow(int nA, int nB, int nCount, float *pOut) const
+{
+	ComputeTile(nA, 1, nB, nCount, pOut, nCount);
+}
+
+void DistanceMatrix::Compute(float *pMatrix) const
+{
+	int nTileRows = (m_NumA + DIST_MATRIX_TILE - 1)/DIST_MATRIX_TILE;
+	int nTileCols = (m_NumB + DIST_MATRIX_TILE - 1)/DIST_MATRIX_TILE;
+
+	ThreadPool::GetDefault().ParallelFor(0, nTileRows*nTileCols, [&](int nBegin, int nEnd, int nThread)
+	{
+		for (int t = nBegin; t < nEnd; t++)
+		{
+			int nRow = (t/nTileCols)*DIST_MATRIX_TILE, nCol = (t%nTileCols)*DIST_MATRIX_TILE;
+			int nRows = std::min(DIST_MATRIX_TILE, m_NumA - nRow), nCols = std::min(DIST_MATRIX_TILE, m_NumB - nCol);
+			ComputeTile(nRow, nRows, nCol, nCols, pMatrix + (size_t)nRow*m_NumB + nCol, m_NumB);
+		}
+	});
+}
+
+int DistanceMatrix::FindLocalMinima(float fThreshold, std::vector<DistanceMinimum> &minima) const
+{
+	int nTileRows = (m_NumA + DIST_MATRIX_TILE - 1)/DIST_MATRIX_TILE;
+	int nTileCols = (m_NumB + DIST_MATRIX_TILE - 1)/DIST_MATRIX_TILE;
+	int nThreads = ThreadPool::GetDefault().GetNumThreads();
+	int const nSize = DIST_MATRIX_TILE + 2;
+
+	//per thread: a tile with its border, and the minima found
+	std::vector<float> tiles((size_t)nThreads*nSize*nSize);
+	std::vector<std::vector<DistanceMinimum> > found(nThreads);
+
+	ThreadPool::GetDefault().ParallelFor(0, nTileRows*nTileCols, [&](int nBegin, int nEnd, int nThread)
+	{
+		float *pTile = &tiles[(size_t)nThread*nSize*nSize];
+		for (int t = nBegin; t < nEnd; t++)
+		{
+			int nRow = (t/nTileCols)*DIST_MATRIX_TILE, nCol = (t%nTileCols)*DIST_MATRIX_TILE;
+			int nRowEnd = std::min(nRow + DIST_MATRIX_TILE, m_NumA), nColEnd = std::min(nCol + DIST_MATRIX_TILE, m_NumB);
+
+			//the border rows and columns that exist in the matrix
+			int r0 = std::max(nRow - 1, 0), r1 = std::min(nRowEnd + 1, m_NumA);
+			int c0 = std::max(nCol - 1, 0), c1 = std::min(nColEnd + 1, m_NumB);
+			ComputeTile(r0, r1 - r0, c0, c1 - c0, pTile, nSize);
+
+			for (int i = nRow; i < nRowEnd; i++)
+				for (int j = nCol; j < nColEnd; j++)
+				{
+					float d = pTile[(i - r0)*nSize + (j - c0)];
+					if (d >= fThreshold)
+						continue;
+
+					//strictly smaller than the neighbours before it, not larger than those after it,
+					//so that a plateau gives a single minimum
+					bool bMinimum = true;
+					for (int di = -1; di <= 1 && bMinimum; di++)
+						for (int dj = -1; dj <= 1; dj++)
+						{
+							int ni = i + di, nj = j + dj;
+							if ((di == 0 && dj == 0) || ni < r0 || ni >= r1 || nj < c0 || nj >= c1)
+								continue;
+							float n = pTile[(ni - r0)*nSize + (nj - c0)];
+							bool bBefore = di < 0 || (di == 0 && dj < 0);
+							if (bBefore ? n <= d : n < d)
+							{
+								bMinimum = false;
+								break;
+							}
+						}
+					if (bMinimum)
+					{
+						DistanceMinimum m = { i, j, d };
+						found[nThread].push_back(m);
+					}
+				}
+		}
+	});
+
+	minima.clear();
+	for (int t = 0; t < nThreads; t++)
+		minima.insert(minima.end(), found[t].begin(), found[t].end());
+	std::sort(minima.begin(), minima.end(), [](DistanceMinimum const& a, DistanceMinimum const& b)
+	{
+		if (a.distance != b.distance)
+			return a.distance < b.distance;
+		return a.frameA != b.frameA ? a.frameA < b.frameA : a.frameB < b.frameB;
+	});
+	return (int)minima.size();
+}
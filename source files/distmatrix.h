@@ -0,0 +1,74 @@
+/*
+	distmatrix.h
+
+	Pose distance between every frame of a motion A and every frame of a motion B,
+	as used to find transition points between clips.
+
+	The frames are turned into PoseFeatures (or given as feature rows directly) and the distance
+	of frames i and j is the Euclidean distance of their features. The matrix is computed in
+	square tiles of DIST_MATRIX_TILE frames, spread over the thread pool; inside a tile one frame
+	of A is compared with four frames of B at a time by SSE/AVX kernels.
+
+	Compute fills the whole nA x nB matrix. FindLocalMinima never stores it: every tile is computed
+	with a one frame border, the local minima below the threshold are kept and the tile is dropped,
+	so the memory used does not depend on the length of the motions.
+*/
+
+#ifndef _DISTMATRIX_H
+#define _DISTMATRIX_H
+
+#include <vector>
+
+#include "motion.h"
+#include "poseindex.h"
+
+#define DIST_MATRIX_TILE 128
+
+//Frame pair that is closer than its eight neighbours in the matrix
+struct DistanceMinimum
+{
+	int frameA;
+	int frameB;
+	float distance;
+};
+
+class DistanceMatrix
+{
+	//member functions
+	public:
+		DistanceMatrix();
+		~DistanceMatrix();
+
+		//Features of the frames of both motions (the motions may be the same)
+		void SetMotions(Motion *pA, Motion *pB, PoseFeatureType type = POSE_FEATURE_JOINTS);
+		//nDimension floats per frame
+		void SetFeatures(float const *pA, int nNumA, float const *pB, int nNumB, int nDimension);
+
+		int GetNumRows() const { return m_NumA; }
+		int GetNumColumns() const { return m_NumB; }
+
+		//Distance of frame nA of motion A and frame nB of motion B
+		float GetDistance(int nA, int nB) const;
+
+		//The whole matrix, row major (m_NumA x m_NumB)
+		void Compute(float *pMatrix) const;
+		//Distances of frame nA of motion A to the frames [nB, nB + nCount) of motion B
+		void ComputeRow(int nA, int nB, int nCount, float *pOut) const;
+
+		//Local minima of the matrix with a distance below fThreshold, sorted by distance.
+		//Returns the number of minima
+		int FindLocalMinima(float fThreshold, std::vector<DistanceMinimum> &minima) const;
+
+	private:
+		void ComputeTile(int nRow, int nRows, int nCol, int nCols, float *pOut, int nOutStride) const;
+		static float *CopyPadded(float const *pFeatures, int nNum, int nDimension, int nStride);
+
+	//member variables
+	private:
+		int m_NumA, m_NumB;
+		int m_Dimension;
+		int m_Stride;					// m_Dimension rounded up to the SIMD width, zero padded
+		float *m_pA, *m_pB;
+};
+
+#endif
@@ -0,0 +1,335 @@
+#include <cstring>
+#include <cstdint>
+#include <charconv>
+#include <algorithm>
+
+#include "export.h"
+#include "kinematics.h"
+#include "threadpool.h"
+
+//Longest text of a float from std::to_chars, with the comma before it
+#define EXPORT_MAX_FLOAT_TEXT 16
+
+static char const *positionNames[3] = { "px", "py", "pz" };
+
+
+//'*' matches any text, everything else itself
+static bool match_pattern(char const *pPattern, char const *pName)
+{
+	if (*pPattern == '\0')
+		return *pName == '\0';
+	if (*pPattern == '*')
+	{
+		for (char const *p = pName; ; p++)
+		{
+			if (match_pattern(pPattern + 1, p))
+				return true;
+			if (*p == '\0')
+				return false;
+		}
+	}
+	return *pName == *pPattern && match_pattern(pPattern + 1, pName + 1);
+}
+
+static inline uint32_t swap_bytes(uint32_t v)
+{
+	return (v >> 24) | ((v >> 8) & 0xFF00) | ((v << 8) & 0xFF0000) | (v << 24);
+}
+
+static bool is_little_endian()
+{
+	uint32_t v = 1;
+	return *(unsigned char *)&v == 1;
+}
+
+
+/************************ MotionExporter class functions **********************************/
+MotionExporter::MotionExporter(Skeleton *pActor, float scale) : m_Layout(pActor)
+{
+	m_Scale = scale;
+	m_NumBytes = 0;
+
+	char str[256];
+	for (int c = 0; c < m_Layout.m_NumChannels; c++)
+	{
+		m_Layout.GetName(c, str);
+		Column column = { str, c, -1, -1, m_Layout.IsAngle(c) };
+		m_Columns.push_back(column);
+	}
+	Bone *pBones = pActor->getRoot();
+	for (int b = 0; b < pActor->NUM_BONES_IN_ASF_FILE; b++)
+		for (int a = 0; a < 3; a++)
+		{
+			Column column = { std::string(pBones[b].name) + "." + positionNames[a], -1, b, a, false };
+			m_Columns.push_back(column);
+		}
+}
+
+MotionExporter::~MotionExporter()
+{
+}
+
+int MotionExporter::Select(char const *pPattern)
+{
+	int nAdded = 0;
+	bool bMatch = false;
+	for (int c = 0; c < (int)m_Columns.size(); c++)
+	{
+		if (!match_pattern(pPattern, m_Columns[c].name.c_str()))
+			continue;
+		bMatch = true;
+		if (std::find(m_Selected.begin(), m_Selected.end(), c) == m_Selected.end())
+		{
+			m_Selected.push_back(c);
+			nAdded++;
+		}
+	}
+	if (!bMatch)
+	{
+		printf("MotionExporter: no column matches '%s'\n", pPattern);
+		return -1;
+	}
+	return nAdded;
+}
+
+void MotionExporter::GatherFrames(Motion *pMotion, MotionKinematics const *pKinematics, int nFirst, int nCount,
+	float *pValues) const
+{
+	int S = (int)m_Selected.size();
+	float row[MAX_CHANNELS];
+	for (int i = 0; i < nCount; i++)
+	{
+		int f = nFirst + i;
+		m_Layout.Gather(pMotion->m_pPostures[f], row);
+		float *pOut = &pValues[(size_t)i*S];
+		for (int s = 0; s < S; s++)
+		{
+			Column const &column = m_Columns[m_Selected[s]];
+			float v = column.channel >= 0 ? row[column.channel] : pKinematics->GetPosition(f, column.bone)[column.axis];
+			pOut[s] = column.angle ? v : v/m_Scale;
+		}
+	}
+}
+
+inline bool MotionExporter::Put(FILE *pFile, void const *pData, size_t nSize)
+{
+	m_NumBytes += nSize;
+	return nSize == 0 || fwrite(pData, 1, nSize, pFile) == nSize;
+}
+
+int MotionExporter::Write(Motion *pMotion, char const *filename, ExportFormat format)
+{
+	m_NumBytes = 0;
+	if (pMotion == NULL || pMotion->m_NumFrames <= 0 || m_Selected.empty())
+		return -1;
+
+	//the kinematics only when positions are selected
+	MotionKinematics const *pKinematics = NULL;
+	for (int s = 0; s < (int)m_Selected.size() && pKinematics == NULL; s++)
+		if (m_Columns[m_Selected[s]].channel < 0)
+		{
+			pKinematics = pMotion->GetKinematics();
+			if (pKinematics == NULL)
+				return -1;
+		}
+
+	FILE *pFile = fopen(filename, "wb");
+	if (pFile == NULL)
+	{
+		printf("MotionExporter: cannot create %s\n", filename);
+		return -1;
+	}
+	//the batches are written in large blocks already
+	setvbuf(pFile, NULL, _IONBF, 0);
+
+	int nResult = -1;
+	if (format == EXPORT_MRDPLOT)
+		nResult = WriteMRDPlot(pMotion, pKinematics, pFile);
+	else if (format == EXPORT_CSV)
+		nResult = WriteCSV(pMotion, pKinematics, pFile);
+	else if (format == EXPORT_COLUMNS)
+		nResult = WriteColumns(pMotion, pKinematics, pFile);
+	if (fclose(pFile) != 0)
+		nResult = -1;
+	if (nResult != 0)
+		printf("MotionExporter: failed to write %s\n", filename);
+	return nResult;
+}
+
+int MotionExporter::WriteMRDPlot(Motion *pMotion, MotionKinematics const *pKinematics, FILE *pFile)
+{
+	int S = (int)m_Selected.size(), n = pMotion->m_NumFrames;
+	std::string header;
+	char str[512];
+	snprintf(str, sizeof(str), "%lld %d %d %f\n", (long long)S*n, S, n, pMotion->m_FrameRate);
+	header += str;
+	for (int s = 0; s < S; s++)
+	{
+		Column const &column = m_Columns[m_Selected[s]];
+		snprintf(str, sizeof(str), "%s %s\n", column.name.c_str(), column.angle ? "deg" : "units");
+		header += str;
+	}
+	header += "\n";
+	if (!Put(pFile, header.data(), header.size()))
+		return -1;
+
+	//batches of whole pieces, frame by frame
+	int nBatch = std::max(EXPORT_BUFFER_SIZE/(S*(int)sizeof(float))/EXPORT_PIECE, 1)*EXPORT_PIECE;
+	std::vector<float> buffer((size_t)std::min(nBatch, n)*S);
+	bool bSwap = is_little_endian();
+	ThreadPool& pool = ThreadPool::GetDefault();
+	for (int nFirst = 0; nFirst < n; nFirst += nBatch)
+	{
+		int nCount = std::min(nBatch, n - nFirst);
+		pool.ParallelFor(0, nCount, [&](int nBegin, int nEnd, int nThread)
+		{
+			float *pValues = &buffer[(size_t)nBegin*S];
+			GatherFrames(pMotion, pKinematics, nFirst + nBegin, nEnd - nBegin, pValues);
+			if (bSwap)
+			{
+				uint32_t *pWords = (uint32_t *)pValues;
+				for (size_t i = 0; i < (size_t)(nEnd - nBegin)*S; i++)
+					pWords[i] = swap_bytes(pWords[i]);
+			}
+		}, EXPORT_PIECE);
+		if (!Put(pFile, buffer.data(), (size_t)nCount*S*sizeof(float)))
+			return -1;
+	}
+	return 0;
+}
+
+int MotionExporter::WriteCSV(Motion *pMotion, MotionKinematics const *pKinematics, FILE *pFile)
+{
+	int S = (int)m_Selected.size(), n = pMotion->m_NumFrames;
+	std::string header = "frame,time";
+	for (int s = 0; s < S; s++)
+		header += "," + m_Columns[m_Selected[s]].name;
+	header += "\n";
+	if (!Put(pFile, header.data(), header.size()))
+		return -1;
+
+	//every piece of a batch is formatted into its own text and written in order
+	size_t nRowSize = (size_t)(S + 2)*EXPORT_MAX_FLOAT_TEXT + 1;
+	int nPieces = (int)std::max((size_t)EXPORT_BUFFER_SIZE/(nRowSize*EXPORT_PIECE), (size_t)1);
+	std::vector<std::vector<char> > texts(nPieces);
+	std::vector<size_t> used(nPieces);
+	ThreadPool& pool = ThreadPool::GetDefault();
+	for (int nFirst = 0; nFirst < n; nFirst += nPieces*EXPORT_PIECE)
+	{
+		int nBatchPieces = std::min(nPieces, (n - nFirst + EXPORT_PIECE - 1)/EXPORT_PIECE);
+		pool.ParallelFor(0, nBatchPieces, [&](int nBegin, int nEnd, int nThread)
+		{
+			std::vector<float> values((size_t)EXPORT_PIECE*S);
+			for (int p = nBegin; p < nEnd; p++)
+			{
+				int nStart = nFirst + p*EXPORT_PIECE, nCount = std::min(EXPORT_PIECE, n - nStart);
+				GatherFrames(pMotion, pKinematics, nStart, nCount, values.data());
+				std::vector<char> &text = texts[p];
+				text.resize(nRowSize*nCount);
+				char *pOut = text.data(), *pEnd = pOut + text.size();
+				for (int i = 0; i < nCount; i++)
+				{
+					int f = nStart + i;
+					pOut = std::to_chars(pOut, pEnd, f + 1).ptr;
+					*pOut++ = ',';
+					pOut = std::to_chars(pOut, pEnd, f/pMotion->m_FrameRate).ptr;
+					float const *pRow = &values[(size_t)i*S];
+					for (int s = 0; s < S; s++)
+					{
+						*pOut++ = ',';
+						pOut = std::to_chars(pOut, pEnd, pRow[s]).ptr;
+					}
+					*pOut++ = '\n';
+				}
+				used[p] = pOut - text.data();
+			}
+		});
+		for (int p = 0; p < nBatchPieces; p++)
+			if (!Put(pFile, texts[p].data(), used[p]))
+				return -1;
+	}
+	return 0;
+}
+
+int MotionExporter::WriteColumns(Motion *pMotion, MotionKinematics const *pKinematics, FILE *pFile)
+{
+	int S = (int)m_Selected.size(), n = pMotion->m_NumFrames;
+	int nChunks = (n + EXPORT_CHUNK - 1)/EXPORT_CHUNK;
+	ExportColumnsHeader header = { EXPORT_COLUMNS_MAGIC, EXPORT_COLUMNS_VERSION, S, n, EXPORT_CHUNK, nChunks,
+		pMotion->m_FrameRate, 0 };
+	std::vector<ExportColumnInfo> infos(S);
+	for (int s = 0; s < S; s++)
+	{
+		Column const &column = m_Columns[m_Selected[s]];
+		memset(&infos[s], 0, sizeof(ExportColumnInfo));
+		strncpy(infos[s].name, column.name.c_str(), sizeof(infos[s].name) - 1);
+		infos[s].isAngle = column.angle ? 1 : 0;
+	}
+
+	//every column chunk padded to 64 bytes, so all the offsets are known before encoding
+	std::vector<ExportChunkInfo> directory((size_t)nChunks*S);
+	size_t nDirectory = sizeof(header) + S*sizeof(ExportColumnInfo) + directory.size()*sizeof(ExportChunkInfo);
+	size_t nDataStart = (nDirectory + 63) & ~(size_t)63;
+	size_t nChunkBytes = (size_t)EXPORT_CHUNK*sizeof(float);
+	size_t nLastBytes = ((size_t)(n - (nChunks - 1)*EXPORT_CHUNK)*sizeof(float) + 63) & ~(size_t)63;
+	for (int k = 0; k < nChunks; k++)
+		for (int s = 0; s < S; s++)
+			directory[(size_t)k*S + s].offset = nDataStart + (size_t)k*S*nChunkBytes + s*(k < nChunks - 1 ? nChunkBytes : nLastBytes);
+
+	//the directory is written again with the min and max of the chunks at the end
+	std::vector<char> head(nDataStart, 0);
+	memcpy(&head[0], &header, sizeof(header));
+	memcpy(&head[sizeof(header)], infos.data(), S*sizeof(ExportColumnInfo));
+	if (!Put(pFile, head.data(), head.size()))
+		return -1;
+
+	int nBatch = (int)std::max((size_t)EXPORT_BUFFER_SIZE/(S*nChunkBytes), (size_t)1);
+	std::vector<char> buffer((size_t)std::min(nBatch, nChunks)*S*nChunkBytes);
+	ThreadPool& pool = ThreadPool::GetDefault();
+	std::vector<std::vector<float> > rows(pool.GetNumThreads());
+	for (int nFirst = 0; nFirst < nChunks; nFirst += nBatch)
+	{
+		int nCount = std::min(nBatch, nChunks - nFirst);
+		pool.ParallelFor(0, nCount, [&](int nBegin, int nEnd, int nThread)
+		{
+			std::vector<float> &values = rows[nThread];
+			values.resize((size_t)EXPORT_CHUNK*S);
+			for (int k = nBegin; k < nEnd; k++)
+			{
+				int nChunk = nFirst + k, nStart = nChunk*EXPORT_CHUNK, nFrames = std::min(EXPORT_CHUNK, n - nStart);
+				GatherFrames(pMotion, pKinematics, nStart, nFrames, values.data());
+				size_t nColumnBytes = nChunk < nChunks - 1 ? nChunkBytes : nLastBytes;
+				char *pChunk = &buffer[(size_t)k*S*nChunkBytes];
+				memset(pChunk, 0, S*nColumnBytes);
+				for (int s = 0; s < S; s++)
+				{
+					float *pColumn = (float *)(pChunk + s*nColumnBytes);
+					float fMin = values[s], fMax = values[s];
+					for (int i = 0; i < nFrames; i++)
+					{
+						float v = values[(size_t)i*S + s];
+						pColumn[i] = v;
+						fMin = std::min(fMin, v);
+						fMax = std::max(fMax, v);
+					}
+					if (!is_little_endian())
+						for (int i = 0; i < nFrames; i++)
+							((uint32_t *)pColumn)[i] = swap_bytes(((uint32_t *)pColumn)[i]);
+					directory[(size_t)nChunk*S + s].min = fMin;
+					directory[(size_t)nChunk*S + s].max = fMax;
+				}
+			}
+		});
+		size_t nBytes = (size_t)nCount*S*nChunkBytes;
+		if (nFirst + nCount == nChunks)
+			nBytes -= S*(nChunkBytes - nLastBytes);
+		if (!Put(pFile, buffer.data(), nBytes))
+			return -1;
+	}
+
+	size_t nDirectoryOffset = sizeof(header) + S*sizeof(ExportColumnInfo);
+	if (fseek(pFile, (long)nDirectoryOffset, SEEK_SET) != 0 ||
+		fwrite(directory.data(), sizeof(ExportChunkInfo), directory.size(), pFile) != directory.size())
+		return -1;
+	return 0;
+}
@@ -0,0 +1,128 @@
+/*
+	export.h
+
+	Export of motion trajectories for plotting and analysis tools.
+
+	The columns that can be exported are the channels of the motion (see channels.h, e.g.
+	"lfemur.rx" or "root.ty") and the world positions of the end points of the bones from the
+	forward kinematics (see kinematics.h), "<bone>.px", "<bone>.py" and "<bone>.pz". Select adds
+	the columns whose names match a pattern, where '*' stands for any text ("*" for all of them,
+	"rfemur.*", "*.py"), in the order they are selected. Angles are in degrees; translations and
+	positions are divided by the scale given to the exporter (1 keeps skeleton units, the scale
+	the motion was read with gives the units of the AMC file).
+
+	Formats:
+		EXPORT_MRDPLOT  the mrdplot file: a text line "<values> <columns> <frames> <frequency>",
+		                a line "<name> <units>" per column, an empty line, then the values as
+		                big-endian floats, frame by frame
+		EXPORT_CSV      a header line "frame,time,<names>", then one line per frame (frames from
+		                1, as in the AMC file, time in seconds), shortest round-trip float text
+		EXPORT_COLUMNS  binary columns: ExportColumnsHeader, ExportColumnInfo for every column,
+		                ExportChunkInfo for every column of every chunk (chunk by chunk), then the
+		                chunks, EXPORT_CHUNK frames of every column in turn as little-endian floats
+		                (the last chunk holds fewer frames). Every column chunk starts at a multiple
+		                of 64 bytes of the file, so a mapped file can be read in place
+
+	The values are read straight from the postures and the kinematics of the motion. The frames
+	are encoded in batches of about EXPORT_BUFFER_SIZE bytes: the pieces of a batch (runs of
+	frames for mrdplot and CSV, chunks for the columns, whose column chunks are encoded together)
+	are spread over the thread pool, and the batch is written with one call per piece, or one for
+	the whole batch when the pieces have a fixed size.
+*/
+
+#ifndef _EXPORT_H
+#define _EXPORT_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "motion.h"
+#include "skeleton.h"
+#include "channels.h"
+
+#define EXPORT_BUFFER_SIZE (4 << 20)
+#define EXPORT_CHUNK 4096					// frames of a chunk of EXPORT_COLUMNS
+#define EXPORT_PIECE 256					// frames encoded by one task for mrdplot and CSV
+
+#define EXPORT_COLUMNS_MAGIC 0x4C4F434D		// "MCOL"
+#define EXPORT_COLUMNS_VERSION 1
+
+enum ExportFormat
+{
+	EXPORT_MRDPLOT = 0, EXPORT_CSV, EXPORT_COLUMNS
+};
+
+struct ExportColumnsHeader
+{
+	unsigned int magic;
+	unsigned int version;
+	int numColumns;
+	int numFrames;
+	int chunkFrames;
+	int numChunks;
+	float frameRate;
+	int reserved;
+};
+
+struct ExportColumnInfo
+{
+	char name[60];
+	int isAngle;							// 1 for degrees, 0 for translations and positions
+};
+
+struct ExportChunkInfo
+{
+	unsigned long long offset;				// from the start of the file
+	float min, max;
+};
+
+class MotionExporter
+{
+	//member functions
+	public:
+		MotionExporter(Skeleton *pActor, float scale = 1.0f);
+		~MotionExporter();
+
+		//Columns that can be selected
+		int GetNumAvailable() const { return (int)m_Columns.size(); }
+		char const *GetAvailableName(int nColumn) const { return m_Columns[nColumn].name.c_str(); }
+
+		//Add the columns matching pPattern that are not selected yet. Returns how many, -1 if no column matches
+		int Select(char const *pPattern);
+		void SelectAll() { Select("*"); }
+		void ClearSelection() { m_Selected.clear(); }
+		int GetNumSelected() const { return (int)m_Selected.size(); }
+		char const *GetSelectedName(int nSelected) const { return m_Columns[m_Selected[nSelected]].name.c_str(); }
+
+		//Write the selected columns of every frame of the motion. Returns 0, -1 on error
+		int Write(Motion *pMotion, char const *filename, ExportFormat format);
+		//Bytes of the last file written
+		long long GetNumBytes() const { return m_NumBytes; }
+
+	private:
+		//Selected columns of nCount frames from nFirst into pValues, frame by frame
+		void GatherFrames(Motion *pMotion, MotionKinematics const *pKinematics, int nFirst, int nCount, float *pValues) const;
+		int WriteMRDPlot(Motion *pMotion, MotionKinematics const *pKinematics, FILE *pFile);
+		int WriteCSV(Motion *pMotion, MotionKinematics const *pKinematics, FILE *pFile);
+		int WriteColumns(Motion *pMotion, MotionKinematics const *pKinematics, FILE *pFile);
+		bool Put(FILE *pFile, void const *pData, size_t nSize);
+
+	//member variables
+	private:
+		struct Column
+		{
+			std::string name;
+			int channel;					// channel of the layout, -1 for a position
+			int bone, axis;					// of a position
+			bool angle;
+		};
+
+		ChannelLayout m_Layout;
+		float m_Scale;
+		std::vector<Column> m_Columns;
+		std::vector<int> m_Selected;
+		long long m_NumBytes;
+};
+
+#endif
@@ -0,0 +1,395 @@
+#include <cmath>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+
+#include "footlock.h"
+#include "transform.h"
+#include "threadpool.h"
+
+static char const *legBoneNames[2][NUM_LEG_BONES] =
+{
+	{ "lfemur", "ltibia", "lfoot", "ltoes" }, { "rfemur", "rtibia", "rfoot", "rtoes" }
+};
+
+
+static float dot3(float const a[3], float const b[3])
+{
+	return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+static void cross3(float const a[3], float const b[3], float c[3])
+{
+	c[0] = a[1]*b[2] - a[2]*b[1];
+	c[1] = a[2]*b[0] - a[0]*b[2];
+	c[2] = a[0]*b[1] - a[1]*b[0];
+}
+
+static float distance3(float const a[3], float const b[3])
+{
+	float d[3] = { a[0] - b[0], a[1] - b[1], a[2] - b[2] };
+	return sqrtf(dot3(d, d));
+}
+
+//World rotations (Rb before and Rc after the rotation of the bone, as computeJointPositions) and
+//end points of the bones of a leg, from the rotation R and end point hip of the bone before it
+static void leg_kinematics(Bone const *pBones, int const *pLeg, Posture const& posture, float const R[3][3], float const hip[3],
+	float Rb[NUM_LEG_BONES][3][3], float Rc[NUM_LEG_BONES][3][3], float ends[NUM_LEG_BONES][3])
+{
+	float const (*Rp)[3] = R;
+	float const *start = hip;
+	for (int i = 0; i < NUM_LEG_BONES; i++)
+	{
+		Bone const& bone = pBones[pLeg[i]];
+		float const *p = posture.bone_rotation[bone.idx].p;
+		float angles[3] = { bone.dofx ? p[0] : 0.0f, bone.dofy ? p[1] : 0.0f, bone.dofz ? p[2] : 0.0f };
+		float Rl[3][3];
+		euler_to_matrix(angles, Rl);
+		for (int r = 0; r < 3; r++)
+			for (int c = 0; c < 3; c++)
+				Rb[i][r][c] = Rp[r][0]*bone.rot_parent_current[c][0] + Rp[r][1]*bone.rot_parent_current[c][1] +
+					Rp[r][2]*bone.rot_parent_current[c][2];
+		matrix3_multiply(Rb[i], Rl, Rc[i]);
+		for (int r = 0; r < 3; r++)
+			ends[i][r] = start[r] + (Rc[i][r][0]*bone.dir[0] + Rc[i][r][1]*bone.dir[1] + Rc[i][r][2]*bone.dir[2])*bone.length;
+		Rp = Rc[i];
+		start = ends[i];
+	}
+}
+
+//Rotation about the unit axis through pivot that brings effector closest to target (radians)
+static float hinge_angle(float const axis[3], float const pivot[3], float const effector[3], float const target[3])
+{
+	float a[3], b[3];
+	for (int i = 0; i < 3; i++)
+	{
+		a[i] = effector[i] - pivot[i];
+		b[i] = target[i] - pivot[i];
+	}
+	float ka = dot3(axis, a), kb = dot3(axis, b);
+	for (int i = 0; i < 3; i++)
+	{
+		a[i] -= axis[i]*ka;
+		b[i] -= axis[i]*kb;
+	}
+	float c[3];
+	cross3(a, b, c);
+	return atan2f(dot3(axis, c), dot3(a, b));
+}
+
+
+/************************ FootLocker class functions **********************************/
+FootLocker::FootLocker(Skeleton *pActor) : m_Kinematics(pActor)
+{
+	m_pActor = pActor;
+	m_NumBones = m_Kinematics.GetNumBones();
+	m_Ground = 0;
+	m_BlendFrames = FOOTLOCK_BLEND;
+	m_Tolerance = 0.001f;
+	m_MaxIterations = 8;
+	m_NumSolved = 0;
+
+	Bone *pBones = pActor->getRoot();
+	int parent[MAX_BONES_IN_ASF_FILE];
+	for (int b = 0; b < m_NumBones; b++)
+		parent[b] = -1;
+	for (int b = 0; b < m_NumBones; b++)
+		for (Bone *pChild = pBones[b].child; pChild != NULL; pChild = pChild->sibling)
+			parent[pChild->idx] = b;
+
+	int joints[2][2] = { { CONTACT_LFOOT, CONTACT_LTOES }, { CONTACT_RFOOT, CONTACT_RTOES } };
+	for (int l = 0; l < 2; l++)
+	{
+		m_Joints[l][0] = joints[l][0];
+		m_Joints[l][1] = joints[l][1];
+		for (int i = 0; i < NUM_LEG_BONES; i++)
+		{
+			m_Legs[l][i] = -1;
+			for (int b = 0; b < m_NumBones; b++)
+				if (strcmp(pBones[b].name, legBoneNames[l][i]) == 0)
+					m_Legs[l][i] = b;
+		}
+		//a chain femur - tibia - foot - toes below a parent, with a knee hinge
+		bool bChain = m_Legs[l][LEG_FEMUR] >= 0 && parent[m_Legs[l][LEG_FEMUR]] >= 0;
+		for (int i = 1; i < NUM_LEG_BONES && bChain; i++)
+			bChain = m_Legs[l][i] >= 0 && parent[m_Legs[l][i]] == m_Legs[l][i - 1];
+		bChain = bChain && pBones[m_Legs[l][LEG_TIBIA]].dofx;
+		m_Hips[l] = bChain ? parent[m_Legs[l][LEG_FEMUR]] : -1;
+		if (!bChain)
+			m_Legs[l][LEG_FEMUR] = -1;
+	}
+}
+
+FootLocker::~FootLocker()
+{
+}
+
+void FootLocker::SetTolerance(float fDistance, int nIterations)
+{
+	m_Tolerance = fDistance;
+	m_MaxIterations = std::max(nIterations, 0);
+}
+
+float FootLocker::GetMaxResidual() const
+{
+	float fMax = 0;
+	for (int f = 0; f < (int)m_Residual.size(); f++)
+		fMax = std::max(fMax, m_Residual[f]);
+	return fMax;
+}
+
+int FootLocker::SolveLeg(int nLeg, Posture &posture, float const R[3][3], float const hip[3], float const pTargets[2][3],
+	float const pWeights[2], float &fResidual) const
+{
+	Bone *pBones = m_pActor->getRoot();
+	int const *pLeg = m_Legs[nLeg];
+	float Rb[NUM_LEG_BONES][3][3], Rc[NUM_LEG_BONES][3][3], ends[NUM_LEG_BONES][3];
+	leg_kinematics(pBones, pLeg, posture, R, hip, Rb, Rc, ends);
+
+	//targets of foot (its end point) and toes, faded towards where they are. The ankle follows
+	//the joint locked more; when the toes lead, the foot end (the heel fading out of a lock as
+	//it lifts) only follows the leg
+	float goal[2][3], foot[3][3];
+	for (int j = 0; j < 2; j++)
+		for (int i = 0; i < 3; i++)
+			goal[j][i] = ends[LEG_FOOT + j][i] + pWeights[j]*(pTargets[j][i] - ends[LEG_FOOT + j][i]);
+	int nLead = pWeights[1] > pWeights[0] ? 1 : 0;
+	bool bToes = nLead == 0 && pWeights[1] > 0;
+	memcpy(foot, Rc[LEG_FOOT], sizeof(foot));
+
+	//the toes are rigid: their target from the run means may not be a toes length from the foot target
+	if (bToes)
+	{
+		float t[3], fLength = pBones[pLeg[LEG_TOES]].length;
+		for (int i = 0; i < 3; i++)
+			t[i] = goal[1][i] - goal[0][i];
+		float fDistance = sqrtf(dot3(t, t));
+		if (fDistance > 1e-8f)
+			for (int i = 0; i < 3; i++)
+				goal[1][i] = goal[0][i] + t[i]*fLength/fDistance;
+	}
+
+	//the angles of the leg with the smallest residual so far
+	float best[NUM_LEG_BONES][3], fBest = 1e30f, fPrevious = 1e30f;
+	//turn of the foot about its end the previous iteration asked for (toes locked too)
+	float S[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+	int nIterations = 0;
+	while (true)
+	{
+		//the ankle moves as much as the leading joint has to, keeping the orientation of the foot
+		//(turned by S)
+		float ankle[3], e[3];
+		for (int i = 0; i < 3; i++)
+			e[i] = ends[LEG_FOOT + nLead][i] - ends[LEG_TIBIA][i];
+		for (int i = 0; i < 3; i++)
+			ankle[i] = goal[nLead][i] - dot3(S[i], e);
+
+		//knee: rotate the tibia about its x axis k until |hip - ankle| is |hip - target|.
+		//u.v(d) = A cos d + B sin d + C for the tibia v turned by d
+		float u[3], v[3], k[3] = { Rc[LEG_TIBIA][0][0], Rc[LEG_TIBIA][1][0], Rc[LEG_TIBIA][2][0] }, w[3], kv[3];
+		for (int i = 0; i < 3; i++)
+		{
+			u[i] = ends[LEG_FEMUR][i] - hip[i];
+			v[i] = ends[LEG_TIBIA][i] - ends[LEG_FEMUR][i];
+			w[i] = ankle[i] - hip[i];
+		}
+		float a = sqrtf(dot3(u, u)), b = sqrtf(dot3(v, v));
+		float D = std::min(std::max(sqrtf(dot3(w, w)), fabsf(a - b)*1.001f), (a + b)*0.999f);
+		cross3(k, v, kv);
+		float C = dot3(k, u)*dot3(k, v), A = dot3(u, v) - C, B = dot3(u, kv);
+		float fNorm = sqrtf(A*A + B*B);
+		if (fNorm > 1e-8f)
+		{
+			float phi = atan2f(B, A), c = acosf(std::min(std::max(((D*D - a*a - b*b)*0.5f - C)/fNorm, -1.0f), 1.0f));
+			float d1 = remainderf(phi + c, (float)(2*M_PI)), d2 = remainderf(phi - c, (float)(2*M_PI));
+			posture.bone_rotation[pLeg[LEG_TIBIA]].p[0] += (fabsf(d1) < fabsf(d2) ? d1 : d2)*(float)(180./M_PI);
+			leg_kinematics(pBones, pLeg, posture, R, hip, Rb, Rc, ends);
+		}
+
+		//femur: the shortest rotation Q taking the ankle onto its target, Rl' = Rb^T Q Rc
+		float x[3], Q[3][3];
+		for (int i = 0; i < 3; i++)
+			x[i] = ends[LEG_TIBIA][i] - hip[i];
+		if (rotation_between(x, w, Q))
+		{
+			float QR[3][3], Gt[3][3], Rl[3][3];
+			matrix3_multiply(Q, Rc[LEG_FEMUR], QR);
+			matrix3_transpose(Rb[LEG_FEMUR], Gt);
+			matrix3_multiply(Gt, QR, Rl);
+			float angles[3];
+			matrix_to_euler(Rl, angles);
+			float *p = posture.bone_rotation[pLeg[LEG_FEMUR]].p;
+			for (int i = 0; i < 3; i++)
+				p[i] = UnwrapAngle(angles[i], p[i]);
+			leg_kinematics(pBones, pLeg, posture, R, hip, Rb, Rc, ends);
+		}
+
+		//foot: back to its orientation before the leg moved, Rl' = Rb^T Rc, as far as its dofs allow
+		{
+			Bone const& bone = pBones[pLeg[LEG_FOOT]];
+			float Gt[3][3], Rl[3][3], angles[3];
+			matrix3_transpose(Rb[LEG_FOOT], Gt);
+			matrix3_multiply(Gt, foot, Rl);
+			matrix_to_euler(Rl, angles);
+			float *p = posture.bone_rotation[pLeg[LEG_FOOT]].p;
+			int dofs[3] = { bone.dofx, bone.dofy, bone.dofz };
+			for (int i = 0; i < 3; i++)
+				if (dofs[i])
+					p[i] = UnwrapAngle(angles[i], p[i]);
+			leg_kinematics(pBones, pLeg, posture, R, hip, Rb, Rc, ends);
+		}
+
+		//toes: CCD of their dofs (each a hinge about its axis) onto their own target
+		for (int d = 0; d < 3 && bToes; d++)
+		{
+			Bone const& bone = pBones[pLeg[LEG_TOES]];
+			float *p = posture.bone_rotation[pLeg[LEG_TOES]].p;
+			int dofs[3] = { bone.dofx, bone.dofy, bone.dofz };
+			if (!dofs[d])
+				continue;
+			//x turns about Rc e_x, y about Rb Rz e_y, z about Rb e_z
+			float zc = bone.dofz ? p[2]*(float)(M_PI/180.) : 0.0f, e[3] = { -sinf(zc), cosf(zc), 0.0f };
+			for (int r = 0; r < 3; r++)
+				k[r] = d == 0 ? Rc[LEG_TOES][r][0] : d == 2 ? Rb[LEG_TOES][r][2] : Rb[LEG_TOES][r][0]*e[0] + Rb[LEG_TOES][r][1]*e[1];
+			p[d] += hinge_angle(k, ends[LEG_FOOT], ends[LEG_TOES], goal[1])*(float)(180./M_PI);
+			leg_kinematics(pBones, pLeg, posture, R, hip, Rb, Rc, ends);
+		}
+
+		//what the toe dofs cannot reach the foot turns for: S about the foot end takes the toes onto
+		//their target, the next iteration moves the ankle for it
+		if (bToes)
+		{
+			float t[3], g[3];
+			for (int i = 0; i < 3; i++)
+			{
+				t[i] = ends[LEG_TOES][i] - ends[LEG_FOOT][i];
+				g[i] = goal[1][i] - ends[LEG_FOOT][i];
+			}
+			rotation_between(t, g, S);
+			float turned[3][3];
+			matrix3_multiply(S, foot, turned);
+			memcpy(foot, turned, sizeof(foot));
+		}
+
+		fResidual = distance3(ends[LEG_FOOT + nLead], goal[nLead]);
+		if (bToes)
+			fResidual = std::max(fResidual, distance3(ends[LEG_TOES], goal[1]));
+		if (fResidual < fBest)
+		{
+			fBest = fResidual;
+			for (int i = 0; i < NUM_LEG_BONES; i++)
+				memcpy(best[i], posture.bone_rotation[pLeg[i]].p, sizeof(best[i]));
+		}
+		//a target out of reach stops the progress long before the iteration limit
+		if (fResidual <= m_Tolerance || fResidual > fPrevious*FOOTLOCK_PROGRESS || nIterations >= m_MaxIterations)
+			break;
+		fPrevious = fResidual;
+		nIterations++;
+	}
+	//targets out of reach can make the iterations wander off
+	fResidual = fBest;
+	for (int i = 0; i < NUM_LEG_BONES; i++)
+		memcpy(posture.bone_rotation[pLeg[i]].p, best[i], sizeof(best[i]));
+	return nIterations;
+}
+
+int FootLocker::Apply(Motion *pMotion, FootContacts const *pContacts, int nFirst, int nLast)
+{
+	if (pMotion == NULL || pContacts == NULL || pMotion->m_NumFrames <= 0)
+		return -1;
+	int nFrames = pMotion->m_NumFrames;
+	if (nLast < 0 || nLast >= nFrames)
+		nLast = nFrames - 1;
+	nFirst = std::max(nFirst, 0);
+	if (nFirst > nLast)
+		return -1;
+
+	m_SolveTime.assign(nFrames, 0.0f);
+	m_Residual.assign(nFrames, 0.0f);
+	m_Iterations.assign(nFrames, 0);
+	m_NumSolved = 0;
+
+	//world rotations and joint positions before locking
+	const int J = NUM_CONTACT_JOINTS;
+	int B = m_NumBones, nCount = nLast - nFirst + 1;
+	std::vector<float> rotations((size_t)nCount*B*9), positions((size_t)nCount*B*3);
+	ThreadPool::GetDefault().ParallelFor(0, nCount, [&](int nBegin, int nEnd, int nThread)
+	{
+		m_Kinematics.ForwardKinematics(pMotion->m_pPostures + nFirst + nBegin, nEnd - nBegin,
+			&rotations[(size_t)nBegin*B*9], &positions[(size_t)nBegin*B*3]);
+	}, FOOTLOCK_CHUNK);
+
+	//one target per run of contact, faded out over the blend frames around it
+	std::vector<float> targets((size_t)nCount*J*3), weights((size_t)nCount*J, 0.0f);
+	int nLabeled = std::min(pContacts->GetNumFrames(), nLast + 1);
+	for (int l = 0; l < 2; l++)
+		for (int n = 0; n < 2 && m_Legs[l][LEG_FEMUR] >= 0; n++)
+		{
+			int j = m_Joints[l][n], nBone = m_Legs[l][LEG_FOOT + n];
+			std::vector<int> firsts, lasts;
+			pContacts->GetIntervals(j, firsts, lasts);
+			for (int r = 0; r < (int)firsts.size(); r++)
+			{
+				int a = std::max(firsts[r], nFirst), c = std::min(lasts[r], nLabeled - 1);
+				if (a > c)
+					continue;
+				float mean[3] = { 0, 0, 0 };
+				for (int f = a; f <= c; f++)
+					for (int i = 0; i < 3; i++)
+						mean[i] += positions[((size_t)(f - nFirst)*B + nBone)*3 + i];
+				for (int i = 0; i < 3; i++)
+					mean[i] /= c - a + 1;
+				mean[1] = std::max(mean[1], m_Ground);
+
+				for (int f = std::max(a - m_BlendFrames, nFirst); f <= std::min(c + m_BlendFrames, nLast); f++)
+				{
+					float x = 1.0f - (float)(f < a ? a - f : f > c ? f - c : 0)/(m_BlendFrames + 1);
+					float weight = x*x*(3 - 2*x);
+					size_t i = (size_t)(f - nFirst)*J + j;
+					if (weight > weights[i])
+					{
+						weights[i] = weight;
+						memcpy(&targets[i*3], mean, sizeof(mean));
+					}
+				}
+			}
+		}
+
+	ThreadPool::GetDefault().ParallelFor(0, nCount, [&](int nBegin, int nEnd, int nThread)
+	{
+		for (int f = nBegin; f < nEnd; f++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			int g = nFirst + f, nIterations = 0;
+			float fResidual = 0;
+			bool bSolved = false;
+			for (int l = 0; l < 2; l++)
+			{
+				float const *w = &weights[(size_t)f*J];
+				float pWeights[2] = { w[m_Joints[l][0]], w[m_Joints[l][1]] };
+				if (m_Legs[l][LEG_FEMUR] < 0 || (pWeights[0] <= 0 && pWeights[1] <= 0))
+					continue;
+				float R[3][3], pTargets[2][3], fLeg;
+				memcpy(R, &rotations[((size_t)f*B + m_Hips[l])*9], sizeof(R));
+				for (int n = 0; n < 2; n++)
+					memcpy(pTargets[n], &targets[((size_t)f*J + m_Joints[l][n])*3], sizeof(pTargets[n]));
+				nIterations += SolveLeg(l, pMotion->m_pPostures[g], R, &positions[((size_t)f*B + m_Hips[l])*3], pTargets,
+					pWeights, fLeg);
+				fResidual = std::max(fResidual, fLeg);
+				bSolved = true;
+			}
+			if (!bSolved)
+				continue;
+			//a solved frame never reports 0 seconds
+			m_SolveTime[g] = std::max((float)std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), 1e-9f);
+			m_Residual[g] = fResidual;
+			m_Iterations[g] = nIterations;
+		}
+	}, FOOTLOCK_CHUNK);
+
+	for (int f = nFirst; f <= nLast; f++)
+		if (m_SolveTime[f] > 0)
+			m_NumSolved++;
+	pMotion->Invalidate();
+	return 0;
+}
@@ -0,0 +1,104 @@
+/*
+	footlock.h
+
+	Foot locking: removes the sliding of the feet that interpolation between keyframes brings
+	in, by holding every foot contact (see contacts.h) in place with inverse kinematics.
+
+	Every run of contact frames of a joint gets one target, where the joint is on average over
+	the run, not below the ground. Over FOOTLOCK_BLEND frames before and after the run the
+	target fades out (smoothstep) towards where the joint is, so locking does not pop.
+
+	Per leg and frame the joint locked more leads (the foot end, or the toes when only they are
+	locked or the heel is fading out of its lock). With the foot end leading and the toes locked
+	too, the toes target is moved to a toes length from the foot target (the two run means need
+	not be). Then iterations of:
+	  - the ankle target moves the ankle as much as the leading joint has to move;
+	  - femur and tibia are solved analytically: the knee (the x dof of the tibia, a hinge) is
+	    bent until the hip to ankle distance is the hip to target distance, taking the solution
+	    closest to the current bend, then the femur swings the leg onto the target;
+	  - the foot turns back to the orientation it had before the leg moved, as far as its dofs
+	    allow (the rest is what the next iteration corrects);
+	  - with the toes locked too, cyclic coordinate descent over the dofs of the toes (each one a
+	    hinge about its axis) turns them onto their target, and what it leaves the foot turns
+	    for about its end: the next iteration places the ankle for the turned foot;
+	until the largest distance to a target is below the tolerance, drops by less than a factor
+	FOOTLOCK_PROGRESS (a target out of reach, e.g. of a stretched leg) or after the iteration
+	limit, keeping the iteration closest to the targets.
+	Frames are solved in parallel, in chunks of FOOTLOCK_CHUNK frames, each from its own pose:
+	the analytic leg solve does not depend on where it starts, so the correction of the previous
+	frame would not save iterations.
+
+	Apply reports for every frame it solved the solve time, the iterations and the residual
+	(largest distance of a locked joint from its target, in skeleton units).
+*/
+
+#ifndef _FOOTLOCK_H
+#define _FOOTLOCK_H
+
+#include <vector>
+
+#include "motion.h"
+#include "skeleton.h"
+#include "posture.h"
+#include "kinematics.h"
+#include "contacts.h"
+
+#define FOOTLOCK_BLEND 6
+#define FOOTLOCK_CHUNK 64
+#define FOOTLOCK_PROGRESS 0.9f		// an iteration must bring the residual below this times the last
+
+enum LegBone
+{
+	LEG_FEMUR = 0, LEG_TIBIA, LEG_FOOT, LEG_TOES, NUM_LEG_BONES
+};
+
+class FootLocker
+{
+	//member functions
+	public:
+		FootLocker(Skeleton *pActor);
+		~FootLocker();
+
+		//Height of the ground plane (default 0)
+		void SetGround(float fHeight) { m_Ground = fHeight; }
+		//Frames over which a lock fades in and out
+		void SetBlendFrames(int nFrames) { m_BlendFrames = nFrames > 0 ? nFrames : 0; }
+		//Iterations stop below this distance to the targets (default 0.001 units) or after nIterations (default 8)
+		void SetTolerance(float fDistance, int nIterations = 8);
+
+		//Lock the joints of pMotion where pContacts (e.g. from the motion the keyframes were taken
+		//from) labels them in contact, on frames nFirst .. nLast (-1 for the last frame).
+		//Returns 0, -1 on error
+		int Apply(Motion *pMotion, FootContacts const *pContacts, int nFirst = 0, int nLast = -1);
+
+		//Results of the last Apply, per frame of the motion (0 for frames without a lock)
+		int GetNumSolved() const { return m_NumSolved; }
+		float GetSolveTime(int nFrame) const { return m_SolveTime[nFrame]; }		// seconds
+		float GetResidual(int nFrame) const { return m_Residual[nFrame]; }
+		int GetIterations(int nFrame) const { return m_Iterations[nFrame]; }
+		float GetMaxResidual() const;
+
+	private:
+		//Solve leg nLeg of posture. pTargets/pWeights: targets and weights of its foot and toes joints
+		int SolveLeg(int nLeg, Posture &posture, float const R[3][3], float const hip[3], float const pTargets[2][3],
+			float const pWeights[2], float &fResidual) const;
+
+	//member variables
+	private:
+		Skeleton *m_pActor;
+		MotionKinematics m_Kinematics;
+		int m_NumBones;
+		int m_Legs[2][NUM_LEG_BONES];			// bones of the left and right leg, -1 if missing
+		int m_Hips[2];							// parent of the femur
+		int m_Joints[2][2];						// ContactJoint of the foot and toes of each leg
+		float m_Ground;
+		int m_BlendFrames;
+		float m_Tolerance;
+		int m_MaxIterations;
+
+		int m_NumSolved;
+		std::vector<float> m_SolveTime, m_Residual;
+		std::vector<int> m_Iterations;
+};
+
+#endif
@@ -2,10 +2,12 @@
 #include <cstdlib>
 #include <cstdio>
 #include <cstring>
+#include <vector>
 
 #include "motion.h"
 #include "interpolator.h"
 #include "types.h"
+#include "profiler.h"
 
 
 
@@ -31,11 +33,22 @@ Interpolator::Interpolator(Motion* pSampledMotion, char* pOffsetFileName)
 
 }
 
+Interpolator::Interpolator(Motion* pSampledMotion, int const* pFrameNums)
+{
+	m_InterpTypeToUse = LINEAR;
+	m_AngleRepresToUse = EULER;
+	m_pSampledMotion = pSampledMotion;
+	m_ErrorType = NO_ERROR_SET;
+
+	m_pTimeDistArray = NULL;
+	SetFrameNumbers(pFrameNums);
+}
+
 
 Interpolator::~Interpolator()
 {
 	if (m_pTimeDistArray != NULL)
-		delete m_pTimeDistArray;
+		delete [] m_pTimeDistArray;
 }
 
 
@@ -87,9 +100,28 @@ void Interpolator::ReadOffsetFile(char* pOffsetFileName)
 	}
 }
 
+void Interpolator::SetFrameNumbers(int const* pFrameNums)
+{
+	m_pTimeDistArray = new int [m_pSampledMotion->m_NumFrames];
+
+	int frameNumPrev = 0;
+	for (int i = 0; i < m_pSampledMotion->m_NumFrames; i++)
+	{
+		if (pFrameNums[i] <= frameNumPrev)
+		{
+			m_ErrorType = BAD_OFFSET_FILE;
+			return;
+		}
+		m_pTimeDistArray[i] = pFrameNums[i] - frameNumPrev - 1;
+		frameNumPrev = pFrameNums[i];
+	}
+}
+
 //Create interpolated motion
 void Interpolator::Interpolate(Motion*& pInterpMotion) 
 {
+	PROFILE_SCOPE("Interpolator::Interpolate");
+
 	//Do nothing if error is set
 	if (m_ErrorType != NO_ERROR_SET)
 	{
@@ -109,13 +141,16 @@ void Interpolator::Interpolate(Motion*& pInterpMotion)
 
 	//Allocate new motion - initially set to default motion
 	pInterpMotion = new Motion(nNumFrames); 
+	pInterpMotion->pActor = m_pSampledMotion->pActor;
 
 	//Perform the interpolation
 	if (m_InterpTypeToUse == LINEAR && m_AngleRepresToUse == EULER)
 		LinearInterpEulerAngles(pInterpMotion);
+	else if (m_InterpTypeToUse == CATMULL_ROM && m_AngleRepresToUse == EULER)
+		CatmullRomInterpEulerAngles(pInterpMotion);
 	else
 	{
-		//For now only linear interpolation of euler angles is supported
+		//For now only euler angles are supported
 		m_ErrorType = NOT_SUPPORTED_INTERP_TYPE;
 		delete pInterpMotion;
 		pInterpMotion = NULL;
@@ -140,7 +175,6 @@ void Interpolator::LinearInterpEulerAngles(Motion* pInterpMotion)
 		float fInterpDist = 1.0/(m_pTimeDistArray[i] + 1.0);
 		for (int j = 1; j <= m_pTimeDistArray[i]; j++)
 		{
-			float fTemp = fInterpDist*j;
 			Posture InterPost = LinearInterpolate(fInterpDist*j, m_pSampledMotion->m_pPostures[i-1], 
 																 m_pSampledMotion->m_pPostures[i]);
 			
@@ -156,6 +190,41 @@ void Interpolator::LinearInterpEulerAngles(Motion* pInterpMotion)
 }
 
 
+void Interpolator::CatmullRomInterpEulerAngles(Motion* pInterpMotion)
+{
+	Posture* pSamples = m_pSampledMotion->m_pPostures;
+	int nLast = m_pSampledMotion->m_NumFrames - 1;
+
+	//frame of every sample in the interpolated motion: the spline follows their spacing
+	std::vector<float> times(nLast + 1);
+	times[0] = 0;
+	for (int i = 1; i <= nLast; i++)
+		times[i] = times[i-1] + m_pTimeDistArray[i] + 1;
+
+	pInterpMotion->SetPosture(0, pSamples[0]);
+
+	int nCurPostureIndx = 1;
+	for (int i = 1; i <= nLast; i++)
+	{
+		//the end samples are repeated to get the outer control points
+		int n0 = i > 1 ? i-2 : 0, n3 = i < nLast ? i+1 : nLast;
+		float keyTimes[4] = { times[n0], times[i-1], times[i], times[n3] };
+
+		float fInterpDist = 1.0/(m_pTimeDistArray[i] + 1.0);
+		for (int j = 1; j <= m_pTimeDistArray[i]; j++)
+		{
+			Posture InterPost = CatmullRomInterpolate(fInterpDist*j, pSamples[n0], pSamples[i-1], pSamples[i], pSamples[n3], keyTimes,
+				m_pSampledMotion->pActor);
+			pInterpMotion->SetPosture(nCurPostureIndx, InterPost);
+			nCurPostureIndx++;
+		}
+
+		pInterpMotion->SetPosture(nCurPostureIndx, pSamples[i]);
+		nCurPostureIndx++;
+	}
+}
+
+
 //Return error description
 void Interpolator::GetErrorString(char* pErrorStr)
 {
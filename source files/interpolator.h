@@ -13,7 +13,7 @@
 
 enum InterpType
 {
-	LINEAR = 0
+	LINEAR = 0, CATMULL_ROM
 };
 
 enum AngleRepresent
@@ -28,6 +28,8 @@ class Interpolator
 	public: 
 		//constructors, destructors
 		Interpolator(Motion* pInitialMotion, char* pOffsetFileName);
+		//pFrameNums holds the frame in the original motion of every sample (as in the offset file)
+		Interpolator(Motion* pInitialMotion, int const* pFrameNums);
 		~Interpolator();
 		
 		//Set interpolation type
@@ -43,12 +45,17 @@ class Interpolator
 		//Init m_pTimeDistArray array from pOffsetFileName file
 		void ReadOffsetFile(char* pOffsetFileName);
 
+		//Init m_pTimeDistArray array from the original frame numbers of the samples
+		void SetFrameNumbers(int const* pFrameNums);
+
 		//Create interpolated motion and store it into 
 		void Interpolate(Motion*& pInterpMotion);
 
 	private:
 		//Linear interpolation using euler angles
 		void LinearInterpEulerAngles(Motion* pInterpMotion);
+		//Catmull-Rom spline through the samples at their frames using euler angles
+		void CatmullRomInterpEulerAngles(Motion* pInterpMotion);
 
 
 	//member variables
@@ -0,0 +1,98 @@
+#include <cstdio>
+#include <cmath>
+
+#include "keyframes.h"
+#include "channels.h"
+
+
+int SelectUniformKeyFrames(Motion *pMotion, int nStep, int *pFrameNums)
+{
+	if (nStep < 1)
+		nStep = 1;
+	if (pMotion->m_NumFrames <= 0)
+		return 0;
+
+	int n = 0;
+	for (int f = 0; f < pMotion->m_NumFrames; f += nStep)
+		pFrameNums[n++] = f + 1;
+	if (pFrameNums[n - 1] != pMotion->m_NumFrames)
+		pFrameNums[n++] = pMotion->m_NumFrames;
+	return n;
+}
+
+//True if every frame strictly between nKey and nEnd is within tolerance of the linear
+//interpolation of the two. pValues holds nNumChannels floats per frame
+static bool segment_fits(float const *pValues, int nNumChannels, bool const *pAngle, int nKey, int nEnd,
+						 float fAngleTolerance, float fPosTolerance)
+{
+	float const *pKey = pValues + nKey*nNumChannels;
+	float const *pEnd = pValues + nEnd*nNumChannels;
+	for (int f = nKey + 1; f < nEnd; f++)
+	{
+		float t = (float)(f - nKey)/(nEnd - nKey);
+		float const *pFrame = pValues + f*nNumChannels;
+		for (int c = 0; c < nNumChannels; c++)
+		{
+			float fError = fabsf(pKey[c] + t*(pEnd[c] - pKey[c]) - pFrame[c]);
+			if (fError > (pAngle[c] ? fAngleTolerance : fPosTolerance))
+				return false;
+		}
+	}
+	return true;
+}
+
+int SelectKeyFrames(Motion *pMotion, float fAngleTolerance, float fPosTolerance, int nMaxGap, int *pFrameNums)
+{
+	int nNumFrames = pMotion->m_NumFrames;
+	if (nNumFrames <= 2)
+		return SelectUniformKeyFrames(pMotion, 1, pFrameNums);
+
+	ChannelLayout layout(pMotion->pActor);
+	int nNumChannels = layout.m_NumChannels;
+	bool pAngle[MAX_CHANNELS];
+	for (int c = 0; c < nNumChannels; c++)
+		pAngle[c] = layout.IsAngle(c);
+
+	float *pValues = new float [nNumFrames*nNumChannels];
+	for (int f = 0; f < nNumFrames; f++)
+		layout.Gather(pMotion->m_pPostures[f], pValues + f*nNumChannels);
+
+	int n = 0;
+	int nKey = 0;
+	pFrameNums[n++] = 1;
+	while (nKey < nNumFrames - 1)
+	{
+		//extend the segment while the skipped frames are reproduced
+		int nEnd = nKey + 1;
+		while (nEnd + 1 < nNumFrames && (nMaxGap <= 0 || nEnd - nKey < nMaxGap + 1) &&
+			   segment_fits(pValues, nNumChannels, pAngle, nKey, nEnd + 1, fAngleTolerance, fPosTolerance))
+			nEnd++;
+
+		pFrameNums[n++] = nEnd + 1;
+		nKey = nEnd;
+	}
+
+	delete [] pValues;
+	return n;
+}
+
+Motion *ExtractKeyFrames(Motion *pMotion, int const *pFrameNums, int nNumKeyFrames)
+{
+	Motion *pSampled = new Motion(nNumKeyFrames);
+	pSampled->pActor = pMotion->pActor;
+	for (int i = 0; i < nNumKeyFrames; i++)
+		pSampled->m_pPostures[i] = pMotion->m_pPostures[pFrameNums[i] - 1];
+	return pSampled;
+}
+
+int WriteOffsetFile(char *filename, int const *pFrameNums, int nNumKeyFrames)
+{
+	FILE *pFile = fopen(filename, "w");
+	if (pFile == NULL)
+		return -1;
+
+	for (int i = 0; i < nNumKeyFrames; i++)
+		fprintf(pFile, "%d\n", pFrameNums[i]);
+
+	return fclose(pFile) == 0 ? 0 : -1;
+}
@@ -0,0 +1,31 @@
+/*
+	keyframes.h
+
+	Keyframe reduction of a motion.
+
+	Frame numbers follow the offset file read by Interpolator: they start at 1 and the first
+	and last frames of the motion are always keyframes, so the sampled motion built from them
+	can be interpolated back to the full length.
+*/
+
+#ifndef _KEYFRAMES_H
+#define _KEYFRAMES_H
+
+#include "motion.h"
+
+//Every nStep-th frame. pFrameNums must hold m_NumFrames ints; returns the number of keyframes
+//(0 for an empty motion)
+int SelectUniformKeyFrames(Motion *pMotion, int nStep, int *pFrameNums);
+
+//Greedy reduction: a keyframe is added wherever linear interpolation from the previous keyframe
+//would be off by more than fAngleTolerance (degrees) on a rotation or fPosTolerance on a translation,
+//or when nMaxGap frames have been skipped (0 = no limit). Returns the number of keyframes
+int SelectKeyFrames(Motion *pMotion, float fAngleTolerance, float fPosTolerance, int nMaxGap, int *pFrameNums);
+
+//Motion made of the keyframes only (same actor)
+Motion *ExtractKeyFrames(Motion *pMotion, int const *pFrameNums, int nNumKeyFrames);
+
+//Write the frame numbers one per line, the format read by Interpolator::ReadOffsetFile
+int WriteOffsetFile(char *filename, int const *pFrameNums, int nNumKeyFrames);
+
+#endif
@@ -0,0 +1,202 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "kinematics.h"
+#include "threadpool.h"
+
+
+//Bones in the order of the recursion of computeJointPositions: a bone starts from the end point
+//of its parent, siblings from the same point
+static void collect_bones(Bone *ptr, int nParent, int *pOrder, int *pParent, int &nCount)
+{
+	for (; ptr != NULL; ptr = ptr->sibling)
+	{
+		pParent[ptr->idx] = nParent;
+		pOrder[nCount++] = ptr->idx;
+		collect_bones(ptr->child, ptr->idx, pOrder, pParent, nCount);
+	}
+}
+
+//Rotation vector (axis times angle) of the rotation matrix R (9 floats, row major)
+static void rotation_log(float const *R, float w[3])
+{
+	float v[3] = { R[7] - R[5], R[2] - R[6], R[3] - R[1] };
+	float c = std::min(std::max((R[0] + R[4] + R[8] - 1.0f)*0.5f, -1.0f), 1.0f);
+	float theta = acosf(c), s = sinf(theta);
+	float scale = theta < 1e-4f ? 0.5f : theta/(2*s);
+	for (int i = 0; i < 3; i++)
+		w[i] = v[i]*scale;
+}
+
+
+/************************ MotionKinematics class functions **********************************/
+MotionKinematics::MotionKinematics(Skeleton *pActor)
+{
+	m_pActor = pActor;
+	m_NumBones = pActor->NUM_BONES_IN_ASF_FILE;
+	m_NumFrames = 0;
+	m_FrameRate = MOCAP_FRAME_RATE;
+
+	Bone *pBones = pActor->getRoot();
+	int nCount = 0;
+	collect_bones(pBones, -1, m_Order, m_Parent, nCount);
+	m_NumBones = nCount;
+	for (int b = 0; b < m_NumBones; b++)
+	{
+		Bone const& bone = pBones[b];
+		for (int i = 0; i < 3; i++)
+		{
+			for (int j = 0; j < 3; j++)
+				m_ParentAxis[b][i][j] = (float)bone.rot_parent_current[j][i];
+			m_Offset[b][i] = bone.dir[i]*bone.length;
+		}
+		m_Dofs[b][0] = bone.dofx; m_Dofs[b][1] = bone.dofy; m_Dofs[b][2] = bone.dofz;
+		m_Dofs[b][3] = bone.doftx; m_Dofs[b][4] = bone.dofty; m_Dofs[b][5] = bone.doftz;
+	}
+}
+
+MotionKinematics::~MotionKinematics()
+{
+}
+
+void MotionKinematics::ForwardKinematics(Posture const *pPostures, int nCount, float *pRotations, float *pPositions) const
+{
+	const int K = KINEMATICS_BLOCK;
+	float R[MAX_BONES_IN_ASF_FILE][9][K], T[MAX_BONES_IN_ASF_FILE][3][K];
+
+	for (int nFirst = 0; nFirst < nCount; nFirst += K)
+	{
+		int n = std::min(K, nCount - nFirst);
+		Posture const *pBlock = pPostures + nFirst;
+
+		for (int o = 0; o < m_NumBones; o++)
+		{
+			int b = m_Order[o], p = m_Parent[b];
+			float const (*A)[3] = m_ParentAxis[b];
+			float Rb[9][K], tl[3][K], angle[3][K], Rl[9][K];
+
+			//Rb = R(parent end) * rot_parent_current^T
+			for (int i = 0; i < 3; i++)
+				for (int j = 0; j < 3; j++)
+					if (p < 0)
+						for (int k = 0; k < n; k++)
+							Rb[3*i + j][k] = A[i][j];
+					else
+						for (int k = 0; k < n; k++)
+							Rb[3*i + j][k] = R[p][3*i][k]*A[0][j] + R[p][3*i + 1][k]*A[1][j] + R[p][3*i + 2][k]*A[2][j];
+
+			for (int i = 0; i < 3; i++)
+			{
+				bool bTranslation = b == root || m_Dofs[b][3 + i], bRotation = m_Dofs[b][i] != 0;
+				for (int k = 0; k < n; k++)
+				{
+					::vector const& t = b == root ? pBlock[k].root_pos : pBlock[k].bone_translation[b];
+					tl[i][k] = bTranslation ? t.p[i] : 0.0f;
+					angle[i][k] = bRotation ? pBlock[k].bone_rotation[b].p[i]*(float)(M_PI/180.) : 0.0f;
+				}
+			}
+
+			//Rl = Rz * Ry * Rx
+			for (int k = 0; k < n; k++)
+			{
+				float sa = sinf(angle[0][k]), ca = cosf(angle[0][k]), sb = sinf(angle[1][k]), cb = cosf(angle[1][k]);
+				float sc = sinf(angle[2][k]), cc = cosf(angle[2][k]);
+				Rl[0][k] = cc*cb; Rl[1][k] = cc*sb*sa - sc*ca; Rl[2][k] = cc*sb*ca + sc*sa;
+				Rl[3][k] = sc*cb; Rl[4][k] = sc*sb*sa + cc*ca; Rl[5][k] = sc*sb*ca - cc*sa;
+				Rl[6][k] = -sb;   Rl[7][k] = cb*sa;            Rl[8][k] = cb*ca;
+			}
+
+			float const *d = m_Offset[b];
+			for (int i = 0; i < 3; i++)
+			{
+				for (int j = 0; j < 3; j++)
+					for (int k = 0; k < n; k++)
+						R[b][3*i + j][k] = Rb[3*i][k]*Rl[j][k] + Rb[3*i + 1][k]*Rl[3 + j][k] + Rb[3*i + 2][k]*Rl[6 + j][k];
+				for (int k = 0; k < n; k++)
+				{
+					float t = p < 0 ? 0.0f : T[p][i][k];
+					t += Rb[3*i][k]*tl[0][k] + Rb[3*i + 1][k]*tl[1][k] + Rb[3*i + 2][k]*tl[2][k];
+					T[b][i][k] = t + R[b][3*i][k]*d[0] + R[b][3*i + 1][k]*d[1] + R[b][3*i + 2][k]*d[2];
+				}
+			}
+		}
+
+		for (int k = 0; k < n; k++)
+			for (int b = 0; b < m_NumBones; b++)
+			{
+				float *pT = pPositions + ((size_t)(nFirst + k)*m_NumBones + b)*3;
+				for (int i = 0; i < 3; i++)
+					pT[i] = T[b][i][k];
+				if (pRotations == NULL)
+					continue;
+				float *pR = pRotations + ((size_t)(nFirst + k)*m_NumBones + b)*9;
+				for (int i = 0; i < 9; i++)
+					pR[i] = R[b][i][k];
+			}
+	}
+}
+
+int MotionKinematics::Compute(Motion *pMotion)
+{
+	if (pMotion == NULL || pMotion->m_NumFrames <= 0 || pMotion->m_FrameRate <= 0)
+		return -1;
+
+	int nFrames = pMotion->m_NumFrames, B = m_NumBones;
+	m_NumFrames = nFrames;
+	m_FrameRate = pMotion->m_FrameRate;
+	size_t nSize = (size_t)nFrames*B*3;
+	m_Positions.resize(nSize);
+	m_Velocities.resize(nSize);
+	m_Accelerations.resize(nSize);
+	m_AngularVelocities.resize(nSize);
+
+	float fRate = m_FrameRate;
+	ThreadPool::GetDefault().ParallelFor(0, nFrames, [&](int nBegin, int nEnd, int nThread)
+	{
+		//the frames of the chunk and two on each side
+		int nLow = std::max(nBegin - 2, 0), nHigh = std::min(nEnd + 2, nFrames);
+		std::vector<float> rotations((size_t)(nHigh - nLow)*B*9), positions((size_t)(nHigh - nLow)*B*3);
+		ForwardKinematics(pMotion->m_pPostures + nLow, nHigh - nLow, rotations.data(), positions.data());
+		auto P = [&](int f) { return &positions[(size_t)(f - nLow)*B*3]; };
+		auto R = [&](int f) { return &rotations[(size_t)(f - nLow)*B*9]; };
+
+		for (int f = nBegin; f < nEnd; f++)
+		{
+			int nPrev = std::max(f - 1, 0), nNext = std::min(f + 1, nFrames - 1);
+			float fScale = nNext > nPrev ? fRate/(nNext - nPrev) : 0.0f;
+			int c = std::min(std::max(f, 1), nFrames - 2);
+			float const *p0 = P(nPrev), *p1 = P(nNext);
+			float *pPosition = &m_Positions[Index(f, 0)], *pVelocity = &m_Velocities[Index(f, 0)];
+			float *pAcceleration = &m_Accelerations[Index(f, 0)];
+
+			memcpy(pPosition, P(f), B*3*sizeof(float));
+			for (int i = 0; i < B*3; i++)
+				pVelocity[i] = (p1[i] - p0[i])*fScale;
+			if (nFrames >= 3)
+			{
+				float const *a = P(c - 1), *m = P(c), *z = P(c + 1);
+				for (int i = 0; i < B*3; i++)
+					pAcceleration[i] = (z[i] - 2*m[i] + a[i])*fRate*fRate;
+			}
+			else
+				memset(pAcceleration, 0, B*3*sizeof(float));
+
+			//R(next) R(prev)^T
+			float const *r0 = R(nPrev), *r1 = R(nNext);
+			for (int b = 0; b < B; b++)
+			{
+				float const *X = r1 + 9*b, *Y = r0 + 9*b;
+				float D[9];
+				for (int i = 0; i < 3; i++)
+					for (int j = 0; j < 3; j++)
+						D[3*i + j] = X[3*i]*Y[3*j] + X[3*i + 1]*Y[3*j + 1] + X[3*i + 2]*Y[3*j + 2];
+				float *w = &m_AngularVelocities[Index(f, b)];
+				rotation_log(D, w);
+				for (int i = 0; i < 3; i++)
+					w[i] *= fScale;
+			}
+		}
+	}, KINEMATICS_CHUNK);
+	return 0;
+}
@@ -0,0 +1,78 @@
+/*
+	kinematics.h
+
+	Derived channels of a motion: for the end point of every bone (as computeJointPositions)
+	its world position, linear velocity and acceleration, and the angular velocity of the bone
+	in world coordinates. Velocities are in skeleton units per second, accelerations in units
+	per second squared, angular velocities in radians per second (axis times rate), all at the
+	frame rate of the motion.
+
+	Velocities and angular velocities are central differences over the neighbouring frames
+	(one sided at the ends); angular velocity is the log map of R(f+1) R(f-1)^T. Accelerations
+	are second differences, those of the first and last frames are the ones of their neighbours.
+
+	Compute runs forward kinematics and the differences in one pass: the frames are split into
+	chunks spread over the thread pool, and each chunk runs the kinematics of its frames (and of
+	the two frames on each side) in blocks of KINEMATICS_BLOCK frames, bone by bone, in loops
+	over the frames of the block that the compiler vectorizes, then differences them while they
+	are in cache. Positions of all frames are never computed twice except at the chunk borders.
+
+	Motion::GetKinematics computes and keeps one for the motion.
+*/
+
+#ifndef _KINEMATICS_H
+#define _KINEMATICS_H
+
+#include <vector>
+
+#include "motion.h"
+#include "skeleton.h"
+#include "posture.h"
+
+#define KINEMATICS_BLOCK 8
+#define KINEMATICS_CHUNK 256
+
+class MotionKinematics
+{
+	//member functions
+	public:
+		MotionKinematics(Skeleton *pActor);
+		~MotionKinematics();
+
+		//All frames of the motion at its m_FrameRate. Returns 0, -1 on error
+		int Compute(Motion *pMotion);
+
+		int GetNumFrames() const { return m_NumFrames; }
+		int GetNumBones() const { return m_NumBones; }
+		float GetFrameRate() const { return m_FrameRate; }
+
+		//3 floats for bone nBone at frame nFrame
+		float const *GetPosition(int nFrame, int nBone) const { return &m_Positions[Index(nFrame, nBone)]; }
+		float const *GetVelocity(int nFrame, int nBone) const { return &m_Velocities[Index(nFrame, nBone)]; }
+		float const *GetAcceleration(int nFrame, int nBone) const { return &m_Accelerations[Index(nFrame, nBone)]; }
+		float const *GetAngularVelocity(int nFrame, int nBone) const { return &m_AngularVelocities[Index(nFrame, nBone)]; }
+
+		//The block kinematics alone: world rotations (9 floats, row major) and end point positions
+		//(3 floats) of the bones for nCount frames from pPostures, frame by frame and bone by bone
+		//in pRotations and pPositions. pRotations may be NULL
+		void ForwardKinematics(Posture const *pPostures, int nCount, float *pRotations, float *pPositions) const;
+
+	private:
+		size_t Index(int nFrame, int nBone) const { return ((size_t)nFrame*m_NumBones + nBone)*3; }
+
+	//member variables
+	private:
+		Skeleton *m_pActor;
+		int m_NumBones;
+		int m_Order[MAX_BONES_IN_ASF_FILE];			// parents before children
+		int m_Parent[MAX_BONES_IN_ASF_FILE];		// bone whose end point this bone starts from, -1 for the root
+		float m_ParentAxis[MAX_BONES_IN_ASF_FILE][3][3];	// rot_parent_current^T
+		float m_Offset[MAX_BONES_IN_ASF_FILE][3];	// dir*length
+		int m_Dofs[MAX_BONES_IN_ASF_FILE][6];		// rx ry rz tx ty tz
+
+		int m_NumFrames;
+		float m_FrameRate;
+		std::vector<float> m_Positions, m_Velocities, m_Accelerations, m_AngularVelocities;
+};
+
+#endif
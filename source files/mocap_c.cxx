@@ -0,0 +1,482 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <new>
+
+#define MOCAP_C_BUILD
+#include "mocap_c.h"
+#include "skeleton.h"
+#include "motion.h"
+#include "posture.h"
+#include "channels.h"
+#include "kinematics.h"
+#include "motionsampler.h"
+#include "interpolator.h"
+#include "keyframes.h"
+#include "threadpool.h"
+
+#define MOCAP_C_BLOCK 64					// postures scattered at once by mocap_forward_kinematics
+
+struct MocapSkeleton
+{
+	Skeleton *pActor;
+	float scale;
+	ChannelLayout *pLayout;
+	MotionKinematics *pKinematics;			// for mocap_forward_kinematics
+	std::vector<std::string> channelNames;
+	std::vector<int> parents;
+	std::atomic<int> references;			// the caller's and one for every motion
+};
+
+struct MocapMotion
+{
+	MocapSkeleton *pSkeleton;
+	Motion *pMotion;
+};
+
+static thread_local std::string lastError;
+
+static void set_error(char const *pMessage, char const *pDetail = NULL)
+{
+	lastError = pMessage;
+	if (pDetail != NULL)
+		lastError += std::string(" ") + pDetail;
+}
+
+static void release_skeleton(MocapSkeleton *pSkeleton)
+{
+	if (pSkeleton != NULL && --pSkeleton->references == 0)
+	{
+		delete pSkeleton->pKinematics;
+		delete pSkeleton->pLayout;
+		delete pSkeleton->pActor;
+		delete pSkeleton;
+	}
+}
+
+//The values a Motion does not set: translations and lengths
+static void clear_posture(Posture &posture)
+{
+	posture.root_pos.setValue(0.0, 0.0, 0.0);
+	for (int b = 0; b < MAX_BONES_IN_ASF_FILE; b++)
+	{
+		posture.bone_rotation[b].setValue(0.0, 0.0, 0.0);
+		posture.bone_translation[b].setValue(0.0, 0.0, 0.0);
+		posture.bone_length[b].setValue(0.0, 0.0, 0.0);
+	}
+}
+
+static void collect_parents(Bone *pBone, int nParent, std::vector<int> &parents)
+{
+	for (; pBone != NULL; pBone = pBone->sibling)
+	{
+		if (pBone->idx >= 0 && pBone->idx < (int)parents.size())
+			parents[pBone->idx] = nParent;
+		collect_parents(pBone->child, pBone->idx, parents);
+	}
+}
+
+static MocapMotion *wrap_motion(MocapSkeleton *pSkeleton, Motion *pMotion)
+{
+	MocapMotion *pHandle = new MocapMotion;
+	pHandle->pSkeleton = pSkeleton;
+	pHandle->pMotion = pMotion;
+	pSkeleton->references++;
+	return pHandle;
+}
+
+static void fill_array(MocapArray *pArray, float const *pData, int nDims, long long const *pShape, long long const *pStrides,
+	bool bReadOnly)
+{
+	memset(pArray, 0, sizeof(MocapArray));
+	pArray->data = (float *)pData;
+	pArray->ndim = nDims;
+	for (int d = 0; d < nDims; d++)
+	{
+		pArray->shape[d] = pShape[d];
+		pArray->strides[d] = pStrides[d];
+	}
+	pArray->readonly = bReadOnly ? 1 : 0;
+}
+
+
+/************************ Library **********************************/
+int mocap_version(void)
+{
+	return MOCAP_C_VERSION;
+}
+
+const char *mocap_last_error(void)
+{
+	return lastError.c_str();
+}
+
+
+/************************ Skeleton **********************************/
+MocapSkeleton *mocap_skeleton_load(const char *asf_filename, float scale)
+{
+	//Skeleton reads the file without reporting a failure
+	FILE *pFile = asf_filename != NULL ? fopen(asf_filename, "r") : NULL;
+	if (pFile == NULL)
+	{
+		set_error("cannot open", asf_filename);
+		return NULL;
+	}
+	fclose(pFile);
+
+	try
+	{
+		MocapSkeleton *pSkeleton = new MocapSkeleton;
+		pSkeleton->scale = scale > 0 ? scale : (float)MOCAP_SCALE;
+		pSkeleton->pActor = new Skeleton((char *)asf_filename, pSkeleton->scale);
+		pSkeleton->pLayout = new ChannelLayout(pSkeleton->pActor);
+		pSkeleton->pKinematics = new MotionKinematics(pSkeleton->pActor);
+		pSkeleton->references = 1;
+		if (pSkeleton->pActor->NUM_BONES_IN_ASF_FILE <= 1)
+		{
+			set_error("no bones in", asf_filename);
+			release_skeleton(pSkeleton);
+			return NULL;
+		}
+
+		char str[256];
+		for (int c = 0; c < pSkeleton->pLayout->m_NumChannels; c++)
+		{
+			pSkeleton->pLayout->GetName(c, str);
+			pSkeleton->channelNames.push_back(str);
+		}
+		pSkeleton->parents.assign(pSkeleton->pKinematics->GetNumBones(), -1);
+		collect_parents(pSkeleton->pActor->getRoot(), -1, pSkeleton->parents);
+		return pSkeleton;
+	}
+	catch (std::bad_alloc const&)
+	{
+		set_error("out of memory");
+		return NULL;
+	}
+}
+
+void mocap_skeleton_free(MocapSkeleton *skeleton)
+{
+	release_skeleton(skeleton);
+}
+
+int mocap_skeleton_num_bones(const MocapSkeleton *skeleton)
+{
+	return skeleton != NULL ? skeleton->pKinematics->GetNumBones() : 0;
+}
+
+const char *mocap_skeleton_bone_name(const MocapSkeleton *skeleton, int bone)
+{
+	if (skeleton == NULL || bone < 0 || bone >= skeleton->pKinematics->GetNumBones())
+	{
+		set_error("no such bone");
+		return NULL;
+	}
+	return skeleton->pActor->getRoot()[bone].name;
+}
+
+int mocap_skeleton_bone_parent(const MocapSkeleton *skeleton, int bone)
+{
+	if (skeleton == NULL || bone < 0 || bone >= (int)skeleton->parents.size())
+		return -1;
+	return skeleton->parents[bone];
+}
+
+int mocap_skeleton_num_channels(const MocapSkeleton *skeleton)
+{
+	return skeleton != NULL ? skeleton->pLayout->m_NumChannels : 0;
+}
+
+const char *mocap_skeleton_channel_name(const MocapSkeleton *skeleton, int channel)
+{
+	if (skeleton == NULL || channel < 0 || channel >= skeleton->pLayout->m_NumChannels)
+	{
+		set_error("no such channel");
+		return NULL;
+	}
+	return skeleton->channelNames[channel].c_str();
+}
+
+int mocap_skeleton_channel_is_angle(const MocapSkeleton *skeleton, int channel)
+{
+	if (skeleton == NULL || channel < 0 || channel >= skeleton->pLayout->m_NumChannels)
+		return 0;
+	return skeleton->pLayout->IsAngle(channel) ? 1 : 0;
+}
+
+int mocap_forward_kinematics(const MocapSkeleton *skeleton, const float *channels, long long row_stride, int count,
+	float *positions)
+{
+	if (skeleton == NULL || channels == NULL || positions == NULL || count < 0 || row_stride < skeleton->pLayout->m_NumChannels)
+	{
+		set_error("mocap_forward_kinematics: bad arguments");
+		return -1;
+	}
+	MotionKinematics const *pKinematics = skeleton->pKinematics;
+	ChannelLayout const *pLayout = skeleton->pLayout;
+	size_t nPoseFloats = (size_t)pKinematics->GetNumBones()*3;
+	ThreadPool::GetDefault().ParallelFor(0, count, [&](int nBegin, int nEnd, int nThread)
+	{
+		std::vector<Posture> postures(MOCAP_C_BLOCK);
+		for (int i = 0; i < MOCAP_C_BLOCK; i++)
+			clear_posture(postures[i]);
+		for (int f = nBegin; f < nEnd; f += MOCAP_C_BLOCK)
+		{
+			int nCount = std::min(MOCAP_C_BLOCK, nEnd - f);
+			for (int i = 0; i < nCount; i++)
+				pLayout->Scatter(&channels[(f + i)*row_stride], postures[i]);
+			pKinematics->ForwardKinematics(postures.data(), nCount, NULL, &positions[f*nPoseFloats]);
+		}
+	}, 4*MOCAP_C_BLOCK);
+	return 0;
+}
+
+
+/************************ Motion **********************************/
+MocapMotion *mocap_motion_load(MocapSkeleton *skeleton, const char *amc_filename)
+{
+	if (skeleton == NULL || amc_filename == NULL)
+	{
+		set_error("mocap_motion_load: bad arguments");
+		return NULL;
+	}
+	try
+	{
+		Motion *pMotion = new Motion((char *)amc_filename, skeleton->scale, skeleton->pActor);
+		if (pMotion->m_NumFrames <= 0)
+		{
+			set_error("cannot read", amc_filename);
+			delete pMotion;
+			return NULL;
+		}
+		return wrap_motion(skeleton, pMotion);
+	}
+	catch (std::bad_alloc const&)
+	{
+		set_error("out of memory reading", amc_filename);
+		return NULL;
+	}
+}
+
+MocapMotion *mocap_motion_create(MocapSkeleton *skeleton, int num_frames, float frame_rate)
+{
+	if (skeleton == NULL || num_frames <= 0)
+	{
+		set_error("mocap_motion_create: bad arguments");
+		return NULL;
+	}
+	try
+	{
+		Motion *pMotion = new Motion(num_frames);
+		pMotion->pActor = skeleton->pActor;
+		if (frame_rate > 0)
+			pMotion->m_FrameRate = frame_rate;
+		for (int f = 0; f < num_frames; f++)
+			clear_posture(pMotion->m_pPostures[f]);
+		return wrap_motion(skeleton, pMotion);
+	}
+	catch (std::bad_alloc const&)
+	{
+		set_error("out of memory");
+		return NULL;
+	}
+}
+
+void mocap_motion_free(MocapMotion *motion)
+{
+	if (motion == NULL)
+		return;
+	delete motion->pMotion;
+	release_skeleton(motion->pSkeleton);
+	delete motion;
+}
+
+MocapSkeleton *mocap_motion_skeleton(const MocapMotion *motion)
+{
+	return motion != NULL ? motion->pSkeleton : NULL;
+}
+
+int mocap_motion_num_frames(const MocapMotion *motion)
+{
+	return motion != NULL ? motion->pMotion->m_NumFrames : 0;
+}
+
+float mocap_motion_frame_rate(const MocapMotion *motion)
+{
+	return motion != NULL ? motion->pMotion->m_FrameRate : 0.0f;
+}
+
+int mocap_motion_write(MocapMotion *motion, const char *amc_filename)
+{
+	if (motion == NULL || amc_filename == NULL || motion->pMotion->writeAMCfile((char *)amc_filename, motion->pSkeleton->scale) != 0)
+	{
+		set_error("cannot write", amc_filename);
+		return -1;
+	}
+	return 0;
+}
+
+int mocap_motion_channel(MocapMotion *motion, int channel, MocapArray *array)
+{
+	if (motion == NULL || array == NULL || channel < 0 || channel >= motion->pSkeleton->pLayout->m_NumChannels)
+	{
+		set_error("mocap_motion_channel: bad arguments");
+		return -1;
+	}
+	Posture *pPostures = motion->pMotion->m_pPostures;
+	Channel const& c = motion->pSkeleton->pLayout->m_Channels[channel];
+	float *pData = c.type == CHANNEL_ROOT_POS ? &pPostures[0].root_pos.p[c.axis] :
+		c.type == CHANNEL_TRANSLATION ? &pPostures[0].bone_translation[c.bone].p[c.axis] :
+		&pPostures[0].bone_rotation[c.bone].p[c.axis];
+	long long shape[1] = { motion->pMotion->m_NumFrames }, strides[1] = { (long long)sizeof(Posture) };
+	fill_array(array, pData, 1, shape, strides, false);
+	return 0;
+}
+
+void mocap_motion_modified(MocapMotion *motion)
+{
+	if (motion != NULL)
+		motion->pMotion->Invalidate();
+}
+
+int mocap_motion_get_channels(const MocapMotion *motion, int first, int count, float *values, long long row_stride)
+{
+	if (motion == NULL || values == NULL || first < 0 || count < 0 || first + count > motion->pMotion->m_NumFrames ||
+		row_stride < motion->pSkeleton->pLayout->m_NumChannels)
+	{
+		set_error("mocap_motion_get_channels: bad arguments");
+		return -1;
+	}
+	ChannelLayout const *pLayout = motion->pSkeleton->pLayout;
+	Posture const *pPostures = motion->pMotion->m_pPostures + first;
+	ThreadPool::GetDefault().ParallelFor(0, count, [&](int nBegin, int nEnd, int nThread)
+	{
+		for (int f = nBegin; f < nEnd; f++)
+			pLayout->Gather(pPostures[f], &values[f*row_stride]);
+	}, 256);
+	return 0;
+}
+
+int mocap_motion_set_channels(MocapMotion *motion, int first, int count, const float *values, long long row_stride)
+{
+	if (motion == NULL || values == NULL || first < 0 || count < 0 || first + count > motion->pMotion->m_NumFrames ||
+		row_stride < motion->pSkeleton->pLayout->m_NumChannels)
+	{
+		set_error("mocap_motion_set_channels: bad arguments");
+		return -1;
+	}
+	ChannelLayout const *pLayout = motion->pSkeleton->pLayout;
+	Posture *pPostures = motion->pMotion->m_pPostures + first;
+	ThreadPool::GetDefault().ParallelFor(0, count, [&](int nBegin, int nEnd, int nThread)
+	{
+		for (int f = nBegin; f < nEnd; f++)
+			pLayout->Scatter(&values[f*row_stride], pPostures[f]);
+	}, 256);
+	motion->pMotion->Invalidate();
+	return 0;
+}
+
+static int kinematics_array(MocapMotion *motion, MocapArray *array, bool bVelocities)
+{
+	if (motion == NULL || array == NULL)
+	{
+		set_error("bad arguments");
+		return -1;
+	}
+	MotionKinematics const *pKinematics = NULL;
+	try
+	{
+		pKinematics = motion->pMotion->GetKinematics();
+	}
+	catch (std::bad_alloc const&)
+	{
+	}
+	if (pKinematics == NULL)
+	{
+		set_error("cannot compute the kinematics");
+		return -1;
+	}
+	long long nBones = pKinematics->GetNumBones();
+	long long shape[3] = { pKinematics->GetNumFrames(), nBones, 3 };
+	long long strides[3] = { nBones*3*(long long)sizeof(float), 3*(long long)sizeof(float), (long long)sizeof(float) };
+	fill_array(array, bVelocities ? pKinematics->GetVelocity(0, 0) : pKinematics->GetPosition(0, 0), 3, shape, strides, true);
+	return 0;
+}
+
+int mocap_motion_positions(MocapMotion *motion, MocapArray *array)
+{
+	return kinematics_array(motion, array, false);
+}
+
+int mocap_motion_velocities(MocapMotion *motion, MocapArray *array)
+{
+	return kinematics_array(motion, array, true);
+}
+
+int mocap_motion_sample(MocapMotion *motion, const float *seconds, int count, int filter, float *values)
+{
+	if (motion == NULL || seconds == NULL || values == NULL || count < 0 || filter < MOCAP_SAMPLE_NEAREST ||
+		filter > MOCAP_SAMPLE_QUATERNION)
+	{
+		set_error("mocap_motion_sample: bad arguments");
+		return -1;
+	}
+	MotionSampler sampler(motion->pMotion, (SampleFilter)filter);
+	sampler.GetValues(seconds, count, values);
+	return 0;
+}
+
+MocapMotion *mocap_motion_interpolate(MocapMotion *motion, const int *keyframes, int num_keys, int method)
+{
+	if (motion == NULL || keyframes == NULL || num_keys < 2 || (method != MOCAP_INTERP_LINEAR && method != MOCAP_INTERP_CATMULL_ROM))
+	{
+		set_error("mocap_motion_interpolate: bad arguments");
+		return NULL;
+	}
+	int nFrames = motion->pMotion->m_NumFrames;
+	if (keyframes[0] != 0 || keyframes[num_keys - 1] != nFrames - 1)
+	{
+		set_error("mocap_motion_interpolate: the keyframes must start at the first frame and end at the last one");
+		return NULL;
+	}
+	//the frame numbers of the offset file start at 1
+	std::vector<int> frameNums(num_keys);
+	for (int i = 0; i < num_keys; i++)
+	{
+		if (i > 0 && keyframes[i] <= keyframes[i - 1])
+		{
+			set_error("mocap_motion_interpolate: the keyframes must increase");
+			return NULL;
+		}
+		frameNums[i] = keyframes[i] + 1;
+	}
+
+	try
+	{
+		Motion *pSampled = ExtractKeyFrames(motion->pMotion, frameNums.data(), num_keys);
+		Interpolator interpolator(pSampled, frameNums.data());
+		interpolator.SetInterpType(method == MOCAP_INTERP_CATMULL_ROM ? CATMULL_ROM : LINEAR);
+		Motion *pInterp = NULL;
+		interpolator.Interpolate(pInterp);
+		delete pSampled;
+		if (pInterp == NULL)
+		{
+			char str[256];
+			interpolator.GetErrorString(str);
+			str[strcspn(str, "\n")] = '\0';
+			set_error("mocap_motion_interpolate:", str);
+			return NULL;
+		}
+		pInterp->m_FrameRate = motion->pMotion->m_FrameRate;
+		return wrap_motion(motion->pSkeleton, pInterp);
+	}
+	catch (std::bad_alloc const&)
+	{
+		set_error("out of memory");
+		return NULL;
+	}
+}
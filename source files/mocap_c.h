@@ -0,0 +1,117 @@
+/*
+	mocap_c.h
+
+	C interface for embedding skeletons and motions in other programs and languages (numpy,
+	pandas, MATLAB): loading, forward kinematics, sampling and keyframe interpolation.
+
+	Ownership: every handle returned by a _load, _create or _interpolate function belongs to
+	the caller, who releases it with the matching _free. A motion keeps its skeleton alive, so
+	the skeleton may be freed before the motions made from it. Strings returned by the library
+	stay valid as long as their skeleton.
+
+	Arrays: MocapArray describes memory of the library as a float pointer with the shape and the
+	strides in bytes of each dimension, the layout numpy's __array_interface__ and the buffer
+	protocol expect, so a client wraps it without copying. mocap_motion_channel views one channel
+	in the postures of the motion itself (writable; call mocap_motion_modified after writing).
+	mocap_motion_positions and mocap_motion_velocities view the kinematics of the motion (see
+	kinematics.h), computed on the first call; they stay valid until the motion is modified
+	or freed.
+
+	Batch functions take and fill rows of channel values (mocap_skeleton_channel_name gives the
+	order) for many frames per call, with a row stride in floats, and run over the thread pool.
+
+	Errors: functions return 0 or a handle on success, -1 or NULL on error; mocap_last_error
+	gives the message of the last error of the calling thread.
+*/
+
+#ifndef _MOCAP_C_H
+#define _MOCAP_C_H
+
+#if defined(_WIN32)
+	#ifdef MOCAP_C_BUILD
+		#define MOCAP_API __declspec(dllexport)
+	#else
+		#define MOCAP_API __declspec(dllimport)
+	#endif
+#else
+	#define MOCAP_API __attribute__((visibility("default")))
+#endif
+
+#define MOCAP_C_VERSION 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct MocapSkeleton MocapSkeleton;
+typedef struct MocapMotion MocapMotion;
+
+typedef struct MocapArray
+{
+	float *data;
+	int ndim;
+	long long shape[3];
+	long long strides[3];			/* bytes */
+	int readonly;
+} MocapArray;
+
+/* Keyframe interpolation of mocap_motion_interpolate */
+enum { MOCAP_INTERP_LINEAR = 0, MOCAP_INTERP_CATMULL_ROM = 1 };
+/* Filters of mocap_motion_sample (see motionsampler.h) */
+enum { MOCAP_SAMPLE_NEAREST = 0, MOCAP_SAMPLE_LINEAR = 1, MOCAP_SAMPLE_CATMULL_ROM = 2, MOCAP_SAMPLE_QUATERNION = 3 };
+
+/* MOCAP_C_VERSION of the library, to check against the header */
+MOCAP_API int mocap_version(void);
+MOCAP_API const char *mocap_last_error(void);
+
+/* Skeleton of an ASF file; scale <= 0 uses the default scale (MOCAP_SCALE) */
+MOCAP_API MocapSkeleton *mocap_skeleton_load(const char *asf_filename, float scale);
+MOCAP_API void mocap_skeleton_free(MocapSkeleton *skeleton);
+MOCAP_API int mocap_skeleton_num_bones(const MocapSkeleton *skeleton);
+MOCAP_API const char *mocap_skeleton_bone_name(const MocapSkeleton *skeleton, int bone);
+/* -1 for the root */
+MOCAP_API int mocap_skeleton_bone_parent(const MocapSkeleton *skeleton, int bone);
+MOCAP_API int mocap_skeleton_num_channels(const MocapSkeleton *skeleton);
+/* e.g. "lfemur.rx" or "root.tx" */
+MOCAP_API const char *mocap_skeleton_channel_name(const MocapSkeleton *skeleton, int channel);
+/* 1 for rotations in degrees, 0 for translations */
+MOCAP_API int mocap_skeleton_channel_is_angle(const MocapSkeleton *skeleton, int channel);
+/* World positions of the end points of the bones (count*num_bones*3 floats, frame by frame and
+   bone by bone) for count rows of channel values, row_stride floats apart */
+MOCAP_API int mocap_forward_kinematics(const MocapSkeleton *skeleton, const float *channels, long long row_stride, int count,
+	float *positions);
+
+/* Motion of an AMC file of the skeleton */
+MOCAP_API MocapMotion *mocap_motion_load(MocapSkeleton *skeleton, const char *amc_filename);
+/* Motion of num_frames default postures; frame_rate <= 0 uses MOCAP_FRAME_RATE */
+MOCAP_API MocapMotion *mocap_motion_create(MocapSkeleton *skeleton, int num_frames, float frame_rate);
+MOCAP_API void mocap_motion_free(MocapMotion *motion);
+MOCAP_API MocapSkeleton *mocap_motion_skeleton(const MocapMotion *motion);
+MOCAP_API int mocap_motion_num_frames(const MocapMotion *motion);
+MOCAP_API float mocap_motion_frame_rate(const MocapMotion *motion);
+MOCAP_API int mocap_motion_write(MocapMotion *motion, const char *amc_filename);
+
+/* One channel of every frame: shape (num_frames), in place in the postures */
+MOCAP_API int mocap_motion_channel(MocapMotion *motion, int channel, MocapArray *array);
+/* Drops the kinematics after the postures were written through mocap_motion_channel */
+MOCAP_API void mocap_motion_modified(MocapMotion *motion);
+/* Copy count frames from first out of or into rows of channel values, row_stride floats apart */
+MOCAP_API int mocap_motion_get_channels(const MocapMotion *motion, int first, int count, float *values, long long row_stride);
+MOCAP_API int mocap_motion_set_channels(MocapMotion *motion, int first, int count, const float *values, long long row_stride);
+
+/* Shape (num_frames, num_bones, 3), read only: world positions of the end points of the bones
+   and their velocities in units per second */
+MOCAP_API int mocap_motion_positions(MocapMotion *motion, MocapArray *array);
+MOCAP_API int mocap_motion_velocities(MocapMotion *motion, MocapArray *array);
+
+/* Channel values at count times in seconds (count rows of num_channels floats) */
+MOCAP_API int mocap_motion_sample(MocapMotion *motion, const float *seconds, int count, int filter, float *values);
+/* Motion of the same length interpolated from the frames keyframes[0..num_keys-1] (0-based,
+   increasing, from the first frame to the last) */
+MOCAP_API MocapMotion *mocap_motion_interpolate(MocapMotion *motion, const int *keyframes, int num_keys, int method);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -6,6 +6,12 @@
 #include "skeleton.h"
 #include "motion.h"
 #include "vector.h"
+#include "amcwriter.h"
+#include "motionsampler.h"
+#include "kinematics.h"
+#include "contacts.h"
+#include "pyramid.h"
+#include "profiler.h"
 
 // a default skeleton that defines each bone's degree of freedom and the order of the data stored in the AMC file
 //static Skeleton actor("Skeleton.ASF", MOCAP_SCALE);
@@ -21,6 +27,11 @@ Motion::Motion(int nNumFrames)
 	
 	m_NumFrames = nNumFrames;
 	offset = 0;
+	m_FrameRate = MOCAP_FRAME_RATE;
+	m_pKinematics = NULL;
+	m_pContacts = NULL;
+	m_pPyramid = NULL;
+	pActor = NULL;
 
 	//allocate postures array
 	m_pPostures = new Posture [m_NumFrames];
@@ -35,6 +46,10 @@ Motion::Motion(char *amc_filename, float scale,Skeleton * pActor2)
 
 //	m_NumDOFs = actor.m_NumDOFs;
 	offset = 0;
+	m_FrameRate = MOCAP_FRAME_RATE;
+	m_pKinematics = NULL;
+	m_pContacts = NULL;
+	m_pPyramid = NULL;
 	m_NumFrames = 0;
 	m_pPostures = NULL;
 	readAMCfile(amc_filename, scale);	
@@ -44,6 +59,10 @@ Motion::Motion(char *amc_filename, float scale)
 {
 //	m_NumDOFs = actor.m_NumDOFs;
 	offset = 0;
+	m_FrameRate = MOCAP_FRAME_RATE;
+	m_pKinematics = NULL;
+	m_pContacts = NULL;
+	m_pPyramid = NULL;
 	m_NumFrames = 0;
 	m_pPostures = NULL;
 	readAMCfile(amc_filename, scale);
@@ -52,8 +71,11 @@ Motion::Motion(char *amc_filename, float scale)
 
 Motion::~Motion()
 {
-	/*if (m_pPostures != NULL)
-		delete [] m_pPostures;*/
+	if (m_pPostures != NULL)
+		delete [] m_pPostures;
+	delete m_pKinematics;
+	delete m_pContacts;
+	delete m_pPyramid;
 }
 
 
@@ -66,9 +88,13 @@ void Motion::SetPosturesToDefault()
 	{
 		//set root position to (0,0,0)
 		m_pPostures[i].root_pos.setValue(0.0, 0.0, 0.0);
-		//set each bone orientation to (0,0,0)
+		//set each bone orientation, translation and length to (0,0,0)
 		for (int j = 0; j < MAX_BONES_IN_ASF_FILE; j++)
+		{
 			m_pPostures[i].bone_rotation[j].setValue(0.0, 0.0, 0.0);
+			m_pPostures[i].bone_translation[j].setValue(0.0, 0.0, 0.0);
+			m_pPostures[i].bone_length[j].setValue(0.0, 0.0, 0.0);
+		}
 
 	}
 }
@@ -77,6 +103,7 @@ void Motion::SetPosturesToDefault()
 void Motion::SetPosture(int nFrameNum, Posture InPosture)
 {
 	m_pPostures[nFrameNum] = InPosture; 	
+	Invalidate();
 }
 
 int Motion::GetPostureNum(int nFrameNum)
@@ -100,14 +127,90 @@ void Motion::SetTimeOffset(int n_offset)
 void Motion::SetBoneRotation(int nFrameNum, vector vRot, int nBone)
 {
 	m_pPostures[nFrameNum].bone_rotation[nBone] = vRot;
+	Invalidate();
 }
 
 void Motion::SetRootPos(int nFrameNum, vector vPos)
 {
 	m_pPostures[nFrameNum].root_pos = vPos;
+	Invalidate();
 }
 
 
+int Motion::GetPostureAt(float fSeconds, Posture *pPosture, SampleFilter filter)
+{
+	if (pActor == NULL || m_NumFrames <= 0)
+		return -1;
+	MotionSampler sampler(this, filter);
+	sampler.GetPosture(fSeconds, pPosture);
+	return 0;
+}
+
+MotionKinematics const* Motion::GetKinematics()
+{
+	if (pActor == NULL)
+		return NULL;
+	if (m_pKinematics == NULL)
+	{
+		m_pKinematics = new MotionKinematics(pActor);
+		if (m_pKinematics->Compute(this) != 0)
+		{
+			delete m_pKinematics;
+			m_pKinematics = NULL;
+		}
+	}
+	return m_pKinematics;
+}
+
+FootContacts const* Motion::GetContacts()
+{
+	if (pActor == NULL)
+		return NULL;
+	if (m_pContacts == NULL)
+	{
+		m_pContacts = new FootContacts();
+		ContactDetector detector(pActor);
+		if (detector.Detect(this, m_pContacts) != 0)
+		{
+			delete m_pContacts;
+			m_pContacts = NULL;
+		}
+	}
+	return m_pContacts;
+}
+
+MotionPyramid const* Motion::GetPyramid()
+{
+	if (pActor == NULL)
+		return NULL;
+	if (m_pPyramid == NULL)
+	{
+		m_pPyramid = new MotionPyramid(pActor);
+		if (m_pPyramid->Build(this) != 0)
+		{
+			delete m_pPyramid;
+			m_pPyramid = NULL;
+		}
+	}
+	return m_pPyramid;
+}
+
+void Motion::SetContacts(FootContacts *pContacts)
+{
+	delete m_pContacts;
+	m_pContacts = pContacts;
+}
+
+void Motion::Invalidate()
+{
+	delete m_pKinematics;
+	m_pKinematics = NULL;
+	delete m_pContacts;
+	m_pContacts = NULL;
+	delete m_pPyramid;
+	m_pPyramid = NULL;
+}
+
 Posture* Motion::GetPosture(int nFrameNum)
 {
 	if (m_pPostures != NULL) 
@@ -119,6 +222,7 @@ Posture* Motion::GetPosture(int nFrameNum)
 
 int Motion::readAMCfile(char* name, float scale)
 {
+	PROFILE_SCOPE("Motion::readAMCfile");
 	Bone *hroot, *bone;
 	bone = hroot= (*pActor).getRoot();
 
@@ -152,8 +256,10 @@ int Motion::readAMCfile(char* name, float scale)
 
 	m_NumFrames = n;
 
-	//Allocate memory for state vector
+	Invalidate();
+	//Allocate memory for state vector; the file sets only the dofs of the bones
 	m_pPostures = new Posture [m_NumFrames]; 
+	SetPosturesToDefault();
 
 	//file.open(name);
 
@@ -180,14 +286,12 @@ int Motion::readAMCfile(char* name, float scale)
 	}
 */
 	int frame_num;
-	float x, y, z;
-	int i, bone_idx, state_idx;
+	int i, bone_idx;
 
 	for(i=0; i<m_NumFrames; i++)
 	{
 		//read frame number
 		file >> frame_num;
-		x=y=z=0;
 
 		//There are (NUM_BONES_IN_ASF_FILE - 2) moving bones and 2 dummy bones (lhipjoint and rhipjoint)
 		for( int j=0; j<movbones; j++ )
@@ -254,59 +358,23 @@ int Motion::readAMCfile(char* name, float scale)
 	}
 
 	file.close();
+	PROFILE_COUNT("AMC frames", n);
 	printf("%d samples in '%s' are read.\n", n, name);
 	return n;
 }
 
+//Frames are formatted into a large buffer and written in blocks (see AMCWriter)
 int Motion::writeAMCfile(char *filename, float scale)
 {
-	int f, n, j, d;
-	Bone *bone;
-	bone=(*pActor).getRoot();
+	AMCWriter writer(pActor, scale);
+	if (writer.Open(filename) != 0)
+		return -1;
 
-    std::ofstream os(filename);
-	if(os.fail()) return -1;
-
-
-	// header lines
-    os << "#Unknow ASF file" << std::endl;
-    os << ":FULLY-SPECIFIED" << std::endl;
-    os << ":DEGREES" << std::endl;
-	int numbones = numBonesInSkel(bone[0]);
-
-	for(f=0; f < m_NumFrames; f++)
-	{
-        os << f+1 <<std::endl;
-		os << "root " << m_pPostures[f].root_pos.p[0]/scale << " " 
-			          << m_pPostures[f].root_pos.p[1]/scale << " " 
-					  << m_pPostures[f].root_pos.p[2]/scale << " " 
-					  << m_pPostures[f].bone_rotation[root].p[0] << " " 
-					  << m_pPostures[f].bone_rotation[root].p[1] << " " 
-					  << m_pPostures[f].bone_rotation[root].p[2] ;
-		n=6;
-		
-		for(j = 2; j < numbones; j++) 
-		{
-
-			//output bone name
-			if(bone[j].dof != 0)
-//				os << endl << AsfPartName[j];
-                os << std::endl << pActor->idx2name(j);
-
-			//output bone rotation angles
-			if(bone[j].dofx == 1) 
-				os << " " << m_pPostures[f].bone_rotation[j].p[0];
-
-			if(bone[j].dofy == 1) 
-				os << " " << m_pPostures[f].bone_rotation[j].p[1];
-
-			if(bone[j].dofz == 1) 
-				os << " " << m_pPostures[f].bone_rotation[j].p[2];
-		}
-        os << std::endl;
-	}
+	for (int f = 0; f < m_NumFrames; f++)
+		writer.WriteFrame(m_pPostures[f]);
 
-	os.close();
+	if (writer.Close() != 0)
+		return -1;
 	printf("Write %d samples to '%s' \n", m_NumFrames, filename);
 	return 0;
 }
@@ -5,7 +5,7 @@
 
 	  1. read an AMC file and store it in a sequence of state vector 
 	  2. write an AMC file
-	  3. export to a mrdplot format for plotting the trajectories
+	  3. export to a mrdplot format for plotting the trajectories (see export.h)
    
       You can add more motion data processing functions in this class. 
 
@@ -21,6 +21,16 @@
 #include "posture.h"
 #include "skeleton.h"
 
+//Reconstruction between frames for sampling at any time (see motionsampler.h)
+enum SampleFilter
+{
+	SAMPLE_NEAREST = 0, SAMPLE_LINEAR, SAMPLE_CATMULL_ROM, SAMPLE_QUATERNION
+};
+
+class MotionKinematics;
+class FootContacts;
+class MotionPyramid;
+
 class Motion 
 {
 	//member functions 
@@ -52,15 +62,42 @@ class Motion
 	   void SetBoneRotation(int nFrameNum, ::vector vRot, int nBone);
 	   void SetRootPos(int nFrameNum, ::vector vPos);
 
+	   //Length in seconds at m_FrameRate (the time of the last frame)
+	   float GetDuration() const { return m_NumFrames > 1 ? (m_NumFrames - 1)/m_FrameRate : 0.0f; }
+	   //Posture at time fSeconds (frame fSeconds*m_FrameRate + offset, clamped to the motion).
+	   //Returns 0, -1 without an actor. Use a MotionSampler for many calls
+	   int GetPostureAt(float fSeconds, Posture *pPosture, SampleFilter filter = SAMPLE_LINEAR);
+
+	   //Joint positions, velocities, accelerations and angular velocities (see kinematics.h),
+	   //computed on the first call and kept until a posture is changed with SetPosture,
+	   //SetBoneRotation or SetRootPos. Call Invalidate after changing m_pPostures or
+	   //m_FrameRate directly. NULL without an actor
+	   MotionKinematics const* GetKinematics();
+	   //Foot contact labels (see contacts.h) from a ContactDetector with its default thresholds,
+	   //or the ones given to SetContacts (which the motion then deletes); kept like the kinematics
+	   FootContacts const* GetContacts();
+	   void SetContacts(FootContacts *pContacts);
+	   //Min/max/mean of every channel and representative frames at power-of-two reductions
+	   //(see pyramid.h), built on the first call and kept like the kinematics. NULL without an actor
+	   MotionPyramid const* GetPyramid();
+	   //Drop the kinematics, contact labels and pyramid
+	   void Invalidate();
+
 	//data members
 	public:
        int m_NumFrames; //Number of frames in the motion 
 	   int offset;
+	   float m_FrameRate;	//Frames per second (MOCAP_FRAME_RATE by default)
 
 //	   int m_NumDOFs;	//Overall number of degrees of freedom (summation of degrees of freedom for all bones)
 		Skeleton * pActor;
 	   //Root position and all bone rotation angles for each frame (as read from AMC file)
 	   Posture* m_pPostures; 
+
+	private:
+	   MotionKinematics* m_pKinematics;	//cache of GetKinematics, NULL when not computed
+	   FootContacts* m_pContacts;			//cache of GetContacts
+	   MotionPyramid* m_pPyramid;			//cache of GetPyramid
 };
 
 #endif
@@ -0,0 +1,523 @@
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "motioncodec.h"
+#include "threadpool.h"
+
+//Quotients of the Rice code from this value on are escaped: the value follows in 32 bits
+#define RICE_ESCAPE 24
+#define RICE_MAX_K 24
+
+//Angles are never quantized coarser than this (degrees), for bones that move almost nothing
+#define MOTION_CODEC_MAX_ANGLE_ERROR 2.0f
+
+//Quantized values stay within +-2^27, so that residuals of the linear prediction fit 32 bits
+#define MOTION_CODEC_MAX_LEVEL 134217728.0f
+
+enum BlockPredictor
+{
+	PREDICT_DELTA = 0, PREDICT_LINEAR
+};
+
+
+/************************ Bit streams **********************************/
+
+static inline int count_trailing_zeros(unsigned long long x)
+{
+#ifdef _MSC_VER
+	unsigned long n;
+	_BitScanForward64(&n, x);
+	return (int)n;
+#else
+	return __builtin_ctzll(x);
+#endif
+}
+
+static inline unsigned int zigzag(int v)
+{
+	return ((unsigned int)v << 1) ^ (unsigned int)(v >> 31);
+}
+
+static inline int unzigzag(unsigned int u)
+{
+	return (int)(u >> 1) ^ -(int)(u & 1);
+}
+
+//Bits are written from the least significant bit of each byte up
+struct BitWriter
+{
+	std::vector<unsigned char> &out;
+	unsigned long long acc;
+	int nBits;
+
+	BitWriter(std::vector<unsigned char> &o) : out(o), acc(0), nBits(0) {}
+
+	//nCount <= 32
+	void Put(unsigned int value, int nCount)
+	{
+		if (nCount < 32)
+			value &= (1u << nCount) - 1;
+		acc |= (unsigned long long)value << nBits;
+		nBits += nCount;
+		while (nBits >= 8)
+		{
+			out.push_back((unsigned char)acc);
+			acc >>= 8;
+			nBits -= 8;
+		}
+	}
+
+	//q zeros, then a one
+	void PutUnary(unsigned int q)
+	{
+		for (; q >= 16; q -= 16)
+			Put(0, 16);
+		Put(1u << q, q + 1);
+	}
+
+	void PutRice(unsigned int u, int k)
+	{
+		unsigned int q = u >> k;
+		if (q >= RICE_ESCAPE)
+		{
+			PutUnary(RICE_ESCAPE);
+			Put(u, 32);
+			return;
+		}
+		PutUnary(q);
+		if (k > 0)
+			Put(u, k);
+	}
+
+	void Flush()
+	{
+		if (nBits > 0)
+			out.push_back((unsigned char)acc);
+		acc = 0;
+		nBits = 0;
+	}
+};
+
+struct BitReader
+{
+	unsigned char const *p, *end;
+	unsigned long long acc;
+	int nBits;
+
+	BitReader(unsigned char const *pBegin, unsigned char const *pEnd) : p(pBegin), end(pEnd), acc(0), nBits(0) {}
+
+	//past the end the stream reads as zeros
+	void Refill()
+	{
+		while (nBits <= 56)
+		{
+			if (p < end)
+				acc |= (unsigned long long)*p++ << nBits;
+			nBits += 8;
+		}
+	}
+
+	unsigned int Get(int nCount)
+	{
+		Refill();
+		unsigned int value = (unsigned int)(acc & ((1ull << nCount) - 1));
+		acc >>= nCount;
+		nBits -= nCount;
+		return value;
+	}
+
+	unsigned int GetUnary()
+	{
+		unsigned int q = 0;
+		for (;;)
+		{
+			Refill();
+			if (acc != 0)
+			{
+				int n = count_trailing_zeros(acc);
+				acc >>= n + 1;
+				nBits -= n + 1;
+				return q + n;
+			}
+			q += nBits;
+			acc = 0;
+			nBits = 0;
+			if (q > RICE_ESCAPE)
+				return q;		// corrupt stream
+		}
+	}
+
+	unsigned int GetRice(int k)
+	{
+		unsigned int q = GetUnary();
+		if (q >= RICE_ESCAPE)
+			return Get(32);
+		return k > 0 ? (q << k) | Get(k) : q;
+	}
+};
+
+static int bit_length(unsigned int u)
+{
+	int n = 0;
+	for (; u != 0; u >>= 1)
+		n++;
+	return n;
+}
+
+//Bits of the Rice code of the values with the best parameter, which is returned in *pK.
+//The best parameter is near log2 of the mean value, only its neighbours are tried
+static long long rice_bits(unsigned int const *pValues, int nCount, int *pK)
+{
+	unsigned long long sum = 0;
+	for (int i = 0; i < nCount; i++)
+		sum += pValues[i];
+	int nGuess = nCount > 0 ? bit_length((unsigned int)std::min(sum/nCount, 0xffffffffull)) : 0;
+
+	long long best = -1;
+	*pK = 0;
+	for (int k = std::max(nGuess - 2, 0); k <= std::min(nGuess + 1, RICE_MAX_K); k++)
+	{
+		long long bits = 0;
+		for (int i = 0; i < nCount; i++)
+		{
+			unsigned int q = pValues[i] >> k;
+			bits += q >= RICE_ESCAPE ? RICE_ESCAPE + 1 + 32 : q + 1 + k;
+		}
+		if (best < 0 || bits < best)
+		{
+			best = bits;
+			*pK = k;
+		}
+	}
+	return best;
+}
+
+
+/************************ Helper functions **********************************/
+
+//Distance from the pivot of the bone to the farthest end below it, and number of rotating
+//joints on the deepest chain from it
+static void chain_of(Bone const *pBone, float *pReach, int *pDepth)
+{
+	float fReach = 0;
+	int nDepth = 0;
+	for (Bone const *pChild = pBone->child; pChild != NULL; pChild = pChild->sibling)
+	{
+		chain_of(pChild, pReach, pDepth);
+		fReach = std::max(fReach, pReach[pChild->idx]);
+		nDepth = std::max(nDepth, pDepth[pChild->idx]);
+	}
+	bool bRotates = pBone->idx == root || pBone->dofx || pBone->dofy || pBone->dofz;
+	pReach[pBone->idx] = fReach + (pBone->idx == root ? 0 : pBone->length);
+	pDepth[pBone->idx] = nDepth + (bRotates ? 1 : 0);
+}
+
+static void default_posture(Posture *pPosture)
+{
+	pPosture->root_pos.setValue(0, 0, 0);
+	for (int j = 0; j < MAX_BONES_IN_ASF_FILE; j++)
+	{
+		pPosture->bone_rotation[j].setValue(0, 0, 0);
+		pPosture->bone_translation[j].setValue(0, 0, 0);
+		pPosture->bone_length[j].setValue(0, 0, 0);
+	}
+}
+
+
+/************************ MotionCodec class functions **********************************/
+MotionCodec::MotionCodec(Skeleton *pActor) : m_Layout(pActor)
+{
+	m_pActor = pActor;
+	m_Tolerance = 0.01f;
+	for (int j = 0; j < MAX_BONES_IN_ASF_FILE; j++)
+		m_JointTolerance[j] = 0;
+	m_BlockFrames = MOTION_CODEC_BLOCK;
+
+	memset(&m_Header, 0, sizeof(m_Header));
+	m_pBlocks = NULL;
+	m_BlockBytes = 0;
+
+	ComputeSteps();
+}
+
+MotionCodec::~MotionCodec()
+{
+}
+
+void MotionCodec::SetTolerance(float fPosition)
+{
+	m_Tolerance = fPosition;
+	ComputeSteps();
+}
+
+void MotionCodec::SetJointTolerance(int nBone, float fDegrees)
+{
+	m_JointTolerance[nBone] = fDegrees;
+	ComputeSteps();
+}
+
+//The position error of a joint is at most the sum, over the dofs above it, of the dof error times
+//the reach of its bone (root translation errors count in full). Each of the D rotating joints (and the
+//root translation) of the deepest chain gets 1/D of the tolerance, split evenly over its dofs
+void MotionCodec::ComputeSteps()
+{
+	Bone *bone = m_pActor->getRoot();
+	float reach[MAX_BONES_IN_ASF_FILE];
+	int depth[MAX_BONES_IN_ASF_FILE];
+	chain_of(bone, reach, depth);
+	float fShare = m_Tolerance/(depth[root] + 1);
+
+	for (int c = 0; c < m_Layout.m_NumChannels; c++)
+	{
+		Channel const& channel = m_Layout.m_Channels[c];
+		float fError;
+		if (channel.type != CHANNEL_ROTATION)
+			fError = fShare/3;
+		else
+		{
+			int b = channel.bone;
+			int nDofs = b == root ? 3 : bone[b].dofx + bone[b].dofy + bone[b].dofz;
+			if (m_JointTolerance[b] > 0)
+				fError = m_JointTolerance[b];
+			else
+			{
+				fError = reach[b] > 0 ? (float)(fShare/(nDofs*reach[b])*180./M_PI) : MOTION_CODEC_MAX_ANGLE_ERROR;
+				fError = std::min(fError, MOTION_CODEC_MAX_ANGLE_ERROR);
+			}
+		}
+		//a uniform quantizer errs by half its step
+		m_Steps[c] = 2*fError;
+	}
+}
+
+void MotionCodec::EncodeBlock(Motion *pMotion, int nFirst, int nFrames, float const *pSteps, std::vector<unsigned char> &out) const
+{
+	int nChannels = m_Layout.m_NumChannels;
+	std::vector<float> values((size_t)nFrames*nChannels);
+	for (int f = 0; f < nFrames; f++)
+		m_Layout.Gather(pMotion->m_pPostures[nFirst + f], &values[(size_t)f*nChannels]);
+
+	std::vector<int> q(nFrames);
+	std::vector<unsigned int> residuals[2];
+	residuals[0].resize(nFrames);
+	residuals[1].resize(nFrames);
+
+	BitWriter writer(out);
+	for (int c = 0; c < nChannels; c++)
+	{
+		//quantize, unwrapping the angles across the block
+		float fPrevious = 0, fOffset = 0;
+		for (int f = 0; f < nFrames; f++)
+		{
+			float v = values[(size_t)f*nChannels + c];
+			if (m_Layout.IsAngle(c) && f > 0)
+			{
+				float d = v + fOffset - fPrevious;
+				fOffset -= 360.0f*floorf((d + 180.0f)/360.0f);
+			}
+			fPrevious = v + fOffset;
+			q[f] = (int)floor((double)fPrevious/pSteps[c] + 0.5);
+		}
+
+		for (int f = 1; f < nFrames; f++)
+		{
+			residuals[PREDICT_DELTA][f] = zigzag(q[f] - q[f - 1]);
+			residuals[PREDICT_LINEAR][f] = zigzag(f == 1 ? q[1] - q[0] : q[f] - 2*q[f - 1] + q[f - 2]);
+		}
+		int k[2];
+		long long bits[2];
+		for (int m = 0; m < 2; m++)
+			bits[m] = rice_bits(residuals[m].data() + 1, nFrames - 1, &k[m]);
+		int nMode = bits[PREDICT_LINEAR] < bits[PREDICT_DELTA] ? PREDICT_LINEAR : PREDICT_DELTA;
+
+		unsigned int u = zigzag(q[0]);
+		int nLength = bit_length(u);
+		writer.Put(nMode, 1);
+		writer.Put(k[nMode], 5);
+		writer.Put(nLength, 6);
+		writer.Put(u, nLength);
+		for (int f = 1; f < nFrames; f++)
+			writer.PutRice(residuals[nMode][f], k[nMode]);
+	}
+	writer.Flush();
+}
+
+int MotionCodec::Encode(Motion *pMotion, std::vector<unsigned char> &data) const
+{
+	data.clear();
+	if (pMotion == NULL || pMotion->m_NumFrames <= 0)
+		return -1;
+
+	int nChannels = m_Layout.m_NumChannels;
+	int nFrames = pMotion->m_NumFrames;
+	int nBlocks = (nFrames + m_BlockFrames - 1)/m_BlockFrames;
+
+	//steps coarse enough for the quantized values to stay in range. Unwrapped angles drift by
+	//less than 180 degrees per frame of a block
+	std::vector<float> steps(m_Steps, m_Steps + nChannels);
+	std::vector<float> values(nChannels);
+	for (int f = 0; f < nFrames; f++)
+	{
+		m_Layout.Gather(pMotion->m_pPostures[f], values.data());
+		for (int c = 0; c < nChannels; c++)
+		{
+			float fRange = fabsf(values[c]) + (m_Layout.IsAngle(c) ? 180.0f*m_BlockFrames : 0.0f);
+			steps[c] = std::max(steps[c], fRange/MOTION_CODEC_MAX_LEVEL);
+		}
+	}
+
+	std::vector<std::vector<unsigned char> > blocks(nBlocks);
+	ThreadPool::GetDefault().ParallelFor(0, nBlocks, [&](int nBegin, int nEnd, int nThread)
+	{
+		for (int b = nBegin; b < nEnd; b++)
+		{
+			int nFirst = b*m_BlockFrames;
+			EncodeBlock(pMotion, nFirst, std::min(m_BlockFrames, nFrames - nFirst), steps.data(), blocks[b]);
+		}
+	});
+
+	MotionCodecHeader header = { MOTION_CODEC_MAGIC, MOTION_CODEC_VERSION, nFrames, nChannels, m_BlockFrames, nBlocks, {0, 0} };
+	std::vector<unsigned long long> offsets(nBlocks + 1, 0);
+	for (int b = 0; b < nBlocks; b++)
+		offsets[b + 1] = offsets[b] + blocks[b].size();
+
+	data.resize(sizeof(header) + nChannels*sizeof(float) + offsets.size()*sizeof(unsigned long long) + (size_t)offsets[nBlocks]);
+	unsigned char *p = data.data();
+	memcpy(p, &header, sizeof(header));
+	p += sizeof(header);
+	memcpy(p, steps.data(), nChannels*sizeof(float));
+	p += nChannels*sizeof(float);
+	memcpy(p, offsets.data(), offsets.size()*sizeof(unsigned long long));
+	p += offsets.size()*sizeof(unsigned long long);
+	for (int b = 0; b < nBlocks; b++)
+	{
+		memcpy(p, blocks[b].data(), blocks[b].size());
+		p += blocks[b].size();
+	}
+	return 0;
+}
+
+int MotionCodec::Open(unsigned char const *pData, size_t nSize)
+{
+	m_pBlocks = NULL;
+	m_BlockBytes = 0;
+	memset(&m_Header, 0, sizeof(m_Header));
+	if (nSize < sizeof(MotionCodecHeader))
+		return -1;
+
+	MotionCodecHeader header;
+	memcpy(&header, pData, sizeof(header));
+	if (header.magic != MOTION_CODEC_MAGIC || header.version != MOTION_CODEC_VERSION || header.numFrames <= 0 ||
+		header.numChannels != m_Layout.m_NumChannels || header.blockFrames <= 0 ||
+		header.numBlocks != (header.numFrames + header.blockFrames - 1)/header.blockFrames)
+	{
+		printf("Motion codec: not a compressed motion of this skeleton\n");
+		return -1;
+	}
+
+	size_t nTables = sizeof(header) + header.numChannels*sizeof(float) + (header.numBlocks + 1)*sizeof(unsigned long long);
+	if (nSize < nTables)
+		return -1;
+	m_StreamSteps.resize(header.numChannels);
+	m_Offsets.resize(header.numBlocks + 1);
+	memcpy(m_StreamSteps.data(), pData + sizeof(header), header.numChannels*sizeof(float));
+	memcpy(m_Offsets.data(), pData + sizeof(header) + header.numChannels*sizeof(float), (header.numBlocks + 1)*sizeof(unsigned long long));
+	//each block lies within the block data, after the one before it
+	for (int b = 0; b < header.numBlocks; b++)
+		if (m_Offsets[b] > m_Offsets[b + 1])
+		{
+			printf("Motion codec: corrupt block offsets\n");
+			return -1;
+		}
+	if (m_Offsets[header.numBlocks] > nSize - nTables)
+	{
+		printf("Motion codec: truncated stream\n");
+		return -1;
+	}
+
+	m_Header = header;
+	m_pBlocks = pData + nTables;
+	m_BlockBytes = nSize - nTables;
+	return 0;
+}
+
+int MotionCodec::DecodeBlock(int nBlock, Posture *pPostures) const
+{
+	if (m_pBlocks == NULL || nBlock < 0 || nBlock >= m_Header.numBlocks)
+		return 0;
+
+	int nChannels = m_Header.numChannels;
+	int nFirst = nBlock*m_Header.blockFrames;
+	int nFrames = std::min(m_Header.blockFrames, m_Header.numFrames - nFirst);
+	std::vector<float> values((size_t)nFrames*nChannels);
+
+	BitReader reader(m_pBlocks + m_Offsets[nBlock], m_pBlocks + m_Offsets[nBlock + 1]);
+	for (int c = 0; c < nChannels; c++)
+	{
+		int nMode = reader.Get(1);
+		int k = reader.Get(5);
+		int nLength = reader.Get(6);
+		int q0 = unzigzag(nLength > 0 ? reader.Get(std::min(nLength, 32)) : 0), q1 = q0, q2 = q0;
+		float fStep = m_StreamSteps[c];
+
+		values[c] = q0*fStep;
+		for (int f = 1; f < nFrames; f++)
+		{
+			int r = unzigzag(reader.GetRice(k));
+			int q = (nMode == PREDICT_LINEAR && f > 1) ? r + 2*q1 - q2 : r + q1;
+			values[(size_t)f*nChannels + c] = q*fStep;
+			q2 = q1;
+			q1 = q;
+		}
+	}
+
+	for (int f = 0; f < nFrames; f++)
+	{
+		default_posture(&pPostures[f]);
+		m_Layout.Scatter(&values[(size_t)f*nChannels], pPostures[f]);
+	}
+	return nFrames;
+}
+
+int MotionCodec::DecodeFrames(int nFirst, int nCount, Posture *pPostures) const
+{
+	nFirst = std::max(nFirst, 0);
+	nCount = std::min(nCount, m_Header.numFrames - nFirst);
+	if (nCount <= 0)
+		return 0;
+
+	std::vector<Posture> block(m_Header.blockFrames);
+	int nDone = 0;
+	while (nDone < nCount)
+	{
+		int nFrame = nFirst + nDone;
+		int nBlock = nFrame/m_Header.blockFrames;
+		int nOffset = nFrame - nBlock*m_Header.blockFrames;
+		int nDecoded = DecodeBlock(nBlock, block.data());
+		int n = std::min(nDecoded - nOffset, nCount - nDone);
+		std::copy(block.begin() + nOffset, block.begin() + nOffset + n, pPostures + nDone);
+		nDone += n;
+	}
+	return nCount;
+}
+
+Motion *MotionCodec::Decode() const
+{
+	if (m_pBlocks == NULL)
+		return NULL;
+
+	Motion *pMotion = new Motion(m_Header.numFrames);
+	pMotion->pActor = m_pActor;
+	ThreadPool::GetDefault().ParallelFor(0, m_Header.numBlocks, [&](int nBegin, int nEnd, int nThread)
+	{
+		for (int b = nBegin; b < nEnd; b++)
+			DecodeBlock(b, pMotion->m_pPostures + b*m_Header.blockFrames);
+	});
+	return pMotion;
+}
@@ -0,0 +1,102 @@
+/*
+	motioncodec.h
+
+	Lossy compression of motions for archiving.
+
+	Every channel of the motion (see channels.h) is quantized with its own step. The steps come
+	from one position tolerance: an angle error e of a bone moves the joints below it by at most
+	e times their distance to it (its reach), so the tolerance is shared out over the rotating
+	joints of the deepest chain and over the dofs of each joint, and every step is set so that
+	the forward kinematics of the decoded motion stays within the tolerance of the original.
+	The angle tolerance of single bones can be set instead.
+
+	The quantized values of a block of frames are coded channel by channel: angles are
+	unwrapped across the block, then either delta coded or predicted linearly from the two
+	previous frames (whichever is smaller for that channel and block), and the residuals are
+	written with a Rice code whose parameter is chosen per channel and block. Decoding the
+	integers back is exact, so the error does not accumulate.
+
+	Blocks are independent: the stream starts with a table of block offsets, so any frame is
+	decoded by decoding its block only. Blocks are encoded and decoded in parallel.
+
+	Stream: MotionCodecHeader, float step[numChannels], unsigned long long offset[numBlocks + 1]
+	(from the start of the block data), block data.
+*/
+
+#ifndef _MOTIONCODEC_H
+#define _MOTIONCODEC_H
+
+#include <vector>
+
+#include "motion.h"
+#include "skeleton.h"
+#include "posture.h"
+#include "channels.h"
+
+#define MOTION_CODEC_MAGIC 0x504D434D		// "MCMP"
+#define MOTION_CODEC_VERSION 1
+#define MOTION_CODEC_BLOCK 64
+
+struct MotionCodecHeader
+{
+	unsigned int magic;
+	unsigned int version;
+	int numFrames;
+	int numChannels;
+	int blockFrames;
+	int numBlocks;
+	int reserved[2];
+};
+
+class MotionCodec
+{
+	//member functions
+	public:
+		MotionCodec(Skeleton *pActor);
+		~MotionCodec();
+
+		//Largest joint position error of the decoded motion, in skeleton units (default 0.01)
+		void SetTolerance(float fPosition);
+		//Largest angle error of the rotation dofs of one bone, in degrees (replaces its share of the tolerance)
+		void SetJointTolerance(int nBone, float fDegrees);
+		void SetBlockFrames(int nFrames) { m_BlockFrames = nFrames > 0 ? nFrames : MOTION_CODEC_BLOCK; }
+		float GetStep(int nChannel) const { return m_Steps[nChannel]; }
+
+		//Compress the motion into data. Returns 0, -1 on error
+		int Encode(Motion *pMotion, std::vector<unsigned char> &data) const;
+
+		//Use a compressed stream for decoding; it is not copied and must stay valid. Returns 0, -1 if it is not one
+		int Open(unsigned char const *pData, size_t nSize);
+		int GetNumFrames() const { return m_Header.numFrames; }
+		int GetNumBlocks() const { return m_Header.numBlocks; }
+		int GetBlockFrames() const { return m_Header.blockFrames; }
+
+		//Frames of block nBlock into pPostures (up to GetBlockFrames()). Returns the number of frames
+		int DecodeBlock(int nBlock, Posture *pPostures) const;
+		//nCount frames from nFirst, decoding only the blocks they are in. Returns the number of frames
+		int DecodeFrames(int nFirst, int nCount, Posture *pPostures) const;
+		//The whole motion. The caller deletes it
+		Motion *Decode() const;
+
+	private:
+		void ComputeSteps();
+		void EncodeBlock(Motion *pMotion, int nFirst, int nFrames, float const *pSteps, std::vector<unsigned char> &out) const;
+
+	//member variables
+	private:
+		Skeleton *m_pActor;
+		ChannelLayout m_Layout;
+		float m_Tolerance;
+		float m_JointTolerance[MAX_BONES_IN_ASF_FILE];		// degrees, <= 0 for a share of m_Tolerance
+		float m_Steps[MAX_CHANNELS];
+		int m_BlockFrames;
+
+		//stream being decoded
+		MotionCodecHeader m_Header;
+		std::vector<float> m_StreamSteps;
+		std::vector<unsigned long long> m_Offsets;
+		unsigned char const *m_pBlocks;
+		size_t m_BlockBytes;
+};
+
+#endif
@@ -0,0 +1,340 @@
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#include "motionerror.h"
+#include "threadpool.h"
+
+static char const *kindNames[NUM_ERROR_KINDS] = { "angle", "position" };
+
+
+/************************ Reductions **********************************/
+
+//Sum, sum of squares and maximum of n values. Eight independent lanes let the compiler
+//keep the loop in vector registers without reassociating floating point sums
+static void reduce(float const *pValues, int n, double *pSum, double *pSumSq, float *pMax, int *pMaxIndex)
+{
+	float sum[8] = { 0 }, sumSq[8] = { 0 }, maxv[8] = { 0 };
+	double totalSum = 0, totalSumSq = 0;
+
+	int i = 0;
+	while (i + 8 <= n)
+	{
+		//partial sums are flushed to double every block to bound the rounding error
+		int nBlockEnd = std::min(n - (n - i) % 8, i + 4096);
+		for (; i < nBlockEnd; i += 8)
+			for (int l = 0; l < 8; l++)
+			{
+				float v = pValues[i + l];
+				sum[l] += v;
+				sumSq[l] += v*v;
+				maxv[l] = v > maxv[l] ? v : maxv[l];
+			}
+		for (int l = 0; l < 8; l++)
+		{
+			totalSum += sum[l];
+			totalSumSq += sumSq[l];
+			sum[l] = sumSq[l] = 0;
+		}
+	}
+	float fMax = 0;
+	for (int l = 0; l < 8; l++)
+		fMax = std::max(fMax, maxv[l]);
+	for (; i < n; i++)
+	{
+		totalSum += pValues[i];
+		totalSumSq += (double)pValues[i]*pValues[i];
+		fMax = std::max(fMax, pValues[i]);
+	}
+
+	*pSum = totalSum;
+	*pSumSq = totalSumSq;
+	*pMax = fMax;
+	if (pMaxIndex != NULL)
+	{
+		//the first occurrence of the maximum
+		*pMaxIndex = 0;
+		for (int j = 0; j < n; j++)
+			if (pValues[j] == fMax)
+			{
+				*pMaxIndex = j;
+				break;
+			}
+	}
+}
+
+//Statistics of n values; pValues is reordered. nIndexDivisor maps the index of the maximum to a frame
+static void summarize(float *pValues, int n, int nIndexDivisor, ErrorSummary *pSummary)
+{
+	memset(pSummary, 0, sizeof(ErrorSummary));
+	pSummary->count = n;
+	if (n == 0)
+		return;
+
+	double sum, sumSq;
+	float fMax;
+	int nMaxIndex;
+	reduce(pValues, n, &sum, &sumSq, &fMax, &nMaxIndex);
+	pSummary->mean = sum/n;
+	pSummary->rms = sqrt(sumSq/n);
+	pSummary->max = fMax;
+	pSummary->maxFrame = nMaxIndex/nIndexDivisor;
+
+	//nearest rank percentiles, each search starts where the previous one ended
+	double const percent[4] = { 0.50, 0.90, 0.95, 0.99 };
+	double *pOut[4] = { &pSummary->p50, &pSummary->p90, &pSummary->p95, &pSummary->p99 };
+	int nFirst = 0;
+	for (int p = 0; p < 4; p++)
+	{
+		int nRank = (int)ceil(percent[p]*n) - 1;
+		if (nRank < nFirst)
+			nRank = nFirst;
+		std::nth_element(pValues + nFirst, pValues + nRank, pValues + n);
+		*pOut[p] = pValues[nRank];
+		nFirst = nRank;
+	}
+}
+
+//Difference of two angles in degrees, wrapped to [-180, 180)
+static inline float angle_difference(float a, float b)
+{
+	float d = a - b;
+	return d - 360.0f*floorf((d + 180.0f)/360.0f);
+}
+
+
+/************************ MotionError class functions **********************************/
+MotionError::MotionError(Skeleton *pActor)
+{
+	m_pActor = pActor;
+
+	Bone *bone = pActor->getRoot();
+	m_NumBones = numBonesInSkel(bone[0]);
+	for (int j = 0; j < m_NumBones; j++)
+		m_bRotates[j] = j == root || bone[j].dofx || bone[j].dofy || bone[j].dofz;
+
+	m_NumFrames = 0;
+	m_Capacity = 0;
+	for (int k = 0; k < NUM_ERROR_KINDS; k++)
+	{
+		m_pErrors[k] = NULL;
+		m_pFrameErrors[k] = NULL;
+	}
+	memset(m_Summary, 0, sizeof(m_Summary));
+	memset(m_pBoneSummary, 0, sizeof(m_pBoneSummary));
+}
+
+MotionError::~MotionError()
+{
+	for (int k = 0; k < NUM_ERROR_KINDS; k++)
+	{
+		delete [] m_pErrors[k];
+		delete [] m_pFrameErrors[k];
+	}
+}
+
+void MotionError::Allocate(int nNumFrames)
+{
+	m_NumFrames = nNumFrames;
+	if (nNumFrames <= m_Capacity)
+		return;
+
+	for (int k = 0; k < NUM_ERROR_KINDS; k++)
+	{
+		delete [] m_pErrors[k];
+		delete [] m_pFrameErrors[k];
+		m_pErrors[k] = new float [nNumFrames*m_NumBones];
+		m_pFrameErrors[k] = new float [nNumFrames];
+	}
+	m_Capacity = nNumFrames;
+}
+
+int MotionError::Compare(Motion *pReference, Motion *pTest)
+{
+	Allocate(std::min(pReference->m_NumFrames, pTest->m_NumFrames));
+
+	Bone *bone = m_pActor->getRoot();
+	int nMeasured[NUM_ERROR_KINDS] = { 0, m_NumBones };
+	for (int j = 0; j < m_NumBones; j++)
+		if (m_bRotates[j])
+			nMeasured[ERROR_ANGLE]++;
+
+	ThreadPool::GetDefault().ParallelFor(0, m_NumFrames, [&](int nBegin, int nEnd, int nThread)
+	{
+		::vector refJoints[MAX_BONES_IN_ASF_FILE], testJoints[MAX_BONES_IN_ASF_FILE];
+		for (int f = nBegin; f < nEnd; f++)
+		{
+			Posture const& ref = pReference->m_pPostures[f];
+			Posture const& test = pTest->m_pPostures[f];
+			m_pActor->computeJointPositions(ref, refJoints);
+			m_pActor->computeJointPositions(test, testJoints);
+
+			float *pAngle = m_pErrors[ERROR_ANGLE] + f*m_NumBones;
+			float *pPos = m_pErrors[ERROR_POSITION] + f*m_NumBones;
+			for (int j = 0; j < m_NumBones; j++)
+			{
+				float sq = 0;
+				int mask[3] = { bone[j].dofx, bone[j].dofy, bone[j].dofz };
+				for (int a = 0; a < 3; a++)
+					if (j == root || mask[a])
+					{
+						float d = angle_difference(ref.bone_rotation[j].p[a], test.bone_rotation[j].p[a]);
+						sq += d*d;
+					}
+				pAngle[j] = sqrtf(sq);
+
+				float dx = refJoints[j].p[0] - testJoints[j].p[0];
+				float dy = refJoints[j].p[1] - testJoints[j].p[1];
+				float dz = refJoints[j].p[2] - testJoints[j].p[2];
+				pPos[j] = sqrtf(dx*dx + dy*dy + dz*dz);
+			}
+
+			//bones without rotation dofs have an angle error of 0, so the sum covers the measured ones;
+			//a skeleton with none of them has a frame angle error of 0
+			for (int k = 0; k < NUM_ERROR_KINDS; k++)
+			{
+				double sum, sumSq;
+				float fMax;
+				reduce(m_pErrors[k] + f*m_NumBones, m_NumBones, &sum, &sumSq, &fMax, NULL);
+				m_pFrameErrors[k][f] = nMeasured[k] > 0 ? (float)sqrt(sumSq/nMeasured[k]) : 0.0f;
+			}
+		}
+	}, 64);
+
+	Summarize();
+	return m_NumFrames;
+}
+
+void MotionError::Summarize()
+{
+	//per bone, one column of the error matrix each
+	for (int k = 0; k < NUM_ERROR_KINDS; k++)
+	{
+		ErrorKind kind = (ErrorKind)k;
+		ThreadPool::GetDefault().ParallelFor(0, m_NumBones, [&](int nBegin, int nEnd, int nThread)
+		{
+			std::vector<float> column(m_NumFrames);
+			for (int j = nBegin; j < nEnd; j++)
+			{
+				if (!IsMeasured(kind, j))
+				{
+					summarize(NULL, 0, 1, &m_pBoneSummary[k][j]);
+					continue;
+				}
+				for (int f = 0; f < m_NumFrames; f++)
+					column[f] = m_pErrors[k][f*m_NumBones + j];
+				summarize(column.data(), m_NumFrames, 1, &m_pBoneSummary[k][j]);
+			}
+		});
+	}
+
+	//whole motion, every measured bone of every frame
+	for (int k = 0; k < NUM_ERROR_KINDS; k++)
+	{
+		ErrorKind kind = (ErrorKind)k;
+		int nMeasured = 0;
+		int pBones[MAX_BONES_IN_ASF_FILE];
+		for (int j = 0; j < m_NumBones; j++)
+			if (IsMeasured(kind, j))
+				pBones[nMeasured++] = j;
+
+		std::vector<float> values((size_t)m_NumFrames*nMeasured);
+		for (int f = 0; f < m_NumFrames; f++)
+			for (int i = 0; i < nMeasured; i++)
+				values[(size_t)f*nMeasured + i] = m_pErrors[k][f*m_NumBones + pBones[i]];
+		summarize(values.data(), (int)values.size(), nMeasured > 0 ? nMeasured : 1, &m_Summary[k]);
+	}
+}
+
+//JSON has no nan or inf, those are written as null
+static void write_number(FILE *pFile, char const *pPrefix, double value)
+{
+	if (std::isfinite(value))
+		fprintf(pFile, "%s%.6g", pPrefix, value);
+	else
+		fprintf(pFile, "%snull", pPrefix);
+}
+
+static void write_summary(FILE *pFile, ErrorSummary const& s)
+{
+	fprintf(pFile, "{\"count\": %d", s.count);
+	write_number(pFile, ", \"rms\": ", s.rms);
+	write_number(pFile, ", \"mean\": ", s.mean);
+	write_number(pFile, ", \"max\": ", s.max);
+	fprintf(pFile, ", \"max_frame\": %d", s.maxFrame);
+	write_number(pFile, ", \"p50\": ", s.p50);
+	write_number(pFile, ", \"p90\": ", s.p90);
+	write_number(pFile, ", \"p95\": ", s.p95);
+	write_number(pFile, ", \"p99\": ", s.p99);
+	fprintf(pFile, "}");
+}
+
+//File names may hold backslashes (Windows paths) and quotes
+static void write_string(FILE *pFile, char const *pStr)
+{
+	fputc('"', pFile);
+	for (; *pStr != '\0'; pStr++)
+	{
+		if (*pStr == '"' || *pStr == '\\')
+			fputc('\\', pFile);
+		fputc(*pStr, pFile);
+	}
+	fputc('"', pFile);
+}
+
+void MotionError::WriteJSON(FILE *pFile, char const *pReferenceName, char const *pTestName, bool bFrames) const
+{
+	fprintf(pFile, "{\n  \"reference\": ");
+	write_string(pFile, pReferenceName != NULL ? pReferenceName : "");
+	fprintf(pFile, ",\n  \"test\": ");
+	write_string(pFile, pTestName != NULL ? pTestName : "");
+	fprintf(pFile, ",\n  \"frames\": %d,\n  \"bones\": %d,\n  \"units\": {\"angle\": \"degrees\", \"position\": \"skeleton\"},\n",
+		m_NumFrames, m_NumBones);
+
+	for (int k = 0; k < NUM_ERROR_KINDS; k++)
+	{
+		fprintf(pFile, "  \"%s\": ", kindNames[k]);
+		write_summary(pFile, m_Summary[k]);
+		fprintf(pFile, ",\n");
+	}
+
+	fprintf(pFile, "  \"per_bone\": [\n");
+	for (int j = 0; j < m_NumBones; j++)
+	{
+		fprintf(pFile, "    {\"bone\": ");
+		write_string(pFile, m_pActor->idx2name(j));
+		for (int k = 0; k < NUM_ERROR_KINDS; k++)
+		{
+			if (!IsMeasured((ErrorKind)k, j))
+				continue;
+			fprintf(pFile, ", \"%s\": ", kindNames[k]);
+			write_summary(pFile, m_pBoneSummary[k][j]);
+		}
+		fprintf(pFile, "}%s\n", j + 1 < m_NumBones ? "," : "");
+	}
+	fprintf(pFile, "  ]");
+
+	if (bFrames)
+	{
+		fprintf(pFile, ",\n  \"per_frame\": {");
+		for (int k = 0; k < NUM_ERROR_KINDS; k++)
+		{
+			fprintf(pFile, "%s\n    \"%s\": [", k > 0 ? "," : "", kindNames[k]);
+			for (int f = 0; f < m_NumFrames; f++)
+				write_number(pFile, f > 0 ? ", " : "", m_pFrameErrors[k][f]);
+			fprintf(pFile, "]");
+		}
+		fprintf(pFile, "\n  }");
+	}
+	fprintf(pFile, "\n}\n");
+}
+
+int MotionError::WriteJSON(char *filename, char const *pReferenceName, char const *pTestName, bool bFrames) const
+{
+	FILE *pFile = fopen(filename, "w");
+	if (pFile == NULL)
+		return -1;
+	WriteJSON(pFile, pReferenceName, pTestName, bFrames);
+	return fclose(pFile) == 0 ? 0 : -1;
+}
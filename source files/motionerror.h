@@ -0,0 +1,87 @@
+/*
+	motionerror.h
+
+	Reconstruction error of a motion (e.g. interpolated from keyframes) against the original.
+
+	For every frame and every bone two errors are computed:
+		angle      norm of the difference of the bone rotation dofs, in degrees
+		           (each difference wrapped to [-180, 180))
+		position   distance between the end points of the bone given by forward kinematics,
+		           in skeleton units (the root position included)
+	The errors are summarized per frame (RMS over the bones), per bone (over the frames) and
+	over the whole motion, and can be written as a JSON report.
+	Bones without rotation dofs do not enter the angle statistics.
+*/
+
+#ifndef _MOTIONERROR_H
+#define _MOTIONERROR_H
+
+#include <cstdio>
+
+#include "types.h"
+#include "motion.h"
+#include "skeleton.h"
+
+//Statistics of a set of error values
+struct ErrorSummary
+{
+	int count;
+	double rms, mean, max;
+	double p50, p90, p95, p99;			// percentiles
+	int maxFrame;						// frame of the maximum (0-based)
+};
+
+enum ErrorKind
+{
+	ERROR_ANGLE = 0, ERROR_POSITION, NUM_ERROR_KINDS
+};
+
+class MotionError
+{
+	//member functions
+	public:
+		MotionError(Skeleton *pActor);
+		~MotionError();
+
+		//Compare the frames the two motions have in common, in parallel over frames.
+		//Returns the number of frames compared
+		int Compare(Motion *pReference, Motion *pTest);
+
+		int GetNumFrames() const { return m_NumFrames; }
+		int GetNumBones() const { return m_NumBones; }
+
+		//Error of bone nBone at frame nFrame
+		float GetError(ErrorKind kind, int nFrame, int nBone) const { return m_pErrors[kind][nFrame*m_NumBones + nBone]; }
+		//RMS over the bones, one value per frame
+		float const* GetFrameErrors(ErrorKind kind) const { return m_pFrameErrors[kind]; }
+
+		ErrorSummary const& GetSummary(ErrorKind kind) const { return m_Summary[kind]; }
+		ErrorSummary const& GetBoneSummary(ErrorKind kind, int nBone) const { return m_pBoneSummary[kind][nBone]; }
+		//True if the bone enters the statistics of this kind
+		bool IsMeasured(ErrorKind kind, int nBone) const { return kind == ERROR_POSITION || m_bRotates[nBone]; }
+
+		//JSON report; with bFrames the per frame errors are included. Values that are not finite
+		//(a corrupt input) are written as null
+		void WriteJSON(FILE *pFile, char const *pReferenceName, char const *pTestName, bool bFrames) const;
+		int WriteJSON(char *filename, char const *pReferenceName, char const *pTestName, bool bFrames) const;
+
+	private:
+		void Allocate(int nNumFrames);
+		void Summarize();
+
+	//member variables
+	private:
+		Skeleton *m_pActor;
+		int m_NumBones;
+		bool m_bRotates[MAX_BONES_IN_ASF_FILE];
+
+		int m_NumFrames;
+		int m_Capacity;
+		float *m_pErrors[NUM_ERROR_KINDS];				// m_NumFrames x m_NumBones
+		float *m_pFrameErrors[NUM_ERROR_KINDS];			// m_NumFrames
+
+		ErrorSummary m_Summary[NUM_ERROR_KINDS];
+		ErrorSummary m_pBoneSummary[NUM_ERROR_KINDS][MAX_BONES_IN_ASF_FILE];
+};
+
+#endif
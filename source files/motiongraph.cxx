@@ -0,0 +1,370 @@
+#include <cmath>
+#include <algorithm>
+
+#include "motiongraph.h"
+#include "distmatrix.h"
+#include "poseindex.h"
+#include "transform.h"
+
+//Frames looked ahead when an edge is chosen to follow a path
+#define MOTION_GRAPH_HORIZON 240
+
+
+/************************ MotionGraph class functions **********************************/
+MotionGraph::MotionGraph(Skeleton *pActor, float fThreshold, int nBlendFrames)
+{
+	m_pActor = pActor;
+	m_Threshold = fThreshold;
+	m_BlendFrames = nBlendFrames < 1 ? 1 : nBlendFrames;
+	m_Dimension = PoseFeatures(pActor, POSE_FEATURE_JOINTS).GetDimension();
+	m_bLiveValid = true;
+}
+
+MotionGraph::~MotionGraph()
+{
+}
+
+int MotionGraph::AddClip(Motion *pMotion)
+{
+	if (pMotion == NULL || pMotion->m_NumFrames <= m_BlendFrames)
+		return -1;
+
+	Clip clip;
+	clip.pMotion = pMotion;
+	clip.features.resize((size_t)pMotion->m_NumFrames*m_Dimension);
+	PoseFeatures(m_pActor, POSE_FEATURE_JOINTS).Compute(pMotion, clip.features.data());
+	clip.lastExit = -1;
+	m_Clips.push_back(clip);
+
+	//only the pairs involving the new clip
+	int nClip = (int)m_Clips.size() - 1;
+	for (int c = 0; c <= nClip; c++)
+		AddEdges(nClip, c);
+
+	m_bLiveValid = false;
+	return nClip;
+}
+
+void MotionGraph::AddEdges(int nClipA, int nClipB)
+{
+	Clip const& a = m_Clips[nClipA];
+	Clip const& b = m_Clips[nClipB];
+	int nA = a.pMotion->m_NumFrames, nB = b.pMotion->m_NumFrames;
+
+	DistanceMatrix matrix;
+	matrix.SetFeatures(a.features.data(), nA, b.features.data(), nB, m_Dimension);
+	std::vector<DistanceMinimum> minima;
+	matrix.FindLocalMinima(m_Threshold, minima);
+
+	//the blend needs m_BlendFrames frames of both clips, and a frame to land on after it
+	for (int m = 0; m < (int)minima.size(); m++)
+	{
+		int i = minima[m].frameA, j = minima[m].frameB;
+		MotionGraphEdge edge;
+		edge.distance = minima[m].distance;
+		edge.bLive = true;
+
+		if (nClipA == nClipB && abs(i - j) <= m_BlendFrames)
+			continue;		// the clip itself, a few frames later
+
+		if (i + m_BlendFrames <= nA && j + m_BlendFrames < nB)
+		{
+			edge.fromClip = nClipA; edge.fromFrame = i;
+			edge.toClip = nClipB; edge.toFrame = j;
+			m_Edges.push_back(edge);
+		}
+		//the matrix is symmetric, so the minima of (B, A) are the same pairs; the self matrix already holds both
+		if (nClipA != nClipB && j + m_BlendFrames <= nB && i + m_BlendFrames < nA)
+		{
+			edge.fromClip = nClipB; edge.fromFrame = j;
+			edge.toClip = nClipA; edge.toFrame = i;
+			m_Edges.push_back(edge);
+		}
+	}
+}
+
+//An edge is live if, after its blend, a live edge still leaves the clip it lands in
+void MotionGraph::UpdateLiveEdges()
+{
+	if (m_bLiveValid)
+		return;
+
+	for (int e = 0; e < (int)m_Edges.size(); e++)
+		m_Edges[e].bLive = true;
+
+	bool bChanged = true;
+	while (bChanged)
+	{
+		bChanged = false;
+		for (int c = 0; c < (int)m_Clips.size(); c++)
+			m_Clips[c].lastExit = -1;
+		for (int e = 0; e < (int)m_Edges.size(); e++)
+			if (m_Edges[e].bLive)
+				m_Clips[m_Edges[e].fromClip].lastExit = std::max(m_Clips[m_Edges[e].fromClip].lastExit, m_Edges[e].fromFrame);
+
+		for (int e = 0; e < (int)m_Edges.size(); e++)
+		{
+			MotionGraphEdge &edge = m_Edges[e];
+			if (edge.bLive && m_Clips[edge.toClip].lastExit < edge.toFrame + m_BlendFrames)
+			{
+				edge.bLive = false;
+				bChanged = true;
+			}
+		}
+	}
+
+	for (int c = 0; c < (int)m_Clips.size(); c++)
+		m_Clips[c].edgesByFrame.clear();
+	for (int e = 0; e < (int)m_Edges.size(); e++)
+		if (m_Edges[e].bLive)
+			m_Clips[m_Edges[e].fromClip].edgesByFrame.push_back(e);
+	for (int c = 0; c < (int)m_Clips.size(); c++)
+	{
+		std::vector<int> &edges = m_Clips[c].edgesByFrame;
+		std::sort(edges.begin(), edges.end(), [this](int a, int b) { return m_Edges[a].fromFrame < m_Edges[b].fromFrame; });
+	}
+	m_bLiveValid = true;
+}
+
+int MotionGraph::GetNumLiveEdges()
+{
+	UpdateLiveEdges();
+	int n = 0;
+	for (int c = 0; c < (int)m_Clips.size(); c++)
+		n += (int)m_Clips[c].edgesByFrame.size();
+	return n;
+}
+
+int MotionGraph::GetLastExit(int nClip)
+{
+	UpdateLiveEdges();
+	return m_Clips[nClip].lastExit;
+}
+
+int MotionGraph::GetEdgesFrom(int nClip, int nFrame, std::vector<int> &edges)
+{
+	UpdateLiveEdges();
+	edges.clear();
+
+	std::vector<int> const& byFrame = m_Clips[nClip].edgesByFrame;
+	std::vector<int>::const_iterator it = std::lower_bound(byFrame.begin(), byFrame.end(), nFrame,
+		[this](int e, int frame) { return m_Edges[e].fromFrame < frame; });
+	for (; it != byFrame.end() && m_Edges[*it].fromFrame == nFrame; ++it)
+		edges.push_back(*it);
+	return (int)edges.size();
+}
+
+
+/************************ MotionSynthesizer class functions **********************************/
+
+//Heading of a posture: angle about the vertical axis of the direction the root faces (+z of the root)
+static float heading(Posture const& posture)
+{
+	float R[3][3];
+	euler_to_matrix(posture.bone_rotation[root].p, R);
+	return (float)(atan2(R[0][2], R[2][2])*180./M_PI);
+}
+
+//Angle difference wrapped to [-180, 180)
+static float wrap_angle(float d)
+{
+	return d - 360.0f*floorf((d + 180.0f)/360.0f);
+}
+
+MotionSynthesizer::MotionSynthesizer(MotionGraph *pGraph, unsigned int nSeed)
+{
+	m_pGraph = pGraph;
+	m_Seed = nSeed;
+	m_Radius = 0;
+	m_NextPoint = 0;
+	m_RandomChance = 20;
+	Start(0, 0);
+}
+
+void MotionSynthesizer::Start(int nClip, int nFrame)
+{
+	m_Clip = nClip;
+	m_Frame = nFrame;
+	m_Transform.yaw = m_Transform.x = m_Transform.z = 0;
+	m_BlendFrame = -1;
+	m_FromClip = m_FromFrame = 0;
+	m_FromTransform = m_Transform;
+	m_NumTransitions = 0;
+	m_NextPoint = 0;
+	m_NumPointsReached = 0;
+}
+
+void MotionSynthesizer::SetPath(float const *pPoints, int nNumPoints, float fRadius)
+{
+	m_Path.assign(pPoints, pPoints + 2*nNumPoints);
+	m_Radius = fRadius;
+	m_NextPoint = 0;
+	m_NumPointsReached = 0;
+}
+
+//Turn the posture about the vertical axis and move it on the floor.
+//The root axis of the ASF file is assumed to be aligned with the world axes
+void MotionSynthesizer::Place(Posture const& in, FloorTransform const& transform, Posture *pOut) const
+{
+	*pOut = in;
+	float a = transform.yaw*(float)(M_PI/180.), c = cosf(a), s = sinf(a);
+
+	float x = in.root_pos.p[0], z = in.root_pos.p[2];
+	pOut->root_pos.p[0] = c*x + s*z + transform.x;
+	pOut->root_pos.p[2] = -s*x + c*z + transform.z;
+	pOut->bone_translation[root] = pOut->root_pos;
+
+	//R' = Ry(yaw) * R
+	float R[3][3], Ry[3][3] = { {c, 0, s}, {0, 1, 0}, {-s, 0, c} }, Rt[3][3];
+	euler_to_matrix(in.bone_rotation[root].p, R);
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 3; j++)
+			Rt[i][j] = Ry[i][0]*R[0][j] + Ry[i][1]*R[1][j] + Ry[i][2]*R[2][j];
+	matrix_to_euler(Rt, pOut->bone_rotation[root].p);
+}
+
+void MotionSynthesizer::RootFloorPosition(int nClip, int nFrame, FloorTransform const& transform, float *pX, float *pZ) const
+{
+	Posture const& posture = m_pGraph->GetClip(nClip)->m_pPostures[nFrame];
+	float a = transform.yaw*(float)(M_PI/180.), c = cosf(a), s = sinf(a);
+	float x = posture.root_pos.p[0], z = posture.root_pos.p[2];
+	*pX = c*x + s*z + transform.x;
+	*pZ = -s*x + c*z + transform.z;
+}
+
+//Placement of nToClip that puts its frame nToFrame where frame nFromFrame of nFromClip is, facing the same way
+FloorTransform MotionSynthesizer::Align(int nFromClip, int nFromFrame, FloorTransform const& from, int nToClip, int nToFrame) const
+{
+	Posture const& a = m_pGraph->GetClip(nFromClip)->m_pPostures[nFromFrame];
+	Posture const& b = m_pGraph->GetClip(nToClip)->m_pPostures[nToFrame];
+
+	FloorTransform to;
+	to.yaw = wrap_angle(heading(a) + from.yaw - heading(b));
+
+	float x, z;
+	RootFloorPosition(nFromClip, nFromFrame, from, &x, &z);
+	float r = to.yaw*(float)(M_PI/180.), c = cosf(r), s = sinf(r);
+	to.x = x - (c*b.root_pos.p[0] + s*b.root_pos.p[2]);
+	to.z = z - (-s*b.root_pos.p[0] + c*b.root_pos.p[2]);
+	return to;
+}
+
+//Edge to take among the candidates, -1 to stay in the clip
+int MotionSynthesizer::ChooseEdge(std::vector<int> const& edges, bool bMustLeave)
+{
+	if (m_NextPoint < (int)m_Path.size()/2)
+	{
+		//the option whose root ends closest to the next point after the horizon
+		float px = m_Path[2*m_NextPoint], pz = m_Path[2*m_NextPoint + 1];
+		int nBest = -1;
+		float fBest = 1e30f;
+		if (!bMustLeave)
+		{
+			Motion *pClip = m_pGraph->GetClip(m_Clip);
+			float x, z;
+			RootFloorPosition(m_Clip, std::min(m_Frame + MOTION_GRAPH_HORIZON, pClip->m_NumFrames - 1), m_Transform, &x, &z);
+			//staying is preferred unless an edge is clearly better
+			fBest = 0.95f*sqrtf((x - px)*(x - px) + (z - pz)*(z - pz));
+		}
+		for (int i = 0; i < (int)edges.size(); i++)
+		{
+			MotionGraphEdge const& edge = m_pGraph->GetEdge(edges[i]);
+			FloorTransform to = Align(m_Clip, m_Frame, m_Transform, edge.toClip, edge.toFrame);
+			float x, z;
+			RootFloorPosition(edge.toClip, std::min(edge.toFrame + MOTION_GRAPH_HORIZON, m_pGraph->GetClip(edge.toClip)->m_NumFrames - 1), to, &x, &z);
+			float d = sqrtf((x - px)*(x - px) + (z - pz)*(z - pz));
+			if (d < fBest)
+			{
+				fBest = d;
+				nBest = edges[i];
+			}
+		}
+		return nBest;
+	}
+
+	m_Seed = m_Seed*1664525u + 1013904223u;
+	unsigned int r = m_Seed >> 8;
+	if (!bMustLeave && m_RandomChance > 0 && r % (unsigned int)m_RandomChance != 0)
+		return -1;
+	return edges[(r/(unsigned int)std::max(m_RandomChance, 1)) % edges.size()];
+}
+
+bool MotionSynthesizer::NextFrame(Posture *pPosture)
+{
+	Motion *pClip = m_pGraph->GetClip(m_Clip);
+
+	//path point reached, or passed: the root is closer to the point after it than the point itself
+	if (m_NextPoint < (int)m_Path.size()/2 && m_Frame < pClip->m_NumFrames)
+	{
+		float x, z;
+		RootFloorPosition(m_Clip, m_Frame, m_Transform, &x, &z);
+		float const *p = &m_Path[2*m_NextPoint];
+		float d2 = (x - p[0])*(x - p[0]) + (z - p[1])*(z - p[1]);
+		if (d2 < m_Radius*m_Radius)
+		{
+			m_NumPointsReached++;
+			m_NextPoint++;
+		}
+		else if (m_NextPoint + 1 < (int)m_Path.size()/2 &&
+			(x - p[2])*(x - p[2]) + (z - p[3])*(z - p[3]) < (p[0] - p[2])*(p[0] - p[2]) + (p[1] - p[3])*(p[1] - p[3]))
+			m_NextPoint++;
+	}
+
+	//decide at the frames edges leave from
+	if (m_BlendFrame < 0)
+	{
+		int nLastExit = m_pGraph->GetLastExit(m_Clip);
+		if (m_Frame >= pClip->m_NumFrames)
+			return false;
+
+		if (m_pGraph->GetEdgesFrom(m_Clip, m_Frame, m_Candidates) > 0)
+		{
+			int nEdge = ChooseEdge(m_Candidates, m_Frame >= nLastExit);
+			if (nEdge >= 0)
+			{
+				MotionGraphEdge const& edge = m_pGraph->GetEdge(nEdge);
+				m_FromClip = m_Clip;
+				m_FromFrame = m_Frame;
+				m_FromTransform = m_Transform;
+				m_Transform = Align(m_Clip, m_Frame, m_Transform, edge.toClip, edge.toFrame);
+				m_Clip = edge.toClip;
+				m_Frame = edge.toFrame;
+				m_BlendFrame = 0;
+				m_NumTransitions++;
+				pClip = m_pGraph->GetClip(m_Clip);
+			}
+		}
+	}
+
+	if (m_BlendFrame < 0)
+	{
+		Place(pClip->m_pPostures[m_Frame], m_Transform, pPosture);
+		m_Frame++;
+		return true;
+	}
+
+	//blend from the clip left towards the clip entered, weight 3w^2 - 2w^3
+	int nBlend = m_pGraph->GetBlendFrames();
+	float w = (float)(m_BlendFrame + 1)/(nBlend + 1);
+	w = w*w*(3.0f - 2.0f*w);
+
+	Posture from;
+	Place(m_pGraph->GetClip(m_FromClip)->m_pPostures[m_FromFrame + m_BlendFrame], m_FromTransform, &from);
+	Place(pClip->m_pPostures[m_Frame], m_Transform, pPosture);
+
+	pPosture->root_pos = from.root_pos*(1.0f - w) + pPosture->root_pos*w;
+	pPosture->bone_translation[root] = pPosture->root_pos;
+	for (int j = 0; j < MAX_BONES_IN_ASF_FILE; j++)
+		for (int a = 0; a < 3; a++)
+		{
+			float fFrom = from.bone_rotation[j].p[a];
+			pPosture->bone_rotation[j].p[a] = fFrom + w*wrap_angle(pPosture->bone_rotation[j].p[a] - fFrom);
+			if (j != root)
+				pPosture->bone_translation[j].p[a] = from.bone_translation[j].p[a]*(1.0f - w) + pPosture->bone_translation[j].p[a]*w;
+		}
+
+	m_Frame++;
+	if (++m_BlendFrame == nBlend)
+		m_BlendFrame = -1;
+	return true;
+}
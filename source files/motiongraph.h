@@ -0,0 +1,148 @@
+/*
+	motiongraph.h
+
+	Motion graph: clips connected by transitions at frames where their poses are alike,
+	walked to synthesize new motions of any length.
+
+	A transition edge (fromClip, fromFrame) -> (toClip, toFrame) is made at every local minimum
+	of the distance matrix (see distmatrix.h) of two clips that is below the threshold.
+	Taking it plays fromClip[fromFrame + t] blended into toClip[toFrame + t] for t = 0 .. blend-1,
+	with a smooth (cubic) weight, and continues in toClip after the blend. The incoming clip is
+	turned about the vertical axis and moved so that its root continues from where the
+	outgoing one is.
+
+	AddClip compares the new clip with itself and with the clips already in the graph only,
+	so the graph grows incrementally. Edges leading to a part of a clip from which no other
+	edge leaves (a dead end) are not taken by the synthesizer.
+
+	MotionSynthesizer walks the graph one frame at a time, so the output is never held in memory:
+	either at random, or following a path of points on the floor.
+*/
+
+#ifndef _MOTIONGRAPH_H
+#define _MOTIONGRAPH_H
+
+#include <vector>
+
+#include "motion.h"
+#include "skeleton.h"
+#include "posture.h"
+
+#define MOTION_GRAPH_DEFAULT_BLEND 30
+
+struct MotionGraphEdge
+{
+	int fromClip, fromFrame;
+	int toClip, toFrame;
+	float distance;
+	bool bLive;						// false if the edge leads to a dead end
+};
+
+class MotionGraph
+{
+	//member functions
+	public:
+		//fThreshold is the largest pose distance of a transition; nBlendFrames the length of its blend
+		MotionGraph(Skeleton *pActor, float fThreshold, int nBlendFrames = MOTION_GRAPH_DEFAULT_BLEND);
+		~MotionGraph();
+
+		//Add a clip (kept by pointer, not copied) and the edges between it and the graph.
+		//Returns the clip number, -1 on error
+		int AddClip(Motion *pMotion);
+
+		int GetNumClips() const { return (int)m_Clips.size(); }
+		Motion *GetClip(int nClip) const { return m_Clips[nClip].pMotion; }
+		int GetNumEdges() const { return (int)m_Edges.size(); }
+		MotionGraphEdge const& GetEdge(int nEdge) const { return m_Edges[nEdge]; }
+		int GetNumLiveEdges();
+		int GetBlendFrames() const { return m_BlendFrames; }
+		Skeleton *GetActor() const { return m_pActor; }
+
+		//Edges leaving nClip at nFrame (live ones only). Returns their number
+		int GetEdgesFrom(int nClip, int nFrame, std::vector<int> &edges);
+		//Last frame of nClip that a live edge leaves from, -1 if none
+		int GetLastExit(int nClip);
+
+	private:
+		void AddEdges(int nClipA, int nClipB);
+		void UpdateLiveEdges();
+
+	//member variables
+	private:
+		struct Clip
+		{
+			Motion *pMotion;
+			std::vector<float> features;
+			std::vector<int> edgesByFrame;	// live edges sorted by source frame
+			int lastExit;
+		};
+
+		Skeleton *m_pActor;
+		float m_Threshold;
+		int m_BlendFrames;
+		int m_Dimension;
+
+		std::vector<Clip> m_Clips;
+		std::vector<MotionGraphEdge> m_Edges;
+		bool m_bLiveValid;				// live flags and clip edge lists are up to date
+};
+
+//2D placement of a clip: rotation about the vertical axis and translation on the floor
+struct FloorTransform
+{
+	float yaw;						// degrees
+	float x, z;
+};
+
+class MotionSynthesizer
+{
+	//member functions
+	public:
+		MotionSynthesizer(MotionGraph *pGraph, unsigned int nSeed = 1);
+
+		//Start over at frame nFrame of clip nClip, placed as in the clip
+		void Start(int nClip, int nFrame);
+
+		//Points on the floor (x, z) to walk through, reached when closer than fRadius.
+		//A point that was missed is given up once the root is closer to the next one than it is.
+		//Without a path the edges are chosen at random, one decision frame in nChance
+		void SetPath(float const *pPoints, int nNumPoints, float fRadius);
+		void SetRandomChance(int nChance) { m_RandomChance = nChance; }
+
+		//Next frame of the motion; false if the walk ended in a dead end
+		bool NextFrame(Posture *pPosture);
+
+		int GetNumTransitions() const { return m_NumTransitions; }
+		int GetNumPointsReached() const { return m_NumPointsReached; }
+		int GetCurrentClip() const { return m_Clip; }
+
+	private:
+		void Place(Posture const& in, FloorTransform const& transform, Posture *pOut) const;
+		void RootFloorPosition(int nClip, int nFrame, FloorTransform const& transform, float *pX, float *pZ) const;
+		FloorTransform Align(int nFromClip, int nFromFrame, FloorTransform const& from, int nToClip, int nToFrame) const;
+		int ChooseEdge(std::vector<int> const& edges, bool bMustLeave);
+
+	//member variables
+	private:
+		MotionGraph *m_pGraph;
+		unsigned int m_Seed;
+
+		//current position in the graph
+		int m_Clip, m_Frame;
+		FloorTransform m_Transform;
+
+		//transition being blended (m_BlendFrame < 0 when none)
+		int m_BlendFrame;
+		int m_FromClip, m_FromFrame;
+		FloorTransform m_FromTransform;
+
+		std::vector<float> m_Path;
+		float m_Radius;
+		int m_NextPoint;
+		int m_NumPointsReached;
+		int m_RandomChance;
+		int m_NumTransitions;
+		std::vector<int> m_Candidates;
+};
+
+#endif
@@ -0,0 +1,189 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "motionsampler.h"
+#include "transform.h"
+#include "threadpool.h"
+
+
+/************************ MotionSampler class functions **********************************/
+MotionSampler::MotionSampler(Motion *pMotion, SampleFilter filter) : m_Layout(pMotion->pActor)
+{
+	m_pMotion = pMotion;
+	m_Filter = filter;
+	m_Segment = -1;
+
+	int count[MAX_BONES_IN_ASF_FILE] = { 0 };
+	m_NumAngles = 0;
+	for (int c = 0; c < m_Layout.m_NumChannels; c++)
+	{
+		Channel const& channel = m_Layout.m_Channels[c];
+		if (m_Layout.IsAngle(c))
+		{
+			m_Angles[m_NumAngles++] = c;
+			m_SlerpChannels[channel.bone][channel.axis] = c;
+			count[channel.bone]++;
+		}
+	}
+	m_NumSlerpBones = 0;
+	for (int b = 0; b < MAX_BONES_IN_ASF_FILE; b++)
+		if (count[b] == 3)
+			m_SlerpBones[m_NumSlerpBones++] = b;
+}
+
+MotionSampler::~MotionSampler()
+{
+}
+
+void MotionSampler::SetFilter(SampleFilter filter)
+{
+	m_Filter = filter;
+	m_Segment = -1;
+}
+
+//Frames nSegment-1 .. nSegment+2. From the previous segment only the new last frame is read
+void MotionSampler::LoadSegment(int nSegment)
+{
+	int nLast = m_pMotion->m_NumFrames - 1;
+	Posture const *pPostures = m_pMotion->m_pPostures;
+	bool bShift = m_Segment >= 0 && nSegment == m_Segment + 1;
+
+	if (bShift)
+	{
+		memmove(m_Raw[0], m_Raw[1], 3*sizeof(m_Raw[0]));
+		m_Layout.Gather(pPostures[std::min(nSegment + 2, nLast)], m_Raw[3]);
+	}
+	else
+		for (int k = 0; k < 4; k++)
+			m_Layout.Gather(pPostures[std::min(std::max(nSegment - 1 + k, 0), nLast)], m_Raw[k]);
+	m_Segment = nSegment;
+
+	//angles within 180 degrees of frame nSegment
+	for (int k = 0; k < 4; k++)
+	{
+		memcpy(m_Keys[k], m_Raw[k], m_Layout.m_NumChannels*sizeof(float));
+		if (k != 1)
+			for (int i = 0; i < m_NumAngles; i++)
+			{
+				int c = m_Angles[i];
+				m_Keys[k][c] = UnwrapAngle(m_Keys[k][c], m_Raw[1][c]);
+			}
+	}
+
+	if (m_Filter != SAMPLE_QUATERNION)
+		return;
+	for (int i = 0; i < m_NumSlerpBones; i++)
+	{
+		int b = m_SlerpBones[i];
+		if (bShift)
+			memcpy(m_Quaternions[0][b], m_Quaternions[1][b], sizeof(m_Quaternions[0][b]));
+		else
+			euler_to_quaternion(pPostures[nSegment].bone_rotation[b].p, m_Quaternions[0][b]);
+		float *q0 = m_Quaternions[0][b], *q1 = m_Quaternions[1][b];
+		euler_to_quaternion(pPostures[std::min(nSegment + 1, nLast)].bone_rotation[b].p, q1);
+
+		float d = q0[0]*q1[0] + q0[1]*q1[1] + q0[2]*q1[2] + q0[3]*q1[3];
+		if (d < 0)
+		{
+			for (int k = 0; k < 4; k++)
+				q1[k] = -q1[k];
+			d = -d;
+		}
+		//nearly the same rotation: a normalized linear blend is as good and stays defined
+		m_Arcs[b] = d < 0.9995f ? acosf(d) : 0.0f;
+	}
+}
+
+void MotionSampler::GetValues(float fSeconds, float *pValues)
+{
+	int nFrames = m_pMotion->m_NumFrames, nChannels = m_Layout.m_NumChannels;
+	float f = fSeconds*m_pMotion->m_FrameRate + m_pMotion->offset;
+	f = std::min(std::max(f, 0.0f), (float)(nFrames - 1));
+	int nSegment = std::min((int)f, std::max(nFrames - 2, 0));
+	float u = f - nSegment;
+	if (nSegment != m_Segment)
+		LoadSegment(nSegment);
+
+	if (m_Filter == SAMPLE_NEAREST)
+	{
+		memcpy(pValues, m_Raw[u < 0.5f ? 1 : 2], nChannels*sizeof(float));
+		return;
+	}
+
+	float const *k0 = m_Keys[0], *k1 = m_Keys[1], *k2 = m_Keys[2], *k3 = m_Keys[3];
+	if (m_Filter == SAMPLE_CATMULL_ROM)
+	{
+		//evenly spaced frames; the end frames are repeated (LoadSegment), as by the Interpolator
+		float w[4];
+		CatmullRomWeights(u, -1.0f, 0.0f, 1.0f, 2.0f, w);
+		for (int c = 0; c < nChannels; c++)
+			pValues[c] = w[0]*k0[c] + w[1]*k1[c] + w[2]*k2[c] + w[3]*k3[c];
+		return;
+	}
+
+	float w1 = 1.0f - u;
+	for (int c = 0; c < nChannels; c++)
+		pValues[c] = w1*k1[c] + u*k2[c];
+	if (m_Filter != SAMPLE_QUATERNION)
+		return;
+
+	for (int i = 0; i < m_NumSlerpBones; i++)
+	{
+		int b = m_SlerpBones[i];
+		float const *q0 = m_Quaternions[0][b], *q1 = m_Quaternions[1][b];
+		float wa = w1, wb = u, theta = m_Arcs[b];
+		if (theta > 0)
+		{
+			float s = 1.0f/sinf(theta);
+			wa = sinf(w1*theta)*s;
+			wb = sinf(u*theta)*s;
+		}
+		float q[4], n = 0;
+		for (int k = 0; k < 4; k++)
+		{
+			q[k] = wa*q0[k] + wb*q1[k];
+			n += q[k]*q[k];
+		}
+		n = 1.0f/sqrtf(n);
+		for (int k = 0; k < 4; k++)
+			q[k] *= n;
+
+		float angles[3];
+		quaternion_to_euler(q, angles);
+		for (int a = 0; a < 3; a++)
+			pValues[m_SlerpChannels[b][a]] = angles[a];
+	}
+}
+
+void MotionSampler::GetPosture(float fSeconds, Posture *pPosture)
+{
+	float values[MAX_CHANNELS];
+	GetValues(fSeconds, values);
+	//what is not a channel (bone lengths, unused dofs) comes from the first frame of the segment
+	*pPosture = m_pMotion->m_pPostures[m_Segment];
+	m_Layout.Scatter(values, *pPosture);
+}
+
+void MotionSampler::GetValues(float const *pSeconds, int nCount, float *pValues) const
+{
+	int nChannels = m_Layout.m_NumChannels;
+	ThreadPool::GetDefault().ParallelFor(0, nCount, [&](int nBegin, int nEnd, int nThread)
+	{
+		MotionSampler sampler(*this);
+		sampler.Invalidate();
+		for (int i = nBegin; i < nEnd; i++)
+			sampler.GetValues(pSeconds[i], pValues + (size_t)i*nChannels);
+	}, 256);
+}
+
+void MotionSampler::GetPostures(float const *pSeconds, int nCount, Posture *pPostures) const
+{
+	ThreadPool::GetDefault().ParallelFor(0, nCount, [&](int nBegin, int nEnd, int nThread)
+	{
+		MotionSampler sampler(*this);
+		sampler.Invalidate();
+		for (int i = nBegin; i < nEnd; i++)
+			sampler.GetPosture(pSeconds[i], &pPostures[i]);
+	}, 256);
+}
@@ -0,0 +1,83 @@
+/*
+	motionsampler.h
+
+	Evaluation of a motion at any time, between its frames.
+
+	Time is in seconds: frame = fSeconds*m_FrameRate + offset of the motion, clamped to its frames.
+	The filter reconstructs the values between frames i and i+1:
+		SAMPLE_NEAREST      the closer frame
+		SAMPLE_LINEAR       linear interpolation of all channels
+		SAMPLE_CATMULL_ROM  Catmull-Rom spline through frames i-1 .. i+2 (CatmullRomWeights of
+		                    posture.h, as the Interpolator uses)
+		SAMPLE_QUATERNION   slerp of the rotations of the bones with three rotation dofs,
+		                    linear interpolation of all other channels
+	Angles are unwrapped onto frame i first, so a channel going from 179 to -179 degrees
+	moves by 2 degrees. Quaternion results are converted back with matrix_to_euler, so they
+	may use other (equivalent) angles than the frames.
+
+	The sampler keeps the frames of the current segment as channel arrays (see channels.h),
+	and for SAMPLE_QUATERNION the quaternions of its two frames and the angle between them.
+	Samples in the same segment as the previous one cost one weighted sum per channel (a loop
+	the compiler vectorizes), plus a slerp per bone; moving on to the next segment loads one
+	frame. A sampler is therefore meant for one thread walking through the motion; the batch
+	functions split the sample times over the thread pool, one sampler per chunk.
+
+	Call Invalidate after changing the frames of the motion.
+*/
+
+#ifndef _MOTIONSAMPLER_H
+#define _MOTIONSAMPLER_H
+
+#include "motion.h"
+#include "skeleton.h"
+#include "posture.h"
+#include "channels.h"
+
+class MotionSampler
+{
+	//member functions
+	public:
+		//The motion needs its actor
+		MotionSampler(Motion *pMotion, SampleFilter filter = SAMPLE_LINEAR);
+		~MotionSampler();
+
+		void SetFilter(SampleFilter filter);
+		SampleFilter GetFilter() const { return m_Filter; }
+		void Invalidate() { m_Segment = -1; }
+
+		ChannelLayout const& GetLayout() const { return m_Layout; }
+		int GetNumChannels() const { return m_Layout.m_NumChannels; }
+
+		//Channel values at fSeconds into pValues (GetNumChannels() floats)
+		void GetValues(float fSeconds, float *pValues);
+		void GetPosture(float fSeconds, Posture *pPosture);
+
+		//nCount samples at once, in parallel: pValues holds nCount*GetNumChannels() floats
+		void GetValues(float const *pSeconds, int nCount, float *pValues) const;
+		void GetPostures(float const *pSeconds, int nCount, Posture *pPostures) const;
+
+	private:
+		void LoadSegment(int nSegment);
+
+	//member variables
+	private:
+		Motion *m_pMotion;
+		ChannelLayout m_Layout;
+		SampleFilter m_Filter;
+
+		//bones interpolated with quaternions and their rotation channels (x, y, z)
+		int m_NumSlerpBones;
+		int m_SlerpBones[MAX_BONES_IN_ASF_FILE];
+		int m_SlerpChannels[MAX_BONES_IN_ASF_FILE][3];
+		int m_NumAngles;
+		int m_Angles[MAX_CHANNELS];							// rotation channels
+
+		//current segment: frames m_Segment-1 .. m_Segment+2, clamped to the motion
+		int m_Segment;
+		float m_Raw[4][MAX_CHANNELS];						// as stored
+		float m_Keys[4][MAX_CHANNELS];						// angles unwrapped onto frame m_Segment
+		float m_Quaternions[2][MAX_BONES_IN_ASF_FILE][4];	// of frames m_Segment, m_Segment+1, same hemisphere
+		float m_Arcs[MAX_BONES_IN_ASF_FILE];				// angle between them, 0 for a linear blend
+};
+
+#endif
@@ -10,11 +10,10 @@
 #include <cmath>
 #include <algorithm>			// For sort() and find()
 
-#include <process.h>
-
 #include <GL/gl.h>				// Header so that you can use GL routines (MESA)
 #include <GL/glu.h>				// some OpenGL extensions
 #include <FL/glut.H>			// GLUT for use with FLTK
+#include <FL/gl.h>				// gl_draw() for the text of the HUD
 #include <FL/fl_file_chooser.H> // Allow a file chooser for save.
 #include <iostream>
 using namespace std;
@@ -31,7 +30,10 @@ using namespace std;
 #include "transform.h"			// utility functions for vector and matrix transformation  
 #include "display.h"   
 #include "interpolator.h"
-#include "video_texture.h"
+#include "footlock.h"			// foot locking of the interpolated motion
+#include "posestream.h"			// streaming of played frames to other programs
+#include "poseshm.h"			// publication of the actor poses in shared memory
+#include "profiler.h"			// timers of the hot paths, frame times and Chrome traces
 
 /***************  Types *********************/
 enum { OFF, ON };
@@ -72,7 +74,36 @@ static int maxFrames = 0;
 static std::vector<int> keyframes;			// Stores the frame numbers of keyframes
 static int firstFrame = 0;					// Number of the first frame of animation
 
+static PoseStreamSender poseStream;			// Sends every played frame to subscribers (-stream option)
+static PoseShmPublisher poseShm;			// Publishes the pose of every actor in shared memory (-shm option)
+
+static int ShowHud = OFF;					// Frame time percentiles over the scene ('h' key, -hud option)
+static char *traceFilename = NULL;			// Chrome trace written at exit and on the 't' key (-profile option)
+
 /***************  Functions *******************/
+//Send the current frame of the sampled and interpolated motions to the pose stream subscribers
+//and the pose of every actor to shared memory
+static void publish_frame()
+{
+	PROFILE_SCOPE("publish_frame");
+	if (poseStream.IsOpen())
+	{
+		poseStream.Publish(pActor, (*pSampledMotion).m_pPostures[(*pSampledMotion).GetPostureNum(nFrameNum)], 0, nFrameNum);
+		if (pInterpMotion != NULL)
+			poseStream.Publish(pActor, (*pInterpMotion).m_pPostures[(*pInterpMotion).GetPostureNum(nFrameNum)], keyframes.size() + 1, nFrameNum);
+	}
+
+	if (poseShm.IsOpen())
+	{
+		Posture posture;
+		for (int i = 0; i < displayer.numActors; i++)
+		{
+			displayer.m_pActor[i]->getPosture(&posture);
+			poseShm.Publish(displayer.m_pActor[i], posture, i, nFrameNum);
+		}
+	}
+}
+
 static void draw_triad()
 {
 	glBegin(GL_LINES);
@@ -96,6 +127,7 @@ static void draw_triad()
 //Draw checker board ground plane
 static void draw_ground()
 {
+	PROFILE_SCOPE("draw_ground");
 	float i, j;
 	int count = 0;
 
@@ -142,6 +174,44 @@ static void draw_ground()
 	glEnd();
 }
 
+//Frame time percentiles of the last frames in the top left corner of a w x h window
+static void draw_hud(int w, int h)
+{
+	Profiler& profiler = Profiler::Get();
+	char str[160];
+	snprintf(str, sizeof(str), "frame ms  p50 %.1f  p90 %.1f  p99 %.1f  max %.1f  (%d frames)%s",
+		profiler.GetFramePercentile(50), profiler.GetFramePercentile(90), profiler.GetFramePercentile(99),
+		profiler.GetFramePercentile(100), profiler.GetNumFrames(), profiler.IsEnabled() ? "  recording" : "");
+
+	glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+	glDisable(GL_LIGHTING);
+	glDisable(GL_DEPTH_TEST);
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glOrtho(0, w, 0, h, -1, 1);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+
+	glColor3f(1., 1., .2);
+	gl_font(FL_HELVETICA, 12);
+	gl_draw(str, 8, h - 18);
+
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	glPopAttrib();
+}
+
+//atexit handler of the -profile option
+static void write_trace()
+{
+	if (Profiler::Get().WriteChromeTrace(traceFilename) == 0)
+		printf("Trace written to %s\n", traceFilename);
+}
+
 void cameraView(void)
 {
 	glTranslated(camera.tx, camera.ty, camera.tz);
@@ -166,6 +236,7 @@ void cameraView(void)
 */
 static void redisplay()
 {
+	PROFILE_SCOPE("redisplay");
 	if (Light) glEnable(GL_LIGHTING);
 	else glDisable(GL_LIGHTING);
 
@@ -199,26 +270,17 @@ void redisplay_proc(Fl_Light_Button *obj, long val)
 	glwindow->redraw();
 }
 
-// Perfoms calculations for Catmull-Rom interpolation
-::vector Catmull_RomCalc(::vector input1, ::vector input2, ::vector input3, ::vector input4, float u){
-
-	float cube = pow(u, 3); 
-	float square = pow(u, 2);
-
-	::vector temp1 = input1*(-0.5 * cube + square - 0.5 * u);  
-	::vector temp2 = input2*(1.5 * cube - 2.5 * square + 1);
-	::vector temp3 = input3*(-1.5 * cube + 2 * square + 0.5 * u);
-	::vector temp4 = input4*(0.5 * cube - 0.5 * square);
-
-	::vector answer = temp1 + temp2 + temp3 + temp4;
+// Catmull-Rom interpolation of the keys at the frames of the weights (see CatmullRomWeights)
+::vector Catmull_RomCalc(::vector input1, ::vector input2, ::vector input3, ::vector input4, float const *w){
 
-	return answer;
+	return input1*w[0] + input2*w[1] + input3*w[2] + input4*w[3];
 }
 
 
 //Interpolate motion
 void interpolate_callback(Fl_Button *button, void *)
 {
+	PROFILE_SCOPE("interpolate_callback");
 
 	int size = keyframes.size(); 
 	
@@ -261,19 +323,21 @@ void interpolate_callback(Fl_Button *button, void *)
 			float j = keyframes[i] + 1;
 			while(j < keyframes[i + 1]){
 
+				//the spline follows the spacing of the keyframes
+				float w[4];
+				CatmullRomWeights((j - keyframes[i]) / (keyframes[i + 1] - keyframes[i]),
+					keyframes[i - 1], keyframes[i], keyframes[i + 1], keyframes[i + 2], w);
+
 				int k = 0;
 				while(k < pActor->NUM_BONES_IN_ASF_FILE){
+					Bone const& bone = pActor->getRoot()[k];
 
 					::vector input1 = (*pSampledMotion).m_pPostures[(*pSampledMotion).GetPostureNum(keyframes[i - 1])].bone_translation[k].p;
 					::vector input2 = (*pSampledMotion).m_pPostures[(*pSampledMotion).GetPostureNum(keyframes[i])].bone_translation[k].p;
 					::vector input3 = (*pSampledMotion).m_pPostures[(*pSampledMotion).GetPostureNum(keyframes[i + 1])].bone_translation[k].p;
 					::vector input4 = (*pSampledMotion).m_pPostures[(*pSampledMotion).GetPostureNum(keyframes[i + 2])].bone_translation[k].p;
 					
-					double temp1 = (j - keyframes[i]);
-					double temp2 = (keyframes[i + 1] - keyframes[i]);
-					double temp3 = temp1 / temp2; 
-
-					::vector value = Catmull_RomCalc(input1, input2, input3, input4, (temp3));
+					::vector value = Catmull_RomCalc(input1, input2, input3, input4, w);
 
 					(*pInterpMotion).m_pPostures[(*pInterpMotion).GetPostureNum(j)].bone_translation[k].setValue(value.p);
 
@@ -282,7 +346,8 @@ void interpolate_callback(Fl_Button *button, void *)
 					input3 = (*pSampledMotion).m_pPostures[(*pSampledMotion).GetPostureNum(keyframes[i + 1])].bone_rotation[k].p;
 					input4 = (*pSampledMotion).m_pPostures[(*pSampledMotion).GetPostureNum(keyframes[i + 2])].bone_rotation[k].p;
 					
-					value = Catmull_RomCalc(input1, input2, input3, input4, (temp3));
+					value = Catmull_RomCalc(UnwrapAngles(input1, input2, bone.dofx, bone.dofy, bone.dofz), input2,
+						UnwrapAngles(input3, input2, bone.dofx, bone.dofy, bone.dofz), UnwrapAngles(input4, input2, bone.dofx, bone.dofy, bone.dofz), w);
 
 					(*pInterpMotion).m_pPostures[(*pInterpMotion).GetPostureNum(j)].bone_rotation[k].setValue(value.p);
 
@@ -293,6 +358,15 @@ void interpolate_callback(Fl_Button *button, void *)
 			i++;
 		}
 
+		//hold the feet where the sampled motion has them on the ground
+		FootContacts const *pContacts = (*pSampledMotion).GetContacts();
+		if (pContacts != NULL)
+		{
+			PROFILE_SCOPE("FootLocker::Apply");
+			FootLocker locker(pActor);
+			locker.Apply(pInterpMotion, pContacts, keyframes.front(), keyframes.back());
+		}
+
 		Skeleton *s = (*pActor).clone();
 		(*s).R = 1;
 		(*s).G = 0.6;
@@ -478,6 +552,7 @@ void record_callback(Fl_Light_Button *button, void *)
 
 void idle(void*)
 {
+	PROFILE_SCOPE("idle");
 
 	if (pSampledMotion != NULL)
 	{
@@ -501,11 +576,16 @@ void idle(void*)
 				nFrameNum = nFrameNum + nFrameInc;
 			else Play = OFF;
 
-			(*displayer.m_pActor[0]).setPosture((*pSampledMotion).m_pPostures[(*pSampledMotion).GetPostureNum(nFrameNum)]);
-			if (pInterpMotion != NULL){
-				(*displayer.m_pActor[keyframes.size() + 1]).setPosture((*pInterpMotion).m_pPostures[(*pInterpMotion).GetPostureNum(nFrameNum)]);
+			{
+				PROFILE_SCOPE("setPosture");
+				(*displayer.m_pActor[0]).setPosture((*pSampledMotion).m_pPostures[(*pSampledMotion).GetPostureNum(nFrameNum)]);
+				if (pInterpMotion != NULL){
+					(*displayer.m_pActor[keyframes.size() + 1]).setPosture((*pInterpMotion).m_pPostures[(*pInterpMotion).GetPostureNum(nFrameNum)]);
+				}
 			}
 
+			publish_frame();
+
 #ifdef WRITE_JPEGS
 			if (Record == ON)
 				glwindow->save(Record_filename);
@@ -850,6 +930,14 @@ int Player_Gl_Window::handle(int event)
 		break;
 	case FL_KEYBOARD:
 		switch (Fl::event_key()) {
+		case 'h':
+			ShowHud = !ShowHud;
+			glwindow->redraw();
+			break;
+		case 't':
+			if (traceFilename != NULL && Profiler::Get().WriteChromeTrace(traceFilename) == 0)
+				printf("Trace written to %s\n", traceFilename);
+			break;
 		case 'q':
 		case 'Q':
 		case 65307:
@@ -888,13 +976,21 @@ void Player_Gl_Window::save(char *filename)
 
 	printf("File to save to: %s\n", anim_filename);
 
-	for (i = 479; i >= 0; i--)
 	{
-		glReadPixels(0, 479 - i, 640, 1, GL_RGB, GL_UNSIGNED_BYTE,
-			&in->pix[i*in->nx*in->bpp]);
+		PROFILE_SCOPE("glReadPixels");
+		for (i = 479; i >= 0; i--)
+		{
+			glReadPixels(0, 479 - i, 640, 1, GL_RGB, GL_UNSIGNED_BYTE,
+				&in->pix[i*in->nx*in->bpp]);
+		}
 	}
 
-	if (jpeg_write(anim_filename, in))
+	int bSaved;
+	{
+		PROFILE_SCOPE("jpeg_write");
+		bSaved = jpeg_write(anim_filename, in);
+	}
+	if (bSaved)
 		printf("%s saved Successfully\n", anim_filename);
 	else
 		printf("Error in Saving\n");
@@ -922,6 +1018,10 @@ void Player_Gl_Window::draw()
 
 	//Redisplay the screen then put the proper buffer on the screen.
 	redisplay();
+
+	Profiler::Get().FrameMark();
+	if (ShowHud)
+		draw_hud(w(), h());
 }
 
 
@@ -939,6 +1039,36 @@ int main(int argc, char **argv)
 
 	frame_slider->value(1);
 
+	//-stream <port> sends the played frames over UDP, -shm publishes the actor poses in shared memory,
+	//-joints sends world joint positions instead of dofs, -profile <file> records the hot paths and
+	//writes them as a Chrome trace at exit, -hud shows the frame time percentiles
+	PoseStreamMode streamMode = POSE_STREAM_DOFS;
+	int streamPort = 0;
+	bool bShm = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-stream") == 0 && i + 1 < argc)
+			streamPort = atoi(argv[i + 1]);
+		if (strcmp(argv[i], "-shm") == 0)
+			bShm = true;
+		if (strcmp(argv[i], "-joints") == 0)
+			streamMode = POSE_STREAM_JOINTS;
+		if (strcmp(argv[i], "-profile") == 0 && i + 1 < argc)
+			traceFilename = argv[i + 1];
+		if (strcmp(argv[i], "-hud") == 0)
+			ShowHud = ON;
+	}
+	if (traceFilename != NULL)
+	{
+		Profiler::Get().Enable(true);
+		ShowHud = ON;
+		atexit(write_trace);
+	}
+	if (streamPort > 0)
+		poseStream.Open(streamPort, streamMode);
+	if (bShm)
+		poseShm.Open(POSE_SHM_DEFAULT_NAME, streamMode);
+
 	/*show form, and do initial draw of model */
 	form->show();
 	glwindow->show(); /* glwindow is initialized when the form is built */
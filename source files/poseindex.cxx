@@ -0,0 +1,460 @@
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+#include "poseindex.h"
+#include "channels.h"
+#include "threadpool.h"
+
+
+//Squared Euclidean distance; eight lanes so the loop is vectorized without reassociation
+static inline float distance_sq(float const *a, float const *b, int n)
+{
+	float lane[8] = { 0 };
+	int i = 0;
+	for (; i + 8 <= n; i += 8)
+		for (int l = 0; l < 8; l++)
+		{
+			float d = a[i + l] - b[i + l];
+			lane[l] += d*d;
+		}
+	float sum = ((lane[0] + lane[1]) + (lane[2] + lane[3])) + ((lane[4] + lane[5]) + (lane[6] + lane[7]));
+	for (; i < n; i++)
+		sum += (a[i] - b[i])*(a[i] - b[i]);
+	return sum;
+}
+
+
+/************************ PoseFeatures class functions **********************************/
+static int find_bone(Skeleton *pActor, int nNumBones, char const *pName)
+{
+	for (int j = 0; j < nNumBones; j++)
+		if (strcmp(pActor->idx2name(j), pName) == 0)
+			return j;
+	return -1;
+}
+
+PoseFeatures::PoseFeatures(Skeleton *pActor, PoseFeatureType type)
+{
+	m_pActor = pActor;
+	m_Type = type;
+	m_NumBones = numBonesInSkel(pActor->getRoot()[0]);
+	m_LeftHip = find_bone(pActor, m_NumBones, "lhipjoint");
+	m_RightHip = find_bone(pActor, m_NumBones, "rhipjoint");
+
+	if (type == POSE_FEATURE_JOINTS)
+		m_Dimension = 3*(m_NumBones - 1) + 1;
+	else
+	{
+		ChannelLayout layout(pActor);
+		m_Dimension = 0;
+		for (int c = 0; c < layout.m_NumChannels; c++)
+			if (layout.IsAngle(c) && !(layout.m_Channels[c].bone == root && layout.m_Channels[c].axis == 1))
+				m_Dimension += 2;
+	}
+}
+
+void PoseFeatures::Compute(Posture const& posture, float *pFeature) const
+{
+	if (m_Type == POSE_FEATURE_ANGLES)
+	{
+		Bone *bone = m_pActor->getRoot();
+		int n = 0;
+		//same order as the rotation channels of ChannelLayout
+		for (int j = 0; j < m_NumBones; j++)
+			for (int x = 0; x < (j == root ? 3 : bone[j].dof); x++)
+			{
+				int axis = j == root ? x : bone[j].dofo[x] - 1;
+				if (axis < 0 || axis > 2 || (j == root && axis == 1))
+					continue;
+				float a = posture.bone_rotation[j].p[axis]*(float)(M_PI/180.0);
+				pFeature[n++] = sinf(a);
+				pFeature[n++] = cosf(a);
+			}
+		return;
+	}
+
+	::vector joints[MAX_BONES_IN_ASF_FILE];
+	m_pActor->computeJointPositions(posture, joints);
+
+	//heading from the hips, in the horizontal (x, z) plane
+	float c = 1, s = 0;
+	if (m_LeftHip >= 0 && m_RightHip >= 0)
+	{
+		float hx = joints[m_RightHip].p[0] - joints[m_LeftHip].p[0];
+		float hz = joints[m_RightHip].p[2] - joints[m_LeftHip].p[2];
+		float len = sqrtf(hx*hx + hz*hz);
+		if (len > 1e-6f)
+		{
+			c = hx/len;
+			s = hz/len;
+		}
+	}
+
+	float const *pRoot = joints[root].p;
+	int n = 0;
+	for (int j = 1; j < m_NumBones; j++)
+	{
+		float x = joints[j].p[0] - pRoot[0];
+		float y = joints[j].p[1] - pRoot[1];
+		float z = joints[j].p[2] - pRoot[2];
+		pFeature[n++] = c*x + s*z;
+		pFeature[n++] = y;
+		pFeature[n++] = -s*x + c*z;
+	}
+	pFeature[n++] = pRoot[1];
+}
+
+void PoseFeatures::Compute(Motion *pMotion, float *pFeatures) const
+{
+	ThreadPool::GetDefault().ParallelFor(0, pMotion->m_NumFrames, [&](int nBegin, int nEnd, int nThread)
+	{
+		for (int f = nBegin; f < nEnd; f++)
+			Compute(pMotion->m_pPostures[f], pFeatures + (size_t)f*m_Dimension);
+	}, 64);
+}
+
+
+/************************ PoseIndex class functions **********************************/
+
+//Current k best of a query, sorted by distance
+struct KnnState
+{
+	int k;
+	int count;
+	int *pIds;					// tree positions
+	float *pDist;
+	int checks;
+	int maxChecks;
+	int dimension;
+
+	float Bound() const { return count < k ? FLT_MAX : pDist[k - 1]; }
+	bool Exhausted() const { return maxChecks > 0 && checks >= maxChecks; }
+
+	void Insert(int nPos, float fDist)
+	{
+		if (count == k && fDist >= pDist[k - 1])
+			return;
+		int i = count < k ? count++ : k - 1;
+		for (; i > 0 && pDist[i - 1] > fDist; i--)
+		{
+			pDist[i] = pDist[i - 1];
+			pIds[i] = pIds[i - 1];
+		}
+		pDist[i] = fDist;
+		pIds[i] = nPos;
+	}
+};
+
+PoseIndex::PoseIndex()
+{
+	m_pClips = NULL;
+	m_pFeatures = NULL;
+	m_pIds = NULL;
+	m_pRadius = NULL;
+	Clear();
+}
+
+PoseIndex::~PoseIndex()
+{
+	Clear();
+}
+
+void PoseIndex::Clear()
+{
+	delete [] m_pClips;
+	delete [] m_pFeatures;
+	delete [] m_pIds;
+	delete [] m_pRadius;
+	m_pClips = NULL;
+	m_pFeatures = NULL;
+	m_pIds = NULL;
+	m_pRadius = NULL;
+
+	m_FeatureType = POSE_FEATURE_JOINTS;
+	m_Dimension = 0;
+	m_LeafSize = POSE_INDEX_DEFAULT_LEAF;
+	m_bBuilt = false;
+	m_NumClips = m_ClipCapacity = 0;
+	m_NumPoints = m_PointCapacity = 0;
+}
+
+int PoseIndex::AddClip(char const *pName, float const *pFeatures, int nNumFrames, int nDimension, PoseFeatureType type)
+{
+	if (m_bBuilt || nNumFrames <= 0)
+		return -1;
+	if (m_NumPoints == 0)
+	{
+		m_Dimension = nDimension;
+		m_FeatureType = type;
+	}
+	else if (nDimension != m_Dimension || type != m_FeatureType)
+	{
+		printf("Pose index: clip '%s' has other features than the index\n", pName);
+		return -1;
+	}
+
+	if (m_NumClips == m_ClipCapacity)
+	{
+		m_ClipCapacity = std::max(16, 2*m_ClipCapacity);
+		Clip *pClips = new Clip [m_ClipCapacity];
+		memcpy(pClips, m_pClips, m_NumClips*sizeof(Clip));
+		delete [] m_pClips;
+		m_pClips = pClips;
+	}
+	if (m_NumPoints + nNumFrames > m_PointCapacity)
+	{
+		m_PointCapacity = std::max(m_NumPoints + nNumFrames, 2*m_PointCapacity);
+		float *pNew = new float [(size_t)m_PointCapacity*m_Dimension];
+		memcpy(pNew, m_pFeatures, (size_t)m_NumPoints*m_Dimension*sizeof(float));
+		delete [] m_pFeatures;
+		m_pFeatures = pNew;
+	}
+
+	Clip &clip = m_pClips[m_NumClips];
+	strncpy(clip.name, pName, sizeof(clip.name) - 1);
+	clip.name[sizeof(clip.name) - 1] = '\0';
+	clip.firstPoint = m_NumPoints;
+	clip.numFrames = nNumFrames;
+
+	memcpy(m_pFeatures + (size_t)m_NumPoints*m_Dimension, pFeatures, (size_t)nNumFrames*m_Dimension*sizeof(float));
+	m_NumPoints += nNumFrames;
+	return m_NumClips++;
+}
+
+//The node [nLo, nHi) has its vantage point at nLo, the points closer than m_pRadius[nLo]
+//in [nLo+1, mid) and the others in [mid, nHi). Small nodes are leaves
+void PoseIndex::BuildNode(int nLo, int nHi, float *pDist, unsigned int *pSeed)
+{
+	if (nHi - nLo <= m_LeafSize)
+	{
+		for (int i = nLo; i < nHi; i++)
+			m_pRadius[i] = 0;
+		return;
+	}
+
+	*pSeed = *pSeed*1664525u + 1013904223u;
+	std::swap(m_pIds[nLo], m_pIds[nLo + (int)((*pSeed >> 8) % (unsigned int)(nHi - nLo))]);
+
+	float const *pVantage = m_pFeatures + (size_t)m_pIds[nLo]*m_Dimension;
+	for (int i = nLo + 1; i < nHi; i++)
+		pDist[m_pIds[i]] = sqrtf(distance_sq(pVantage, m_pFeatures + (size_t)m_pIds[i]*m_Dimension, m_Dimension));
+
+	int nMid = (nLo + 1 + nHi)/2;
+	std::nth_element(m_pIds + nLo + 1, m_pIds + nMid, m_pIds + nHi,
+		[pDist](int a, int b) { return pDist[a] < pDist[b]; });
+	m_pRadius[nLo] = pDist[m_pIds[nMid]];
+
+	BuildNode(nLo + 1, nMid, pDist, pSeed);
+	BuildNode(nMid, nHi, pDist, pSeed);
+}
+
+void PoseIndex::Build(int nLeafSize)
+{
+	m_LeafSize = nLeafSize < 1 ? 1 : nLeafSize;
+
+	delete [] m_pIds;
+	delete [] m_pRadius;
+	m_pIds = new int [m_NumPoints];
+	m_pRadius = new float [m_NumPoints];
+	for (int i = 0; i < m_NumPoints; i++)
+		m_pIds[i] = i;
+
+	float *pDist = new float [m_NumPoints];
+	unsigned int nSeed = 12345;
+	BuildNode(0, m_NumPoints, pDist, &nSeed);
+	delete [] pDist;
+
+	//features in tree order, so that a node reads contiguous memory
+	float *pOrdered = new float [(size_t)m_NumPoints*m_Dimension];
+	for (int i = 0; i < m_NumPoints; i++)
+		memcpy(pOrdered + (size_t)i*m_Dimension, m_pFeatures + (size_t)m_pIds[i]*m_Dimension, m_Dimension*sizeof(float));
+	delete [] m_pFeatures;
+	m_pFeatures = pOrdered;
+	m_PointCapacity = m_NumPoints;
+	m_bBuilt = true;
+}
+
+void PoseIndex::SearchNode(int nLo, int nHi, float const *pFeature, KnnState &state) const
+{
+	if (nHi <= nLo || state.Exhausted())
+		return;
+
+	if (nHi - nLo <= m_LeafSize)
+	{
+		for (int i = nLo; i < nHi; i++)
+			state.Insert(i, sqrtf(distance_sq(pFeature, m_pFeatures + (size_t)i*m_Dimension, m_Dimension)));
+		state.checks += nHi - nLo;
+		return;
+	}
+
+	float d = sqrtf(distance_sq(pFeature, m_pFeatures + (size_t)nLo*m_Dimension, m_Dimension));
+	state.checks++;
+	state.Insert(nLo, d);
+
+	int nMid = (nLo + 1 + nHi)/2;
+	float r = m_pRadius[nLo];
+	//visit the side the query falls in first; the other one only if the ball around the query reaches it
+	if (d < r)
+	{
+		SearchNode(nLo + 1, nMid, pFeature, state);
+		if (d + state.Bound() >= r)
+			SearchNode(nMid, nHi, pFeature, state);
+	}
+	else
+	{
+		SearchNode(nMid, nHi, pFeature, state);
+		if (d - state.Bound() <= r)
+			SearchNode(nLo + 1, nMid, pFeature, state);
+	}
+}
+
+void PoseIndex::ToMatch(int nPoint, float fDistance, PoseMatch *pMatch) const
+{
+	//last clip starting at or before the point
+	int lo = 0, hi = m_NumClips - 1;
+	while (lo < hi)
+	{
+		int mid = (lo + hi + 1)/2;
+		if (m_pClips[mid].firstPoint <= nPoint)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	pMatch->clip = lo;
+	pMatch->frame = nPoint - m_pClips[lo].firstPoint;
+	pMatch->distance = fDistance;
+}
+
+int PoseIndex::Query(float const *pFeature, int k, PoseMatch *pMatches, int nMaxChecks) const
+{
+	if (!m_bBuilt || k <= 0)
+		return 0;
+
+	int ids[64], *pIds = k <= 64 ? ids : new int [k];
+	float dist[64], *pDist = k <= 64 ? dist : new float [k];
+	KnnState state = { k, 0, pIds, pDist, 0, nMaxChecks, m_Dimension };
+	SearchNode(0, m_NumPoints, pFeature, state);
+
+	for (int i = 0; i < state.count; i++)
+		ToMatch(m_pIds[pIds[i]], pDist[i], &pMatches[i]);
+
+	if (pIds != ids)
+		delete [] pIds;
+	if (pDist != dist)
+		delete [] pDist;
+	return state.count;
+}
+
+void PoseIndex::QueryBatch(float const *pFeatures, int nNumQueries, int k, PoseMatch *pMatches, int nMaxChecks) const
+{
+	ThreadPool::GetDefault().ParallelFor(0, nNumQueries, [&](int nBegin, int nEnd, int nThread)
+	{
+		for (int q = nBegin; q < nEnd; q++)
+		{
+			int n = Query(pFeatures + (size_t)q*m_Dimension, k, pMatches + (size_t)q*k, nMaxChecks);
+			for (int i = n; i < k; i++)
+				pMatches[(size_t)q*k + i].clip = -1;
+		}
+	}, 8);
+}
+
+int PoseIndex::BruteForce(float const *pFeature, int k, PoseMatch *pMatches) const
+{
+	if (m_NumPoints == 0 || k <= 0)
+		return 0;
+
+	int *pIds = new int [k];
+	float *pDist = new float [k];
+	KnnState state = { k, 0, pIds, pDist, 0, 0, m_Dimension };
+	for (int i = 0; i < m_NumPoints; i++)
+		state.Insert(i, distance_sq(pFeature, m_pFeatures + (size_t)i*m_Dimension, m_Dimension));
+
+	for (int i = 0; i < state.count; i++)
+		ToMatch(m_bBuilt ? m_pIds[pIds[i]] : pIds[i], sqrtf(pDist[i]), &pMatches[i]);
+
+	delete [] pIds;
+	delete [] pDist;
+	return state.count;
+}
+
+
+/************************ On-disk form **********************************/
+
+//Header of the file, followed by the clips, the features (tree order), the ids and the radii.
+//The file is read with the byte order it was written with
+struct PoseIndexHeader
+{
+	unsigned int magic;
+	unsigned int version;
+	int featureType;
+	int dimension;
+	int numPoints;
+	int numClips;
+	int leafSize;
+	int reserved;
+};
+
+int PoseIndex::Save(char const *filename) const
+{
+	if (!m_bBuilt)
+		return -1;
+
+	FILE *pFile = fopen(filename, "wb");
+	if (pFile == NULL)
+		return -1;
+
+	PoseIndexHeader header = { POSE_INDEX_MAGIC, POSE_INDEX_VERSION, m_FeatureType, m_Dimension, m_NumPoints, m_NumClips, m_LeafSize, 0 };
+	bool bOk = fwrite(&header, sizeof(header), 1, pFile) == 1 &&
+		fwrite(m_pClips, sizeof(Clip), m_NumClips, pFile) == (size_t)m_NumClips &&
+		fwrite(m_pFeatures, sizeof(float)*m_Dimension, m_NumPoints, pFile) == (size_t)m_NumPoints &&
+		fwrite(m_pIds, sizeof(int), m_NumPoints, pFile) == (size_t)m_NumPoints &&
+		fwrite(m_pRadius, sizeof(float), m_NumPoints, pFile) == (size_t)m_NumPoints;
+	if (fclose(pFile) != 0)
+		bOk = false;
+	return bOk ? 0 : -1;
+}
+
+int PoseIndex::Load(char const *filename)
+{
+	Clear();
+
+	FILE *pFile = fopen(filename, "rb");
+	if (pFile == NULL)
+		return -1;
+
+	PoseIndexHeader header;
+	if (fread(&header, sizeof(header), 1, pFile) != 1 || header.magic != POSE_INDEX_MAGIC ||
+		header.version != POSE_INDEX_VERSION || header.dimension <= 0 || header.numPoints <= 0 || header.numClips <= 0)
+	{
+		printf("Pose index: '%s' is not a pose index\n", filename);
+		fclose(pFile);
+		return -1;
+	}
+
+	m_FeatureType = (PoseFeatureType)header.featureType;
+	m_Dimension = header.dimension;
+	m_LeafSize = header.leafSize;
+	m_NumClips = m_ClipCapacity = header.numClips;
+	m_NumPoints = m_PointCapacity = header.numPoints;
+	m_pClips = new Clip [m_NumClips];
+	m_pFeatures = new float [(size_t)m_NumPoints*m_Dimension];
+	m_pIds = new int [m_NumPoints];
+	m_pRadius = new float [m_NumPoints];
+
+	bool bOk = fread(m_pClips, sizeof(Clip), m_NumClips, pFile) == (size_t)m_NumClips &&
+		fread(m_pFeatures, sizeof(float)*m_Dimension, m_NumPoints, pFile) == (size_t)m_NumPoints &&
+		fread(m_pIds, sizeof(int), m_NumPoints, pFile) == (size_t)m_NumPoints &&
+		fread(m_pRadius, sizeof(float), m_NumPoints, pFile) == (size_t)m_NumPoints;
+	fclose(pFile);
+	if (!bOk)
+	{
+		printf("Pose index: '%s' is truncated\n", filename);
+		Clear();
+		return -1;
+	}
+	m_bBuilt = true;
+	return 0;
+}
@@ -0,0 +1,127 @@
+/*
+	poseindex.h
+
+	Nearest neighbour search of poses across a library of motions.
+
+	PoseFeatures turns a posture into a feature vector:
+		POSE_FEATURE_JOINTS   FK joint positions relative to the root, turned about the vertical
+		                      axis so that the hips face the same way, plus the root height
+		POSE_FEATURE_ANGLES   sine and cosine of every rotation dof (the root yaw excluded)
+	so that the same pose performed at another place or heading gives the same features.
+
+	PoseIndex is a vantage point tree over the features of every frame of the clips added to it.
+	It is stored flat (points in tree order, one radius per point) so that it can be written to
+	and read from disk as is. Queries return the k nearest frames by Euclidean distance, exactly,
+	or approximately when the number of distance computations is limited.
+*/
+
+#ifndef _POSEINDEX_H
+#define _POSEINDEX_H
+
+#include "types.h"
+#include "posture.h"
+#include "skeleton.h"
+#include "motion.h"
+
+#define POSE_INDEX_MAGIC 0x58444950		// "PIDX"
+#define POSE_INDEX_VERSION 1
+#define POSE_INDEX_DEFAULT_LEAF 16
+
+enum PoseFeatureType
+{
+	POSE_FEATURE_JOINTS = 0, POSE_FEATURE_ANGLES
+};
+
+class PoseFeatures
+{
+	//member functions
+	public:
+		PoseFeatures(Skeleton *pActor, PoseFeatureType type);
+
+		int GetDimension() const { return m_Dimension; }
+		PoseFeatureType GetType() const { return m_Type; }
+
+		//pFeature receives GetDimension() floats
+		void Compute(Posture const& posture, float *pFeature) const;
+		//Every frame of the motion, in parallel; pFeatures receives m_NumFrames*GetDimension() floats
+		void Compute(Motion *pMotion, float *pFeatures) const;
+
+	//member variables
+	private:
+		Skeleton *m_pActor;
+		PoseFeatureType m_Type;
+		int m_Dimension;
+		int m_NumBones;
+		int m_LeftHip, m_RightHip;			// bones giving the heading (-1 if missing)
+};
+
+//One result of a query
+struct PoseMatch
+{
+	int clip;
+	int frame;					// 0-based frame of the clip
+	float distance;
+};
+
+struct KnnState;
+
+class PoseIndex
+{
+	//member functions
+	public:
+		PoseIndex();
+		~PoseIndex();
+
+		//Add the features of every frame of a clip (before Build). Returns the clip number, -1 on error
+		int AddClip(char const *pName, float const *pFeatures, int nNumFrames, int nDimension, PoseFeatureType type);
+		void Build(int nLeafSize = POSE_INDEX_DEFAULT_LEAF);
+
+		//k nearest frames, closest first; returns the number of matches (less than k if the index is smaller).
+		//nMaxChecks > 0 stops the search after that many distance computations
+		int Query(float const *pFeature, int k, PoseMatch *pMatches, int nMaxChecks = 0) const;
+		//nNumQueries queries in parallel, k matches each in pMatches
+		void QueryBatch(float const *pFeatures, int nNumQueries, int k, PoseMatch *pMatches, int nMaxChecks = 0) const;
+		//Exact answer by comparing with every frame
+		int BruteForce(float const *pFeature, int k, PoseMatch *pMatches) const;
+
+		//Returns 0 on success, -1 on error
+		int Save(char const *filename) const;
+		int Load(char const *filename);
+
+		int GetNumPoints() const { return m_NumPoints; }
+		int GetDimension() const { return m_Dimension; }
+		PoseFeatureType GetFeatureType() const { return m_FeatureType; }
+		int GetNumClips() const { return m_NumClips; }
+		char const* GetClipName(int nClip) const { return m_pClips[nClip].name; }
+		int GetClipFrames(int nClip) const { return m_pClips[nClip].numFrames; }
+
+	private:
+		void Clear();
+		void BuildNode(int nLo, int nHi, float *pDist, unsigned int *pSeed);
+		void SearchNode(int nLo, int nHi, float const *pFeature, KnnState &state) const;
+		void ToMatch(int nPoint, float fDistance, PoseMatch *pMatch) const;
+
+	//member variables
+	private:
+		struct Clip
+		{
+			char name[256];
+			int firstPoint;
+			int numFrames;
+		};
+
+		PoseFeatureType m_FeatureType;
+		int m_Dimension;
+		int m_LeafSize;
+		bool m_bBuilt;
+
+		int m_NumClips, m_ClipCapacity;
+		Clip *m_pClips;
+
+		int m_NumPoints, m_PointCapacity;
+		float *m_pFeatures;			// m_NumPoints x m_Dimension, in tree order once built
+		int *m_pIds;				// point (clip first point + frame) at every tree position
+		float *m_pRadius;			// median distance to the vantage point of the node starting there
+};
+
+#endif
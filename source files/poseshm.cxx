@@ -0,0 +1,295 @@
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <thread>
+
+#include "poseshm.h"
+
+
+/************************ Mapping helpers **********************************/
+
+//Map the region named pName. The publisher creates it, readers only attach.
+//Returns NULL on error; pHandle receives the handle to pass to unmap_region
+static PoseShmRegion *map_region(char const *pName, bool bCreate, intptr_t *pHandle)
+{
+	void *pMemory;
+#ifdef WIN32
+	//Windows names may not start with a slash
+	if (pName[0] == '/')
+		pName++;
+	HANDLE hMap;
+	if (bCreate)
+		hMap = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(PoseShmRegion), pName);
+	else
+		hMap = OpenFileMappingA(FILE_MAP_READ, FALSE, pName);
+	if (hMap == NULL)
+		return NULL;
+	pMemory = MapViewOfFile(hMap, bCreate ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, sizeof(PoseShmRegion));
+	if (pMemory == NULL)
+	{
+		CloseHandle(hMap);
+		return NULL;
+	}
+	*pHandle = (intptr_t)hMap;
+#else
+	int fd = shm_open(pName, bCreate ? (O_CREAT | O_RDWR) : O_RDONLY, 0644);
+	if (fd < 0)
+		return NULL;
+	if (bCreate && ftruncate(fd, sizeof(PoseShmRegion)) != 0)
+	{
+		close(fd);
+		return NULL;
+	}
+	if (!bCreate)
+	{
+		//the publisher may not have sized the region yet
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(PoseShmRegion))
+		{
+			close(fd);
+			return NULL;
+		}
+	}
+	pMemory = mmap(NULL, sizeof(PoseShmRegion), bCreate ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (pMemory == MAP_FAILED)
+		return NULL;
+	*pHandle = 0;
+#endif
+	return (PoseShmRegion *)pMemory;
+}
+
+static void unmap_region(PoseShmRegion *pRegion, intptr_t handle)
+{
+#ifdef WIN32
+	UnmapViewOfFile(pRegion);
+	CloseHandle((HANDLE)handle);
+#else
+	munmap(pRegion, sizeof(PoseShmRegion));
+#endif
+}
+
+
+/************************ PoseShmPublisher class functions **********************************/
+PoseShmPublisher::PoseShmPublisher()
+{
+	m_pRegion = NULL;
+	m_Mode = POSE_STREAM_DOFS;
+	m_Sequence = 0;
+	m_Name[0] = '\0';
+	m_Handle = 0;
+	for (int a = 0; a < POSE_SHM_MAX_ACTORS; a++)
+	{
+		m_pLayouts[a] = NULL;
+		m_pLayoutActors[a] = NULL;
+	}
+}
+
+PoseShmPublisher::~PoseShmPublisher()
+{
+	Close();
+	for (int a = 0; a < POSE_SHM_MAX_ACTORS; a++)
+		if (m_pLayouts[a] != NULL)
+			delete m_pLayouts[a];
+}
+
+int PoseShmPublisher::Open(char const *pName, PoseStreamMode mode)
+{
+	Close();
+
+	m_pRegion = map_region(pName, true, &m_Handle);
+	if (m_pRegion == NULL)
+	{
+		printf("Pose shared memory: cannot create '%s'\n", pName);
+		return -1;
+	}
+	strncpy(m_Name, pName, MAX_CHAR - 1);
+	m_Name[MAX_CHAR - 1] = '\0';
+
+	//readers check the magic number, so it is set after everything else
+	m_pRegion->magic = 0;
+	std::atomic_thread_fence(std::memory_order_release);
+	m_pRegion->version = POSE_SHM_VERSION;
+	m_pRegion->numActors = 0;
+	m_pRegion->mode = mode;
+	for (int a = 0; a < POSE_SHM_MAX_ACTORS; a++)
+	{
+		m_pRegion->rings[a].count.store(0, std::memory_order_relaxed);
+		for (int s = 0; s < POSE_SHM_SLOTS; s++)
+			m_pRegion->rings[a].slots[s].lock.store(0, std::memory_order_relaxed);
+	}
+	std::atomic_thread_fence(std::memory_order_release);
+	m_pRegion->magic = POSE_SHM_MAGIC;
+
+	m_Mode = mode;
+	m_Sequence = 0;
+	printf("Pose shared memory: publishing %s in '%s'\n", mode == POSE_STREAM_DOFS ? "dofs" : "joint positions", pName);
+	return 0;
+}
+
+void PoseShmPublisher::Close()
+{
+	if (m_pRegion == NULL)
+		return;
+
+	m_pRegion->magic = 0;
+	unmap_region(m_pRegion, m_Handle);
+	m_pRegion = NULL;
+#ifndef WIN32
+	shm_unlink(m_Name);
+#endif
+}
+
+int PoseShmPublisher::Publish(Skeleton *pActor, Posture const& posture, int nActor, int nFrameNum)
+{
+	if (m_pRegion == NULL || nActor < 0 || nActor >= POSE_SHM_MAX_ACTORS)
+		return -1;
+
+	if (m_pLayoutActors[nActor] != pActor)
+	{
+		if (m_pLayouts[nActor] != NULL)
+			delete m_pLayouts[nActor];
+		m_pLayouts[nActor] = new ChannelLayout(pActor);
+		m_pLayoutActors[nActor] = pActor;
+	}
+
+	PoseShmRing &ring = m_pRegion->rings[nActor];
+	uint64_t nIndex = ring.count.load(std::memory_order_relaxed);
+	PoseShmSlot &slot = ring.slots[nIndex % POSE_SHM_SLOTS];
+
+	//odd sequence: readers discard what they copy from now on
+	uint32_t nLock = slot.lock.load(std::memory_order_relaxed);
+	slot.lock.store(nLock + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	slot.size = PoseStreamEncode(slot.packet, m_Mode, *m_pLayouts[nActor], pActor, posture, nActor, nFrameNum, m_Sequence++);
+	slot.index = nIndex;
+
+	slot.lock.store(nLock + 2, std::memory_order_release);
+	ring.count.store(nIndex + 1, std::memory_order_release);
+
+	if ((uint32_t)nActor >= m_pRegion->numActors)
+		m_pRegion->numActors = nActor + 1;
+	return 0;
+}
+
+
+/************************ PoseShmReader class functions **********************************/
+PoseShmReader::PoseShmReader()
+{
+	m_pRegion = NULL;
+	m_Handle = 0;
+}
+
+PoseShmReader::~PoseShmReader()
+{
+	Close();
+}
+
+int PoseShmReader::Open(char const *pName)
+{
+	Close();
+
+	m_pRegion = map_region(pName, false, &m_Handle);
+	if (m_pRegion == NULL)
+		return -1;
+
+	if (m_pRegion->magic != POSE_SHM_MAGIC || m_pRegion->version != POSE_SHM_VERSION)
+	{
+		Close();
+		return -1;
+	}
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return 0;
+}
+
+void PoseShmReader::Close()
+{
+	if (m_pRegion != NULL)
+		unmap_region(m_pRegion, m_Handle);
+	m_pRegion = NULL;
+}
+
+int PoseShmReader::GetNumActors() const
+{
+	return m_pRegion != NULL ? m_pRegion->numActors : 0;
+}
+
+PoseStreamMode PoseShmReader::GetMode() const
+{
+	return m_pRegion != NULL ? (PoseStreamMode)m_pRegion->mode : POSE_STREAM_DOFS;
+}
+
+uint64_t PoseShmReader::GetCount(int nActor) const
+{
+	if (m_pRegion == NULL || nActor < 0 || nActor >= POSE_SHM_MAX_ACTORS)
+		return 0;
+	return m_pRegion->rings[nActor].count.load(std::memory_order_acquire);
+}
+
+int PoseShmReader::Read(int nActor, uint64_t nIndex, unsigned char *pBuffer) const
+{
+	if (m_pRegion == NULL || nActor < 0 || nActor >= POSE_SHM_MAX_ACTORS)
+		return 0;
+
+	PoseShmSlot const &slot = m_pRegion->rings[nActor].slots[nIndex % POSE_SHM_SLOTS];
+	std::chrono::steady_clock::time_point deadline;
+	for (int nTry = 1; ; nTry++)
+	{
+		//the writer finishes a slot in well under a microsecond unless it is preempted; a slot that
+		//stays locked past the deadline belongs to a writer that died mid-write
+		if (nTry % POSE_SHM_SPINS == 0)
+		{
+			auto now = std::chrono::steady_clock::now();
+			if (nTry == POSE_SHM_SPINS)
+				deadline = now + std::chrono::milliseconds(POSE_SHM_READ_TIMEOUT);
+			else if (now > deadline)
+				return -1;
+			std::this_thread::yield();
+		}
+
+		uint32_t nBefore = slot.lock.load(std::memory_order_acquire);
+		if (nBefore & 1)
+			continue;		// being written
+
+		uint32_t nSize = slot.size;
+		uint64_t nSlotIndex = slot.index;
+		if (nSize > POSE_STREAM_MAX_PACKET)
+			nSize = 0;
+		memcpy(pBuffer, slot.packet, nSize);
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.lock.load(std::memory_order_relaxed) != nBefore)
+			continue;		// torn copy
+
+		if (nBefore == 0 || nSlotIndex != nIndex)
+			return 0;		// not published yet, or already overwritten by a newer frame
+		return (int)nSize;
+	}
+}
+
+int PoseShmReader::ReadLatest(int nActor, unsigned char *pBuffer) const
+{
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(POSE_SHM_READ_TIMEOUT);
+	while (std::chrono::steady_clock::now() < deadline)
+	{
+		uint64_t nCount = GetCount(nActor);
+		if (nCount == 0)
+			return 0;
+
+		//the frame can only be lost if the writer lapped the ring meanwhile, then retry with the newer one
+		int nSize = Read(nActor, nCount - 1, pBuffer);
+		if (nSize != 0)
+			return nSize;
+	}
+	return -1;
+}
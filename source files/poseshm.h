@@ -0,0 +1,124 @@
+/*
+	poseshm.h
+
+	Publish postures in a shared memory region, for readers on the same host.
+
+	The region holds one ring of POSE_SHM_SLOTS slots per actor. The single writer (the player,
+	or a headless driver) stores every frame of an actor in the next slot of its ring and then
+	advances the ring counter. Each slot is guarded by a sequence lock: the writer makes the
+	sequence odd while it writes, so a reader that sees the same even sequence before and after
+	copying a slot knows the copy is complete. Readers never block the writer, and the writer
+	never waits for readers; a reader that falls more than POSE_SHM_SLOTS frames behind
+	simply misses frames. A slot that stays locked (a writer that died while writing it) makes the
+	readers give up after POSE_SHM_READ_TIMEOUT ms instead of spinning forever.
+
+	Slot contents use the pose stream packet format (see posestream.h), so PoseStreamDecode
+	turns them back into a Posture or joint positions.
+*/
+
+#ifndef _POSESHM_H
+#define _POSESHM_H
+
+#include <stdint.h>
+#include <atomic>
+
+#include "types.h"
+#include "posture.h"
+#include "skeleton.h"
+#include "channels.h"
+#include "posestream.h"
+
+#define POSE_SHM_MAGIC 0x4d48534d			// "MSHM"
+#define POSE_SHM_VERSION 1
+#define POSE_SHM_DEFAULT_NAME "/mocap_poses"
+#define POSE_SHM_SLOTS 64					// frames kept per actor
+#define POSE_SHM_MAX_ACTORS MAX_SKELS
+#define POSE_SHM_SPINS 1024					// reads of a locked slot between yields
+#define POSE_SHM_READ_TIMEOUT 100			// ms a reader waits for a locked slot
+
+struct PoseShmSlot
+{
+	std::atomic<uint32_t> lock;				// sequence lock, odd while the slot is written
+	uint32_t size;							// packet size in bytes
+	uint64_t index;							// publication number of this frame for its actor
+	unsigned char packet[POSE_STREAM_MAX_PACKET];
+};
+
+struct PoseShmRing
+{
+	std::atomic<uint64_t> count;			// number of frames published for this actor
+	PoseShmSlot slots[POSE_SHM_SLOTS];
+};
+
+struct PoseShmRegion
+{
+	uint32_t magic;							// POSE_SHM_MAGIC, written last by the publisher
+	uint32_t version;
+	uint32_t numActors;						// rings in use
+	uint32_t mode;							// PoseStreamMode of the packets
+	PoseShmRing rings[POSE_SHM_MAX_ACTORS];
+};
+
+
+class PoseShmPublisher
+{
+	//member functions
+	public:
+		PoseShmPublisher();
+		~PoseShmPublisher();
+
+		//Create (or reuse) the shared memory region. Returns 0 on success, -1 on error
+		int Open(char const *pName, PoseStreamMode mode);
+		//Unmap and remove the region
+		void Close();
+		bool IsOpen() const { return m_pRegion != NULL; }
+
+		//Store the posture of actor nActor as its latest frame. Never blocks.
+		//Returns 0 on success, -1 if the region is not open or nActor is out of range.
+		int Publish(Skeleton *pActor, Posture const& posture, int nActor, int nFrameNum);
+
+	//member variables
+	private:
+		PoseShmRegion *m_pRegion;
+		PoseStreamMode m_Mode;
+		uint32_t m_Sequence;
+		char m_Name[MAX_CHAR];
+		intptr_t m_Handle;
+		ChannelLayout *m_pLayouts[POSE_SHM_MAX_ACTORS];	// layout of each actor, rebuilt when the skeleton changes
+		Skeleton *m_pLayoutActors[POSE_SHM_MAX_ACTORS];
+};
+
+
+class PoseShmReader
+{
+	//member functions
+	public:
+		PoseShmReader();
+		~PoseShmReader();
+
+		//Map an existing region read only. Returns 0 on success, -1 if there is no publisher
+		int Open(char const *pName);
+		void Close();
+
+		int GetNumActors() const;
+		PoseStreamMode GetMode() const;
+
+		//Number of frames published so far for the actor
+		uint64_t GetCount(int nActor) const;
+
+		//Copy frame nIndex (0 <= nIndex < GetCount) of the actor into pBuffer (POSE_STREAM_MAX_PACKET bytes).
+		//Returns the packet size, 0 if the frame was already overwritten or not yet published, -1 if
+		//the slot stayed locked for POSE_SHM_READ_TIMEOUT ms (the writer died while writing it).
+		int Read(int nActor, uint64_t nIndex, unsigned char *pBuffer) const;
+
+		//Copy the latest frame of the actor. Returns the packet size, 0 if nothing was published yet,
+		//-1 if no frame could be read (see Read).
+		int ReadLatest(int nActor, unsigned char *pBuffer) const;
+
+	//member variables
+	private:
+		PoseShmRegion *m_pRegion;
+		intptr_t m_Handle;
+};
+
+#endif
@@ -0,0 +1,435 @@
+#ifdef WIN32
+#include <winsock2.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "ws2_32.lib")
+#endif
+typedef int socklen_t;
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define closesocket close
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+
+#include "posestream.h"
+
+
+/************************ Packet encoding **********************************/
+
+uint64_t PoseStreamClock()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//Round v/step to a short, saturating at the ends of the range
+static int16_t quantize(float v, float step)
+{
+	float q = floorf(v/step + 0.5f);
+	if (q > 32767.f) q = 32767.f;
+	if (q < -32768.f) q = -32768.f;
+	return (int16_t)q;
+}
+
+//Wrap an angle in degrees to [-180, 180)
+static float wrap_angle(float a)
+{
+	a = fmodf(a + 180.f, 360.f);
+	if (a < 0) a += 360.f;
+	return a - 180.f;
+}
+
+int PoseStreamEncode(unsigned char *pBuffer, PoseStreamMode mode, ChannelLayout const& layout, Skeleton *pActor,
+					 Posture const& posture, int nActor, int nFrameNum, uint32_t nSequence)
+{
+	PoseStreamHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = POSE_STREAM_MAGIC;
+	header.version = POSE_STREAM_VERSION;
+	header.mode = (uint8_t)mode;
+	header.actor = (uint8_t)nActor;
+	header.sequence = nSequence;
+	header.frame = nFrameNum;
+
+	float rootPos[3];
+	int16_t *pValues = (int16_t *)(pBuffer + sizeof(header) + sizeof(rootPos));
+
+	if (mode == POSE_STREAM_DOFS)
+	{
+		header.count = (uint16_t)layout.m_NumChannels;
+		header.step = POSE_STREAM_ANGLE_STEP;
+
+		//the first 3 channels are the root position
+		rootPos[0] = posture.root_pos.p[0];
+		rootPos[1] = posture.root_pos.p[1];
+		rootPos[2] = posture.root_pos.p[2];
+		for (int c = 3; c < layout.m_NumChannels; c++)
+		{
+			float v = layout.GetValue(posture, c);
+			if (layout.IsAngle(c))
+				*pValues++ = quantize(wrap_angle(v), POSE_STREAM_ANGLE_STEP);
+			else
+				*pValues++ = quantize(v, POSE_STREAM_POS_STEP);
+		}
+	}
+	else
+	{
+		::vector jointPos[MAX_BONES_IN_ASF_FILE];
+		pActor->computeJointPositions(posture, jointPos);
+
+		header.count = (uint16_t)pActor->NUM_BONES_IN_ASF_FILE;
+		header.step = POSE_STREAM_POS_STEP;
+
+		rootPos[0] = jointPos[root].p[0];
+		rootPos[1] = jointPos[root].p[1];
+		rootPos[2] = jointPos[root].p[2];
+		for (int j = 1; j < header.count; j++)
+			for (int a = 0; a < 3; a++)
+				*pValues++ = quantize(jointPos[j].p[a] - rootPos[a], POSE_STREAM_POS_STEP);
+	}
+
+	header.timestamp = PoseStreamClock();
+	memcpy(pBuffer, &header, sizeof(header));
+	memcpy(pBuffer + sizeof(header), rootPos, sizeof(rootPos));
+
+	return (int)((unsigned char *)pValues - pBuffer);
+}
+
+int PoseStreamDecode(unsigned char const *pBuffer, int nSize, PoseStreamHeader *pHeader,
+					 ChannelLayout const& layout, Posture *pPosture, ::vector *pJointPos)
+{
+	float rootPos[3];
+
+	if (nSize < (int)(sizeof(PoseStreamHeader) + sizeof(rootPos)))
+		return -1;
+	memcpy(pHeader, pBuffer, sizeof(PoseStreamHeader));
+	if (pHeader->magic != POSE_STREAM_MAGIC || pHeader->version != POSE_STREAM_VERSION)
+		return -1;
+	memcpy(rootPos, pBuffer + sizeof(PoseStreamHeader), sizeof(rootPos));
+
+	int16_t values[2*MAX_CHANNELS];
+	int nValues = (pHeader->mode == POSE_STREAM_DOFS) ? pHeader->count - 3 : 3*(pHeader->count - 1);
+	if (nValues < 0 || nValues > 2*MAX_CHANNELS ||
+		nSize != (int)(sizeof(PoseStreamHeader) + sizeof(rootPos) + nValues*sizeof(int16_t)))
+		return -1;
+	memcpy(values, pBuffer + sizeof(PoseStreamHeader) + sizeof(rootPos), nValues*sizeof(int16_t));
+
+	if (pHeader->mode == POSE_STREAM_DOFS)
+	{
+		if (pHeader->count != layout.m_NumChannels)
+			return -1;
+		if (pPosture != NULL)
+		{
+			for (int c = 0; c < 3; c++)
+				layout.SetValue(*pPosture, c, rootPos[c]);
+			for (int c = 3; c < layout.m_NumChannels; c++)
+			{
+				float step = layout.IsAngle(c) ? POSE_STREAM_ANGLE_STEP : POSE_STREAM_POS_STEP;
+				layout.SetValue(*pPosture, c, values[c - 3]*step);
+			}
+		}
+	}
+	else if (pHeader->mode == POSE_STREAM_JOINTS)
+	{
+		//pJointPos holds at most MAX_BONES_IN_ASF_FILE joints, whatever the sender claims
+		if (pHeader->count < 1 || pHeader->count > MAX_BONES_IN_ASF_FILE)
+			return -1;
+		if (pJointPos != NULL)
+		{
+			pJointPos[root].setValue(rootPos[0], rootPos[1], rootPos[2]);
+			for (int j = 1; j < pHeader->count; j++)
+				pJointPos[j].setValue(rootPos[0] + values[3*(j-1)]*pHeader->step,
+									  rootPos[1] + values[3*(j-1) + 1]*pHeader->step,
+									  rootPos[2] + values[3*(j-1) + 2]*pHeader->step);
+		}
+	}
+	else
+		return -1;
+
+	return 0;
+}
+
+
+/************************ Socket helpers **********************************/
+
+static bool socket_startup()
+{
+#ifdef WIN32
+	static bool started = false;
+	if (!started)
+	{
+		WSADATA wsaData;
+		if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+			return false;
+		started = true;
+	}
+#endif
+	return true;
+}
+
+static void set_nonblocking(intptr_t s)
+{
+#ifdef WIN32
+	u_long mode = 1;
+	ioctlsocket((SOCKET)s, FIONBIO, &mode);
+#else
+	fcntl((int)s, F_SETFL, fcntl((int)s, F_GETFL, 0) | O_NONBLOCK);
+#endif
+}
+
+//Open a UDP socket bound to 127.0.0.1:nPort (0 for an ephemeral port). Returns -1 on error
+static intptr_t open_udp_socket(int nPort)
+{
+	if (!socket_startup())
+		return -1;
+
+	intptr_t s = (intptr_t)socket(AF_INET, SOCK_DGRAM, 0);
+	if (s < 0)
+		return -1;
+
+	//large buffers, so bursts of frames are not dropped
+	int nBufSize = 1 << 20;
+	setsockopt(s, SOL_SOCKET, SO_RCVBUF, (char *)&nBufSize, sizeof(nBufSize));
+	setsockopt(s, SOL_SOCKET, SO_SNDBUF, (char *)&nBufSize, sizeof(nBufSize));
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons((unsigned short)nPort);
+	if (bind(s, (sockaddr *)&addr, sizeof(addr)) != 0)
+	{
+		closesocket(s);
+		return -1;
+	}
+	return s;
+}
+
+
+/************************ PoseStreamSender class functions **********************************/
+PoseStreamSender::PoseStreamSender()
+{
+	m_Socket = -1;
+	m_Mode = POSE_STREAM_DOFS;
+	m_Sequence = 0;
+	m_NumSubscribers = 0;
+	m_NumDropped = 0;
+	m_pLayout = NULL;
+	m_pLayoutActor = NULL;
+}
+
+PoseStreamSender::~PoseStreamSender()
+{
+	Close();
+	if (m_pLayout != NULL)
+		delete m_pLayout;
+}
+
+int PoseStreamSender::Open(int nPort, PoseStreamMode mode)
+{
+	Close();
+
+	m_Socket = open_udp_socket(nPort);
+	if (m_Socket == -1)
+	{
+		printf("Pose stream: cannot open port %d\n", nPort);
+		return -1;
+	}
+	set_nonblocking(m_Socket);
+
+	m_Mode = mode;
+	m_Sequence = 0;
+	m_NumSubscribers = 0;
+	m_NumDropped = 0;
+	printf("Pose stream: sending %s on port %d\n", mode == POSE_STREAM_DOFS ? "dofs" : "joint positions", nPort);
+	return 0;
+}
+
+void PoseStreamSender::Close()
+{
+	if (m_Socket != -1)
+		closesocket(m_Socket);
+	m_Socket = -1;
+	m_NumSubscribers = 0;
+}
+
+void PoseStreamSender::Poll()
+{
+	uint32_t request;
+	sockaddr_in from;
+	socklen_t fromLen = sizeof(from);
+	uint64_t now = PoseStreamClock();
+
+	//drain the pending requests
+	while (recvfrom(m_Socket, (char *)&request, sizeof(request), 0, (sockaddr *)&from, &fromLen) == sizeof(request))
+	{
+		int i;
+		for (i = 0; i < m_NumSubscribers; i++)
+			if (m_Subscribers[i].addr == from.sin_addr.s_addr && m_Subscribers[i].port == from.sin_port)
+				break;
+
+		if (request == POSE_STREAM_SUBSCRIBE)
+		{
+			if (i == m_NumSubscribers)
+			{
+				if (m_NumSubscribers == POSE_STREAM_MAX_SUBSCRIBERS)
+					continue;
+				m_Subscribers[i].addr = from.sin_addr.s_addr;
+				m_Subscribers[i].port = from.sin_port;
+				m_NumSubscribers++;
+				printf("Pose stream: subscriber on port %d\n", ntohs(from.sin_port));
+			}
+			m_Subscribers[i].lastSeen = now;
+		}
+		else if (request == POSE_STREAM_UNSUBSCRIBE && i < m_NumSubscribers)
+			m_Subscribers[i].lastSeen = 0;
+
+		fromLen = sizeof(from);
+	}
+
+	//drop expired subscribers
+	for (int i = 0; i < m_NumSubscribers; )
+	{
+		if (now - m_Subscribers[i].lastSeen > (uint64_t)(POSE_STREAM_TIMEOUT*1e6))
+			m_Subscribers[i] = m_Subscribers[--m_NumSubscribers];
+		else
+			i++;
+	}
+}
+
+int PoseStreamSender::Publish(Skeleton *pActor, Posture const& posture, int nActor, int nFrameNum)
+{
+	if (m_Socket == -1)
+		return 0;
+
+	Poll();
+	if (m_NumSubscribers == 0)
+		return 0;
+
+	if (m_pLayoutActor != pActor)
+	{
+		if (m_pLayout != NULL)
+			delete m_pLayout;
+		m_pLayout = new ChannelLayout(pActor);
+		m_pLayoutActor = pActor;
+	}
+
+	unsigned char buffer[POSE_STREAM_MAX_PACKET];
+	int nSize = PoseStreamEncode(buffer, m_Mode, *m_pLayout, pActor, posture, nActor, nFrameNum, m_Sequence++);
+
+	int nSent = 0;
+	for (int i = 0; i < m_NumSubscribers; i++)
+	{
+		sockaddr_in to;
+		memset(&to, 0, sizeof(to));
+		to.sin_family = AF_INET;
+		to.sin_addr.s_addr = m_Subscribers[i].addr;
+		to.sin_port = m_Subscribers[i].port;
+		if (sendto(m_Socket, (char *)buffer, nSize, 0, (sockaddr *)&to, sizeof(to)) == nSize)
+			nSent++;
+		else
+			m_NumDropped++;
+	}
+	return nSent;
+}
+
+
+/************************ PoseStreamReceiver class functions **********************************/
+PoseStreamReceiver::PoseStreamReceiver()
+{
+	m_Socket = -1;
+	m_SenderPort = 0;
+	m_LastSubscribe = 0;
+	m_NumReceived = 0;
+	m_NumLost = 0;
+	m_LastSequence = 0;
+}
+
+PoseStreamReceiver::~PoseStreamReceiver()
+{
+	Close();
+}
+
+int PoseStreamReceiver::Open(int nSenderPort)
+{
+	Close();
+
+	m_Socket = open_udp_socket(0);
+	if (m_Socket == -1)
+	{
+		printf("Pose stream: cannot open receiver socket\n");
+		return -1;
+	}
+
+	m_SenderPort = nSenderPort;
+	m_NumReceived = 0;
+	m_NumLost = 0;
+	Subscribe(POSE_STREAM_SUBSCRIBE);
+	return 0;
+}
+
+void PoseStreamReceiver::Close()
+{
+	if (m_Socket != -1)
+	{
+		Subscribe(POSE_STREAM_UNSUBSCRIBE);
+		closesocket(m_Socket);
+	}
+	m_Socket = -1;
+}
+
+void PoseStreamReceiver::Subscribe(uint32_t nRequest)
+{
+	sockaddr_in to;
+	memset(&to, 0, sizeof(to));
+	to.sin_family = AF_INET;
+	to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	to.sin_port = htons((unsigned short)m_SenderPort);
+	sendto(m_Socket, (char *)&nRequest, sizeof(nRequest), 0, (sockaddr *)&to, sizeof(to));
+	m_LastSubscribe = PoseStreamClock();
+}
+
+int PoseStreamReceiver::Receive(unsigned char *pBuffer, int nBufferSize, int nTimeoutMs)
+{
+	if (m_Socket == -1)
+		return -1;
+
+	//renew the subscription well before it expires
+	if (PoseStreamClock() - m_LastSubscribe > (uint64_t)(POSE_STREAM_TIMEOUT*1e6/4))
+		Subscribe(POSE_STREAM_SUBSCRIBE);
+
+	fd_set readSet;
+	FD_ZERO(&readSet);
+	FD_SET(m_Socket, &readSet);
+	timeval timeout;
+	timeout.tv_sec = nTimeoutMs/1000;
+	timeout.tv_usec = (nTimeoutMs%1000)*1000;
+
+	int nReady = select((int)m_Socket + 1, &readSet, NULL, NULL, &timeout);
+	if (nReady < 0)
+		return -1;
+	if (nReady == 0)
+		return 0;
+
+	int nSize = recv(m_Socket, (char *)pBuffer, nBufferSize, 0);
+	if (nSize < (int)sizeof(PoseStreamHeader))
+		return -1;
+
+	PoseStreamHeader header;
+	memcpy(&header, pBuffer, sizeof(header));
+	if (m_NumReceived > 0 && header.sequence > m_LastSequence + 1)
+		m_NumLost += header.sequence - m_LastSequence - 1;
+	m_LastSequence = header.sequence;
+	m_NumReceived++;
+
+	return nSize;
+}
@@ -0,0 +1,147 @@
+/*
+	posestream.h
+
+	Stream postures to other programs over a local UDP socket.
+
+	Every frame is sent as one datagram: a PoseStreamHeader followed by the payload.
+	  POSE_STREAM_DOFS:   root position as 3 floats, then one short per remaining channel
+	                      of the ChannelLayout: angle = value * step (angles wrapped to [-180, 180))
+	  POSE_STREAM_JOINTS: root joint position as 3 floats, then 3 shorts per remaining bone:
+	                      position = root + value * step (world joint positions, see computeJointPositions)
+
+	Receivers subscribe by sending a POSE_STREAM_SUBSCRIBE datagram to the sender port.
+	The subscription expires if it is not repeated within POSE_STREAM_TIMEOUT seconds.
+	Both ends are expected to run on the same host (same byte order).
+*/
+
+#ifndef _POSESTREAM_H
+#define _POSESTREAM_H
+
+#include <stdint.h>
+
+#include "types.h"
+#include "posture.h"
+#include "skeleton.h"
+#include "channels.h"
+
+#define POSE_STREAM_MAGIC 0x5350434d			// "MCPS"
+#define POSE_STREAM_SUBSCRIBE 0x4255534d		// "MSUB"
+#define POSE_STREAM_UNSUBSCRIBE 0x5453554d		// "MUST"
+#define POSE_STREAM_VERSION 1
+#define POSE_STREAM_DEFAULT_PORT 9750
+#define POSE_STREAM_MAX_SUBSCRIBERS 16
+#define POSE_STREAM_TIMEOUT 5.0
+#define POSE_STREAM_MAX_PACKET (sizeof(PoseStreamHeader) + 12 + 2*MAX_CHANNELS)
+
+//Quantization steps
+#define POSE_STREAM_ANGLE_STEP (360.0f/65536.0f)	// degrees
+#define POSE_STREAM_POS_STEP 0.0001f				// scaled units (about 0.1 mm with MOCAP_SCALE)
+
+enum PoseStreamMode
+{
+	POSE_STREAM_DOFS = 0, POSE_STREAM_JOINTS
+};
+
+struct PoseStreamHeader
+{
+	uint32_t magic;			// POSE_STREAM_MAGIC
+	uint8_t version;		// POSE_STREAM_VERSION
+	uint8_t mode;			// PoseStreamMode
+	uint8_t actor;			// actor number in the player
+	uint8_t flags;			// unused, 0
+	uint16_t count;			// number of channels (DOFS) or joints (JOINTS) in the payload
+	uint16_t reserved;
+	uint32_t sequence;		// incremented for every packet sent
+	int32_t frame;			// frame number in the played motion
+	float step;				// quantization step of the payload
+	uint64_t timestamp;		// send time in microseconds, see PoseStreamClock()
+};
+
+//Monotonic clock shared by sender and receiver, in microseconds
+uint64_t PoseStreamClock();
+
+//Encode the posture into pBuffer (at least POSE_STREAM_MAX_PACKET bytes).
+//Returns the packet size.
+int PoseStreamEncode(unsigned char *pBuffer, PoseStreamMode mode, ChannelLayout const& layout, Skeleton *pActor,
+					 Posture const& posture, int nActor, int nFrameNum, uint32_t nSequence);
+
+//Decode a packet. In DOFS mode the channels are written into pPosture (layout must match the sender actor),
+//in JOINTS mode the joint positions are written into pJointPos (header.count entries, packets with
+//more than MAX_BONES_IN_ASF_FILE are malformed).
+//Either pointer may be NULL. Returns 0 on success, -1 if the packet is malformed.
+int PoseStreamDecode(unsigned char const *pBuffer, int nSize, PoseStreamHeader *pHeader,
+					 ChannelLayout const& layout, Posture *pPosture, ::vector *pJointPos);
+
+
+class PoseStreamSender
+{
+	//member functions
+	public:
+		PoseStreamSender();
+		~PoseStreamSender();
+
+		//Bind the UDP socket to 127.0.0.1:nPort. Returns 0 on success, -1 on error
+		int Open(int nPort, PoseStreamMode mode);
+		void Close();
+		bool IsOpen() const { return m_Socket != -1; }
+
+		//Handle pending subscribe/unsubscribe requests and drop expired subscribers.
+		//Called by Publish.
+		void Poll();
+
+		//Send the posture of one actor to all subscribers. Returns the number of subscribers reached.
+		int Publish(Skeleton *pActor, Posture const& posture, int nActor, int nFrameNum);
+
+	//member variables
+	public:
+		PoseStreamMode m_Mode;
+		uint32_t m_Sequence;		// sequence number of the next packet
+		int m_NumSubscribers;
+		int m_NumDropped;			// packets the socket refused (send buffer full)
+
+	private:
+		struct Subscriber
+		{
+			uint32_t addr;			// network byte order
+			uint16_t port;			// network byte order
+			uint64_t lastSeen;		// PoseStreamClock() of the last subscribe request
+		};
+
+		intptr_t m_Socket;
+		Subscriber m_Subscribers[POSE_STREAM_MAX_SUBSCRIBERS];
+		ChannelLayout *m_pLayout;	// layout of m_pLayoutActor, rebuilt when the actor changes
+		Skeleton *m_pLayoutActor;
+};
+
+
+class PoseStreamReceiver
+{
+	//member functions
+	public:
+		PoseStreamReceiver();
+		~PoseStreamReceiver();
+
+		//Open a socket on an ephemeral port and subscribe to the sender on 127.0.0.1:nSenderPort
+		//Returns 0 on success, -1 on error
+		int Open(int nSenderPort);
+		void Close();
+
+		//Wait up to nTimeoutMs for the next packet. The subscription is renewed as needed.
+		//Returns the packet size, 0 on timeout, -1 on error.
+		int Receive(unsigned char *pBuffer, int nBufferSize, int nTimeoutMs);
+
+	//member variables
+	public:
+		uint32_t m_NumReceived;
+		uint32_t m_NumLost;			// gaps in the sequence numbers
+		uint32_t m_LastSequence;
+
+	private:
+		void Subscribe(uint32_t nRequest);
+
+		intptr_t m_Socket;
+		int m_SenderPort;
+		uint64_t m_LastSubscribe;
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "posture.h"
+#include "skeleton.h"
 
 /************************ Posture class functions **********************************/
 
@@ -13,7 +14,64 @@ LinearInterpolate(float t, Posture const& a, Posture const& b )
 
 	//Interpolate bones rotations
 	for (int i = 0; i < MAX_BONES_IN_ASF_FILE; i++)
+	{
 		InterpPosture.bone_rotation[i] = interpolate(t, a.bone_rotation[i], b.bone_rotation[i]);
+		InterpPosture.bone_translation[i] = interpolate(t, a.bone_translation[i], b.bone_translation[i]);
+	}
 
 	return InterpPosture;
-}
\ No newline at end of file
+}
+
+void CatmullRomWeights(float t, float ta, float tb, float tc, float td, float *pWeights)
+{
+	float fLength = tc - tb;
+	if (ta >= tb)
+		ta = tb - fLength;
+	if (td <= tc)
+		td = tc + fLength;
+	//Hermite segment with the tangents fLength*(c - a)/(tc - ta) at b and fLength*(d - b)/(td - tb) at c
+	float t2 = t*t, t3 = t2*t;
+	float h00 = 2.0f*t3 - 3.0f*t2 + 1.0f, h10 = t3 - 2.0f*t2 + t;
+	float h01 = -2.0f*t3 + 3.0f*t2, h11 = t3 - t2;
+	float sb = fLength/(tc - ta), sc = fLength/(td - tb);
+	pWeights[0] = -h10*sb;
+	pWeights[1] = h00 - h11*sc;
+	pWeights[2] = h01 + h10*sb;
+	pWeights[3] = h11*sc;
+}
+
+Posture 
+CatmullRomInterpolate(float t, Posture const& a, Posture const& b, Posture const& c, Posture const& d, float const *pTimes,
+	Skeleton *pActor)
+{
+	Posture InterpPosture;
+	Bone *pBones = pActor != NULL ? pActor->getRoot() : NULL;
+	int nBones = pActor != NULL ? pActor->NUM_BONES_IN_ASF_FILE : 0;
+
+	float w[4];
+	CatmullRomWeights(t, pTimes[0], pTimes[1], pTimes[2], pTimes[3], w);
+
+	InterpPosture.root_pos = a.root_pos*w[0] + b.root_pos*w[1] + c.root_pos*w[2] + d.root_pos*w[3];
+
+	for (int i = 0; i < MAX_BONES_IN_ASF_FILE; i++)
+	{
+		//only the rotation dofs hold angles, the rest is 0 (or whatever a reader left there)
+		::vector const& rb = b.bone_rotation[i];
+		bool bBone = i < nBones;
+		int dofx = pBones == NULL || (bBone && pBones[i].dofx), dofy = pBones == NULL || (bBone && pBones[i].dofy),
+			dofz = pBones == NULL || (bBone && pBones[i].dofz);
+		InterpPosture.bone_rotation[i] = UnwrapAngles(a.bone_rotation[i], rb, dofx, dofy, dofz)*w[0] + rb*w[1] +
+			UnwrapAngles(c.bone_rotation[i], rb, dofx, dofy, dofz)*w[2] + UnwrapAngles(d.bone_rotation[i], rb, dofx, dofy, dofz)*w[3];
+		InterpPosture.bone_translation[i] = a.bone_translation[i]*w[0] + b.bone_translation[i]*w[1] + c.bone_translation[i]*w[2] + d.bone_translation[i]*w[3];
+	}
+
+	return InterpPosture;
+}
+
+//Uniform Catmull-Rom spline: passes through b at t=0 and c at t=1
+Posture 
+CatmullRomInterpolate(float t, Posture const& a, Posture const& b, Posture const& c, Posture const& d, Skeleton *pActor)
+{
+	float const times[4] = { -1.0f, 0.0f, 1.0f, 2.0f };
+	return CatmullRomInterpolate(t, a, b, c, d, times, pActor);
+}
@@ -1,15 +1,26 @@
 #ifndef _POSTURE_H
 #define _POSTURE_H
 
+#include <cmath>
+
 #include "vector.h"
 #include "types.h"
 
+class Skeleton;
+
 //Root position and all bone rotation angles (including root) 
 class Posture
 {
 	//member functions
 	public:
 		friend Posture LinearInterpolate(float, Posture const&, Posture const& );
+		//Catmull-Rom segment between b and c (t in [0,1]), a and d are the outer control points, the
+		//keys evenly spaced or at the times pTimes[0..3] (see CatmullRomWeights). The rotation dofs
+		//of the bones of pActor (every angle for NULL) in a, c and d are first unwrapped to within 180
+		//degrees of b
+		friend Posture CatmullRomInterpolate(float, Posture const&, Posture const&, Posture const&, Posture const&, Skeleton *pActor);
+		friend Posture CatmullRomInterpolate(float, Posture const&, Posture const&, Posture const&, Posture const&, float const *pTimes,
+			Skeleton *pActor);
 
 	//member variables
 	public:
@@ -26,4 +37,29 @@ class Posture
 		::vector bone_length[MAX_BONES_IN_ASF_FILE];
 };
 
+//Weights of the control points a, b, c, d of the Catmull-Rom segment between b and c at t in [0,1]
+//for keys at the times ta <= tb < tc <= td: the tangent at a key is the difference of its
+//neighbours over their time apart, so unevenly spaced keys keep their speed and evenly spaced
+//keys give the uniform spline. A repeated end key (ta == tb or td == tc) is taken one segment
+//beyond. Every Catmull-Rom evaluation (Interpolator, MotionSampler, the player) goes through it
+void CatmullRomWeights(float t, float ta, float tb, float tc, float td, float *pWeights);
+
+//Angle in degrees moved by whole turns to within 180 degrees of ref (closed form: a non-finite
+//or huge angle comes out non-finite or unchanged instead of looping)
+inline float UnwrapAngle(float angle, float ref)
+{
+	return angle - 360.0f*floorf((angle - ref + 180.0f)/360.0f);
+}
+
+//The angles of the rotation dofs of a bone (dofx, dofy, dofz) unwrapped onto the ones of ref,
+//the others left as they are
+inline ::vector UnwrapAngles(::vector angles, ::vector const& ref, int dofx, int dofy, int dofz)
+{
+	int dofs[3] = { dofx, dofy, dofz };
+	for (int k = 0; k < 3; k++)
+		if (dofs[k])
+			angles.p[k] = UnwrapAngle(angles.p[k], ref.p[k]);
+	return angles;
+}
+
 #endif
\ No newline at end of file
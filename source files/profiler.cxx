@@ -0,0 +1,180 @@
+#include <cstdio>
+#include <algorithm>
+
+#include "profiler.h"
+
+//Ring of the calling thread and the profiler it belongs to
+static thread_local Profiler *pRingOwner = NULL;
+static thread_local void *pThreadRing = NULL;
+
+
+//Name with the characters JSON strings escape
+static void write_json_name(FILE *pFile, char const *name)
+{
+	fputc('"', pFile);
+	for (char const *p = name; *p != '\0'; p++)
+	{
+		if (*p == '"' || *p == '\\')
+			fputc('\\', pFile);
+		if ((unsigned char)*p >= 0x20)
+			fputc(*p, pFile);
+	}
+	fputc('"', pFile);
+}
+
+
+/************************ Profiler class functions **********************************/
+Profiler::Profiler()
+{
+	m_bEnabled = false;
+	m_Start = std::chrono::steady_clock::now();
+	m_MainThread = std::this_thread::get_id();
+	m_NumFrames = 0;
+	m_LastFrame = -1;
+}
+
+Profiler::~Profiler()
+{
+	for (int i = 0; i < (int)m_Rings.size(); i++)
+		delete m_Rings[i];
+}
+
+Profiler& Profiler::Get()
+{
+	static Profiler profiler;
+	return profiler;
+}
+
+Profiler::ThreadRing *Profiler::GetRing()
+{
+	if (pRingOwner == this)
+		return (ThreadRing *)pThreadRing;
+
+	ThreadRing *pRing = new ThreadRing;
+	pRing->events.resize(PROFILE_RING_SIZE);
+	pRing->count = 0;
+	pRing->bMain = std::this_thread::get_id() == m_MainThread;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		pRing->thread = (int)m_Rings.size();
+		m_Rings.push_back(pRing);
+	}
+	pRingOwner = this;
+	pThreadRing = pRing;
+	return pRing;
+}
+
+//Only the owning thread writes a ring; the count is published after the event
+void Profiler::Push(ProfileEvent const& event)
+{
+	ThreadRing *pRing = GetRing();
+	unsigned long long n = pRing->count.load(std::memory_order_relaxed);
+	pRing->events[n % PROFILE_RING_SIZE] = event;
+	pRing->count.store(n + 1, std::memory_order_release);
+}
+
+void Profiler::AddTimer(char const *name, long long nBegin, long long nEnd)
+{
+	ProfileEvent event;
+	event.name = name;
+	event.begin = nBegin;
+	event.end = nEnd;
+	event.value = 0;
+	Push(event);
+}
+
+void Profiler::AddCounter(char const *name, double value)
+{
+	ProfileEvent event;
+	event.name = name;
+	event.begin = Now();
+	event.end = -1;
+	event.value = value;
+	Push(event);
+}
+
+void Profiler::Clear()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	for (int i = 0; i < (int)m_Rings.size(); i++)
+		m_Rings[i]->count.store(0, std::memory_order_relaxed);
+	m_NumFrames = 0;
+	m_LastFrame = -1;
+}
+
+int Profiler::WriteChromeTrace(char const *filename)
+{
+	FILE *pFile = fopen(filename, "w");
+	if (pFile == NULL)
+	{
+		printf("Profiler: cannot create %s\n", filename);
+		return -1;
+	}
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	fprintf(pFile, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	bool bFirst = true;
+	for (int r = 0; r < (int)m_Rings.size(); r++)
+	{
+		ThreadRing const *pRing = m_Rings[r];
+		char name[32];
+		if (pRing->bMain)
+			snprintf(name, sizeof(name), "main");
+		else
+			snprintf(name, sizeof(name), "thread %d", pRing->thread);
+		fprintf(pFile, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+			bFirst ? "" : ",\n", pRing->thread, name);
+		bFirst = false;
+
+		//the oldest events were overwritten once the ring went round
+		unsigned long long nEnd = pRing->count.load(std::memory_order_acquire);
+		unsigned long long nBegin = nEnd > PROFILE_RING_SIZE ? nEnd - PROFILE_RING_SIZE : 0;
+		for (unsigned long long n = nBegin; n < nEnd; n++)
+		{
+			ProfileEvent const& event = pRing->events[n % PROFILE_RING_SIZE];
+			fprintf(pFile, ",\n{\"name\":");
+			write_json_name(pFile, event.name);
+			if (event.end >= 0)
+				fprintf(pFile, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+					pRing->thread, event.begin*1e-3, (event.end - event.begin)*1e-3);
+			else
+				fprintf(pFile, ",\"ph\":\"C\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"args\":{\"value\":%.9g}}",
+					pRing->thread, event.begin*1e-3, event.value);
+		}
+	}
+	fprintf(pFile, "\n]}\n");
+
+	bool bFailed = ferror(pFile) != 0;
+	if (fclose(pFile) != 0 || bFailed)
+	{
+		printf("Profiler: failed to write %s\n", filename);
+		return -1;
+	}
+	return 0;
+}
+
+void Profiler::FrameMark()
+{
+	long long nNow = Now();
+	if (m_LastFrame >= 0)
+	{
+		m_FrameTimes[m_NumFrames % PROFILE_FRAMES] = (nNow - m_LastFrame)*1e-6f;
+		m_NumFrames++;
+		if (IsEnabled())
+			AddTimer("frame", m_LastFrame, nNow);
+	}
+	m_LastFrame = nNow;
+}
+
+float Profiler::GetFramePercentile(float fPercent) const
+{
+	int nFrames = GetNumFrames();
+	if (nFrames == 0)
+		return 0;
+
+	std::vector<float> times(m_FrameTimes, m_FrameTimes + nFrames);
+	int nRank = (int)(fPercent/100*nFrames + 0.999f) - 1;
+	nRank = std::max(0, std::min(nFrames - 1, nRank));
+	std::nth_element(times.begin(), times.begin() + nRank, times.end());
+	return times[nRank];
+}
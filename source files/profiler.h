@@ -0,0 +1,128 @@
+/*
+	profiler.h
+
+	Timers and counters around the hot paths (playback, drawing, AMC loading, interpolation,
+	the thread pool), cheap enough to stay compiled in.
+
+	PROFILE_SCOPE("name") times the rest of the enclosing block and PROFILE_COUNT("name", value)
+	records a value; names must be string literals (only the pointer is kept). While the profiler
+	is disabled (the default) either costs one relaxed atomic load. Enabled, every thread writes
+	its events into its own ring buffer of PROFILE_RING_SIZE events, allocated on its first
+	event, without locks; when a ring is full the oldest events are overwritten, so the buffers
+	hold the last moments before a stutter. Defining MOCAP_NO_PROFILE compiles the macros out.
+
+	WriteChromeTrace writes the events of every thread as Chrome trace JSON (chrome://tracing,
+	Perfetto): timers as complete events, counters as counter events, one track per thread. Call
+	it while the recorded threads are quiet (between frames, no ParallelFor running): an event
+	written during the export may come out torn.
+
+	FrameMark, called once per drawn frame from the drawing thread, keeps the last PROFILE_FRAMES
+	frame times, enabled or not, for GetFramePercentile (the HUD of the player).
+*/
+
+#ifndef _PROFILER_H
+#define _PROFILER_H
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <chrono>
+#include <thread>
+
+#define PROFILE_RING_SIZE (1 << 15)			// events per thread
+#define PROFILE_FRAMES 512					// frame times kept for the percentiles
+
+struct ProfileEvent
+{
+	char const *name;
+	long long begin;						// ns since the start of the profiler
+	long long end;							// -1 for a counter
+	double value;							// of a counter
+};
+
+class Profiler
+{
+	//member functions
+	public:
+		Profiler();
+		~Profiler();
+
+		static Profiler& Get();
+
+		void Enable(bool bEnable) { m_bEnabled.store(bEnable, std::memory_order_relaxed); }
+		bool IsEnabled() const { return m_bEnabled.load(std::memory_order_relaxed); }
+
+		//ns since the profiler was created
+		long long Now() const { return (long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_Start).count(); }
+
+		//Record into the ring of the calling thread
+		void AddTimer(char const *name, long long nBegin, long long nEnd);
+		void AddCounter(char const *name, double value);
+
+		//Drop the events of every thread and the frame times
+		void Clear();
+		//Write the events of every thread. Returns 0, -1 on error
+		int WriteChromeTrace(char const *filename);
+
+		//End of a frame: records the time since the previous mark (and a "frame" timer when enabled)
+		void FrameMark();
+		int GetNumFrames() const { return m_NumFrames < PROFILE_FRAMES ? m_NumFrames : PROFILE_FRAMES; }
+		//Frame time in ms below which fPercent of the kept frames are, 0 without frames
+		float GetFramePercentile(float fPercent) const;
+
+	private:
+		struct ThreadRing
+		{
+			int thread;								// in order of the first event
+			bool bMain;								// thread that created the profiler
+			std::vector<ProfileEvent> events;
+			std::atomic<unsigned long long> count;	// events ever written
+		};
+
+		ThreadRing *GetRing();
+		void Push(ProfileEvent const& event);
+
+	//member variables
+	private:
+		std::atomic<bool> m_bEnabled;
+		std::chrono::steady_clock::time_point m_Start;
+		std::thread::id m_MainThread;
+
+		std::mutex m_Mutex;						// guards m_Rings
+		std::vector<ThreadRing*> m_Rings;
+
+		float m_FrameTimes[PROFILE_FRAMES];		// ms
+		int m_NumFrames;						// frames ever marked
+		long long m_LastFrame;
+};
+
+class ProfileScope
+{
+	public:
+		ProfileScope(char const *name)
+		{
+			m_Name = Profiler::Get().IsEnabled() ? name : NULL;
+			m_Begin = m_Name != NULL ? Profiler::Get().Now() : 0;
+		}
+		~ProfileScope()
+		{
+			if (m_Name != NULL)
+				Profiler::Get().AddTimer(m_Name, m_Begin, Profiler::Get().Now());
+		}
+
+	private:
+		char const *m_Name;
+		long long m_Begin;
+};
+
+#ifdef MOCAP_NO_PROFILE
+#define PROFILE_SCOPE(name)
+#define PROFILE_COUNT(name, value)
+#else
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_COUNT(name, value) do { if (Profiler::Get().IsEnabled()) Profiler::Get().AddCounter(name, (double)(value)); } while (0)
+#endif
+
+#endif
@@ -0,0 +1,219 @@
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include "pyramid.h"
+#include "threadpool.h"
+
+#define PYRAMID_CHUNK 256
+
+
+/************************ MotionPyramid class functions **********************************/
+MotionPyramid::MotionPyramid(Skeleton *pActor) : m_Layout(pActor)
+{
+	m_NumFrames = 0;
+}
+
+MotionPyramid::~MotionPyramid()
+{
+}
+
+float const *MotionPyramid::GetMin(int nLevel, int nChannel) const
+{
+	return nLevel == 0 ? &m_Values[(size_t)nChannel*m_NumFrames] : &m_Levels[nLevel].min[(size_t)nChannel*m_Levels[nLevel].numBins];
+}
+
+float const *MotionPyramid::GetMax(int nLevel, int nChannel) const
+{
+	return nLevel == 0 ? &m_Values[(size_t)nChannel*m_NumFrames] : &m_Levels[nLevel].max[(size_t)nChannel*m_Levels[nLevel].numBins];
+}
+
+float const *MotionPyramid::GetMean(int nLevel, int nChannel) const
+{
+	return nLevel == 0 ? &m_Values[(size_t)nChannel*m_NumFrames] : &m_Levels[nLevel].mean[(size_t)nChannel*m_Levels[nLevel].numBins];
+}
+
+size_t MotionPyramid::GetMemory() const
+{
+	size_t nBytes = 0;
+	for (int l = 1; l < (int)m_Levels.size(); l++)
+		nBytes += (size_t)m_Levels[l].numBins*(3*m_Layout.m_NumChannels*sizeof(float) + sizeof(int));
+	return nBytes;
+}
+
+int MotionPyramid::Build(Motion *pMotion)
+{
+	m_Levels.clear();
+	m_Values.clear();
+	m_NumFrames = 0;
+	if (pMotion == NULL || pMotion->m_NumFrames <= 0)
+		return -1;
+
+	int n = pMotion->m_NumFrames, C = m_Layout.m_NumChannels;
+	m_NumFrames = n;
+	m_Values.resize((size_t)C*n);
+	ThreadPool& pool = ThreadPool::GetDefault();
+	pool.ParallelFor(0, n, [&](int nBegin, int nEnd, int nThread)
+	{
+		float row[MAX_CHANNELS];
+		for (int f = nBegin; f < nEnd; f++)
+		{
+			m_Layout.Gather(pMotion->m_pPostures[f], row);
+			for (int c = 0; c < C; c++)
+				m_Values[(size_t)c*n + f] = row[c];
+		}
+	}, PYRAMID_CHUNK);
+
+	//channels count in the choice of representatives relative to how much they vary
+	std::vector<float> weights(C);
+	pool.ParallelFor(0, C, [&](int nBegin, int nEnd, int nThread)
+	{
+		for (int c = nBegin; c < nEnd; c++)
+		{
+			float const *pValues = &m_Values[(size_t)c*n];
+			double sum = 0, sum2 = 0;
+			for (int f = 0; f < n; f++)
+			{
+				sum += pValues[f];
+				sum2 += (double)pValues[f]*pValues[f];
+			}
+			double variance = std::max(sum2/n - (sum/n)*(sum/n), 0.0);
+			weights[c] = variance > 1e-12 ? (float)(1.0/variance) : 0.0f;
+		}
+	});
+
+	m_Levels.push_back(Level());
+	m_Levels[0].numBins = n;
+	for (int l = 1; m_Levels[l - 1].numBins > 1; l++)
+	{
+		m_Levels.push_back(Level());
+		Level &level = m_Levels[l];
+		Level const &prev = m_Levels[l - 1];
+		int nBins = (prev.numBins + 1)/2, nHalf = 1 << (l - 1);
+		level.numBins = nBins;
+		level.min.resize((size_t)C*nBins);
+		level.max.resize((size_t)C*nBins);
+		level.mean.resize((size_t)C*nBins);
+		level.representatives.resize(nBins);
+
+		pool.ParallelFor(0, C, [&](int nBegin, int nEnd, int nThread)
+		{
+			for (int c = nBegin; c < nEnd; c++)
+			{
+				float const *pMin = GetMin(l - 1, c), *pMax = GetMax(l - 1, c), *pMean = GetMean(l - 1, c);
+				float *pOutMin = &level.min[(size_t)c*nBins], *pOutMax = &level.max[(size_t)c*nBins];
+				float *pOutMean = &level.mean[(size_t)c*nBins];
+				for (int b = 0; b < nBins; b++)
+				{
+					int i = 2*b;
+					if (i + 1 < prev.numBins)
+					{
+						//the second half holds fewer frames only at the end of the motion
+						float w = (float)std::min(nHalf, n - (i + 1)*nHalf)/nHalf;
+						pOutMin[b] = std::min(pMin[i], pMin[i + 1]);
+						pOutMax[b] = std::max(pMax[i], pMax[i + 1]);
+						pOutMean[b] = (pMean[i] + w*pMean[i + 1])/(1 + w);
+					}
+					else
+					{
+						pOutMin[b] = pMin[i];
+						pOutMax[b] = pMax[i];
+						pOutMean[b] = pMean[i];
+					}
+				}
+			}
+		});
+
+		pool.ParallelFor(0, nBins, [&](int nBegin, int nEnd, int nThread)
+		{
+			for (int b = nBegin; b < nEnd; b++)
+			{
+				int nBest = GetRepresentative(l - 1, 2*b);
+				if (2*b + 1 < prev.numBins)
+				{
+					int nOther = GetRepresentative(l - 1, 2*b + 1);
+					float d0 = 0, d1 = 0;
+					for (int c = 0; c < C; c++)
+					{
+						float fMean = level.mean[(size_t)c*nBins + b];
+						float e0 = m_Values[(size_t)c*n + nBest] - fMean, e1 = m_Values[(size_t)c*n + nOther] - fMean;
+						d0 += weights[c]*e0*e0;
+						d1 += weights[c]*e1*e1;
+					}
+					if (d1 < d0)
+						nBest = nOther;
+				}
+				level.representatives[b] = nBest;
+			}
+		}, PYRAMID_CHUNK);
+	}
+	return 0;
+}
+
+int MotionPyramid::ChooseLevel(int nFrames, int nPixels) const
+{
+	int nPerPixel = nPixels > 0 ? nFrames/nPixels : nFrames, nLevel = 0;
+	while (nLevel + 1 < (int)m_Levels.size() && (2 << nLevel) <= nPerPixel)
+		nLevel++;
+	return nLevel;
+}
+
+int MotionPyramid::Summarize(int nChannel, int nFirst, int nLast, int nPixels, float *pMin, float *pMax, float *pMean) const
+{
+	nFirst = std::max(nFirst, 0);
+	nLast = std::min(nLast, m_NumFrames - 1);
+	if (m_NumFrames <= 0 || nFirst > nLast || nPixels <= 0)
+		return -1;
+	int nCount = nLast - nFirst + 1, nLevels = (int)m_Levels.size();
+	float const *mins[32], *maxs[32], *means[32];			// levels of an int number of frames
+	for (int l = 0; l < nLevels; l++)
+	{
+		mins[l] = GetMin(l, nChannel);
+		maxs[l] = GetMax(l, nChannel);
+		means[l] = GetMean(l, nChannel);
+	}
+
+	for (int p = 0; p < nPixels; p++)
+	{
+		//the frames of the pixel as the largest whole bins that fit, as in a segment tree
+		int a = nFirst + (int)((long long)p*nCount/nPixels);
+		int b = std::max(nFirst + (int)((long long)(p + 1)*nCount/nPixels) - 1, a);
+		float fMin = 0, fMax = 0;
+		double sum = 0;
+		for (int f = a; f <= b; )
+		{
+			int l = 0;
+			while (l + 1 < nLevels && (f & ((2 << l) - 1)) == 0 && f + (2 << l) - 1 <= b)
+				l++;
+			int k = f >> l;
+			fMin = f == a ? mins[l][k] : std::min(fMin, mins[l][k]);
+			fMax = f == a ? maxs[l][k] : std::max(fMax, maxs[l][k]);
+			sum += (double)means[l][k]*(1 << l);
+			f += 1 << l;
+		}
+		if (pMin != NULL)
+			pMin[p] = fMin;
+		if (pMax != NULL)
+			pMax[p] = fMax;
+		if (pMean != NULL)
+			pMean[p] = (float)(sum/(b - a + 1));
+	}
+	return 0;
+}
+
+int MotionPyramid::SummarizePoses(int nFirst, int nLast, int nPixels, int *pFrames) const
+{
+	nFirst = std::max(nFirst, 0);
+	nLast = std::min(nLast, m_NumFrames - 1);
+	if (m_NumFrames <= 0 || nFirst > nLast || nPixels <= 0)
+		return -1;
+	int nCount = nLast - nFirst + 1, nLevel = ChooseLevel(nCount, nPixels);
+	for (int p = 0; p < nPixels; p++)
+	{
+		//the bin in the middle of the pixel
+		int a = nFirst + (int)((long long)p*nCount/nPixels);
+		int b = std::max(nFirst + (int)((long long)(p + 1)*nCount/nPixels) - 1, a);
+		pFrames[p] = GetRepresentative(nLevel, ((a + b)/2) >> nLevel);
+	}
+	return nLevel;
+}
@@ -0,0 +1,84 @@
+/*
+	pyramid.h
+
+	Multi-resolution summary of a motion, like mipmaps in time: level l has one bin for every
+	2^l frames (the last bin of a level may hold fewer), level 0 being the frames themselves,
+	up to the level with a single bin. For every channel of the ChannelLayout a bin keeps the
+	smallest, largest and mean value of its frames, and every bin has a representative frame.
+
+	A level is built from the one below it: min of the mins, max of the maxes, mean weighted by
+	the frames of the two bins, so building costs about twice reading the motion once. The
+	representative of a bin is the representative of one of its two halves, the one closest to
+	the mean of the bin (distance over all channels, each divided by its standard deviation over
+	the motion), which at level 1 are the two frames themselves.
+
+	Summarize fills a timeline or a curve plot of any range of frames at any width: the frames of
+	a pixel are cut into the largest whole bins that fit (as in a segment tree), so the summary is
+	exact and reads at most two bins per level up to the frames of a pixel, whatever the length
+	of the range. SummarizePoses takes a representative frame per pixel from the coarsest level
+	that still has a bin for every pixel.
+
+	Motion::GetPyramid builds one for the motion on the first call.
+*/
+
+#ifndef _PYRAMID_H
+#define _PYRAMID_H
+
+#include <vector>
+
+#include "motion.h"
+#include "skeleton.h"
+#include "channels.h"
+
+class MotionPyramid
+{
+	//member functions
+	public:
+		MotionPyramid(Skeleton *pActor);
+		~MotionPyramid();
+
+		//All levels of the motion. Returns 0, -1 on error
+		int Build(Motion *pMotion);
+
+		ChannelLayout const& GetLayout() const { return m_Layout; }
+		int GetNumChannels() const { return m_Layout.m_NumChannels; }
+		int GetNumFrames() const { return m_NumFrames; }
+		int GetNumLevels() const { return (int)m_Levels.size(); }
+		int GetNumBins(int nLevel) const { return m_Levels[nLevel].numBins; }
+		//Frames of the bins of a level (but the last)
+		int GetReduction(int nLevel) const { return 1 << nLevel; }
+
+		//GetNumBins(nLevel) floats; at level 0 all three are the values of the channel
+		float const *GetMin(int nLevel, int nChannel) const;
+		float const *GetMax(int nLevel, int nChannel) const;
+		float const *GetMean(int nLevel, int nChannel) const;
+		//Frame standing for bin nBin of level nLevel
+		int GetRepresentative(int nLevel, int nBin) const { return nLevel == 0 ? nBin : m_Levels[nLevel].representatives[nBin]; }
+
+		//Coarsest level with at least one bin for every nPixels-th part of nFrames frames
+		int ChooseLevel(int nFrames, int nPixels) const;
+		//Min, max and mean of channel nChannel for nPixels pixels spread evenly over frames
+		//nFirst .. nLast. Any of pMin, pMax, pMean may be NULL. Returns 0, -1 on error
+		int Summarize(int nChannel, int nFirst, int nLast, int nPixels, float *pMin, float *pMax, float *pMean) const;
+		//Representative frames of the pixels. Returns the level read, -1 on error
+		int SummarizePoses(int nFirst, int nLast, int nPixels, int *pFrames) const;
+
+		//Bytes held by the levels above 0
+		size_t GetMemory() const;
+
+	//member variables
+	private:
+		struct Level
+		{
+			int numBins;
+			std::vector<float> min, max, mean;		// channel by channel, numBins floats each
+			std::vector<int> representatives;
+		};
+
+		ChannelLayout m_Layout;
+		int m_NumFrames;
+		std::vector<float> m_Values;				// level 0: channel by channel, m_NumFrames floats each
+		std::vector<Level> m_Levels;				// level 0 has no values of its own
+};
+
+#endif
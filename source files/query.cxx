@@ -0,0 +1,660 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <cmath>
+#include <algorithm>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define QUERY_SIMD_WIDTH 8
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define QUERY_SIMD_WIDTH 4
+#else
+#define QUERY_SIMD_WIDTH 1
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "query.h"
+#include "channels.h"
+#include "kinematics.h"
+#include "contacts.h"
+#include "threadpool.h"
+
+#define QUERY_WORDS (QUERY_BLOCK/64)
+
+static char const *derivedNames[7] = { "px", "py", "pz", "vx", "vy", "vz", "speed" };
+
+
+/************************ Scans **********************************/
+
+static inline int count_trailing_zeros(unsigned long long x)
+{
+#ifdef _MSC_VER
+	unsigned long n;
+	_BitScanForward64(&n, x);
+	return (int)n;
+#else
+	return __builtin_ctzll(x);
+#endif
+}
+
+//Bits of the QUERY_BLOCK frames of a - b (b may be NULL) compared with c: x < y, or x <= y with
+//bEqual, where x is the value and y the constant, or the other way round with bSwap
+template <bool bSwap, bool bEqual> static void scan_block(float const *a, float const *b, float c, unsigned long long *pBits)
+{
+	for (int w = 0; w < QUERY_WORDS; w++, a += 64, b = b != NULL ? b + 64 : NULL)
+	{
+		unsigned long long bits = 0;
+#if QUERY_SIMD_WIDTH == 8
+		__m256 vc = _mm256_set1_ps(c);
+		for (int i = 0; i < 64; i += 8)
+		{
+			__m256 v = _mm256_loadu_ps(a + i);
+			if (b != NULL)
+				v = _mm256_sub_ps(v, _mm256_loadu_ps(b + i));
+			__m256 m = _mm256_cmp_ps(bSwap ? vc : v, bSwap ? v : vc, bEqual ? _CMP_LE_OQ : _CMP_LT_OQ);
+			bits |= (unsigned long long)_mm256_movemask_ps(m) << i;
+		}
+#elif QUERY_SIMD_WIDTH == 4
+		__m128 vc = _mm_set1_ps(c);
+		for (int i = 0; i < 64; i += 4)
+		{
+			__m128 v = _mm_loadu_ps(a + i);
+			if (b != NULL)
+				v = _mm_sub_ps(v, _mm_loadu_ps(b + i));
+			__m128 x = bSwap ? vc : v, y = bSwap ? v : vc;
+			__m128 m = bEqual ? _mm_cmple_ps(x, y) : _mm_cmplt_ps(x, y);
+			bits |= (unsigned long long)_mm_movemask_ps(m) << i;
+		}
+#else
+		for (int i = 0; i < 64; i++)
+		{
+			float v = b != NULL ? a[i] - b[i] : a[i];
+			float x = bSwap ? c : v, y = bSwap ? v : c;
+			if (bEqual ? x <= y : x < y)
+				bits |= 1ULL << i;
+		}
+#endif
+		pBits[w] = bits;
+	}
+}
+
+static void scan_block(float const *a, float const *b, float c, QueryRelation relation, unsigned long long *pBits)
+{
+	switch (relation)
+	{
+		case QUERY_LESS: scan_block<false, false>(a, b, c, pBits); break;
+		case QUERY_LESS_EQUAL: scan_block<false, true>(a, b, c, pBits); break;
+		case QUERY_GREATER: scan_block<true, false>(a, b, c, pBits); break;
+		case QUERY_GREATER_EQUAL: scan_block<true, true>(a, b, c, pBits); break;
+	}
+}
+
+static bool compare(float v, QueryRelation relation, float c)
+{
+	switch (relation)
+	{
+		case QUERY_LESS: return v < c;
+		case QUERY_LESS_EQUAL: return v <= c;
+		case QUERY_GREATER: return v > c;
+		case QUERY_GREATER_EQUAL: default: return v >= c;
+	}
+}
+
+//Bits of the first nFrames frames of a block
+static void block_mask(int nFrames, unsigned long long *pMask)
+{
+	for (int w = 0; w < QUERY_WORDS; w++)
+	{
+		int n = nFrames - w*64;
+		pMask[w] = n >= 64 ? ~0ULL : n > 0 ? (1ULL << n) - 1 : 0;
+	}
+}
+
+//Append the runs of set bits of nWords words, frame 0 in bit 0 of word 0
+static void append_ranges(int nClip, unsigned long long const *pBits, int nWords, std::vector<FrameRange> &ranges)
+{
+	int nStart = -1;
+	for (int w = 0; w < nWords; w++)
+	{
+		unsigned long long x = pBits[w];
+		int nBit = 0;
+		while (nBit < 64)
+		{
+			//skip to the next bit that differs from the current state
+			unsigned long long y = (nStart < 0 ? x : ~x) >> nBit;
+			if (y == 0)
+				break;
+			nBit += count_trailing_zeros(y);
+			if (nStart < 0)
+				nStart = w*64 + nBit;
+			else
+			{
+				FrameRange range = { nClip, nStart, w*64 + nBit - 1 };
+				ranges.push_back(range);
+				nStart = -1;
+			}
+		}
+	}
+	if (nStart >= 0)
+	{
+		FrameRange range = { nClip, nStart, nWords*64 - 1 };
+		ranges.push_back(range);
+	}
+}
+
+
+/************************ MotionQuery class functions **********************************/
+MotionQuery::MotionQuery()
+{
+	m_Root = -1;
+	m_pExpression = NULL;
+	m_Depth = 0;
+}
+
+MotionQuery::~MotionQuery()
+{
+}
+
+static void skip_space(char const *&p)
+{
+	while (isspace((unsigned char)*p))
+		p++;
+}
+
+void MotionQuery::Fail(char const *pMessage, char const *p)
+{
+	if (!m_Error.empty())
+		return;
+	char str[64];
+	sprintf(str, " at character %d", (int)(p - m_pExpression) + 1);
+	m_Error = std::string(pMessage) + str;
+}
+
+int MotionQuery::AddNode(QueryNode const& node)
+{
+	if ((int)m_Nodes.size() >= QUERY_MAX_NODES)
+		return -1;
+	m_Nodes.push_back(node);
+	return (int)m_Nodes.size() - 1;
+}
+
+int MotionQuery::Compile(char const *pExpression, MotionLibrary const& library)
+{
+	m_Nodes.clear();
+	m_Error.clear();
+	m_pExpression = pExpression;
+	m_Depth = 0;
+	char const *p = pExpression;
+	m_Root = ParseOr(p, library);
+	skip_space(p);
+	if (m_Root >= 0 && *p != '\0')
+	{
+		Fail("unexpected text", p);
+		m_Root = -1;
+	}
+	if (m_Root < 0)
+	{
+		m_Nodes.clear();
+		if (m_Error.empty())
+			m_Error = "expression too long";
+		return -1;
+	}
+	return 0;
+}
+
+int MotionQuery::ParseOr(char const *&p, MotionLibrary const& library)
+{
+	int nLeft = ParseAnd(p, library);
+	skip_space(p);
+	while (nLeft >= 0 && p[0] == '|' && p[1] == '|')
+	{
+		p += 2;
+		int nRight = ParseAnd(p, library);
+		if (nRight < 0)
+			return -1;
+		QueryNode node = { QUERY_OR, nLeft, nRight, { -1, -1 }, QUERY_LESS, 0 };
+		nLeft = AddNode(node);
+		skip_space(p);
+	}
+	return nLeft;
+}
+
+int MotionQuery::ParseAnd(char const *&p, MotionLibrary const& library)
+{
+	int nLeft = ParseUnary(p, library);
+	skip_space(p);
+	while (nLeft >= 0 && p[0] == '&' && p[1] == '&')
+	{
+		p += 2;
+		int nRight = ParseUnary(p, library);
+		if (nRight < 0)
+			return -1;
+		QueryNode node = { QUERY_AND, nLeft, nRight, { -1, -1 }, QUERY_LESS, 0 };
+		nLeft = AddNode(node);
+		skip_space(p);
+	}
+	return nLeft;
+}
+
+int MotionQuery::ParseUnary(char const *&p, MotionLibrary const& library)
+{
+	skip_space(p);
+	if ((*p == '!' || *p == '(') && m_Depth >= QUERY_MAX_DEPTH)
+	{
+		Fail("expression nested too deeply", p);
+		return -1;
+	}
+	if (*p == '!')
+	{
+		p++;
+		m_Depth++;
+		int nChild = ParseUnary(p, library);
+		m_Depth--;
+		if (nChild < 0)
+			return -1;
+		QueryNode node = { QUERY_NOT, nChild, -1, { -1, -1 }, QUERY_LESS, 0 };
+		return AddNode(node);
+	}
+	if (*p == '(')
+	{
+		p++;
+		m_Depth++;
+		int nChild = ParseOr(p, library);
+		m_Depth--;
+		skip_space(p);
+		if (nChild < 0)
+			return -1;
+		if (*p != ')')
+		{
+			Fail("missing ')'", p);
+			return -1;
+		}
+		p++;
+		return nChild;
+	}
+
+	//comparison: column + a rel column + b, either side a column, a number or both
+	int nLeft, nRight;
+	float fLeft, fRight;
+	if (ParseOperand(p, library, nLeft, fLeft) != 0)
+		return -1;
+	skip_space(p);
+	QueryRelation relation;
+	if (p[0] == '<')
+		relation = p[1] == '=' ? QUERY_LESS_EQUAL : QUERY_LESS;
+	else if (p[0] == '>')
+		relation = p[1] == '=' ? QUERY_GREATER_EQUAL : QUERY_GREATER;
+	else
+	{
+		Fail("expected < <= > or >=", p);
+		return -1;
+	}
+	p += relation == QUERY_LESS_EQUAL || relation == QUERY_GREATER_EQUAL ? 2 : 1;
+	if (ParseOperand(p, library, nRight, fRight) != 0)
+		return -1;
+
+	QueryNode node = { QUERY_COMPARE, -1, -1, { nLeft, nRight }, relation, fRight - fLeft };
+	if (nLeft < 0 && nRight < 0)
+	{
+		node.op = compare(fLeft, relation, fRight) ? QUERY_TRUE : QUERY_FALSE;
+		node.columns[1] = -1;
+	}
+	else if (nLeft < 0)
+	{
+		//a rel column + b is column rel' a - b
+		static QueryRelation const flipped[4] = { QUERY_GREATER, QUERY_GREATER_EQUAL, QUERY_LESS, QUERY_LESS_EQUAL };
+		node.columns[0] = nRight;
+		node.columns[1] = -1;
+		node.relation = flipped[relation];
+		node.constant = fLeft - fRight;
+	}
+	return AddNode(node);
+}
+
+int MotionQuery::ParseOperand(char const *&p, MotionLibrary const& library, int &nColumn, float &fConstant)
+{
+	skip_space(p);
+	nColumn = -1;
+	fConstant = 0;
+	if (isdigit((unsigned char)*p) || *p == '.' || ((*p == '-' || *p == '+') && (isdigit((unsigned char)p[1]) || p[1] == '.')))
+	{
+		char *pEnd;
+		fConstant = strtof(p, &pEnd);
+		p = pEnd;
+		return 0;
+	}
+
+	char const *pStart = p;
+	while (isalnum((unsigned char)*p) || *p == '_' || *p == '.')
+		p++;
+	if (p == pStart)
+	{
+		Fail("expected a column or a number", p);
+		return -1;
+	}
+	std::string name(pStart, p - pStart);
+	nColumn = library.FindColumn(name.c_str());
+	if (nColumn < 0)
+	{
+		Fail(("unknown column '" + name + "'").c_str(), pStart);
+		return -1;
+	}
+
+	//column + number or column - number
+	skip_space(p);
+	if ((*p == '+' || *p == '-') && p[1] != '\0')
+	{
+		char const *q = p + 1;
+		skip_space(q);
+		char *pEnd;
+		float f = strtof(q, &pEnd);
+		if (pEnd == q)
+		{
+			Fail("expected a number", q);
+			return -1;
+		}
+		fConstant = *p == '-' ? -f : f;
+		p = pEnd;
+	}
+	return 0;
+}
+
+
+/************************ MotionLibrary class functions **********************************/
+MotionLibrary::MotionLibrary()
+{
+}
+
+MotionLibrary::~MotionLibrary()
+{
+}
+
+int MotionLibrary::FindColumn(char const *pName) const
+{
+	for (int c = 0; c < (int)m_ColumnNames.size(); c++)
+		if (m_ColumnNames[c] == pName)
+			return c;
+	return -1;
+}
+
+float const *MotionLibrary::GetColumn(int nClip, int nColumn) const
+{
+	Clip const& clip = m_Clips[nClip];
+	return &clip.values[(size_t)nColumn*clip.numBlocks*QUERY_BLOCK];
+}
+
+int MotionLibrary::AddClip(char const *pName, Motion *pMotion)
+{
+	if (pMotion == NULL || pMotion->pActor == NULL || pMotion->m_NumFrames <= 0)
+		return -1;
+	MotionKinematics const *pKinematics = pMotion->GetKinematics();
+	if (pKinematics == NULL)
+		return -1;
+	FootContacts const *pContacts = pMotion->GetContacts();
+
+	//the columns: degrees of freedom, then position, velocity and speed of every bone, then contacts
+	Skeleton *pActor = pMotion->pActor;
+	Bone *pBones = pActor->getRoot();
+	ChannelLayout layout(pActor);
+	ContactDetector detector(pActor);
+	int nBones = pKinematics->GetNumBones();
+	std::vector<std::string> names;
+	char str[256];
+	for (int c = 0; c < layout.m_NumChannels; c++)
+	{
+		layout.GetName(c, str);
+		names.push_back(str);
+	}
+	for (int b = 0; b < nBones; b++)
+		for (int d = 0; d < 7; d++)
+			names.push_back(std::string(pBones[b].name) + "." + derivedNames[d]);
+	int nContacts = 0, contactJoints[NUM_CONTACT_JOINTS];
+	for (int j = 0; j < NUM_CONTACT_JOINTS; j++)
+		if (detector.GetBone(j) >= 0)
+		{
+			contactJoints[nContacts++] = j;
+			names.push_back(std::string(pBones[detector.GetBone(j)].name) + ".contact");
+		}
+	if (m_Clips.empty())
+		m_ColumnNames = names;
+	else if (names != m_ColumnNames)
+	{
+		printf("MotionLibrary: '%s' has other columns than the first clip\n", pName);
+		return -1;
+	}
+
+	int nColumns = (int)names.size(), nFrames = pMotion->m_NumFrames;
+	m_Clips.push_back(Clip());
+	Clip &clip = m_Clips.back();
+	clip.name = pName;
+	clip.numFrames = nFrames;
+	clip.numBlocks = (nFrames + QUERY_BLOCK - 1)/QUERY_BLOCK;
+	size_t nStride = (size_t)clip.numBlocks*QUERY_BLOCK;
+	clip.values.assign(nColumns*nStride, 0.0f);
+	clip.zones.resize((size_t)nColumns*clip.numBlocks*2);
+
+	std::vector<float> row(layout.m_NumChannels);
+	int nDerived = layout.m_NumChannels;
+	for (int f = 0; f < nFrames; f++)
+	{
+		layout.Gather(pMotion->m_pPostures[f], row.data());
+		for (int c = 0; c < layout.m_NumChannels; c++)
+			clip.values[c*nStride + f] = row[c];
+		for (int b = 0; b < nBones; b++)
+		{
+			float const *p = pKinematics->GetPosition(f, b), *v = pKinematics->GetVelocity(f, b);
+			float *pColumns = &clip.values[(nDerived + b*7)*nStride + f];
+			for (int i = 0; i < 3; i++)
+			{
+				pColumns[i*nStride] = p[i];
+				pColumns[(3 + i)*nStride] = v[i];
+			}
+			pColumns[6*nStride] = sqrtf(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+		}
+		for (int j = 0; j < nContacts && pContacts != NULL; j++)
+			clip.values[(nDerived + nBones*7 + j)*nStride + f] = pContacts->IsContact(f, contactJoints[j]) ? 1.0f : 0.0f;
+	}
+
+	//zone maps, over the frames of the clip only
+	for (int c = 0; c < nColumns; c++)
+		for (int k = 0; k < clip.numBlocks; k++)
+		{
+			float const *pValues = &clip.values[c*nStride + (size_t)k*QUERY_BLOCK];
+			int n = std::min(QUERY_BLOCK, nFrames - k*QUERY_BLOCK);
+			float fMin = pValues[0], fMax = pValues[0];
+			for (int f = 1; f < n; f++)
+			{
+				fMin = std::min(fMin, pValues[f]);
+				fMax = std::max(fMax, pValues[f]);
+			}
+			clip.zones[((size_t)c*clip.numBlocks + k)*2] = fMin;
+			clip.zones[((size_t)c*clip.numBlocks + k)*2 + 1] = fMax;
+		}
+	return (int)m_Clips.size() - 1;
+}
+
+void MotionLibrary::EvaluateBlock(MotionQuery const& query, int nNode, int nClip, int nBlock, unsigned long long *pBits,
+	QueryStats &stats) const
+{
+	QueryNode const& node = query.GetNode(nNode);
+	Clip const& clip = m_Clips[nClip];
+	unsigned long long mask[QUERY_WORDS], right[QUERY_WORDS];
+	block_mask(clip.numFrames - nBlock*QUERY_BLOCK, mask);
+	bool bNone = true, bAll = true;
+
+	switch (node.op)
+	{
+		case QUERY_TRUE:
+			memcpy(pBits, mask, sizeof(mask));
+			break;
+		case QUERY_FALSE:
+			memset(pBits, 0, sizeof(mask));
+			break;
+		case QUERY_NOT:
+			EvaluateBlock(query, node.left, nClip, nBlock, pBits, stats);
+			for (int w = 0; w < QUERY_WORDS; w++)
+				pBits[w] = ~pBits[w] & mask[w];
+			break;
+		case QUERY_AND:
+			EvaluateBlock(query, node.left, nClip, nBlock, pBits, stats);
+			for (int w = 0; w < QUERY_WORDS; w++)
+				bNone = bNone && pBits[w] == 0;
+			if (bNone)
+			{
+				stats.shortCircuited++;
+				break;
+			}
+			EvaluateBlock(query, node.right, nClip, nBlock, right, stats);
+			for (int w = 0; w < QUERY_WORDS; w++)
+				pBits[w] &= right[w];
+			break;
+		case QUERY_OR:
+			EvaluateBlock(query, node.left, nClip, nBlock, pBits, stats);
+			for (int w = 0; w < QUERY_WORDS; w++)
+				bAll = bAll && pBits[w] == mask[w];
+			if (bAll)
+			{
+				stats.shortCircuited++;
+				break;
+			}
+			EvaluateBlock(query, node.right, nClip, nBlock, right, stats);
+			for (int w = 0; w < QUERY_WORDS; w++)
+				pBits[w] |= right[w];
+			break;
+		case QUERY_COMPARE:
+		{
+			//the range of a - b over the block, from the zone maps
+			stats.leafBlocks++;
+			float const *pZone = &clip.zones[((size_t)node.columns[0]*clip.numBlocks + nBlock)*2];
+			float fLow = pZone[0], fHigh = pZone[1];
+			if (node.columns[1] >= 0)
+			{
+				float const *pOther = &clip.zones[((size_t)node.columns[1]*clip.numBlocks + nBlock)*2];
+				fLow = pZone[0] - pOther[1];
+				fHigh = pZone[1] - pOther[0];
+			}
+			float c = node.constant;
+			switch (node.relation)
+			{
+				case QUERY_LESS: bAll = fHigh < c; bNone = fLow >= c; break;
+				case QUERY_LESS_EQUAL: bAll = fHigh <= c; bNone = fLow > c; break;
+				case QUERY_GREATER: bAll = fLow > c; bNone = fHigh <= c; break;
+				case QUERY_GREATER_EQUAL: bAll = fLow >= c; bNone = fHigh < c; break;
+			}
+			if (bAll || bNone)
+			{
+				stats.zoneSkipped++;
+				if (bAll)
+					memcpy(pBits, mask, sizeof(mask));
+				else
+					memset(pBits, 0, sizeof(mask));
+				break;
+			}
+			size_t nOffset = (size_t)nBlock*QUERY_BLOCK;
+			float const *a = GetColumn(nClip, node.columns[0]) + nOffset;
+			float const *b = node.columns[1] >= 0 ? GetColumn(nClip, node.columns[1]) + nOffset : NULL;
+			scan_block(a, b, c, node.relation, pBits);
+			for (int w = 0; w < QUERY_WORDS; w++)
+				pBits[w] &= mask[w];
+			break;
+		}
+	}
+}
+
+bool MotionLibrary::EvaluateFrame(MotionQuery const& query, int nNode, Clip const& clip, int nFrame) const
+{
+	QueryNode const& node = query.GetNode(nNode);
+	size_t nStride = (size_t)clip.numBlocks*QUERY_BLOCK;
+	switch (node.op)
+	{
+		case QUERY_TRUE: return true;
+		case QUERY_FALSE: return false;
+		case QUERY_NOT: return !EvaluateFrame(query, node.left, clip, nFrame);
+		case QUERY_AND: return EvaluateFrame(query, node.left, clip, nFrame) && EvaluateFrame(query, node.right, clip, nFrame);
+		case QUERY_OR: return EvaluateFrame(query, node.left, clip, nFrame) || EvaluateFrame(query, node.right, clip, nFrame);
+		case QUERY_COMPARE: default:
+		{
+			float v = clip.values[node.columns[0]*nStride + nFrame];
+			if (node.columns[1] >= 0)
+				v -= clip.values[node.columns[1]*nStride + nFrame];
+			return compare(v, node.relation, node.constant);
+		}
+	}
+}
+
+int MotionLibrary::Run(MotionQuery const& query, std::vector<FrameRange> &ranges, QueryStats *pStats) const
+{
+	ranges.clear();
+	int nClips = (int)m_Clips.size();
+	if (query.GetRoot() < 0 || nClips == 0)
+		return 0;
+
+	//the blocks of all clips, one after the other
+	std::vector<int> firstBlocks(nClips + 1, 0);
+	for (int i = 0; i < nClips; i++)
+		firstBlocks[i + 1] = firstBlocks[i] + m_Clips[i].numBlocks;
+	std::vector<unsigned long long> bits((size_t)firstBlocks[nClips]*QUERY_WORDS);
+	ThreadPool& pool = ThreadPool::GetDefault();
+	std::vector<QueryStats> threadStats(pool.GetNumThreads());
+	memset(threadStats.data(), 0, threadStats.size()*sizeof(QueryStats));
+
+	pool.ParallelFor(0, firstBlocks[nClips], [&](int nBegin, int nEnd, int nThread)
+	{
+		int nClip = (int)(std::upper_bound(firstBlocks.begin(), firstBlocks.end(), nBegin) - firstBlocks.begin()) - 1;
+		for (int k = nBegin; k < nEnd; k++)
+		{
+			while (k >= firstBlocks[nClip + 1])
+				nClip++;
+			EvaluateBlock(query, query.GetRoot(), nClip, k - firstBlocks[nClip], &bits[(size_t)k*QUERY_WORDS],
+				threadStats[nThread]);
+		}
+	}, 16);
+
+	for (int i = 0; i < nClips; i++)
+		append_ranges(i, &bits[(size_t)firstBlocks[i]*QUERY_WORDS], m_Clips[i].numBlocks*QUERY_WORDS, ranges);
+
+	if (pStats != NULL)
+	{
+		memset(pStats, 0, sizeof(QueryStats));
+		pStats->blocks = firstBlocks[nClips];
+		for (int t = 0; t < (int)threadStats.size(); t++)
+		{
+			pStats->leafBlocks += threadStats[t].leafBlocks;
+			pStats->zoneSkipped += threadStats[t].zoneSkipped;
+			pStats->shortCircuited += threadStats[t].shortCircuited;
+		}
+		for (int r = 0; r < (int)ranges.size(); r++)
+			pStats->matchingFrames += ranges[r].last - ranges[r].first + 1;
+	}
+	return (int)ranges.size();
+}
+
+int MotionLibrary::RunScalar(MotionQuery const& query, std::vector<FrameRange> &ranges) const
+{
+	ranges.clear();
+	if (query.GetRoot() < 0)
+		return 0;
+	for (int i = 0; i < (int)m_Clips.size(); i++)
+	{
+		int nStart = -1;
+		for (int f = 0; f <= m_Clips[i].numFrames; f++)
+		{
+			bool bMatch = f < m_Clips[i].numFrames && EvaluateFrame(query, query.GetRoot(), m_Clips[i], f);
+			if (bMatch && nStart < 0)
+				nStart = f;
+			else if (!bMatch && nStart >= 0)
+			{
+				FrameRange range = { i, nStart, f - 1 };
+				ranges.push_back(range);
+				nStart = -1;
+			}
+		}
+	}
+	return (int)ranges.size();
+}
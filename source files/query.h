@@ -0,0 +1,161 @@
+/*
+	query.h
+
+	Queries over a library of motions, such as "frames where rhand is above head and the root is
+	slower than 0.5 units/s":
+
+		rhand.py > head.py && root.speed < 0.5
+
+	Every clip added to a MotionLibrary is kept as columns, one float per frame:
+		<bone>.rx ry rz tx ty tz   the degrees of freedom of the AMC file (see channels.h), root.tx
+		                           .. root.tz being the root position
+		<bone>.px py pz            world position of the end point of the bone (see kinematics.h)
+		<bone>.vx vy vz            its velocity, units per second
+		<bone>.speed               the length of the velocity
+		<bone>.contact             1 while the joint touches the ground, for lfoot, rfoot, ltoes and
+		                           rtoes (see contacts.h), 0 otherwise
+	and for every block of QUERY_BLOCK frames of a column its smallest and largest value (zone map).
+
+	An expression compares columns and numbers with < <= > >=, where each side is a number, a
+	column or a column plus or minus a number; comparisons combine with && || ! and parentheses.
+	MotionQuery compiles it into a tree whose leaves are "a - b rel c" (b and c optional), of at
+	most QUERY_MAX_NODES nodes, with ! and parentheses nested at most QUERY_MAX_DEPTH deep.
+
+	Run evaluates the query block by block, the blocks of all clips spread over the thread pool.
+	A leaf first looks at the zone maps of its columns: when no frame of the block can match (or
+	every frame must), the block is decided without reading the column. Otherwise the column is
+	scanned with SSE or AVX compares into a bitmap, one bit per frame. && and || skip their right
+	side when the left one already decides the block. The bitmaps of every clip are turned into
+	runs of matching frames.
+*/
+
+#ifndef _QUERY_H
+#define _QUERY_H
+
+#include <string>
+#include <vector>
+
+#include "motion.h"
+#include "skeleton.h"
+
+#define QUERY_BLOCK 256					// frames of a zone map entry and of a scan, a multiple of 64
+#define QUERY_MAX_NODES 256
+#define QUERY_MAX_DEPTH 64				// nesting of ! and ( in an expression
+
+//A run of matching frames of a clip
+struct FrameRange
+{
+	int clip;
+	int first, last;					// 0-based frames, both included
+};
+
+enum QueryRelation
+{
+	QUERY_LESS = 0, QUERY_LESS_EQUAL, QUERY_GREATER, QUERY_GREATER_EQUAL
+};
+
+enum QueryOp
+{
+	QUERY_COMPARE = 0, QUERY_AND, QUERY_OR, QUERY_NOT, QUERY_TRUE, QUERY_FALSE
+};
+
+struct QueryNode
+{
+	QueryOp op;
+	int left, right;					// child nodes of AND, OR (both) and NOT (left)
+	int columns[2];						// COMPARE: columns[0] - columns[1] rel constant, -1 if not there
+	QueryRelation relation;
+	float constant;
+};
+
+//Counts of the last Run
+struct QueryStats
+{
+	long long blocks;					// blocks of all clips
+	long long leafBlocks;				// comparisons of a leaf with a block
+	long long zoneSkipped;				// of those decided by the zone maps
+	long long shortCircuited;			// right sides of && and || that were not evaluated
+	long long matchingFrames;
+};
+
+class MotionLibrary;
+
+class MotionQuery
+{
+	//member functions
+	public:
+		MotionQuery();
+		~MotionQuery();
+
+		//Parse pExpression against the columns of library. Returns 0, -1 on error (see GetError)
+		int Compile(char const *pExpression, MotionLibrary const& library);
+		char const *GetError() const { return m_Error.c_str(); }
+
+		int GetNumNodes() const { return (int)m_Nodes.size(); }
+		QueryNode const& GetNode(int nNode) const { return m_Nodes[nNode]; }
+		int GetRoot() const { return m_Root; }
+
+	private:
+		int ParseOr(char const *&p, MotionLibrary const& library);
+		int ParseAnd(char const *&p, MotionLibrary const& library);
+		int ParseUnary(char const *&p, MotionLibrary const& library);
+		int ParseOperand(char const *&p, MotionLibrary const& library, int &nColumn, float &fConstant);
+		int AddNode(QueryNode const& node);
+		void Fail(char const *pMessage, char const *p);
+
+	//member variables
+	private:
+		std::vector<QueryNode> m_Nodes;
+		int m_Root;
+		std::string m_Error;
+		char const *m_pExpression;
+		int m_Depth;						// ! and ( the parser is in
+};
+
+class MotionLibrary
+{
+	//member functions
+	public:
+		MotionLibrary();
+		~MotionLibrary();
+
+		//Add the columns of a motion (all clips must be of the same skeleton, the first one
+		//gives the column names). The motion is not kept. Returns the clip number, -1 on error
+		int AddClip(char const *pName, Motion *pMotion);
+
+		int GetNumClips() const { return (int)m_Clips.size(); }
+		char const *GetClipName(int nClip) const { return m_Clips[nClip].name.c_str(); }
+		int GetClipFrames(int nClip) const { return m_Clips[nClip].numFrames; }
+		int GetNumColumns() const { return (int)m_ColumnNames.size(); }
+		char const *GetColumnName(int nColumn) const { return m_ColumnNames[nColumn].c_str(); }
+		//-1 if there is no such column
+		int FindColumn(char const *pName) const;
+		//The values of a column of a clip, GetClipFrames floats
+		float const *GetColumn(int nClip, int nColumn) const;
+
+		//Runs of frames matching query, clip by clip, in frame order. Returns their number
+		int Run(MotionQuery const& query, std::vector<FrameRange> &ranges, QueryStats *pStats = NULL) const;
+		//The same by testing every frame of every clip, one by one
+		int RunScalar(MotionQuery const& query, std::vector<FrameRange> &ranges) const;
+
+	private:
+		struct Clip
+		{
+			std::string name;
+			int numFrames, numBlocks;
+			std::vector<float> values;		// column by column, numBlocks*QUERY_BLOCK floats each
+			std::vector<float> zones;		// column by column, min and max of every block
+		};
+
+		//Bits of frames block*QUERY_BLOCK .. of a clip matching node into pBits (QUERY_BLOCK/64 words)
+		void EvaluateBlock(MotionQuery const& query, int nNode, int nClip, int nBlock, unsigned long long *pBits,
+			QueryStats &stats) const;
+		bool EvaluateFrame(MotionQuery const& query, int nNode, Clip const& clip, int nFrame) const;
+
+	//member variables
+	private:
+		std::vector<std::string> m_ColumnNames;
+		std::vector<Clip> m_Clips;
+};
+
+#endif
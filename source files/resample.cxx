@@ -0,0 +1,175 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "resample.h"
+#include "threadpool.h"
+
+
+/************************ MotionResampler class functions **********************************/
+MotionResampler::MotionResampler(Skeleton *pActor, float fInRate, float fOutRate, int nHalfWidth) :
+	m_Layout(pActor), m_Features(&m_Layout)
+{
+	m_pActor = pActor;
+	m_InRate = fInRate;
+
+	//L/M: the first (smallest) exact fraction, else the closest one
+	double ratio = (double)fOutRate/fInRate, best = 1e30;
+	m_Up = m_Down = 1;
+	for (int m = 1; m <= RESAMPLE_MAX_FACTOR; m++)
+	{
+		int l = std::max(1, (int)floor(ratio*m + 0.5));
+		double err = fabs((double)l/m - ratio);
+		if (err < best)
+		{
+			best = err;
+			m_Up = l;
+			m_Down = m;
+		}
+		if (err <= 1e-6*ratio)
+			break;
+	}
+
+	//windowed sinc at the lower of the two Nyquist rates, one set of 2R taps per phase
+	double scale = std::min(1.0, (double)m_Up/m_Down);
+	m_HalfWidth = std::max(1, (int)ceil(std::max(1, nHalfWidth)/scale));
+	int R = m_HalfWidth;
+	m_Taps.resize((size_t)m_Up*2*R);
+	for (int p = 0; p < m_Up; p++)
+	{
+		float *pTaps = &m_Taps[(size_t)p*2*R];
+		double sum = 0;
+		for (int k = 0; k < 2*R; k++)
+		{
+			double d = (double)p/m_Up + (R - 1 - k);		// from input frame base-R+1+k to the output time
+			double x = M_PI*scale*d, w = d/R;
+			double sinc = fabs(x) < 1e-9 ? 1.0 : sin(x)/x;
+			double window = fabs(w) < 1 ? 0.42 + 0.5*cos(M_PI*w) + 0.08*cos(2*M_PI*w) : 0.0;
+			pTaps[k] = (float)(scale*sinc*window);
+			sum += pTaps[k];
+		}
+		for (int k = 0; k < 2*R; k++)
+			pTaps[k] = (float)(pTaps[k]/sum);
+	}
+
+	Reset();
+}
+
+MotionResampler::~MotionResampler()
+{
+}
+
+void MotionResampler::FromFeatures(float const *pRow, Posture const& templ, Posture *pPosture) const
+{
+	float values[MAX_CHANNELS];
+	m_Features.FromFeatures(pRow, values);
+	for (int c = 0; c < m_Layout.m_NumChannels; c++)
+		if (m_Layout.IsAngle(c))
+			values[c] -= 360.0f*floorf((values[c] + 180.0f)/360.0f);
+	*pPosture = templ;
+	m_Layout.Scatter(values, *pPosture);
+}
+
+template <class Rows> void MotionResampler::Filter(long long n, Rows const& rows, int nLast, float *pOut) const
+{
+	long long t = n*m_Down;
+	int nBase = (int)(t/m_Up), R = m_HalfWidth, F = m_Features.m_NumFeatures;
+	float const *pTaps = &m_Taps[(size_t)(t % m_Up)*2*R];
+
+	for (int f = 0; f < F; f++)
+		pOut[f] = 0;
+	for (int k = 0; k < 2*R; k++)
+	{
+		float w = pTaps[k];
+		float const *pRow = rows(std::min(std::max(nBase - R + 1 + k, 0), nLast));
+		for (int f = 0; f < F; f++)
+			pOut[f] += w*pRow[f];
+	}
+}
+
+void MotionResampler::Reset()
+{
+	m_NumIn = 0;
+	m_NumOut = 0;
+	m_Ring.assign((size_t)(2*m_HalfWidth + 2)*m_Features.m_NumFeatures, 0.0f);
+}
+
+int MotionResampler::Push(Posture const& in, std::vector<Posture> &out)
+{
+	int nSize = 2*m_HalfWidth + 2, F = m_Features.m_NumFeatures;
+	auto rows = [&](int j) { return &m_Ring[(size_t)(j % nSize)*F]; };
+
+	float *pRow = rows(m_NumIn);
+	m_Features.ToFeatures(in, pRow);
+	if (m_NumIn == 0)
+		m_Template = in;
+	else
+		m_Features.MakeContinuous(pRow, rows(m_NumIn - 1));
+	int nLast = m_NumIn++;
+
+	//output frames whose last input frame has arrived
+	int nCount = 0;
+	float row[MAX_CHANNELS + MAX_BONES_IN_ASF_FILE];
+	while (m_NumOut*m_Down/m_Up + m_HalfWidth <= nLast)
+	{
+		Filter(m_NumOut++, rows, nLast, row);
+		out.push_back(m_Template);
+		FromFeatures(row, m_Template, &out.back());
+		nCount++;
+	}
+	return nCount;
+}
+
+int MotionResampler::Flush(std::vector<Posture> &out)
+{
+	if (m_NumIn == 0)
+		return 0;
+	int nSize = 2*m_HalfWidth + 2, F = m_Features.m_NumFeatures;
+	auto rows = [&](int j) { return &m_Ring[(size_t)(j % nSize)*F]; };
+
+	//output frames up to the time of the last input frame
+	int nLast = m_NumIn - 1, nCount = 0;
+	long long nTotal = (long long)nLast*m_Up/m_Down + 1;
+	float row[MAX_CHANNELS + MAX_BONES_IN_ASF_FILE];
+	while (m_NumOut < nTotal)
+	{
+		Filter(m_NumOut++, rows, nLast, row);
+		out.push_back(m_Template);
+		FromFeatures(row, m_Template, &out.back());
+		nCount++;
+	}
+	Reset();
+	return nCount;
+}
+
+Motion *MotionResampler::Resample(Motion *pMotion) const
+{
+	int nIn = pMotion->m_NumFrames, F = m_Features.m_NumFeatures;
+	if (nIn <= 0)
+		return NULL;
+
+	std::vector<float> features((size_t)nIn*F);
+	ThreadPool::GetDefault().ParallelFor(0, nIn, [&](int nBegin, int nEnd, int nThread)
+	{
+		for (int j = nBegin; j < nEnd; j++)
+			m_Features.ToFeatures(pMotion->m_pPostures[j], &features[(size_t)j*F]);
+	}, 256);
+	for (int j = 1; j < nIn; j++)
+		m_Features.MakeContinuous(&features[(size_t)j*F], &features[(size_t)(j - 1)*F]);
+
+	long long nOut = (long long)(nIn - 1)*m_Up/m_Down + 1;
+	Motion *pOut = new Motion((int)nOut);
+	pOut->pActor = pMotion->pActor;
+	pOut->m_FrameRate = GetOutRate();
+	auto rows = [&](int j) { return &features[(size_t)j*F]; };
+	ThreadPool::GetDefault().ParallelFor(0, (int)nOut, [&](int nBegin, int nEnd, int nThread)
+	{
+		float row[MAX_CHANNELS + MAX_BONES_IN_ASF_FILE];
+		for (int n = nBegin; n < nEnd; n++)
+		{
+			Filter(n, rows, nIn - 1, row);
+			FromFeatures(row, pMotion->m_pPostures[0], &pOut->m_pPostures[n]);
+		}
+	}, 256);
+	return pOut;
+}
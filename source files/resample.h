@@ -0,0 +1,87 @@
+/*
+	resample.h
+
+	Conversion of motions to another frame rate (e.g. 120 Hz captures to 30, 60 or 240 Hz).
+
+	The ratio of the rates is taken as a fraction L/M (exact for the usual rates). Output frame n
+	is at input time t = n*M/L; it is a weighted sum of the 2R input frames around t, with the
+	weights of a Blackman windowed sinc low pass at the Nyquist rate of the slower of the two
+	rates, so downsampling does not alias and upsampling is band limited. t falls on one of L
+	phases between two input frames, and the weights of every phase are computed once
+	(a polyphase filter); each phase is normalized so that a constant motion stays constant.
+	Input frames before the first and after the last are taken as copies of them.
+
+	Every frame is turned into a row of features that can be filtered linearly (FeatureLayout,
+	see channels.h): translations, unwrapped angles and, for bones with three dofs, unit
+	quaternions. Filtered quaternions are normalized before they become Euler angles again,
+	so no gimbal lock or wrap around shows up in the output. A filtered row is one multiply-add
+	per feature and tap, in a loop over the features that the compiler vectorizes.
+
+	Push/Flush resample a stream with a buffer of 2R+2 rows; Resample converts a whole motion,
+	in parallel over the output frames. Both give the same frames. Like any sharp low pass, the
+	filter rings a little near abrupt changes (a few percent of the step).
+*/
+
+#ifndef _RESAMPLE_H
+#define _RESAMPLE_H
+
+#include <vector>
+
+#include "motion.h"
+#include "skeleton.h"
+#include "posture.h"
+#include "channels.h"
+
+//Half width of the filter in frames of the slower rate
+#define RESAMPLE_HALF_WIDTH 8
+//Largest denominator tried for the ratio of the rates
+#define RESAMPLE_MAX_FACTOR 1000
+
+class MotionResampler
+{
+	//member functions
+	public:
+		MotionResampler(Skeleton *pActor, float fInRate, float fOutRate, int nHalfWidth = RESAMPLE_HALF_WIDTH);
+		~MotionResampler();
+
+		int GetUpFactor() const { return m_Up; }
+		int GetDownFactor() const { return m_Down; }
+		//The output rate as it is used: fInRate*L/M
+		float GetOutRate() const { return m_InRate*m_Up/m_Down; }
+		//Input frames on each side of an output frame
+		int GetHalfWidth() const { return m_HalfWidth; }
+
+		//Streaming: add the next input frame; the output frames that are complete are appended
+		//to out. Returns their number
+		int Push(Posture const& in, std::vector<Posture> &out);
+		//End of the input: appends the remaining output frames
+		int Flush(std::vector<Posture> &out);
+		//Start a new stream
+		void Reset();
+
+		//The whole motion at the output rate. The caller deletes it
+		Motion *Resample(Motion *pMotion) const;
+
+	private:
+		void FromFeatures(float const *pRow, Posture const& templ, Posture *pPosture) const;
+		//Output frame n from the rows of the input frames (rows(j), j clamped to 0 .. nLast)
+		template <class Rows> void Filter(long long n, Rows const& rows, int nLast, float *pOut) const;
+
+	//member variables
+	private:
+		Skeleton *m_pActor;
+		ChannelLayout m_Layout;
+		FeatureLayout m_Features;
+		float m_InRate;
+		int m_Up, m_Down;			// L, M
+		int m_HalfWidth;			// R
+		std::vector<float> m_Taps;	// 2R per phase
+
+		//stream
+		int m_NumIn;				// input frames pushed
+		long long m_NumOut;			// output frames produced
+		std::vector<float> m_Ring;	// rows of the last 2R+2 input frames
+		Posture m_Template;			// first input frame, for what is not a channel
+};
+
+#endif
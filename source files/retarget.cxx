@@ -0,0 +1,299 @@
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <cmath>
+#include <algorithm>
+
+#include "retarget.h"
+#include "transform.h"
+#include "threadpool.h"
+
+
+/************************ Helper functions **********************************/
+
+static bool same_name(char const *a, char const *b)
+{
+	for (; *a != '\0' && *b != '\0'; a++, b++)
+		if (tolower((unsigned char)*a) != tolower((unsigned char)*b))
+			return false;
+	return *a == *b;
+}
+
+static int find_bone(Skeleton *pSkeleton, char const *pName)
+{
+	for (int i = 0; i < pSkeleton->NUM_BONES_IN_ASF_FILE; i++)
+		if (same_name(pSkeleton->idx2name(i), pName))
+			return i;
+	return -1;
+}
+
+static void parents_of(Skeleton *pSkeleton, int *pParent)
+{
+	Bone *bone = pSkeleton->getRoot();
+	for (int i = 0; i < pSkeleton->NUM_BONES_IN_ASF_FILE; i++)
+		pParent[i] = -1;
+	for (int i = 0; i < pSkeleton->NUM_BONES_IN_ASF_FILE; i++)
+		for (Bone *pChild = bone[i].child; pChild != NULL; pChild = pChild->sibling)
+			pParent[pChild->idx] = i;
+}
+
+//Axis rotation of a bone: its local frame in the global frame of the rest pose
+static void axis_matrix(Bone const& bone, float A[3][3])
+{
+	float angles[3] = { bone.axis_x, bone.axis_y, bone.axis_z };
+	euler_to_matrix(angles, A);
+}
+
+//Direction of a bone in the global frame of the rest pose (dir is stored in the local frame)
+static void global_dir(Bone const& bone, float d[3])
+{
+	float A[3][3];
+	axis_matrix(bone, A);
+	for (int i = 0; i < 3; i++)
+		d[i] = A[i][0]*bone.dir[0] + A[i][1]*bone.dir[1] + A[i][2]*bone.dir[2];
+}
+
+//Height of the skeleton in its rest pose
+static float rest_height(Skeleton *pSkeleton)
+{
+	Posture rest;
+	rest.root_pos.setValue(0, 0, 0);
+	for (int j = 0; j < MAX_BONES_IN_ASF_FILE; j++)
+	{
+		rest.bone_rotation[j].setValue(0, 0, 0);
+		rest.bone_translation[j].setValue(0, 0, 0);
+	}
+	::vector joints[MAX_BONES_IN_ASF_FILE];
+	pSkeleton->computeJointPositions(rest, joints);
+
+	float fMin = 0, fMax = 0;
+	for (int j = 0; j < pSkeleton->NUM_BONES_IN_ASF_FILE; j++)
+	{
+		fMin = std::min(fMin, joints[j].p[1]);
+		fMax = std::max(fMax, joints[j].p[1]);
+	}
+	return fMax - fMin;
+}
+
+
+/************************ Retargeter class functions **********************************/
+Retargeter::Retargeter(Skeleton *pSource, Skeleton *pTarget)
+{
+	m_pSource = pSource;
+	m_pTarget = pTarget;
+	m_NumBones = pTarget->NUM_BONES_IN_ASF_FILE;
+
+	for (int k = 0; k < m_NumBones; k++)
+		m_Bones[k].nSource = find_bone(pSource, pTarget->idx2name(k));
+
+	float fSourceHeight = rest_height(pSource);
+	m_RootScale = fSourceHeight > 0 ? rest_height(pTarget)/fSourceHeight : 1.0f;
+
+	ComputeCorrections();
+}
+
+Retargeter::~Retargeter()
+{
+}
+
+int Retargeter::MapBone(char const *pTargetName, char const *pSourceName)
+{
+	int nTarget = find_bone(m_pTarget, pTargetName);
+	int nSource = pSourceName != NULL ? find_bone(m_pSource, pSourceName) : -1;
+	if (nTarget < 0 || (pSourceName != NULL && nSource < 0))
+	{
+		printf("Retargeter: no bone '%s'\n", nTarget < 0 ? pTargetName : pSourceName);
+		return -1;
+	}
+	m_Bones[nTarget].nSource = nSource;
+	ComputeCorrections();
+	return 0;
+}
+
+int Retargeter::LoadBoneMap(char const *filename)
+{
+	FILE *pFile = fopen(filename, "r");
+	if (pFile == NULL)
+	{
+		printf("Cannot open bone map '%s'\n", filename);
+		return -1;
+	}
+
+	int nResult = 0;
+	char line[512], target[256], source[256];
+	while (fgets(line, sizeof(line), pFile) != NULL)
+	{
+		if (line[0] == '#' || sscanf(line, "%255s %255s", target, source) != 2)
+			continue;
+		if (MapBone(target, strcmp(source, "-") == 0 ? NULL : source) != 0)
+			nResult = -1;
+	}
+	fclose(pFile);
+	return nResult;
+}
+
+void Retargeter::ComputeCorrections()
+{
+	Bone *source = m_pSource->getRoot(), *target = m_pTarget->getRoot();
+	int targetParent[MAX_BONES_IN_ASF_FILE];
+	parents_of(m_pTarget, targetParent);
+
+	//D: target rest direction onto source rest direction, per target bone. A bone without rotational
+	//dofs cannot be turned, so it keeps the correction of its parent and its children make up for it.
+	//Parents come before their children in the ASF file
+	float D[MAX_BONES_IN_ASF_FILE][3][3];
+	matrix3_identity(D[root]);
+	for (int k = 1; k < m_NumBones; k++)
+	{
+		float u[3], v[3];
+		int s = m_Bones[k].nSource, p = targetParent[k] >= 0 ? targetParent[k] : root;
+		bool bFixed = !target[k].dofx && !target[k].dofy && !target[k].dofz;
+		if (s > 0 && !bFixed)
+		{
+			global_dir(target[k], u);
+			global_dir(source[s], v);
+		}
+		if (s <= 0 || bFixed || (u[0] == 0 && u[1] == 0 && u[2] == 0) || (v[0] == 0 && v[1] == 0 && v[2] == 0))
+			memcpy(D[k], D[p], sizeof(D[k]));
+		else
+			rotation_between(u, v, D[k]);
+	}
+
+	for (int k = 0; k < m_NumBones; k++)
+	{
+		BoneMap &map = m_Bones[k];
+		map.dof[0] = target[k].dofx;
+		map.dof[1] = target[k].dofy;
+		map.dof[2] = target[k].dofz;
+		if (k == root)
+			map.dof[0] = map.dof[1] = map.dof[2] = 1;
+		if (map.nSource < 0)
+			continue;
+
+		float A[3][3], At[3][3], B[3][3], Bt[3][3], Dpt[3][3], T1[3][3], T2[3][3];
+		axis_matrix(source[map.nSource], A);
+		axis_matrix(target[k], B);
+		matrix3_transpose(A, At);
+		matrix3_transpose(B, Bt);
+		if (targetParent[k] >= 0)
+			matrix3_transpose(D[targetParent[k]], Dpt);
+		else
+			matrix3_identity(Dpt);
+
+		//P = B^-1 Dp^-1 A, S = A^-1 D B
+		matrix3_multiply(Bt, Dpt, T1);
+		matrix3_multiply(T1, A, map.P);
+		matrix3_multiply(At, D[k], T2);
+		matrix3_multiply(T2, B, map.S);
+	}
+}
+
+//Frames bone by bone: the angles of one bone over the block are gathered so that the
+//matrix products run as loops over the frames
+void Retargeter::RetargetBlock(Posture const *pIn, Posture *pOut, int nFrames) const
+{
+	Bone *source = m_pSource->getRoot();
+	float c[3][RETARGET_BLOCK], s[3][RETARGET_BLOCK];
+	float L[3][3][RETARGET_BLOCK], M[3][3][RETARGET_BLOCK], T[3][3][RETARGET_BLOCK];
+
+	for (int f = 0; f < nFrames; f++)
+	{
+		Posture &out = pOut[f];
+		out.root_pos = pIn[f].root_pos*m_RootScale;
+		for (int j = 0; j < MAX_BONES_IN_ASF_FILE; j++)
+		{
+			out.bone_rotation[j].setValue(0, 0, 0);
+			out.bone_translation[j].setValue(0, 0, 0);
+			out.bone_length[j].setValue(0, 0, 0);
+		}
+		out.bone_translation[root] = out.root_pos;
+	}
+
+	for (int k = 0; k < m_NumBones; k++)
+	{
+		BoneMap const& map = m_Bones[k];
+		int nSource = map.nSource;
+		if (nSource < 0)
+			continue;
+
+		int dof[3] = { source[nSource].dofx, source[nSource].dofy, source[nSource].dofz };
+		if (nSource == root)
+			dof[0] = dof[1] = dof[2] = 1;
+		for (int a = 0; a < 3; a++)
+			for (int f = 0; f < nFrames; f++)
+			{
+				float angle = dof[a] ? pIn[f].bone_rotation[nSource].p[a]*(float)(M_PI/180.) : 0.0f;
+				c[a][f] = cosf(angle);
+				s[a][f] = sinf(angle);
+			}
+
+		//L = Rz * Ry * Rx
+		for (int f = 0; f < nFrames; f++)
+		{
+			L[0][0][f] = c[2][f]*c[1][f];
+			L[0][1][f] = c[2][f]*s[1][f]*s[0][f] - s[2][f]*c[0][f];
+			L[0][2][f] = c[2][f]*s[1][f]*c[0][f] + s[2][f]*s[0][f];
+			L[1][0][f] = s[2][f]*c[1][f];
+			L[1][1][f] = s[2][f]*s[1][f]*s[0][f] + c[2][f]*c[0][f];
+			L[1][2][f] = s[2][f]*s[1][f]*c[0][f] - c[2][f]*s[0][f];
+			L[2][0][f] = -s[1][f];
+			L[2][1][f] = c[1][f]*s[0][f];
+			L[2][2][f] = c[1][f]*c[0][f];
+		}
+
+		//M = P L S
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 3; j++)
+				for (int f = 0; f < nFrames; f++)
+					T[i][j][f] = map.P[i][0]*L[0][j][f] + map.P[i][1]*L[1][j][f] + map.P[i][2]*L[2][j][f];
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 3; j++)
+				for (int f = 0; f < nFrames; f++)
+					M[i][j][f] = T[i][0][f]*map.S[0][j] + T[i][1][f]*map.S[1][j] + T[i][2][f]*map.S[2][j];
+
+		//back to angles, as matrix_to_euler
+		for (int f = 0; f < nFrames; f++)
+		{
+			float angles[3], m[3][3];
+			for (int i = 0; i < 3; i++)
+				for (int j = 0; j < 3; j++)
+					m[i][j] = M[i][j][f];
+			matrix_to_euler(m, angles);
+
+			::vector &rotation = pOut[f].bone_rotation[k];
+			for (int a = 0; a < 3; a++)
+				rotation.p[a] = map.dof[a] ? angles[a] : 0.0f;
+			if (k != root)
+			{
+				::vector const& translation = pIn[f].bone_translation[nSource];
+				pOut[f].bone_translation[k].setValue(source[nSource].doftx ? translation.p[0] : 0.0f,
+					source[nSource].dofty ? translation.p[1] : 0.0f, source[nSource].doftz ? translation.p[2] : 0.0f);
+				if (source[nSource].doftl)
+					pOut[f].bone_length[k] = pIn[f].bone_length[nSource];
+			}
+		}
+	}
+}
+
+void Retargeter::Retarget(Posture const& in, Posture *pOut) const
+{
+	RetargetBlock(&in, pOut, 1);
+}
+
+Motion *Retargeter::Retarget(Motion *pSource) const
+{
+	Motion *pTarget = new Motion(pSource->m_NumFrames);
+	pTarget->pActor = m_pTarget;
+
+	int nBlocks = (pSource->m_NumFrames + RETARGET_BLOCK - 1)/RETARGET_BLOCK;
+	ThreadPool::GetDefault().ParallelFor(0, nBlocks, [&](int nBegin, int nEnd, int nThread)
+	{
+		for (int b = nBegin; b < nEnd; b++)
+		{
+			int nFirst = b*RETARGET_BLOCK;
+			int nFrames = std::min(RETARGET_BLOCK, pSource->m_NumFrames - nFirst);
+			RetargetBlock(pSource->m_pPostures + nFirst, pTarget->m_pPostures + nFirst, nFrames);
+		}
+	});
+	return pTarget;
+}
@@ -0,0 +1,72 @@
+/*
+	retarget.h
+
+	Retargeting of motions between skeletons (ASF files) that differ in their bone axes,
+	rest pose directions and proportions, so that one motion library can drive many actors.
+
+	Bones are matched by name (case insensitive), or by a map given by the caller. For every
+	bone the rotation is carried over in the global frame of the rest pose: with A the axis
+	rotation of a bone (axis field) and D the rotation that turns the target rest direction of
+	the bone onto the source one (dir field), the local rotation L of the source becomes
+		L' = (A'^-1 Dp^-1 A) L (A^-1 D A')
+	where Dp is D of the parent. Both brackets are computed once per bone pair, so converting a
+	frame is two 3x3 products per bone and the conversion of the Euler angles. Rotations about
+	axes the target bone has no dof for are dropped. The root translation is scaled by the ratio
+	of the heights of the two skeletons in their rest pose.
+
+	Retarget on a Motion converts the frames in blocks of RETARGET_BLOCK, bone by bone, in loops
+	over the frames of the block that the compiler vectorizes, and spreads the blocks over the
+	thread pool.
+*/
+
+#ifndef _RETARGET_H
+#define _RETARGET_H
+
+#include "motion.h"
+#include "skeleton.h"
+#include "posture.h"
+
+#define RETARGET_BLOCK 64
+
+class Retargeter
+{
+	//member functions
+	public:
+		Retargeter(Skeleton *pSource, Skeleton *pTarget);
+		~Retargeter();
+
+		//Drive target bone pTargetName with source bone pSourceName (NULL: leave it at rest).
+		//Returns 0, or -1 if a name is not in its skeleton
+		int MapBone(char const *pTargetName, char const *pSourceName);
+		//Map file: one "target_bone source_bone" pair per line, "-" as source for none
+		int LoadBoneMap(char const *filename);
+
+		//Source bone index driving target bone nTargetBone, -1 if none
+		int GetSourceBone(int nTargetBone) const { return m_Bones[nTargetBone].nSource; }
+		float GetRootScale() const { return m_RootScale; }
+		void SetRootScale(float fScale) { m_RootScale = fScale; }
+
+		void Retarget(Posture const& in, Posture *pOut) const;
+		//New motion of the target skeleton. The caller deletes it
+		Motion *Retarget(Motion *pSource) const;
+
+	private:
+		void ComputeCorrections();
+		void RetargetBlock(Posture const *pIn, Posture *pOut, int nFrames) const;
+
+	//member variables
+	private:
+		struct BoneMap
+		{
+			int nSource;				// -1 if the target bone is not driven
+			float P[3][3], S[3][3];		// L' = P L S
+			int dof[3];					// rotational dofs of the target bone
+		};
+
+		Skeleton *m_pSource, *m_pTarget;
+		int m_NumBones;					// of the target
+		float m_RootScale;
+		BoneMap m_Bones[MAX_BONES_IN_ASF_FILE];
+};
+
+#endif
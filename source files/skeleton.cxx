@@ -44,7 +44,8 @@ int movBonesInSkel(Bone item)
 	{
 		if (tmp->child != NULL)
 			i+= movBonesInSkel(*(tmp->child));
-		if (tmp->dof > 0) i++; tmp = tmp->sibling; 
+		if (tmp->dof > 0) i++;
+		tmp = tmp->sibling; 
 	}
 
 if (item.child != NULL)
@@ -59,14 +60,14 @@ int Skeleton::name2idx(char *name)
 {
 int i=0;
 	while(strcmp(m_pBoneList[i].name, name) != 0 && i++ < NUM_BONES_IN_ASF_FILE);
-		return m_pBoneList[i].idx;
+	return m_pBoneList[i].idx;
 }
 
 char * Skeleton::idx2name(int idx)
 {
 	int i=0;
 	while(m_pBoneList[i].idx != idx && i++ < NUM_BONES_IN_ASF_FILE);
-		return m_pBoneList[i].name;
+	return m_pBoneList[i].name;
 }
 
 void Skeleton::readASFfile(char* asf_filename, float scale)
@@ -78,7 +79,6 @@ void Skeleton::readASFfile(char* asf_filename, float scale)
 	//
 	// ignore header information
 	//
-	int n;
 	char	str[2048], keyword[256];
 	while (1)
 	{
@@ -140,7 +140,7 @@ void Skeleton::readASFfile(char* asf_filename, float scale)
 			// this line describes the bone's dof 
 			if(strcmp(keyword, "dof") == 0)       
 			{
-				token=strtok(str, " "); 
+				token=strtok(str, " \r\n\t"); 
 				m_pBoneList[i].dof=0;
 				while(token != NULL)      
 				{
@@ -159,7 +159,7 @@ void Skeleton::readASFfile(char* asf_filename, float scale)
 					m_pBoneList[i].dof++;
 					m_pBoneList[i].dofo[m_pBoneList[i].dof] = 0;
 end:
-					token=strtok(NULL, " ");
+					token=strtok(NULL, " \r\n\t");
 				}
 //				m_NumDOFs+=m_pBoneList[i].dof;
 				printf("Bone %d DOF: ",i);
@@ -209,7 +209,7 @@ end:
 		else
 		{
 			//parse this line, it contains parent followed by children
-			part_name=strtok(str, " ");
+			part_name=strtok(str, " \r\n\t");
 			j=0;
 			while(part_name != NULL)
 			{
@@ -217,7 +217,7 @@ end:
 					parent=name2idx(part_name);
 				else 
 					setChildrenAndSibling(parent, &m_pBoneList[name2idx(part_name)]);
-				part_name=strtok(NULL, " ");
+				part_name=strtok(NULL, " \r\n\t");
 				j++;
 			}
 		}
@@ -423,9 +423,9 @@ void Skeleton::setBasePosture()
 //Copy Skeleton
 Skeleton* Skeleton::clone()
 {
-	char *c = new char();
-	strcpy(c, actor_Filename.c_str());
-	return new Skeleton(c, MOCAP_SCALE);
+	Skeleton *pClone = new Skeleton((char *)actor_Filename.c_str(), MOCAP_SCALE);
+	pClone->actor_Filename = actor_Filename;
+	return pClone;
 }
 
 
@@ -465,6 +465,102 @@ void Skeleton::setPosture(Posture posture)
 }
 
 
+// read the current pose back into a posture
+void Skeleton::getPosture(Posture *pPosture)
+{
+	pPosture->root_pos.setValue(m_RootPos[0], m_RootPos[1], m_RootPos[2]);
+
+	for(int j=0;j<NUM_BONES_IN_ASF_FILE;j++)
+	{
+		pPosture->bone_rotation[j].setValue(m_pBoneList[j].dofx ? m_pBoneList[j].drx : 0.,
+											m_pBoneList[j].dofy ? m_pBoneList[j].dry : 0.,
+											m_pBoneList[j].dofz ? m_pBoneList[j].drz : 0.);
+		if (j == root)
+			pPosture->bone_translation[j] = pPosture->root_pos;
+		else
+			pPosture->bone_translation[j].setValue(m_pBoneList[j].doftx ? m_pBoneList[j].tx : 0.,
+												   m_pBoneList[j].dofty ? m_pBoneList[j].ty : 0.,
+												   m_pBoneList[j].doftz ? m_pBoneList[j].tz : 0.);
+	}
+}
+
+
+/******************************************************************************
+Forward kinematics without OpenGL
+******************************************************************************/
+
+/*
+	Same update as in Display::drawBone, written out on 3x3 matrices:
+		R_k+1 = R_k * (rot_parent_current) * Rz * Ry * Rx
+		t_k+1 = t_k + R_k * (rot_parent_current) * T_k+1 + R_k+1 * (dir * length)
+	rot_parent_current is stored transposed for glMultMatrixd (column major), 
+	so it is transposed back here.
+*/
+void Skeleton::computeJointPositions(Bone *ptr, Posture const& posture, float R[3][3], float t[3], ::vector *pJointPos)
+{
+	if (ptr == NULL)
+		return;
+
+	int i, j, k;
+	float Rb[3][3], Rl[3][3], Rc[3][3], tc[3];
+
+	//Rb = R * (rot_parent_current)^T
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < 3; j++)
+			Rb[i][j] = R[i][0]*ptr->rot_parent_current[j][0] + R[i][1]*ptr->rot_parent_current[j][1] + R[i][2]*ptr->rot_parent_current[j][2];
+
+	//translation dofs (the root translation is stored in root_pos)
+	float tl[3] = { 0., 0., 0. };
+	if (ptr->idx == root)
+	{
+		tl[0] = posture.root_pos.p[0]; tl[1] = posture.root_pos.p[1]; tl[2] = posture.root_pos.p[2];
+	}
+	else
+	{
+		if (ptr->doftx) tl[0] = posture.bone_translation[ptr->idx].p[0];
+		if (ptr->dofty) tl[1] = posture.bone_translation[ptr->idx].p[1];
+		if (ptr->doftz) tl[2] = posture.bone_translation[ptr->idx].p[2];
+	}
+	for (i = 0; i < 3; i++)
+		tc[i] = t[i] + Rb[i][0]*tl[0] + Rb[i][1]*tl[1] + Rb[i][2]*tl[2];
+
+	//Rl = Rz * Ry * Rx for the rotational dofs of this bone
+	float a = ptr->dofx ? posture.bone_rotation[ptr->idx].p[0]*M_PI/180. : 0.;
+	float b = ptr->dofy ? posture.bone_rotation[ptr->idx].p[1]*M_PI/180. : 0.;
+	float c = ptr->dofz ? posture.bone_rotation[ptr->idx].p[2]*M_PI/180. : 0.;
+	float sa = sin(a), ca = cos(a), sb = sin(b), cb = cos(b), sc = sin(c), cc = cos(c);
+	Rl[0][0] = cc*cb; Rl[0][1] = cc*sb*sa - sc*ca; Rl[0][2] = cc*sb*ca + sc*sa;
+	Rl[1][0] = sc*cb; Rl[1][1] = sc*sb*sa + cc*ca; Rl[1][2] = sc*sb*ca - cc*sa;
+	Rl[2][0] = -sb;   Rl[2][1] = cb*sa;            Rl[2][2] = cb*ca;
+
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < 3; j++)
+		{
+			Rc[i][j] = 0;
+			for (k = 0; k < 3; k++)
+				Rc[i][j] += Rb[i][k]*Rl[k][j];
+		}
+
+	//move to the end of the bone
+	float d[3] = { ptr->dir[0]*ptr->length, ptr->dir[1]*ptr->length, ptr->dir[2]*ptr->length };
+	for (i = 0; i < 3; i++)
+		tc[i] += Rc[i][0]*d[0] + Rc[i][1]*d[1] + Rc[i][2]*d[2];
+
+	pJointPos[ptr->idx].setValue(tc[0], tc[1], tc[2]);
+
+	//children continue from the end of this bone, siblings from the end of the parent
+	computeJointPositions(ptr->child, posture, Rc, tc, pJointPos);
+	computeJointPositions(ptr->sibling, posture, R, t, pJointPos);
+}
+
+void Skeleton::computeJointPositions(Posture const& posture, ::vector *pJointPos)
+{
+	float R[3][3] = { {1., 0., 0.}, {0., 1., 0.}, {0., 0., 1.} };
+	float t[3] = { 0., 0., 0. };
+	computeJointPositions(m_pRootBone, posture, R, t, pJointPos);
+}
+
+
 //Set the aspect ratio of each bone 
 void set_bone_shape(Bone *bone)
 {
@@ -14,7 +14,7 @@
 #include <string>
 
 // Bone segment names used in ASF file
-static int root = 0;
+static const int root = 0;
 
 // this structure defines the property of each bone segment, including its connection to other bones,
 // DOF (degrees of freedom), relative orientation and distance to the outboard bone 
@@ -71,12 +71,20 @@ class Skeleton {
 	//Set the skeleton's pose based on the given posture    
 	void setPosture(Posture posture);        
 
+	//Read the current pose back into a posture (inverse of setPosture)
+	void getPosture(Posture *pPosture);
+
 	//Initial posture Root at (0,0,0)
 	//All bone rotations are set to 0
     void setBasePosture();
 
 	//Copy Skeleton
 	Skeleton* clone();
+
+	//Forward kinematics without OpenGL: world position of the end point of every bone 
+	//(the origin of its children) for the given posture. Uses the same transforms as Display::drawBone.
+	//pJointPos is indexed by bone index and must hold NUM_BONES_IN_ASF_FILE entries.
+	void computeJointPositions(Posture const& posture, ::vector *pJointPos);
 	  
 
   private:
@@ -101,6 +109,10 @@ class Skeleton {
 	//Rotate all bone's direction vector (dir) from global to local coordinate system
 	void RotateBoneDirToLocalCoordSystem();
 
+	//Recursive part of computeJointPositions. R and t are the orientation and position
+	//of the parent bone end point in world coordinates
+	void computeJointPositions(Bone *ptr, Posture const& posture, float R[3][3], float t[3], ::vector *pJointPos);
+
   //Member Variables
   public:
 	// root position in world coordinate system
@@ -0,0 +1,365 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "smoothing.h"
+
+
+/************************ Filter design **********************************/
+
+//Weights of the W frames of a window for the value at frame nPosition of the window of a least
+//squares polynomial of degree nDegree
+static void savitzky_golay_weights(int W, int nDegree, int nPosition, float *pWeights)
+{
+	int K = nDegree + 1;
+	double M[8][16];
+	for (int i = 0; i < K; i++)
+		for (int j = 0; j < K; j++)
+		{
+			double sum = 0;
+			for (int f = 0; f < W; f++)
+				sum += pow((double)(f - nPosition), i + j);
+			M[i][j] = sum;
+			M[i][K + j] = i == j ? 1.0 : 0.0;
+		}
+	//inverse of A^T A by Gauss-Jordan elimination with partial pivoting
+	for (int col = 0; col < K; col++)
+	{
+		int nPivot = col;
+		for (int r = col + 1; r < K; r++)
+			if (fabs(M[r][col]) > fabs(M[nPivot][col]))
+				nPivot = r;
+		for (int c = 0; c < 2*K; c++)
+			std::swap(M[col][c], M[nPivot][c]);
+		double pivot = M[col][col];
+		for (int c = 0; c < 2*K; c++)
+			M[col][c] /= pivot;
+		for (int r = 0; r < K; r++)
+			if (r != col)
+			{
+				double factor = M[r][col];
+				for (int c = 0; c < 2*K; c++)
+					M[r][c] -= factor*M[col][c];
+			}
+	}
+	//value at x = 0: first row of (A^T A)^-1 A^T
+	for (int f = 0; f < W; f++)
+	{
+		double sum = 0, x = f - nPosition, power = 1;
+		for (int k = 0; k < K; k++, power *= x)
+			sum += M[0][K + k]*power;
+		pWeights[f] = (float)sum;
+	}
+}
+
+//Run the frame pValues (one value per feature) through the biquad sections, in place
+static void run_sections(float const (*pSections)[5], int nSections, float (*pState)[MAX_FEATURES], float *pValues, int nChannels)
+{
+	for (int s = 0; s < nSections; s++)
+	{
+		float b0 = pSections[s][0], b1 = pSections[s][1], b2 = pSections[s][2], a1 = pSections[s][3], a2 = pSections[s][4];
+		float *z1 = pState[2*s], *z2 = pState[2*s + 1];
+		for (int c = 0; c < nChannels; c++)
+		{
+			float x = pValues[c], y = b0*x + z1[c];
+			z1[c] = b1*x - a1*y + z2[c];
+			z2[c] = b2*x - a2*y;
+			pValues[c] = y;
+		}
+	}
+}
+
+//State of the sections after a long constant input pValues (each section has gain 1 at 0 Hz)
+static void steady_state(float const (*pSections)[5], int nSections, float (*pState)[MAX_FEATURES], float const *pValues, int nChannels)
+{
+	for (int s = 0; s < nSections; s++)
+	{
+		float b1 = pSections[s][1], b2 = pSections[s][2], a1 = pSections[s][3], a2 = pSections[s][4];
+		for (int c = 0; c < nChannels; c++)
+		{
+			pState[2*s + 1][c] = (b2 - a2)*pValues[c];
+			pState[2*s][c] = (b1 - a1)*pValues[c] + pState[2*s + 1][c];
+		}
+	}
+}
+
+
+/************************ MotionSmoother class functions **********************************/
+MotionSmoother::MotionSmoother(Skeleton *pActor) : m_Layout(pActor), m_Features(&m_Layout)
+{
+	m_pActor = pActor;
+
+	m_FrameRate = MOCAP_FRAME_RATE;
+	m_bHold = false;
+
+	m_Cutoff = 6.0f;
+	m_Order = 2;
+	m_MinCutoff = 1.0f;
+	m_AngleBeta = 1.0f;
+	m_PositionBeta = 15.0f;
+	m_DerivativeCutoff = 1.0f;
+	m_HalfWidth = 0;
+	m_Degree = 0;
+	SetSavitzkyGolay(5, 2);
+	SetButterworth(6.0f, 2);
+}
+
+MotionSmoother::~MotionSmoother()
+{
+}
+
+void MotionSmoother::SetFrameRate(float fRate)
+{
+	m_FrameRate = fRate;
+	Reset();
+}
+
+void MotionSmoother::SetButterworth(float fCutoff, int nOrder)
+{
+	m_Filter = SMOOTH_BUTTERWORTH;
+	m_Cutoff = fCutoff;
+	m_Order = std::min(std::max(2, nOrder & ~1), 2*SMOOTH_MAX_SECTIONS);
+	Reset();
+}
+
+void MotionSmoother::SetSavitzkyGolay(int nHalfWidth, int nDegree)
+{
+	m_Filter = SMOOTH_SAVITZKY_GOLAY;
+	m_HalfWidth = std::max(1, nHalfWidth);
+	m_Degree = std::min(std::max(0, nDegree), std::min(2*m_HalfWidth, 7));
+	int W = 2*m_HalfWidth + 1;
+	m_Weights.resize((size_t)W*W);
+	for (int p = 0; p < W; p++)
+		savitzky_golay_weights(W, m_Degree, p, &m_Weights[(size_t)p*W]);
+	Reset();
+}
+
+void MotionSmoother::SetOneEuro(float fMinCutoff, float fAngleBeta, float fPositionBeta, float fDerivativeCutoff)
+{
+	m_Filter = SMOOTH_ONE_EURO;
+	m_MinCutoff = fMinCutoff;
+	m_AngleBeta = fAngleBeta;
+	m_PositionBeta = fPositionBeta;
+	m_DerivativeCutoff = fDerivativeCutoff;
+	Reset();
+}
+
+int MotionSmoother::GetLatency() const
+{
+	if (m_Filter == SMOOTH_BUTTERWORTH)
+		return SMOOTH_BLOCK + m_Lookahead;
+	if (m_Filter == SMOOTH_SAVITZKY_GOLAY)
+		return m_HalfWidth;
+	return 0;
+}
+
+void MotionSmoother::Reset()
+{
+	m_NumIn = m_NumOut = m_Base = 0;
+	m_Postures.clear();
+	m_Rows.clear();
+
+	//Butterworth sections (bilinear transform), cutoff corrected for the two passes
+	m_NumSections = m_Order/2;
+	double correction = pow(sqrt(2.0) - 1.0, 1.0/(2*m_Order));
+	double fc = std::min((double)m_Cutoff/correction, 0.45*m_FrameRate);
+	double w0 = 2*M_PI*fc/m_FrameRate, cw = cos(w0);
+	for (int s = 0; s < m_NumSections; s++)
+	{
+		double Q = 1/(2*cos(M_PI*(2*s + 1)/(2.0*m_Order)));
+		double alpha = sin(w0)/(2*Q), a0 = 1 + alpha;
+		m_Sections[s][0] = (float)((1 - cw)/2/a0);
+		m_Sections[s][1] = (float)((1 - cw)/a0);
+		m_Sections[s][2] = (float)((1 - cw)/2/a0);
+		m_Sections[s][3] = (float)(-2*cw/a0);
+		m_Sections[s][4] = (float)((1 - alpha)/a0);
+	}
+	m_Lookahead = std::max(16, (int)ceil(3*m_FrameRate/fc));
+
+	//a quaternion component moves by about half the rotation in radians
+	for (int f = 0; f < m_Features.m_NumFeatures; f++)
+		m_Beta[f] = m_Features.m_Angle[f] ? m_AngleBeta : m_PositionBeta;
+	for (int i = 0; i < m_Features.m_NumQuatBones; i++)
+		for (int k = 0; k < 4; k++)
+			m_Beta[m_Features.m_QuatFeature[m_Features.m_QuatBones[i]] + k] = m_AngleBeta*360.0f/(float)M_PI;
+}
+
+//Give out the frame in with the filtered features pRow, angles back within 180 degrees of the input
+void MotionSmoother::Emit(Posture const& in, float const *pRow, std::vector<Posture> &out)
+{
+	float raw[MAX_CHANNELS], values[MAX_CHANNELS];
+	m_Layout.Gather(in, raw);
+	m_Features.FromFeatures(pRow, values);
+	for (int c = 0; c < m_Layout.m_NumChannels; c++)
+		if (m_Layout.IsAngle(c))
+			values[c] = UnwrapAngle(values[c], raw[c]);
+	out.push_back(in);
+	m_Layout.Scatter(values, out.back());
+	m_NumOut++;
+}
+
+void MotionSmoother::Drop(int nFrames)
+{
+	m_Postures.erase(m_Postures.begin(), m_Postures.begin() + nFrames);
+	m_Rows.erase(m_Rows.begin(), m_Rows.begin() + (size_t)nFrames*m_Features.m_NumFeatures);
+	m_Base += nFrames;
+}
+
+//Backward pass over the held frames, from the last one; the first nFrames are given out
+void MotionSmoother::Backward(int nFrames, std::vector<Posture> &out)
+{
+	int nHeld = m_NumIn - m_Base, C = m_Features.m_NumFeatures;
+	float state[2*SMOOTH_MAX_SECTIONS][MAX_FEATURES];
+	std::vector<float> result((size_t)nFrames*C);
+	steady_state(m_Sections, m_NumSections, state, &m_Rows[(size_t)(nHeld - 1)*C], C);
+
+	float values[MAX_FEATURES];
+	for (int j = nHeld - 1; j >= 0; j--)
+	{
+		memcpy(values, &m_Rows[(size_t)j*C], C*sizeof(float));
+		run_sections(m_Sections, m_NumSections, state, values, C);
+		if (j < nFrames)
+			memcpy(&result[(size_t)j*C], values, C*sizeof(float));
+	}
+	for (int j = 0; j < nFrames; j++)
+		Emit(m_Postures[j], &result[(size_t)j*C], out);
+	Drop(nFrames);
+}
+
+//Frame nFrame from its window; nTotal is the number of frames of the motion, or -1 while it is
+//not known (the frames up to nFrame + h are there)
+void MotionSmoother::SavitzkyGolay(int nFrame, int nTotal, std::vector<Posture> &out)
+{
+	int W = 2*m_HalfWidth + 1, C = m_Features.m_NumFeatures, nStart;
+	float const *pWeights;
+	std::vector<float> shortWeights;
+	if (nTotal >= 0 && nTotal < W)
+	{
+		//shorter than the window: fit all frames
+		W = nTotal;
+		nStart = 0;
+		shortWeights.resize(W);
+		savitzky_golay_weights(W, std::min(m_Degree, W - 1), nFrame, shortWeights.data());
+		pWeights = shortWeights.data();
+	}
+	else
+	{
+		nStart = std::max(nFrame - m_HalfWidth, 0);
+		if (nTotal >= 0)
+			nStart = std::min(nStart, nTotal - W);
+		pWeights = &m_Weights[(size_t)(nFrame - nStart)*W];
+	}
+
+	float values[MAX_FEATURES] = { 0 };
+	for (int i = 0; i < W; i++)
+	{
+		float w = pWeights[i];
+		float const *pRow = &m_Rows[(size_t)(nStart + i - m_Base)*C];
+		for (int c = 0; c < C; c++)
+			values[c] += w*pRow[c];
+	}
+	Emit(m_Postures[nFrame - m_Base], values, out);
+}
+
+int MotionSmoother::Push(Posture const *pFrames, int nCount, std::vector<Posture> &out)
+{
+	int C = m_Features.m_NumFeatures, nOut = m_NumOut;
+	float values[MAX_FEATURES];
+	for (int i = 0; i < nCount; i++)
+	{
+		m_Features.ToFeatures(pFrames[i], values);
+		if (m_NumIn > 0)
+			m_Features.MakeContinuous(values, m_Previous);
+		memcpy(m_Previous, values, C*sizeof(float));
+
+		if (m_Filter == SMOOTH_ONE_EURO)
+		{
+			float *pValue = m_State[0], *pSpeed = m_State[1];
+			if (m_NumIn == 0)
+				for (int c = 0; c < C; c++)
+				{
+					pValue[c] = values[c];
+					pSpeed[c] = 0;
+				}
+			float tau = m_FrameRate/(2*(float)M_PI), alphaSpeed = 1/(1 + tau/m_DerivativeCutoff);
+			for (int c = 0; c < C; c++)
+			{
+				float speed = (values[c] - pValue[c])*m_FrameRate;
+				pSpeed[c] += alphaSpeed*(speed - pSpeed[c]);
+				float alpha = 1/(1 + tau/(m_MinCutoff + m_Beta[c]*fabsf(pSpeed[c])));
+				pValue[c] += alpha*(values[c] - pValue[c]);
+				values[c] = pValue[c];
+			}
+			m_NumIn++;
+			m_Base++;
+			Emit(pFrames[i], values, out);
+			continue;
+		}
+
+		if (m_Filter == SMOOTH_BUTTERWORTH)
+		{
+			if (m_NumIn == 0)
+				steady_state(m_Sections, m_NumSections, m_State, values, C);
+			run_sections(m_Sections, m_NumSections, m_State, values, C);
+		}
+		m_Postures.push_back(pFrames[i]);
+		m_Rows.insert(m_Rows.end(), values, values + C);
+		m_NumIn++;
+		if (m_bHold)
+			continue;
+
+		if (m_Filter == SMOOTH_BUTTERWORTH)
+		{
+			if (m_NumIn - m_NumOut >= SMOOTH_BLOCK + m_Lookahead)
+				Backward(SMOOTH_BLOCK, out);
+		}
+		else
+		{
+			//the window of the first h frames is the first 2h+1 frames
+			while (std::max(m_NumOut, m_HalfWidth) + m_HalfWidth < m_NumIn)
+				SavitzkyGolay(m_NumOut, -1, out);
+			//the windows of the frames still to come (also the last ones, at Flush) start later
+			int nUnused = std::max(m_NumOut - 2*m_HalfWidth - 1, 0) - m_Base;
+			if (nUnused >= SMOOTH_BLOCK)
+				Drop(nUnused);
+		}
+	}
+	return m_NumOut - nOut;
+}
+
+int MotionSmoother::Flush(std::vector<Posture> &out)
+{
+	int nOut = m_NumOut;
+	if (m_Filter == SMOOTH_BUTTERWORTH && m_NumIn > m_NumOut)
+		Backward(m_NumIn - m_NumOut, out);
+	else if (m_Filter == SMOOTH_SAVITZKY_GOLAY)
+		while (m_NumOut < m_NumIn)
+			SavitzkyGolay(m_NumOut, m_NumIn, out);
+	nOut = m_NumOut - nOut;
+	Reset();
+	return nOut;
+}
+
+int MotionSmoother::Smooth(Motion *pMotion)
+{
+	if (pMotion == NULL || pMotion->m_NumFrames <= 0 || pMotion->m_FrameRate <= 0)
+		return -1;
+
+	//the filters at the rate of the motion, then back at the rate of the stream
+	float fRate = m_FrameRate;
+	m_FrameRate = pMotion->m_FrameRate;
+	std::vector<Posture> out;
+	out.reserve(pMotion->m_NumFrames);
+	Reset();
+	m_bHold = true;
+	Push(pMotion->m_pPostures, pMotion->m_NumFrames, out);
+	Flush(out);
+	m_bHold = false;
+	m_FrameRate = fRate;
+	Reset();
+
+	for (int f = 0; f < pMotion->m_NumFrames; f++)
+		pMotion->m_pPostures[f] = out[f];
+	pMotion->Invalidate();
+	return 0;
+}
@@ -0,0 +1,122 @@
+/*
+	smoothing.h
+
+	Smoothing of the channels of a motion (see channels.h) against capture noise.
+
+	Filters:
+		SMOOTH_BUTTERWORTH      low pass run forward and then backward over the frames, so it
+		                        has no phase lag. The cutoff is corrected (Winter) so that the
+		                        two passes together are 3 dB down at the cutoff frequency.
+		SMOOTH_SAVITZKY_GOLAY   least squares polynomial over a window of 2h+1 frames, which
+		                        keeps peaks better than a low pass; the first and last h frames
+		                        use the window at the end of the motion.
+		SMOOTH_ONE_EURO         causal low pass whose cutoff rises with the speed of the channel
+		                        (Casiez et al.): steady poses are smoothed much, fast moves little.
+	Frames are filtered as rows of features (FeatureLayout, see channels.h), as by the resampler:
+	translations as they are, rotations of bones with one or two dofs as angles unwrapped from
+	frame to frame, rotations of bones with three dofs (the root among them) as unit quaternions
+	kept in the hemisphere of the previous frame. Filtering the three Euler angles of a bone apart would blend
+	angles from both sides of a gimbal flip (near ry = +-90 degrees rx and rz jump by tens of
+	degrees from one frame to the next) into poses that were never captured. Filtered quaternions
+	are normalized before they become Euler angles again, and every angle is put back within 180
+	degrees of its input.
+
+	Streaming: Push takes frames in blocks of any size and appends the frames that are done;
+	Flush ends the stream. Only a bounded number of frames is held, so long captures need not be
+	loaded whole. Savitzky-Golay holds h frames and gives the same result as on the whole motion.
+	The backward Butterworth pass needs the future: it is run over a block plus a lookahead,
+	starting from the steady state of the last frame, and only the block is given out. The
+	lookahead (three periods of the cutoff) lets the start-up of the backward pass die out, so
+	the stream differs from the whole motion by a small fraction of the noise. One-Euro gives out
+	every frame at once. Smooth filters a whole motion in place.
+
+	All filters run over the features of a frame in inner loops the compiler vectorizes; for
+	One-Euro the speed of a quaternion feature is scaled to degrees per second of rotation.
+*/
+
+#ifndef _SMOOTHING_H
+#define _SMOOTHING_H
+
+#include <vector>
+
+#include "motion.h"
+#include "skeleton.h"
+#include "posture.h"
+#include "channels.h"
+
+//Frames given out at once by the streaming Butterworth filter
+#define SMOOTH_BLOCK 256
+#define SMOOTH_MAX_SECTIONS 4
+
+enum SmoothFilter
+{
+	SMOOTH_BUTTERWORTH = 0, SMOOTH_SAVITZKY_GOLAY, SMOOTH_ONE_EURO
+};
+
+class MotionSmoother
+{
+	//member functions
+	public:
+		MotionSmoother(Skeleton *pActor);
+		~MotionSmoother();
+
+		//Frames per second of the stream (default MOCAP_FRAME_RATE); Smooth uses the rate of the motion
+		void SetFrameRate(float fRate);
+		//Cutoff in Hz, order of each pass (even, up to 2*SMOOTH_MAX_SECTIONS)
+		void SetButterworth(float fCutoff, int nOrder = 2);
+		//Window of 2*nHalfWidth+1 frames, polynomial degree
+		void SetSavitzkyGolay(int nHalfWidth, int nDegree);
+		//Cutoff at rest (Hz), growth of the cutoff with the speed of angles (per degree/s) and
+		//of translations (per unit/s), cutoff for the speed estimate (Hz)
+		void SetOneEuro(float fMinCutoff, float fAngleBeta, float fPositionBeta, float fDerivativeCutoff = 1.0f);
+		SmoothFilter GetFilter() const { return m_Filter; }
+
+		//Frames held back by the stream before a frame is given out
+		int GetLatency() const;
+
+		//Filter the whole motion in place, at its m_FrameRate. Returns 0, -1 on error
+		int Smooth(Motion *pMotion);
+
+		//Streaming: the frames that are done are appended to out. Returns their number
+		int Push(Posture const *pFrames, int nCount, std::vector<Posture> &out);
+		int Flush(std::vector<Posture> &out);
+		void Reset();
+
+	private:
+		void Emit(Posture const& in, float const *pRow, std::vector<Posture> &out);
+		void Drop(int nFrames);
+		void Backward(int nFrames, std::vector<Posture> &out);
+		void SavitzkyGolay(int nFrame, int nTotal, std::vector<Posture> &out);
+
+	//member variables
+	private:
+		Skeleton *m_pActor;
+		ChannelLayout m_Layout;
+		FeatureLayout m_Features;
+		SmoothFilter m_Filter;
+		float m_FrameRate;
+
+		//Butterworth: biquad sections (b0 b1 b2 a1 a2), lookahead of the stream
+		float m_Cutoff;
+		int m_Order, m_NumSections, m_Lookahead;
+		float m_Sections[SMOOTH_MAX_SECTIONS][5];
+
+		//Savitzky-Golay: weights of the 2h+1 window frames for every position in the window
+		int m_HalfWidth, m_Degree;
+		std::vector<float> m_Weights;
+
+		//One-Euro
+		float m_MinCutoff, m_AngleBeta, m_PositionBeta, m_DerivativeCutoff;
+		float m_Beta[MAX_FEATURES];
+
+		//stream: frames m_Base .. m_NumIn-1 are held; their postures and rows of features
+		//(after the forward pass for Butterworth)
+		bool m_bHold;							// keep all frames until Flush (Smooth)
+		int m_NumIn, m_NumOut, m_Base;
+		std::vector<Posture> m_Postures;
+		std::vector<float> m_Rows;
+		float m_Previous[MAX_FEATURES];		// features of the last input
+		float m_State[2*SMOOTH_MAX_SECTIONS][MAX_FEATURES];	// forward Butterworth; One-Euro value and speed
+};
+
+#endif
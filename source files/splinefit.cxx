@@ -0,0 +1,334 @@
+#include <cmath>
+#include <algorithm>
+
+#include "splinefit.h"
+#include "threadpool.h"
+
+
+/************************ B-spline fitting **********************************/
+
+//Knot span s of the clamped knot vector T (m control points): T[s] <= t < T[s+1], 3 <= s < m
+static int knot_span(std::vector<double> const& T, int m, double t)
+{
+	if (t >= T[m])
+		return m - 1;
+	return std::max(3, (int)(std::upper_bound(T.begin() + 3, T.begin() + m + 1, t) - T.begin()) - 1);
+}
+
+//The four cubic basis functions that are not zero on span s (The NURBS Book, A2.2)
+static void basis(std::vector<double> const& T, int s, double t, double N[4])
+{
+	double left[4], right[4];
+	N[0] = 1;
+	for (int j = 1; j <= 3; j++)
+	{
+		left[j] = t - T[s + 1 - j];
+		right[j] = T[s + j] - t;
+		double saved = 0;
+		for (int r = 0; r < j; r++)
+		{
+			double temp = N[r]/(right[r + 1] + left[j - r]);
+			N[r] = saved + right[r + 1]*temp;
+			saved = left[j - r]*temp;
+		}
+		N[j] = saved;
+	}
+}
+
+static double spline_value(std::vector<double> const& T, std::vector<double> const& P, double t)
+{
+	int m = (int)P.size(), s = knot_span(T, m, t);
+	double N[4];
+	basis(T, s, t, N);
+	return N[0]*P[s - 3] + N[1]*P[s - 2] + N[2]*P[s - 1] + N[3]*P[s];
+}
+
+//Least squares control points P for knots T and values y at t = 0 .. n-1. The normal equations
+//have 7 diagonals; they are solved by a banded Cholesky factorization
+static void least_squares(std::vector<double> const& T, double const *y, int n, std::vector<double> &P)
+{
+	int m = (int)T.size() - 4;
+	std::vector<double> A((size_t)m*4, 0.0), b(m, 0.0);		// A[4*i + d] = A(i, i-d)
+	for (int f = 0; f < n; f++)
+	{
+		int s = knot_span(T, m, f);
+		double N[4];
+		basis(T, s, f, N);
+		for (int a = 0; a < 4; a++)
+		{
+			b[s - 3 + a] += N[a]*y[f];
+			for (int c = 0; c <= a; c++)
+				A[4*(s - 3 + a) + a - c] += N[a]*N[c];
+		}
+	}
+	//a little ridge for control points that no frame pins down
+	for (int i = 0; i < m; i++)
+		A[4*i] += 1e-9;
+
+	std::vector<double> &L = A;
+	for (int i = 0; i < m; i++)
+		for (int d = std::min(3, i); d >= 0; d--)
+		{
+			int j = i - d;
+			double sum = A[4*i + d];
+			for (int k = std::max(0, i - 3); k < j; k++)
+				sum -= L[4*i + i - k]*L[4*j + j - k];
+			L[4*i + d] = d == 0 ? sqrt(std::max(sum, 1e-300)) : sum/L[4*j];
+		}
+
+	P.resize(m);
+	for (int i = 0; i < m; i++)
+	{
+		double sum = b[i];
+		for (int k = std::max(0, i - 3); k < i; k++)
+			sum -= L[4*i + i - k]*P[k];
+		P[i] = sum/L[4*i];
+	}
+	for (int i = m - 1; i >= 0; i--)
+	{
+		double sum = P[i];
+		for (int k = i + 1; k <= std::min(m - 1, i + 3); k++)
+			sum -= L[4*k + k - i]*P[k];
+		P[i] = sum/L[4*i];
+	}
+}
+
+//Fits y (n values) within fTolerance. Returns the knot vector and the control points
+static void fit_channel(double const *y, int n, double fTolerance, std::vector<double> &T, std::vector<double> &P)
+{
+	std::vector<double> interior;
+	for (int k = SPLINE_INITIAL_SPACING; k < n - 1; k += SPLINE_INITIAL_SPACING)
+		interior.push_back(k);
+
+	std::vector<double> spanError;
+	for (;;)
+	{
+		T.assign(4, 0.0);
+		T.insert(T.end(), interior.begin(), interior.end());
+		T.insert(T.end(), 4, (double)(n - 1));
+		least_squares(T, y, n, P);
+
+		//largest error in every span between interior knots
+		spanError.assign(interior.size() + 1, 0.0);
+		size_t nSpan = 0;
+		for (int f = 0; f < n; f++)
+		{
+			while (nSpan < interior.size() && f >= interior[nSpan])
+				nSpan++;
+			spanError[nSpan] = std::max(spanError[nSpan], fabs(spline_value(T, P, f) - y[f]));
+		}
+
+		std::vector<double> refined;
+		for (size_t k = 0; k <= interior.size(); k++)
+		{
+			double a = k == 0 ? 0.0 : interior[k - 1], b = k == interior.size() ? n - 1.0 : interior[k];
+			if (k > 0)
+				refined.push_back(a);
+			if (spanError[k] > fTolerance && b - a >= 0.25)
+				refined.push_back(0.5*(a + b));
+		}
+		if (refined.size() == interior.size())
+			break;
+		interior.swap(refined);
+	}
+}
+
+//Power form of the spline on [a, b]: c0 + c1 u + c2 u^2 + c3 u^3 with u = t - a,
+//from its values at four points of the span
+static void span_polynomial(std::vector<double> const& T, std::vector<double> const& P, double a, double b, float *pCoefficients)
+{
+	double h = b - a;
+	double V[4][5];
+	for (int i = 0; i < 4; i++)
+	{
+		double x = i/3.0;
+		V[i][0] = 1; V[i][1] = x; V[i][2] = x*x; V[i][3] = x*x*x;
+		V[i][4] = spline_value(T, P, std::min(a + x*h, b));
+	}
+	//Gauss elimination with partial pivoting, in x = u/h
+	for (int col = 0; col < 4; col++)
+	{
+		int nPivot = col;
+		for (int r = col + 1; r < 4; r++)
+			if (fabs(V[r][col]) > fabs(V[nPivot][col]))
+				nPivot = r;
+		for (int c = 0; c < 5; c++)
+			std::swap(V[col][c], V[nPivot][c]);
+		for (int r = 0; r < 4; r++)
+			if (r != col)
+			{
+				double factor = V[r][col]/V[col][col];
+				for (int c = col; c < 5; c++)
+					V[r][c] -= factor*V[col][c];
+			}
+	}
+	double scale = 1;
+	for (int k = 0; k < 4; k++)
+	{
+		pCoefficients[k] = (float)(V[k][4]/V[k][k]/scale);
+		scale *= h;
+	}
+}
+
+
+/************************ SplineMotion class functions **********************************/
+SplineMotion::SplineMotion(Skeleton *pActor) : m_Layout(pActor)
+{
+	m_pActor = pActor;
+	m_AngleTolerance = 0.5f;
+	m_PositionTolerance = 0.005f;
+	m_NumFrames = 0;
+	m_NumCoefficients = 0;
+}
+
+SplineMotion::~SplineMotion()
+{
+}
+
+int SplineMotion::Fit(Motion *pMotion)
+{
+	if (pMotion == NULL || pMotion->m_NumFrames <= 0)
+		return -1;
+
+	int nChannels = m_Layout.m_NumChannels, nFrames = pMotion->m_NumFrames;
+	std::vector<float> values((size_t)nFrames*nChannels);
+	for (int f = 0; f < nFrames; f++)
+		m_Layout.Gather(pMotion->m_pPostures[f], &values[(size_t)f*nChannels]);
+
+	//per channel: span starts and end, polynomials, number of coefficients
+	std::vector<std::vector<float> > starts(nChannels), polynomials(nChannels);
+	std::vector<int> coefficients(nChannels);
+	ThreadPool::GetDefault().ParallelFor(0, nChannels, [&](int nBegin, int nEnd, int nThread)
+	{
+		std::vector<double> y(nFrames), T, P;
+		for (int c = nBegin; c < nEnd; c++)
+		{
+			double offset = 0;
+			for (int f = 0; f < nFrames; f++)
+			{
+				double v = values[(size_t)f*nChannels + c];
+				if (m_Layout.IsAngle(c) && f > 0)
+					offset -= 360.0*floor((v + offset - y[f - 1] + 180.0)/360.0);
+				y[f] = v + offset;
+			}
+
+			if (nFrames == 1)
+			{
+				starts[c].assign(1, 0.0f);
+				starts[c].push_back(0.0f);
+				polynomials[c].assign(4, 0.0f);
+				polynomials[c][0] = (float)y[0];
+				coefficients[c] = 1;
+				continue;
+			}
+
+			fit_channel(y.data(), nFrames, m_Layout.IsAngle(c) ? m_AngleTolerance : m_PositionTolerance, T, P);
+			int m = (int)P.size();
+			starts[c].clear();
+			polynomials[c].clear();
+			for (int s = 3; s < m; s++)
+			{
+				if (T[s + 1] <= T[s])
+					continue;
+				starts[c].push_back((float)T[s]);
+				polynomials[c].resize(polynomials[c].size() + 4);
+				span_polynomial(T, P, T[s], T[s + 1], &polynomials[c][polynomials[c].size() - 4]);
+			}
+			starts[c].push_back((float)(nFrames - 1));
+			coefficients[c] = (m - 4) + m;			// interior knots and control points
+		}
+	}, 1);
+
+	m_NumFrames = nFrames;
+	m_NumCoefficients = 0;
+	m_SpanOffset.assign(1, 0);
+	m_Starts.clear();
+	m_Polynomials.clear();
+	for (int c = 0; c < nChannels; c++)
+	{
+		m_SpanOffset.push_back(m_SpanOffset.back() + (int)starts[c].size() - 1);
+		m_Starts.insert(m_Starts.end(), starts[c].begin(), starts[c].end());
+		m_Polynomials.insert(m_Polynomials.end(), polynomials[c].begin(), polynomials[c].end());
+		m_NumCoefficients += coefficients[c];
+	}
+	return 0;
+}
+
+//Span of the channel containing fTime: the hint or the one after it, else a binary search
+int SplineMotion::FindSpan(int nChannel, float fTime, int nHint) const
+{
+	float const *pStarts = &m_Starts[m_SpanOffset[nChannel] + nChannel];
+	int nSpans = m_SpanOffset[nChannel + 1] - m_SpanOffset[nChannel];
+
+	if (nHint >= 0 && nHint < nSpans && fTime >= pStarts[nHint])
+	{
+		if (fTime < pStarts[nHint + 1] || nHint == nSpans - 1)
+			return nHint;
+		if (fTime < pStarts[nHint + 2] || nHint + 1 == nSpans - 1)
+			return nHint + 1;
+	}
+	int nSpan = (int)(std::upper_bound(pStarts, pStarts + nSpans, fTime) - pStarts) - 1;
+	return std::min(std::max(nSpan, 0), nSpans - 1);
+}
+
+float SplineMotion::Evaluate(int nChannel, float fTime, SplineCursor *pCursor) const
+{
+	fTime = std::min(std::max(fTime, 0.0f), (float)(m_NumFrames - 1));
+	int nHint = -1;
+	if (pCursor != NULL)
+	{
+		if ((int)pCursor->m_Spans.size() != m_Layout.m_NumChannels)
+			pCursor->m_Spans.assign(m_Layout.m_NumChannels, 0);
+		nHint = pCursor->m_Spans[nChannel];
+	}
+
+	int nSpan = FindSpan(nChannel, fTime, nHint);
+	if (pCursor != NULL)
+		pCursor->m_Spans[nChannel] = nSpan;
+
+	float u = fTime - m_Starts[m_SpanOffset[nChannel] + nChannel + nSpan];
+	float const *p = &m_Polynomials[4*(m_SpanOffset[nChannel] + nSpan)];
+	return p[0] + u*(p[1] + u*(p[2] + u*p[3]));
+}
+
+void SplineMotion::Evaluate(float fTime, float *pValues, SplineCursor *pCursor) const
+{
+	int nChannels = m_Layout.m_NumChannels;
+	if (pCursor != NULL && (int)pCursor->m_Spans.size() != nChannels)
+		pCursor->m_Spans.assign(nChannels, 0);
+	fTime = std::min(std::max(fTime, 0.0f), (float)(m_NumFrames - 1));
+
+	for (int c = 0; c < nChannels; c++)
+	{
+		int nSpan = FindSpan(c, fTime, pCursor != NULL ? pCursor->m_Spans[c] : -1);
+		if (pCursor != NULL)
+			pCursor->m_Spans[c] = nSpan;
+		float u = fTime - m_Starts[m_SpanOffset[c] + c + nSpan];
+		float const *p = &m_Polynomials[4*(m_SpanOffset[c] + nSpan)];
+		pValues[c] = p[0] + u*(p[1] + u*(p[2] + u*p[3]));
+	}
+}
+
+void SplineMotion::GetPosture(float fTime, Posture *pPosture, SplineCursor *pCursor) const
+{
+	float values[MAX_CHANNELS];
+	Evaluate(fTime, values, pCursor);
+	m_Layout.Scatter(values, *pPosture);
+}
+
+Motion *SplineMotion::Sample(int nNumFrames) const
+{
+	if (m_NumFrames <= 0 || nNumFrames <= 0)
+		return NULL;
+
+	Motion *pMotion = new Motion(nNumFrames);
+	pMotion->pActor = m_pActor;
+	float fStep = nNumFrames > 1 ? (float)(m_NumFrames - 1)/(nNumFrames - 1) : 0.0f;
+	ThreadPool::GetDefault().ParallelFor(0, nNumFrames, [&](int nBegin, int nEnd, int nThread)
+	{
+		SplineCursor cursor;
+		for (int f = nBegin; f < nEnd; f++)
+			GetPosture(f*fStep, &pMotion->m_pPostures[f], &cursor);
+	}, 256);
+	return pMotion;
+}
@@ -0,0 +1,84 @@
+/*
+	splinefit.h
+
+	Motion stored as one cubic B-spline per channel (see channels.h) instead of a posture per frame.
+
+	Each channel is fitted by least squares with a clamped cubic B-spline over the frame times
+	0 .. nFrames-1 (angles are unwrapped first). The fit starts with a knot every 32 frames; every
+	knot span in which some frame is farther from the spline than the tolerance is split in two,
+	and the channel is fitted again, until all frames are within the tolerance. Quiet channels keep
+	few knots, busy ones get many. The channels are fitted in parallel.
+
+	For evaluation every span is turned into a cubic polynomial in the time from its start, so a
+	channel value is three multiply-adds once its span is known. A SplineCursor remembers the span
+	of every channel from the previous call, so playback and other calls at increasing (or nearby)
+	times find it in O(1); other times fall back to a binary search.
+*/
+
+#ifndef _SPLINEFIT_H
+#define _SPLINEFIT_H
+
+#include <vector>
+
+#include "motion.h"
+#include "skeleton.h"
+#include "posture.h"
+#include "channels.h"
+
+#define SPLINE_INITIAL_SPACING 32
+
+//Span of every channel found by the last evaluation. One per thread
+class SplineCursor
+{
+	friend class SplineMotion;
+	std::vector<int> m_Spans;
+};
+
+class SplineMotion
+{
+	//member functions
+	public:
+		SplineMotion(Skeleton *pActor);
+		~SplineMotion();
+
+		//Largest difference at the frames: degrees for rotations, skeleton units for translations
+		void SetTolerance(float fAngle, float fPosition) { m_AngleTolerance = fAngle; m_PositionTolerance = fPosition; }
+
+		//Fit all channels of the motion. Returns 0, -1 on error
+		int Fit(Motion *pMotion);
+
+		int GetNumFrames() const { return m_NumFrames; }
+		int GetNumChannels() const { return m_Layout.m_NumChannels; }
+		//Knots and control points of the B-splines, the numbers stored for the motion
+		int GetNumCoefficients() const { return m_NumCoefficients; }
+		int GetNumSpans(int nChannel) const { return m_SpanOffset[nChannel + 1] - m_SpanOffset[nChannel]; }
+
+		//Value of one channel at time fTime (in frames, clamped to the motion)
+		float Evaluate(int nChannel, float fTime, SplineCursor *pCursor) const;
+		//All channels at time fTime into pValues (GetNumChannels() floats)
+		void Evaluate(float fTime, float *pValues, SplineCursor *pCursor) const;
+		//Posture at time fTime
+		void GetPosture(float fTime, Posture *pPosture, SplineCursor *pCursor) const;
+
+		//Motion of nNumFrames frames spread evenly over the fitted one. The caller deletes it
+		Motion *Sample(int nNumFrames) const;
+
+	private:
+		int FindSpan(int nChannel, float fTime, int nHint) const;
+
+	//member variables
+	private:
+		Skeleton *m_pActor;
+		ChannelLayout m_Layout;
+		float m_AngleTolerance, m_PositionTolerance;
+		int m_NumFrames;
+		int m_NumCoefficients;
+
+		//spans of channel c are m_SpanOffset[c] .. m_SpanOffset[c+1]-1. m_Starts holds their start
+		//times followed, per channel, by the end time; m_Polynomials 4 coefficients per span
+		std::vector<int> m_SpanOffset;
+		std::vector<float> m_Starts;
+		std::vector<float> m_Polynomials;
+};
+
+#endif
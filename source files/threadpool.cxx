@@ -0,0 +1,122 @@
+#include "threadpool.h"
+#include "profiler.h"
+
+//Set while a thread runs a chunk, so that nested loops do not wait on the pool they run in
+static thread_local bool bInsideTask = false;
+
+
+/************************ ThreadPool class functions **********************************/
+ThreadPool::ThreadPool(int nThreads)
+{
+	if (nThreads <= 0)
+		nThreads = (int)std::thread::hardware_concurrency();
+	if (nThreads <= 0)
+		nThreads = 1;
+
+	m_NumThreads = nThreads;
+	m_bQuit = false;
+	m_Generation = 0;
+	m_NumActive = 0;
+	m_pTask = NULL;
+	m_Begin = m_End = 0;
+	m_Grain = 1;
+	m_NextChunk = 0;
+	m_NumChunks = 0;
+
+	//the calling thread is thread 0
+	for (int i = 1; i < m_NumThreads; i++)
+		m_Workers.push_back(std::thread(&ThreadPool::WorkerLoop, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_bQuit = true;
+	}
+	m_WakeWorkers.notify_all();
+	for (int i = 0; i < (int)m_Workers.size(); i++)
+		m_Workers[i].join();
+}
+
+ThreadPool& ThreadPool::GetDefault()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+void ThreadPool::RunChunks(int nThread)
+{
+	PROFILE_SCOPE("ParallelFor");
+	bInsideTask = true;
+	for (;;)
+	{
+		int nChunk = m_NextChunk.fetch_add(1);
+		if (nChunk >= m_NumChunks)
+			break;
+		int nBegin = m_Begin + nChunk*m_Grain;
+		int nEnd = nBegin + m_Grain < m_End ? nBegin + m_Grain : m_End;
+		(*m_pTask)(nBegin, nEnd, nThread);
+	}
+	bInsideTask = false;
+}
+
+void ThreadPool::WorkerLoop(int nThread)
+{
+	unsigned int nGeneration = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_WakeWorkers.wait(lock, [&] { return m_bQuit || m_Generation != nGeneration; });
+			if (m_bQuit)
+				return;
+			nGeneration = m_Generation;
+		}
+
+		RunChunks(nThread);
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (--m_NumActive == 0)
+			m_LoopDone.notify_one();
+	}
+}
+
+void ThreadPool::ParallelFor(int nBegin, int nEnd, ParallelTask const& task, int nGrain)
+{
+	if (nEnd <= nBegin)
+		return;
+	if (nGrain < 1)
+		nGrain = 1;
+
+	//small loops, nested loops and loops issued while another thread owns the pool run here
+	std::unique_lock<std::mutex> loopLock(m_LoopMutex, std::defer_lock);
+	if (m_NumThreads == 1 || nEnd - nBegin <= nGrain || bInsideTask || !loopLock.try_lock())
+	{
+		bool bWasInside = bInsideTask;
+		bInsideTask = true;
+		for (int i = nBegin; i < nEnd; i += nGrain)
+			task(i, i + nGrain < nEnd ? i + nGrain : nEnd, 0);
+		bInsideTask = bWasInside;
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_pTask = &task;
+		m_Begin = nBegin;
+		m_End = nEnd;
+		m_Grain = nGrain;
+		m_NumChunks = (nEnd - nBegin + nGrain - 1)/nGrain;
+		m_NextChunk = 0;
+		m_NumActive = (int)m_Workers.size();
+		m_Generation++;
+	}
+	m_WakeWorkers.notify_all();
+
+	RunChunks(0);
+
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_LoopDone.wait(lock, [&] { return m_NumActive == 0; });
+	m_pTask = NULL;
+}
@@ -0,0 +1,65 @@
+/*
+	threadpool.h
+
+	Fixed set of worker threads for data parallel loops.
+
+	ParallelFor splits [nBegin, nEnd) into chunks of nGrain items which the workers and
+	the calling thread take in turn until none is left; the call returns when every chunk is done.
+	The task receives the chunk range and the index of the thread running it (0 .. GetNumThreads()-1),
+	so per-thread scratch memory can be allocated once and indexed by it.
+	Loops are run one at a time: a ParallelFor issued from inside a task runs serially on that thread.
+*/
+
+#ifndef _THREADPOOL_H
+#define _THREADPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+typedef std::function<void(int nBegin, int nEnd, int nThread)> ParallelTask;
+
+class ThreadPool
+{
+	//member functions
+	public:
+		//nThreads counts the calling thread; 0 uses every hardware thread
+		ThreadPool(int nThreads = 0);
+		~ThreadPool();
+
+		int GetNumThreads() const { return m_NumThreads; }
+
+		//Run task on every chunk of [nBegin, nEnd) and wait for all of them
+		void ParallelFor(int nBegin, int nEnd, ParallelTask const& task, int nGrain = 1);
+
+		//Pool shared by the library functions, created on first use with every hardware thread
+		static ThreadPool& GetDefault();
+
+	private:
+		void WorkerLoop(int nThread);
+		void RunChunks(int nThread);
+
+	//member variables
+	private:
+		int m_NumThreads;
+		std::vector<std::thread> m_Workers;
+
+		std::mutex m_Mutex;
+		std::condition_variable m_WakeWorkers;
+		std::condition_variable m_LoopDone;
+		std::mutex m_LoopMutex;				// held for the whole of a ParallelFor
+		bool m_bQuit;
+		unsigned int m_Generation;			// incremented for every loop, wakes the workers
+		int m_NumActive;					// workers still inside the current loop
+
+		//current loop
+		ParallelTask const *m_pTask;
+		int m_Begin, m_End, m_Grain;
+		std::atomic<int> m_NextChunk;
+		int m_NumChunks;
+};
+
+#endif
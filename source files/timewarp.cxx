@@ -0,0 +1,275 @@
+#include <cstring>
+#include <cfloat>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TIME_WARP_SSE
+#endif
+
+#include "timewarp.h"
+
+//Subproblems with fewer cells are solved with a full table and traced back
+#define TIME_WARP_TABLE_CELLS (1 << 20)
+
+static float const INF = FLT_MAX;
+
+
+/************************ Row update **********************************/
+
+//One row of the table: cur[l] = cost[l - l0] + min(prev[l-1], prev[l], cur[l-1]) for l in [l0, l1].
+//prev and cur can be read at index -1; cur[l0 - 1] must be INF
+static void update_row(float const *prev, float const *pCost, int l0, int l1, float *cur)
+{
+	int l = l0;
+#ifdef TIME_WARP_SSE
+	//vertical and diagonal steps, four columns at a time
+	for (; l + 4 <= l1 + 1; l += 4)
+	{
+		__m128 m = _mm_min_ps(_mm_loadu_ps(prev + l - 1), _mm_loadu_ps(prev + l));
+		_mm_storeu_ps(cur + l, _mm_add_ps(_mm_loadu_ps(pCost + l - l0), m));
+	}
+#endif
+	for (; l <= l1; l++)
+		cur[l] = pCost[l - l0] + std::min(prev[l - 1], prev[l]);
+
+	//horizontal steps
+	for (l = l0; l <= l1; l++)
+		cur[l] = std::min(cur[l], pCost[l - l0] + cur[l - 1]);
+}
+
+//First row of a subproblem: the start cell, then horizontal steps only
+static void first_row(float const *pCost, int l1, float *cur)
+{
+	cur[0] = pCost[0];
+	for (int l = 1; l <= l1; l++)
+		cur[l] = pCost[l] + cur[l - 1];
+}
+
+
+/************************ TimeWarp class functions **********************************/
+TimeWarp::TimeWarp(int nBand)
+{
+	m_RequestedBand = m_Band = nBand;
+	m_NumA = m_NumB = 0;
+	m_NumCells = m_MaxTableCells = 0;
+}
+
+TimeWarp::~TimeWarp()
+{
+}
+
+void TimeWarp::SetFeatures(float const *pA, int nNumA, float const *pB, int nNumB, int nDimension)
+{
+	m_Costs.SetFeatures(pA, nNumA, pB, nNumB, nDimension);
+	m_NumA = nNumA;
+	m_NumB = nNumB;
+
+	m_Band = m_RequestedBand;
+	if (m_Band > 0 && nNumA > 1)
+		m_Band = std::max(m_Band, (nNumB - 1 + nNumA - 2)/(nNumA - 1));
+}
+
+void TimeWarp::SetMotions(Motion *pA, Motion *pB, PoseFeatureType type)
+{
+	PoseFeatures features(pA->pActor, type);
+	int nDim = features.GetDimension();
+	std::vector<float> featuresA((size_t)pA->m_NumFrames*nDim), featuresB((size_t)pB->m_NumFrames*nDim);
+	features.Compute(pA, featuresA.data());
+	features.Compute(pB, featuresB.data());
+	SetFeatures(featuresA.data(), pA->m_NumFrames, featuresB.data(), pB->m_NumFrames, nDim);
+}
+
+//Columns of row nRow inside the band, clipped to [nCol0, nCol1]
+void TimeWarp::GetBand(int nRow, int nCol0, int nCol1, int *pLo, int *pHi) const
+{
+	*pLo = nCol0;
+	*pHi = nCol1;
+	if (m_Band <= 0 || m_NumA <= 1)
+		return;
+
+	//the diagonal goes from (0, 0) to (nA-1, nB-1)
+	long long n = (long long)nRow*(m_NumB - 1);
+	int nFloor = (int)(n/(m_NumA - 1)), nCeil = (int)((n + m_NumA - 2)/(m_NumA - 1));
+	*pLo = std::max(nCol0, nFloor - m_Band);
+	*pHi = std::min(nCol1, nCeil + m_Band);
+}
+
+//Cost of the best paths from (nRow0, nCol0) to every cell of row nRow1, or with bBackward from
+//(nRow1, nCol1) to every cell of row nRow0. pOut[j - nCol0] is the cost of column j, INF outside the band.
+//The table is walked in local coordinates that run backwards when bBackward, so the same row update serves both
+void TimeWarp::LastRow(int nRow0, int nCol0, int nRow1, int nCol1, bool bBackward, float *pOut)
+{
+	int nWidth = nCol1 - nCol0 + 1, nRows = nRow1 - nRow0 + 1;
+	for (int r = 0; r < 2; r++)
+		m_Rows[r].assign(nWidth + 1, INF);
+	m_CostRow.resize(nWidth);
+
+	float *cur = NULL;
+	int l0 = 0, l1 = 0;
+	for (int k = 0; k < nRows; k++)
+	{
+		int i = bBackward ? nRow1 - k : nRow0 + k;
+		int lo, hi;
+		GetBand(i, nCol0, nCol1, &lo, &hi);
+		l0 = bBackward ? nCol1 - hi : lo - nCol0;
+		l1 = bBackward ? nCol1 - lo : hi - nCol0;
+
+		m_Costs.ComputeRow(i, lo, hi - lo + 1, m_CostRow.data());
+		if (bBackward)
+			std::reverse(m_CostRow.begin(), m_CostRow.begin() + (hi - lo + 1));
+		m_NumCells += hi - lo + 1;
+
+		cur = m_Rows[k & 1].data() + 1;
+		float const *prev = m_Rows[(k + 1) & 1].data() + 1;
+		cur[l0 - 1] = INF;
+		if (k == 0)
+			first_row(m_CostRow.data(), l1, cur);
+		else
+			update_row(prev, m_CostRow.data(), l0, l1, cur);
+	}
+
+	for (int j = 0; j < nWidth; j++)
+		pOut[j] = INF;
+	for (int l = l0; l <= l1; l++)
+		pOut[bBackward ? nWidth - 1 - l : l] = cur[l];
+}
+
+//Full table of the subproblem and trace back from its end. Appends the path from (nRow0, nCol0) to (nRow1, nCol1)
+void TimeWarp::SolveTable(int nRow0, int nCol0, int nRow1, int nCol1, std::vector<WarpStep> &path)
+{
+	int nWidth = nCol1 - nCol0 + 1, nRows = nRow1 - nRow0 + 1;
+	int nStride = nWidth + 1;			// a column of INF on the left of every row
+	m_Table.assign((size_t)nRows*nStride, INF);
+	m_CostRow.resize(nWidth);
+	m_MaxTableCells = std::max(m_MaxTableCells, (long long)nRows*nStride);
+
+	for (int k = 0; k < nRows; k++)
+	{
+		int lo, hi;
+		GetBand(nRow0 + k, nCol0, nCol1, &lo, &hi);
+		m_Costs.ComputeRow(nRow0 + k, lo, hi - lo + 1, m_CostRow.data());
+		m_NumCells += hi - lo + 1;
+
+		float *cur = &m_Table[(size_t)k*nStride + 1];
+		if (k == 0)
+			first_row(m_CostRow.data(), hi - nCol0, cur);
+		else
+			update_row(cur - nStride, m_CostRow.data(), lo - nCol0, hi - nCol0, cur);
+	}
+
+	//trace back, the diagonal step first on ties
+	size_t nStart = path.size();
+	int k = nRows - 1, l = nWidth - 1;
+	for (;;)
+	{
+		WarpStep step = { nRow0 + k, nCol0 + l };
+		path.push_back(step);
+		if (k == 0 && l == 0)
+			break;
+
+		float const *cur = &m_Table[(size_t)k*nStride + 1];
+		float diag = k > 0 ? cur[l - 1 - nStride] : INF;
+		float up = k > 0 ? cur[l - nStride] : INF;
+		float left = cur[l - 1];
+		if (diag <= up && diag <= left)
+			k--, l--;
+		else if (up <= left)
+			k--;
+		else
+			l--;
+	}
+	std::reverse(path.begin() + nStart, path.end());
+}
+
+//Appends the path from (nRow0, nCol0) to (nRow1, nCol1)
+void TimeWarp::Solve(int nRow0, int nCol0, int nRow1, int nCol1, std::vector<WarpStep> &path)
+{
+	int nWidth = nCol1 - nCol0 + 1, nRows = nRow1 - nRow0 + 1;
+	if (nRows <= 2 || (long long)nRows*(nWidth + 1) <= TIME_WARP_TABLE_CELLS)
+	{
+		SolveTable(nRow0, nCol0, nRow1, nCol1, path);
+		return;
+	}
+
+	//the path crosses the middle row at the column of least cost from the start plus cost to the end
+	int nMid = (nRow0 + nRow1)/2;
+	m_Forward.resize(nWidth);
+	m_Backward.resize(nWidth);
+	LastRow(nRow0, nCol0, nMid, nCol1, false, m_Forward.data());
+	LastRow(nMid, nCol0, nRow1, nCol1, true, m_Backward.data());
+
+	int lo, hi;
+	GetBand(nMid, nCol0, nCol1, &lo, &hi);
+	m_CostRow.resize(nWidth);
+	m_Costs.ComputeRow(nMid, lo, hi - lo + 1, m_CostRow.data());
+	int nSplit = -1;
+	float fBest = INF;
+	for (int j = lo; j <= hi; j++)
+	{
+		float f = m_Forward[j - nCol0], b = m_Backward[j - nCol0];
+		if (f == INF || b == INF)
+			continue;
+		float fTotal = f + b - m_CostRow[j - lo];
+		if (fTotal < fBest)
+		{
+			fBest = fTotal;
+			nSplit = j;
+		}
+	}
+
+	Solve(nRow0, nCol0, nMid, nSplit, path);
+	path.pop_back();					// (nMid, nSplit) starts the second half again
+	Solve(nMid, nSplit, nRow1, nCol1, path);
+}
+
+float TimeWarp::Align(std::vector<WarpStep> &path)
+{
+	path.clear();
+	m_NumCells = m_MaxTableCells = 0;
+	if (m_NumA <= 0 || m_NumB <= 0)
+		return -1;
+
+	Solve(0, 0, m_NumA - 1, m_NumB - 1, path);
+
+	double cost = 0;
+	for (size_t s = 0; s < path.size(); s++)
+		cost += m_Costs.GetDistance(path[s].frameA, path[s].frameB);
+	return (float)cost;
+}
+
+float TimeWarp::GetCost()
+{
+	m_NumCells = m_MaxTableCells = 0;
+	if (m_NumA <= 0 || m_NumB <= 0)
+		return -1;
+
+	m_Forward.resize(m_NumB);
+	LastRow(0, 0, m_NumA - 1, m_NumB - 1, false, m_Forward.data());
+	return m_Forward[m_NumB - 1];
+}
+
+Motion *TimeWarp::Warp(Motion *pB, std::vector<WarpStep> const& path, int nNumFramesA)
+{
+	std::vector<double> sum(nNumFramesA, 0);
+	std::vector<int> count(nNumFramesA, 0);
+	for (size_t s = 0; s < path.size(); s++)
+	{
+		sum[path[s].frameA] += path[s].frameB;
+		count[path[s].frameA]++;
+	}
+
+	Motion *pWarped = new Motion(nNumFramesA);
+	pWarped->pActor = pB->pActor;
+	for (int i = 0; i < nNumFramesA; i++)
+	{
+		double t = count[i] > 0 ? sum[i]/count[i] : 0;
+		int j = std::min((int)t, pB->m_NumFrames - 1);
+		float f = (float)(t - j);
+		if (f > 0 && j + 1 < pB->m_NumFrames)
+			pWarped->m_pPostures[i] = LinearInterpolate(f, pB->m_pPostures[j], pB->m_pPostures[j + 1]);
+		else
+			pWarped->m_pPostures[i] = pB->m_pPostures[j];
+	}
+	return pWarped;
+}
@@ -0,0 +1,80 @@
+/*
+	timewarp.h
+
+	Dynamic time warping of a motion B onto a motion A: the monotonic frame to frame
+	correspondence (warp path) of least total pose distance, e.g. to line up two takes of the
+	same performance instead of shifting one of them by a constant number of frames.
+
+	The local cost of frames i and j is their pose distance (see distmatrix.h) and the path
+	goes from (0, 0) to (nA-1, nB-1) by steps (1,0), (0,1) and (1,1).
+
+	Only cells within nBand frames of the diagonal are considered (Sakoe-Chiba band); nBand 0
+	is the whole matrix. The path is recovered in linear memory, Hirschberg style: the cost of
+	the middle row is computed forward from the start and backward from the end, the path
+	crosses it at the column of least total, and both halves are solved the same way until they
+	are small enough for a full table. The rows are updated with SSE: the costs of a row and the
+	vertical and diagonal minima are computed four columns at a time, only the horizontal
+	step is sequential.
+*/
+
+#ifndef _TIMEWARP_H
+#define _TIMEWARP_H
+
+#include <vector>
+
+#include "motion.h"
+#include "poseindex.h"
+#include "distmatrix.h"
+
+//Frame frameA of motion A corresponds to frame frameB of motion B
+struct WarpStep
+{
+	int frameA;
+	int frameB;
+};
+
+class TimeWarp
+{
+	//member functions
+	public:
+		//nBand is the half width of the band in frames around the diagonal, 0 for no band
+		TimeWarp(int nBand = 0);
+		~TimeWarp();
+
+		void SetMotions(Motion *pA, Motion *pB, PoseFeatureType type = POSE_FEATURE_JOINTS);
+		void SetFeatures(float const *pA, int nNumA, float const *pB, int nNumB, int nDimension);
+
+		//Warp path from (0, 0) to (nA-1, nB-1). Returns its total cost, -1 if there are no frames
+		float Align(std::vector<WarpStep> &path);
+
+		//Total cost of the best path only (no path, one row pair of memory)
+		float GetCost();
+
+		//Cells of the table evaluated by the last Align or GetCost, and the largest table held
+		long long GetNumCells() const { return m_NumCells; }
+		long long GetMaxTableCells() const { return m_MaxTableCells; }
+
+		//Motion B played on the time of motion A: frame i is B at the mean of the frames matched
+		//with frame i of A (interpolated when that falls between frames). The caller deletes it
+		static Motion *Warp(Motion *pB, std::vector<WarpStep> const& path, int nNumFramesA);
+
+	private:
+		void GetBand(int nRow, int nCol0, int nCol1, int *pLo, int *pHi) const;
+		void LastRow(int nRow0, int nCol0, int nRow1, int nCol1, bool bBackward, float *pOut);
+		void Solve(int nRow0, int nCol0, int nRow1, int nCol1, std::vector<WarpStep> &path);
+		void SolveTable(int nRow0, int nCol0, int nRow1, int nCol1, std::vector<WarpStep> &path);
+
+	//member variables
+	private:
+		DistanceMatrix m_Costs;
+		int m_NumA, m_NumB;
+		int m_RequestedBand;
+		int m_Band;						// widened to the slope of the diagonal, so that the band is connected
+		long long m_NumCells, m_MaxTableCells;
+
+		//scratch, one row each
+		std::vector<float> m_Rows[2], m_CostRow, m_Forward, m_Backward;
+		std::vector<float> m_Table;
+};
+
+#endif
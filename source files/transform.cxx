@@ -113,7 +113,6 @@ void matrix_mult(double a[][4], double b[][4], double c[][4])
 */
 void vector_rotationXYZ(float *v, float a, float b, float c)
 {
-    float x, y, z;
     double Rx[4][4], Ry[4][4], Rz[4][4];
 
 	//Rz is a rotation matrix about Z axis by angle c, same for Ry and Rx
@@ -183,4 +182,127 @@ float GetAngle(float* v1, float* v2, float* axis)
 	}
 	return theta;
 #endif
-}
\ No newline at end of file
+}
+
+/* Rotation matrix R = Rz(c) * Ry(b) * Rx(a) of the euler angles (a, b, c) in degrees,
+   the same product as in Skeleton::computeJointPositions
+*/
+void euler_to_matrix(float const angles[3], float R[3][3])
+{
+	float a = angles[0]*M_PI/180., b = angles[1]*M_PI/180., c = angles[2]*M_PI/180.;
+	float sa = sin(a), ca = cos(a), sb = sin(b), cb = cos(b), sc = sin(c), cc = cos(c);
+	R[0][0] = cc*cb; R[0][1] = cc*sb*sa - sc*ca; R[0][2] = cc*sb*ca + sc*sa;
+	R[1][0] = sc*cb; R[1][1] = sc*sb*sa + cc*ca; R[1][2] = sc*sb*ca - cc*sa;
+	R[2][0] = -sb;   R[2][1] = cb*sa;            R[2][2] = cb*ca;
+}
+
+/* Euler angles of R = Rz * Ry * Rx, with the y angle in [-90, 90].
+   At y = +-90 (gimbal lock) only x - z or x + z is defined; z is set to 0
+*/
+void matrix_to_euler(float const R[3][3], float angles[3])
+{
+	float sb = -R[2][0];
+	if (sb > 1.) sb = 1.;
+	if (sb < -1.) sb = -1.;
+	float b = asin(sb), a, c;
+	if (fabs(sb) < 0.99999)
+	{
+		a = atan2(R[2][1], R[2][2]);
+		c = atan2(R[1][0], R[0][0]);
+	}
+	else
+	{
+		a = atan2(-R[1][2], R[1][1]);
+		c = 0.;
+	}
+	angles[0] = a*180./M_PI;
+	angles[1] = b*180./M_PI;
+	angles[2] = c*180./M_PI;
+}
+
+
+//q = qz * qy * qx, the rotation of euler_to_matrix
+void euler_to_quaternion(float const angles[3], float q[4])
+{
+	float a = angles[0]*M_PI/360., b = angles[1]*M_PI/360., c = angles[2]*M_PI/360.;
+	float sa = sin(a), ca = cos(a), sb = sin(b), cb = cos(b), sc = sin(c), cc = cos(c);
+	q[0] = cc*cb*ca + sc*sb*sa;
+	q[1] = cc*cb*sa - sc*sb*ca;
+	q[2] = cc*sb*ca + sc*cb*sa;
+	q[3] = sc*cb*ca - cc*sb*sa;
+}
+
+void quaternion_to_matrix(float const q[4], float R[3][3])
+{
+	float w = q[0], x = q[1], y = q[2], z = q[3];
+	R[0][0] = 1 - 2*(y*y + z*z); R[0][1] = 2*(x*y - w*z);     R[0][2] = 2*(x*z + w*y);
+	R[1][0] = 2*(x*y + w*z);     R[1][1] = 1 - 2*(x*x + z*z); R[1][2] = 2*(y*z - w*x);
+	R[2][0] = 2*(x*z - w*y);     R[2][1] = 2*(y*z + w*x);     R[2][2] = 1 - 2*(x*x + y*y);
+}
+
+void quaternion_to_euler(float const q[4], float angles[3])
+{
+	float R[3][3];
+	quaternion_to_matrix(q, R);
+	matrix_to_euler(R, angles);
+}
+
+
+void matrix3_multiply(float const A[3][3], float const B[3][3], float C[3][3])
+{
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 3; j++)
+			C[i][j] = A[i][0]*B[0][j] + A[i][1]*B[1][j] + A[i][2]*B[2][j];
+}
+
+void matrix3_transpose(float const A[3][3], float T[3][3])
+{
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 3; j++)
+			T[i][j] = A[j][i];
+}
+
+void matrix3_identity(float R[3][3])
+{
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 3; j++)
+			R[i][j] = i == j ? 1.0f : 0.0f;
+}
+
+//Rodrigues about the unit axis of a x b by the angle between them
+bool rotation_between(float const a[3], float const b[3], float R[3][3])
+{
+	float axis[3] = { a[1]*b[2] - a[2]*b[1], a[2]*b[0] - a[0]*b[2], a[0]*b[1] - a[1]*b[0] };
+	float s = sqrtf(axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2]);
+	float c = a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+	float la = sqrtf(a[0]*a[0] + a[1]*a[1] + a[2]*a[2]), lb = sqrtf(b[0]*b[0] + b[1]*b[1] + b[2]*b[2]);
+
+	if (s <= 1e-6f*la*lb)
+	{
+		if (c > 0)
+		{
+			matrix3_identity(R);
+			return false;
+		}
+		//opposite: half turn about any axis p perpendicular to a
+		float p[3] = { 0, -a[2], a[1] };
+		if (fabsf(a[0]) > 0.9f*la)
+			p[0] = -a[2], p[1] = 0, p[2] = a[0];
+		float n2 = p[0]*p[0] + p[1]*p[1] + p[2]*p[2];
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 3; j++)
+				R[i][j] = 2*p[i]*p[j]/n2 - (i == j ? 1.0f : 0.0f);
+		return true;
+	}
+
+	float angle = atan2f(s, c), cs = cosf(angle), sn = sinf(angle);
+	for (int i = 0; i < 3; i++)
+		axis[i] /= s;
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 3; j++)
+			R[i][j] = (i == j ? cs : 0.0f) + (1 - cs)*axis[i]*axis[j];
+	R[0][1] -= sn*axis[2]; R[0][2] += sn*axis[1];
+	R[1][0] += sn*axis[2]; R[1][2] -= sn*axis[0];
+	R[2][0] -= sn*axis[1]; R[2][1] += sn*axis[0];
+	return true;
+}
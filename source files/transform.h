@@ -35,4 +35,23 @@ void rotationZ(double r[][4], float a);
 //Return the angle between vectors v1 and v2 around the given axis 
 float GetAngle(float* v1, float* v2, float* axis);
 
+//Rotation matrix of euler angles in degrees, in the order of the AMC file: R = Rz * Ry * Rx
+void euler_to_matrix(float const angles[3], float R[3][3]);
+//Euler angles (degrees) of a rotation matrix, inverse of euler_to_matrix
+void matrix_to_euler(float const R[3][3], float angles[3]);
+
+//Unit quaternions q = (w, x, y, z)
+void euler_to_quaternion(float const angles[3], float q[4]);
+void quaternion_to_matrix(float const q[4], float R[3][3]);
+//Euler angles (degrees) of q, as matrix_to_euler
+void quaternion_to_euler(float const q[4], float angles[3]);
+
+//3x3 rotation matrices: C = A * B, T = A^T, R = I
+void matrix3_multiply(float const A[3][3], float const B[3][3], float C[3][3]);
+void matrix3_transpose(float const A[3][3], float T[3][3]);
+void matrix3_identity(float R[3][3]);
+//Shortest rotation R taking the direction of a onto that of b (neither of length 0). Returns false,
+//with R the identity, when they already point the same way; opposite ones give a half turn
+bool rotation_between(float const a[3], float const b[3], float R[3][3]);
+
 #endif
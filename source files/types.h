@@ -12,6 +12,9 @@
 
 #define PM_MAX_FRAMES 60000
 
+// Frames per second of the AMC files (they do not store it)
+#define MOCAP_FRAME_RATE 120
+
 #ifndef M_PI
 #define M_PI 3.14159265
 #endif
@@ -0,0 +1,152 @@
+/*
+	amc_write_bench.cxx
+
+	Throughput of Motion::writeAMCfile (buffered AMCWriter) against the previous
+	std::ofstream writer, which is kept here as the reference.
+
+	amc_write_bench <asf file> <amc file> [-repeat n] [-runs n] [-o dir]
+		The motion is repeated n times (default 20) to get a file large enough to time.
+		Each writer runs -runs times (default 3); the best run is reported.
+		The file written by AMCWriter is read back and compared with the motion.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+
+#include "skeleton.h"
+#include "motion.h"
+#include "channels.h"
+
+
+//The writer as it was before AMCWriter: one << per value and std::endl per line
+static int write_amc_ofstream(Motion *pMotion, char *filename, float scale)
+{
+	Skeleton *pActor = pMotion->pActor;
+	Bone *bone = pActor->getRoot();
+
+	std::ofstream os(filename);
+	if (os.fail()) return -1;
+
+	os << "#Unknow ASF file" << std::endl;
+	os << ":FULLY-SPECIFIED" << std::endl;
+	os << ":DEGREES" << std::endl;
+	int numbones = numBonesInSkel(bone[0]);
+
+	for (int f = 0; f < pMotion->m_NumFrames; f++)
+	{
+		Posture &posture = pMotion->m_pPostures[f];
+		os << f+1 << std::endl;
+		os << "root " << posture.root_pos.p[0]/scale << " "
+					  << posture.root_pos.p[1]/scale << " "
+					  << posture.root_pos.p[2]/scale << " "
+					  << posture.bone_rotation[root].p[0] << " "
+					  << posture.bone_rotation[root].p[1] << " "
+					  << posture.bone_rotation[root].p[2];
+
+		for (int j = 2; j < numbones; j++)
+		{
+			if (bone[j].dof != 0)
+				os << std::endl << pActor->idx2name(j);
+			if (bone[j].dofx == 1)
+				os << " " << posture.bone_rotation[j].p[0];
+			if (bone[j].dofy == 1)
+				os << " " << posture.bone_rotation[j].p[1];
+			if (bone[j].dofz == 1)
+				os << " " << posture.bone_rotation[j].p[2];
+		}
+		os << std::endl;
+	}
+	os.close();
+	return 0;
+}
+
+static long long file_size(char *filename)
+{
+	FILE *pFile = fopen(filename, "rb");
+	if (pFile == NULL)
+		return 0;
+	fseek(pFile, 0, SEEK_END);
+	long long size = ftell(pFile);
+	fclose(pFile);
+	return size;
+}
+
+
+int main(int argc, char **argv)
+{
+	if (argc < 3)
+	{
+		printf("usage: amc_write_bench <asf file> <amc file> [-repeat n] [-runs n] [-o dir]\n");
+		return 1;
+	}
+
+	int nRepeat = 20, nRuns = 3;
+	char const *pDir = ".";
+	for (int i = 3; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-repeat") == 0 && i + 1 < argc) nRepeat = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-runs") == 0 && i + 1 < argc) nRuns = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) pDir = argv[++i];
+	}
+	if (nRepeat < 1) nRepeat = 1;
+	if (nRuns < 1) nRuns = 1;
+
+	Skeleton *pActor = new Skeleton(argv[1], MOCAP_SCALE);
+	Motion *pInput = new Motion(argv[2], MOCAP_SCALE, pActor);
+	if (pInput->m_NumFrames <= 0)
+		return 1;
+
+	//lengthen the motion
+	Motion *pMotion = new Motion(pInput->m_NumFrames*nRepeat);
+	pMotion->pActor = pActor;
+	for (int f = 0; f < pMotion->m_NumFrames; f++)
+		pMotion->SetPosture(f, pInput->m_pPostures[f % pInput->m_NumFrames]);
+
+	char streamFile[MAX_CHAR], bufferedFile[MAX_CHAR];
+	sprintf(streamFile, "%s/bench_ofstream.amc", pDir);
+	sprintf(bufferedFile, "%s/bench_amcwriter.amc", pDir);
+
+	double bestStream = 1e30, bestBuffered = 1e30;
+	for (int r = 0; r < nRuns; r++)
+	{
+		auto t0 = std::chrono::steady_clock::now();
+		write_amc_ofstream(pMotion, streamFile, MOCAP_SCALE);
+		auto t1 = std::chrono::steady_clock::now();
+		pMotion->writeAMCfile(bufferedFile, MOCAP_SCALE);
+		auto t2 = std::chrono::steady_clock::now();
+
+		bestStream = std::min(bestStream, std::chrono::duration<double>(t1 - t0).count());
+		bestBuffered = std::min(bestBuffered, std::chrono::duration<double>(t2 - t1).count());
+	}
+
+	long long streamSize = file_size(streamFile), bufferedSize = file_size(bufferedFile);
+	printf("\n%d frames\n", pMotion->m_NumFrames);
+	printf("%-12s %10s %12s %10s %12s\n", "writer", "seconds", "frames/s", "MB/s", "bytes");
+	printf("%-12s %10.3f %12.0f %10.1f %12lld\n", "ofstream", bestStream,
+		pMotion->m_NumFrames/bestStream, streamSize/bestStream/1e6, streamSize);
+	printf("%-12s %10.3f %12.0f %10.1f %12lld\n", "AMCWriter", bestBuffered,
+		pMotion->m_NumFrames/bestBuffered, bufferedSize/bestBuffered/1e6, bufferedSize);
+	printf("speedup %.1fx\n", bestStream/bestBuffered);
+
+	//the shortest round-trip text gives back the same floats (translations up to the scale division)
+	Motion *pCheck = new Motion(bufferedFile, MOCAP_SCALE, pActor);
+	ChannelLayout layout(pActor);
+	double maxDiff = 0;
+	int nFrames = std::min(pCheck->m_NumFrames, pMotion->m_NumFrames);
+	for (int f = 0; f < nFrames; f++)
+		for (int c = 0; c < layout.m_NumChannels; c++)
+			maxDiff = std::max(maxDiff, (double)fabs(layout.GetValue(pCheck->m_pPostures[f], c) - layout.GetValue(pMotion->m_pPostures[f], c)));
+	printf("read back %d of %d frames, max difference %g\n", pCheck->m_NumFrames, pMotion->m_NumFrames, maxDiff);
+	bool bComplete = pCheck->m_NumFrames == pMotion->m_NumFrames;
+
+	delete pCheck;
+	delete pMotion;
+	delete pInput;
+	delete pActor;
+	return bComplete ? 0 : 1;
+}
@@ -0,0 +1,159 @@
+/*
+	dist_matrix.cxx
+
+	Frame to frame distance matrix of two motions (see distmatrix.h).
+
+	dist_matrix <asf file> <amc file A> <amc file B> [-threshold t] [-features joints|angles]
+	            [-repeat n] [-pgm file] [-show n]
+		Times the full matrix and the streaming local minima search, checks the matrix against
+		a plain scalar computation and prints the n best transition candidates (default 10).
+		-repeat    tiles the motions n times to time longer clips (the full matrix is then skipped
+		           above 20000 x 20000 frames)
+		-pgm       writes the matrix as a grey level image
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include "skeleton.h"
+#include "motion.h"
+#include "poseindex.h"
+#include "distmatrix.h"
+#include "threadpool.h"
+
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::vector<float> features_of(Motion *pMotion, PoseFeatures const& features, int nRepeat)
+{
+	int nDim = features.GetDimension();
+	std::vector<float> values((size_t)pMotion->m_NumFrames*nDim*nRepeat);
+	features.Compute(pMotion, values.data());
+	for (int r = 1; r < nRepeat; r++)
+		std::copy(values.begin(), values.begin() + (size_t)pMotion->m_NumFrames*nDim, values.begin() + (size_t)r*pMotion->m_NumFrames*nDim);
+	return values;
+}
+
+static int write_pgm(char const *filename, float const *pMatrix, int nRows, int nCols)
+{
+	FILE *pFile = fopen(filename, "wb");
+	if (pFile == NULL)
+		return -1;
+
+	float fMax = 0;
+	for (size_t i = 0; i < (size_t)nRows*nCols; i++)
+		fMax = std::max(fMax, pMatrix[i]);
+	fprintf(pFile, "P5\n%d %d\n255\n", nCols, nRows);
+	std::vector<unsigned char> row(nCols);
+	for (int i = 0; i < nRows; i++)
+	{
+		for (int j = 0; j < nCols; j++)
+			row[j] = (unsigned char)(fMax > 0 ? 255.0f*pMatrix[(size_t)i*nCols + j]/fMax : 0);
+		fwrite(row.data(), 1, nCols, pFile);
+	}
+	return fclose(pFile) == 0 ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 4)
+	{
+		printf("usage: dist_matrix <asf file> <amc file A> <amc file B> [-threshold t] [-features joints|angles] [-repeat n] [-pgm file] [-show n]\n");
+		return 1;
+	}
+
+	float fThreshold = -1;
+	PoseFeatureType type = POSE_FEATURE_JOINTS;
+	int nRepeat = 1, nShow = 10;
+	char const *pPgm = NULL;
+	for (int i = 4; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-threshold") == 0 && i + 1 < argc) fThreshold = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "-features") == 0 && i + 1 < argc)
+			type = strcmp(argv[++i], "angles") == 0 ? POSE_FEATURE_ANGLES : POSE_FEATURE_JOINTS;
+		else if (strcmp(argv[i], "-repeat") == 0 && i + 1 < argc) nRepeat = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "-pgm") == 0 && i + 1 < argc) pPgm = argv[++i];
+		else if (strcmp(argv[i], "-show") == 0 && i + 1 < argc) nShow = atoi(argv[++i]);
+	}
+
+	Skeleton *pActor = new Skeleton(argv[1], MOCAP_SCALE);
+	Motion *pA = new Motion(argv[2], MOCAP_SCALE, pActor);
+	Motion *pB = new Motion(argv[3], MOCAP_SCALE, pActor);
+	if (pA->m_NumFrames <= 0 || pB->m_NumFrames <= 0)
+		return 1;
+
+	PoseFeatures features(pActor, type);
+	int nDim = features.GetDimension();
+	std::vector<float> featuresA = features_of(pA, features, nRepeat), featuresB = features_of(pB, features, nRepeat);
+	int nA = pA->m_NumFrames*nRepeat, nB = pB->m_NumFrames*nRepeat;
+
+	DistanceMatrix matrix;
+	matrix.SetFeatures(featuresA.data(), nA, featuresB.data(), nB, nDim);
+	double nPairs = (double)nA*nB;
+	printf("\n%d x %d frames, %d features, %d threads\n", nA, nB, nDim, ThreadPool::GetDefault().GetNumThreads());
+
+	int nResult = 0;
+	if (nPairs <= 4e8)
+	{
+		std::vector<float> full((size_t)nA*nB);
+		auto start = std::chrono::steady_clock::now();
+		matrix.Compute(full.data());
+		double seconds = seconds_since(start);
+		printf("full matrix      %8.3f s  %8.1f Mpairs/s  %6.2f GFLOP/s  %.1f MB\n", seconds, nPairs/seconds/1e6,
+			3.0*nPairs*nDim/seconds/1e9, nPairs*sizeof(float)/1e6);
+
+		//plain scalar computation of a sample of the entries
+		double maxDiff = 0;
+		for (int i = 0; i < nA; i += std::max(1, nA/97))
+			for (int j = 0; j < nB; j += std::max(1, nB/89))
+			{
+				double sum = 0;
+				for (int d = 0; d < nDim; d++)
+				{
+					double diff = featuresA[(size_t)i*nDim + d] - featuresB[(size_t)j*nDim + d];
+					sum += diff*diff;
+				}
+				maxDiff = std::max(maxDiff, fabs(sqrt(sum) - full[(size_t)i*nB + j]));
+			}
+		printf("max difference to the scalar reference %g\n", maxDiff);
+		if (maxDiff > 1e-3)
+			nResult = 1;
+
+		//default threshold: a quarter of the median distance
+		if (fThreshold < 0)
+		{
+			std::vector<float> sample;
+			for (size_t i = 0; i < full.size(); i += 7)
+				sample.push_back(full[i]);
+			std::nth_element(sample.begin(), sample.begin() + sample.size()/2, sample.end());
+			fThreshold = 0.25f*sample[sample.size()/2];
+		}
+		if (pPgm != NULL && write_pgm(pPgm, full.data(), nA, nB) != 0)
+			printf("Cannot write '%s'\n", pPgm);
+	}
+	else if (fThreshold < 0)
+		fThreshold = 0.25f*matrix.GetDistance(0, nB/2);
+
+	std::vector<DistanceMinimum> minima;
+	auto start = std::chrono::steady_clock::now();
+	matrix.FindLocalMinima(fThreshold, minima);
+	double seconds = seconds_since(start);
+	printf("local minima     %8.3f s  %8.1f Mpairs/s  %d minima below %g, %.1f MB of tiles\n", seconds, nPairs/seconds/1e6,
+		(int)minima.size(), fThreshold, (double)ThreadPool::GetDefault().GetNumThreads()*(DIST_MATRIX_TILE + 2)*(DIST_MATRIX_TILE + 2)*sizeof(float)/1e6);
+
+	for (int i = 0; i < nShow && i < (int)minima.size(); i++)
+		printf("  A %6d  B %6d  distance %g\n", minima[i].frameA + 1, minima[i].frameB + 1, minima[i].distance);
+
+	delete pB;
+	delete pA;
+	delete pActor;
+	return nResult;
+}
@@ -0,0 +1,154 @@
+/*
+	foot_contacts.cxx
+
+	Labels the foot contacts of motions (see contacts.h) and checks the labels.
+
+	foot_contacts <asf file> <amc file>... [-ground y] [-height enter leave] [-speed enter leave]
+	              [-block n] [-o dir]
+		-ground     height of the ground plane (default 0, the plane the player draws)
+		-height     enter and leave heights above the ground (default 0.07 0.1)
+		-speed      enter and leave speeds in units per second (default 0.5 0.9)
+		-block      frames per Push call of the stream (default 64)
+		-o          writes <name>.contacts for every motion into dir
+	For every motion: the time of Detect (frames/s), whether the stream gives the same labels
+	and the file reads back the same, and for every joint the part of the frames in contact,
+	the number of contacts and the rms speed of the joint while in contact (foot skate).
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include "skeleton.h"
+#include "motion.h"
+#include "kinematics.h"
+#include "contacts.h"
+
+
+static char const *jointNames[NUM_CONTACT_JOINTS] = { "lfoot", "rfoot", "ltoes", "rtoes" };
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool same_labels(FootContacts const& a, FootContacts const& b)
+{
+	if (a.GetNumFrames() != b.GetNumFrames())
+		return false;
+	for (int f = 0; f < a.GetNumFrames(); f++)
+		if (a.GetMask(f) != b.GetMask(f))
+			return false;
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<char *> amcFiles;
+	char const *pOutDir = NULL;
+	float fGround = 0, fEnterHeight = 0.07f, fLeaveHeight = 0.1f, fEnterSpeed = 0.5f, fLeaveSpeed = 0.9f;
+	int nBlock = 64;
+	for (int i = 2; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-ground") == 0 && i + 1 < argc) fGround = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "-height") == 0 && i + 2 < argc)
+		{
+			fEnterHeight = (float)atof(argv[++i]);
+			fLeaveHeight = (float)atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-speed") == 0 && i + 2 < argc)
+		{
+			fEnterSpeed = (float)atof(argv[++i]);
+			fLeaveSpeed = (float)atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-block") == 0 && i + 1 < argc) nBlock = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) pOutDir = argv[++i];
+		else amcFiles.push_back(argv[i]);
+	}
+	if (argc < 3 || amcFiles.empty())
+	{
+		printf("usage: foot_contacts <asf file> <amc file>... [-ground y] [-height enter leave] [-speed enter leave]\n");
+		printf("                     [-block n] [-o dir]\n");
+		return 1;
+	}
+
+	Skeleton *pActor = new Skeleton(argv[1], MOCAP_SCALE);
+	ContactDetector detector(pActor);
+	detector.SetGround(fGround);
+	detector.SetHeights(fEnterHeight, fLeaveHeight);
+	detector.SetSpeeds(fEnterSpeed, fLeaveSpeed);
+
+	printf("\n%-28s %7s %10s %7s %5s", "motion", "frames", "frames/s", "stream", "file");
+	for (int j = 0; j < NUM_CONTACT_JOINTS; j++)
+		printf(" %19s", jointNames[j]);
+	printf("\n");
+
+	int nResult = 0;
+	for (int i = 0; i < (int)amcFiles.size(); i++)
+	{
+		Motion *pMotion = new Motion(amcFiles[i], MOCAP_SCALE, pActor);
+		if (pMotion->m_NumFrames <= 0)
+		{
+			nResult = 1;
+			delete pMotion;
+			continue;
+		}
+
+		FootContacts *pContacts = new FootContacts();
+		int nRepeat = 20;
+		auto start = std::chrono::steady_clock::now();
+		for (int r = 0; r < nRepeat; r++)
+			detector.Detect(pMotion, pContacts);
+		double seconds = seconds_since(start)/nRepeat;
+
+		FootContacts stream;
+		detector.Reset();
+		for (int f = 0; f < pMotion->m_NumFrames; f += nBlock)
+			detector.Push(pMotion->m_pPostures + f, std::min(nBlock, pMotion->m_NumFrames - f), &stream);
+		detector.Flush(&stream);
+		bool bStream = same_labels(*pContacts, stream);
+
+		char const *pName = strrchr(amcFiles[i], '/') != NULL ? strrchr(amcFiles[i], '/') + 1 : amcFiles[i];
+		std::string name = pName;
+		name = name.substr(0, name.rfind('.'));
+		std::string file = pOutDir != NULL ? std::string(pOutDir) + "/" + name + ".contacts" : std::string("foot_contacts.tmp");
+		FootContacts read;
+		bool bFile = pContacts->Write(file.c_str()) == 0 && read.Read(file.c_str()) == 0 && same_labels(*pContacts, read);
+		if (pOutDir == NULL)
+			remove(file.c_str());
+
+		printf("%-28s %7d %10.0f %7s %5s", pName, pMotion->m_NumFrames, pMotion->m_NumFrames/seconds,
+			bStream ? "same" : "DIFF", bFile ? "ok" : "FAIL");
+		if (!bStream || !bFile)
+			nResult = 1;
+
+		//the motion keeps the labels; the kinematics give the speed of the planted joints
+		pMotion->SetContacts(pContacts);
+		MotionKinematics const *pKinematics = pMotion->GetKinematics();
+		for (int j = 0; j < NUM_CONTACT_JOINTS; j++)
+		{
+			std::vector<int> firsts, lasts;
+			int nContacts = pContacts->GetIntervals(j, firsts, lasts);
+			int nBone = detector.GetBone(j);
+			double sum = 0;
+			for (int f = 0; f < pMotion->m_NumFrames && nBone >= 0; f++)
+				if (pContacts->IsContact(f, j))
+				{
+					float const *v = pKinematics->GetVelocity(f, nBone);
+					sum += v[0]*v[0] + v[1]*v[1] + v[2]*v[2];
+				}
+			int nFrames = pContacts->Count(j);
+			printf(" %4.0f%% %3d %6.3f/s", 100.0*nFrames/pMotion->m_NumFrames, nContacts, nFrames > 0 ? sqrt(sum/nFrames) : 0.0);
+		}
+		printf("\n");
+		delete pMotion;
+	}
+
+	delete pActor;
+	return nResult;
+}
@@ -0,0 +1,139 @@
+/*
+	foot_lock.cxx
+
+	Measures foot locking (see footlock.h) on motions interpolated from keyframes.
+
+	foot_lock <asf file> <amc file>... [-step n] [-interp linear|catmullrom] [-blend n] [-o file]
+		-step       every n-th frame is a keyframe (default 20)
+		-interp     interpolation of the keyframes (default catmullrom)
+		-blend      frames over which a lock fades (default FOOTLOCK_BLEND)
+		-o          writes the last motion after locking as AMC
+	The contacts are those of the original motion. For every motion: the frames solved, the solve
+	time per frame (mean, median and largest, in microseconds), the iterations per frame, the
+	largest residual, and the foot skate (rms speed of the joints while in contact, units/s) of
+	the original, the interpolated and the locked motion.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "skeleton.h"
+#include "motion.h"
+#include "interpolator.h"
+#include "keyframes.h"
+#include "kinematics.h"
+#include "contacts.h"
+#include "footlock.h"
+
+
+//rms speed of the contact joints in the frames they are labeled in contact
+static double foot_skate(Motion *pMotion, FootContacts const *pContacts, ContactDetector const& detector)
+{
+	MotionKinematics const *pKinematics = pMotion->GetKinematics();
+	double sum = 0;
+	long long n = 0;
+	int nFrames = std::min(pMotion->m_NumFrames, pContacts->GetNumFrames());
+	for (int j = 0; j < NUM_CONTACT_JOINTS; j++)
+	{
+		int nBone = detector.GetBone(j);
+		for (int f = 0; f < nFrames && nBone >= 0; f++)
+			if (pContacts->IsContact(f, j))
+			{
+				float const *v = pKinematics->GetVelocity(f, nBone);
+				sum += v[0]*v[0] + v[1]*v[1] + v[2]*v[2];
+				n++;
+			}
+	}
+	return n > 0 ? sqrt(sum/n) : 0.0;
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<char *> amcFiles;
+	char *pOutFile = NULL;
+	int nStep = 20, nBlend = FOOTLOCK_BLEND;
+	InterpType interp = CATMULL_ROM;
+	for (int i = 2; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-step") == 0 && i + 1 < argc) nStep = std::max(2, atoi(argv[++i]));
+		else if (strcmp(argv[i], "-interp") == 0 && i + 1 < argc) interp = strcmp(argv[++i], "linear") == 0 ? LINEAR : CATMULL_ROM;
+		else if (strcmp(argv[i], "-blend") == 0 && i + 1 < argc) nBlend = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) pOutFile = argv[++i];
+		else amcFiles.push_back(argv[i]);
+	}
+	if (argc < 3 || amcFiles.empty())
+	{
+		printf("usage: foot_lock <asf file> <amc file>... [-step n] [-interp linear|catmullrom] [-blend n] [-o file]\n");
+		return 1;
+	}
+
+	Skeleton *pActor = new Skeleton(argv[1], MOCAP_SCALE);
+	ContactDetector detector(pActor);
+	FootLocker locker(pActor);
+	locker.SetBlendFrames(nBlend);
+
+	printf("\n%-28s %7s %7s %8s %8s %8s %6s %9s %9s %9s %9s\n", "motion", "frames", "solved", "mean us", "p50 us", "max us",
+		"iters", "residual", "skate in", "interp", "locked");
+	int nResult = 0;
+	for (int i = 0; i < (int)amcFiles.size(); i++)
+	{
+		Motion *pMotion = new Motion(amcFiles[i], MOCAP_SCALE, pActor);
+		int nFrames = pMotion->m_NumFrames;
+		if (nFrames < 4)
+		{
+			nResult = 1;
+			delete pMotion;
+			continue;
+		}
+
+		std::vector<int> frameNums(nFrames);
+		int nKeyFrames = SelectUniformKeyFrames(pMotion, nStep, frameNums.data());
+		Motion *pSampled = ExtractKeyFrames(pMotion, frameNums.data(), nKeyFrames);
+		Interpolator interpolator(pSampled, frameNums.data());
+		interpolator.SetInterpType(interp);
+		Motion *pInterp = NULL;
+		interpolator.Interpolate(pInterp);
+		if (pInterp == NULL)
+		{
+			nResult = 1;
+			delete pSampled;
+			delete pMotion;
+			continue;
+		}
+		pInterp->pActor = pActor;
+
+		FootContacts const *pContacts = pMotion->GetContacts();
+		double skateIn = foot_skate(pMotion, pContacts, detector), skateInterp = foot_skate(pInterp, pContacts, detector);
+		locker.Apply(pInterp, pContacts);
+		double skateLocked = foot_skate(pInterp, pContacts, detector);
+
+		std::vector<float> times;
+		double sum = 0, iterations = 0;
+		for (int f = 0; f < pInterp->m_NumFrames; f++)
+			if (locker.GetSolveTime(f) > 0)
+			{
+				times.push_back(locker.GetSolveTime(f)*1e6f);
+				sum += times.back();
+				iterations += locker.GetIterations(f);
+			}
+		std::sort(times.begin(), times.end());
+		int nSolved = locker.GetNumSolved();
+		char const *pName = strrchr(amcFiles[i], '/') != NULL ? strrchr(amcFiles[i], '/') + 1 : amcFiles[i];
+		printf("%-28s %7d %7d %8.2f %8.2f %8.2f %6.2f %9.5f %9.4f %9.4f %9.4f\n", pName, nFrames, nSolved,
+			nSolved > 0 ? sum/nSolved : 0.0, nSolved > 0 ? times[nSolved/2] : 0.0f, nSolved > 0 ? times.back() : 0.0f,
+			nSolved > 0 ? iterations/nSolved : 0.0, locker.GetMaxResidual(), skateIn, skateInterp, skateLocked);
+
+		if (pOutFile != NULL && i == (int)amcFiles.size() - 1)
+			pInterp->writeAMCfile(pOutFile, MOCAP_SCALE);
+		delete pInterp;
+		delete pSampled;
+		delete pMotion;
+	}
+
+	delete pActor;
+	return nResult;
+}
@@ -0,0 +1,148 @@
+/*
+	kinematics.cxx
+
+	Checks and times the derived kinematics channels of motions (see kinematics.h).
+
+	kinematics <asf file> <amc file>... [-repeat n]
+		For every motion: the time of the fused pass (frames/s) against computeJointPositions
+		for every frame followed by the differences, the largest difference of the positions
+		from computeJointPositions, how well the angular velocities explain the velocities
+		(for a bone without translation dofs the velocity of its end point relative to its start
+		is w x (end - start); both are differences over two frames, so fast moves such as waving
+		hands agree to some percent only), the fastest joint, and that changing a posture through
+		SetBoneRotation recomputes the channels.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include "skeleton.h"
+#include "motion.h"
+#include "kinematics.h"
+
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<char *> amcFiles;
+	int nRepeat = 20;
+	for (int i = 2; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-repeat") == 0 && i + 1 < argc) nRepeat = std::max(1, atoi(argv[++i]));
+		else amcFiles.push_back(argv[i]);
+	}
+	if (argc < 3 || amcFiles.empty())
+	{
+		printf("usage: kinematics <asf file> <amc file>... [-repeat n]\n");
+		return 1;
+	}
+
+	Skeleton *pActor = new Skeleton(argv[1], MOCAP_SCALE);
+	int nBones = pActor->NUM_BONES_IN_ASF_FILE;
+	Bone *pBones = pActor->getRoot();
+
+	//the start of every bone is the end of its parent
+	std::vector<int> parent(nBones, -1);
+	for (int b = 0; b < nBones; b++)
+		for (Bone *pChild = pBones[b].child; pChild != NULL; pChild = pChild->sibling)
+			parent[pChild->idx] = b;
+
+	printf("\n%-28s %7s %10s %10s %10s %10s %12s %10s %s\n", "motion", "frames", "frames/s", "naive f/s", "pos diff",
+		"w rel err", "fastest", "speed", "invalidate");
+	int nResult = 0;
+	for (int i = 0; i < (int)amcFiles.size(); i++)
+	{
+		Motion *pMotion = new Motion(amcFiles[i], MOCAP_SCALE, pActor);
+		int nFrames = pMotion->m_NumFrames;
+		if (nFrames < 3)
+		{
+			nResult = 1;
+			delete pMotion;
+			continue;
+		}
+
+		MotionKinematics kinematics(pActor);
+		auto start = std::chrono::steady_clock::now();
+		for (int r = 0; r < nRepeat; r++)
+			kinematics.Compute(pMotion);
+		double seconds = seconds_since(start)/nRepeat;
+
+		//naive: joint positions of every frame, then the velocities
+		std::vector<::vector> joints((size_t)nFrames*nBones);
+		std::vector<float> velocities((size_t)nFrames*nBones*3);
+		start = std::chrono::steady_clock::now();
+		for (int r = 0; r < nRepeat; r++)
+		{
+			for (int f = 0; f < nFrames; f++)
+				pActor->computeJointPositions(pMotion->m_pPostures[f], &joints[(size_t)f*nBones]);
+			for (int f = 0; f < nFrames; f++)
+			{
+				int a = std::max(f - 1, 0), b = std::min(f + 1, nFrames - 1);
+				for (int j = 0; j < nBones; j++)
+					for (int k = 0; k < 3; k++)
+						velocities[((size_t)f*nBones + j)*3 + k] =
+							(joints[(size_t)b*nBones + j].p[k] - joints[(size_t)a*nBones + j].p[k])*pMotion->m_FrameRate/(b - a);
+			}
+		}
+		double naiveSeconds = seconds_since(start)/nRepeat;
+
+		double posDiff = 0, errSum = 0, relSum = 0, maxSpeed = 0;
+		int nFastest = 0;
+		for (int f = 0; f < nFrames; f++)
+			for (int b = 0; b < nBones; b++)
+			{
+				float const *p = kinematics.GetPosition(f, b), *v = kinematics.GetVelocity(f, b);
+				for (int k = 0; k < 3; k++)
+					posDiff = std::max(posDiff, (double)fabs(p[k] - joints[(size_t)f*nBones + b].p[k]));
+				double speed = sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+				if (speed > maxSpeed)
+				{
+					maxSpeed = speed;
+					nFastest = b;
+				}
+
+				//relative velocity of the bone end against w x (end - start)
+				int nParent = parent[b];
+				if (nParent < 0 || pBones[b].doftx || pBones[b].dofty || pBones[b].doftz || f == 0 || f == nFrames - 1)
+					continue;
+				float const *w = kinematics.GetAngularVelocity(f, b), *q = kinematics.GetPosition(f, nParent);
+				float const *u = kinematics.GetVelocity(f, nParent);
+				float r[3] = { p[0] - q[0], p[1] - q[1], p[2] - q[2] };
+				float predicted[3] = { w[1]*r[2] - w[2]*r[1], w[2]*r[0] - w[0]*r[2], w[0]*r[1] - w[1]*r[0] };
+				for (int k = 0; k < 3; k++)
+				{
+					double measured = v[k] - u[k];
+					errSum += (measured - predicted[k])*(measured - predicted[k]);
+					relSum += measured*measured;
+				}
+			}
+		double relErr = relSum > 0 ? sqrt(errSum/relSum) : 0.0;
+
+		//changing a posture through the Motion drops the cached channels
+		float before = pMotion->GetKinematics()->GetPosition(nFrames/2, nFastest)[1];
+		::vector rotation = pMotion->m_pPostures[nFrames/2].bone_rotation[root];
+		rotation.p[0] += 30;
+		pMotion->SetBoneRotation(nFrames/2, rotation, root);
+		float after = pMotion->GetKinematics()->GetPosition(nFrames/2, nFastest)[1];
+		bool bInvalidated = before != after;
+
+		char const *pName = strrchr(amcFiles[i], '/') != NULL ? strrchr(amcFiles[i], '/') + 1 : amcFiles[i];
+		printf("%-28s %7d %10.0f %10.0f %10.6f %10.4f %12s %10.3f %s\n", pName, nFrames, nFrames/seconds, nFrames/naiveSeconds,
+			posDiff, relErr, pActor->idx2name(nFastest), maxSpeed, bInvalidated ? "ok" : "FAILED");
+		if (posDiff > 1e-3 || relErr > 0.2 || !bInvalidated)
+			nResult = 1;
+		delete pMotion;
+	}
+
+	delete pActor;
+	return nResult;
+}
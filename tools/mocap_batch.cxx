@@ -0,0 +1,537 @@
+/*
+	mocap_batch.cxx
+
+	Headless pipeline over a library of captures: load, keyframe-reduce, interpolate,
+	compare with the original and export, with the files spread over a pool of workers.
+
+	mocap_batch (-manifest file | -dir dir) -o outdir [options]
+		-manifest file   one pair per line: "<asf file> <amc file>" (a tab may separate paths
+		                 containing spaces; relative paths are relative to the manifest; # comments)
+		-dir dir         every .amc file of dir, paired with <subject>.asf where subject is the
+		                 part of the file name before the first '.', or with the only .asf of dir
+		-threads n       workers (default: hardware threads)
+		-mem MB          memory a worker may use for one file (default 512); larger files fail
+		-tol deg         keyframe tolerance on rotations, in degrees (default 1)
+		-postol units    keyframe tolerance on translations (default tol*MOCAP_SCALE)
+		-maxgap n        at most n frames between keyframes (default 30)
+		-step n          every n-th frame is a keyframe, instead of the tolerance
+		-interp linear|catmullrom    interpolation of the keyframes (default linear)
+		-footlock        hold the feet of the interpolated motion where the original has them
+		                 on the ground (see footlock.h)
+		-rate hz         convert the motions from MOCAP_FRAME_RATE to hz first (see resample.h);
+		                 the steps below work on the converted motion
+		-resume          skip the files already listed as done in the checkpoint
+
+	For every motion <name>.amc the output directory receives
+		<name>.keys.amc        the keyframes
+		<name>_offset.txt      their frame numbers (Interpolator offset file)
+		<name>.interp.amc      the motion interpolated back from the keyframes
+		<name>.error.json      its error against the original (MotionError report)
+		<name>.resampled.amc   with -rate, the motion at the new rate
+		<name>.contacts        its foot contact labels (see contacts.h)
+	batch.checkpoint records every finished file as soon as it is written; after a crash,
+	-resume continues from there. batch_report.txt has the timings of every file.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <string>
+#include <vector>
+#include <set>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#ifdef WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "skeleton.h"
+#include "motion.h"
+#include "interpolator.h"
+#include "channels.h"
+#include "keyframes.h"
+#include "motionerror.h"
+#include "resample.h"
+#include "contacts.h"
+#include "footlock.h"
+#include "threadpool.h"
+
+namespace fs = std::filesystem;
+
+#define CHECKPOINT_FILE "batch.checkpoint"
+#define REPORT_FILE "batch_report.txt"
+
+enum Stage
+{
+	STAGE_LOAD = 0, STAGE_RESAMPLE, STAGE_CONTACTS, STAGE_REDUCE, STAGE_INTERPOLATE, STAGE_ERROR, STAGE_EXPORT, NUM_STAGES
+};
+static char const *stageNames[NUM_STAGES] = { "load", "resample", "contacts", "reduce", "interp", "error", "export" };
+
+struct BatchJob
+{
+	std::string asf, amc, name;
+
+	//results
+	bool bDone;
+	std::string error;
+	int nFrames, nKeyFrames;
+	double rmsError, maxError;			// degrees, bone rotations
+	double rmsPosError, maxPosError;	// skeleton units, joint positions
+	double seconds[NUM_STAGES];
+};
+
+struct BatchOptions
+{
+	std::string outDir;
+	double memLimit;					// bytes per worker
+	float fAngleTolerance, fPosTolerance;
+	int nMaxGap, nStep;
+	InterpType interp;
+	bool bFootLock;
+	float fRate;						// 0 to keep the frame rate
+};
+
+static std::mutex asfMutex;				// the ASF parser is not reentrant (strtok, static in getBone)
+static std::mutex checkpointMutex;
+static FILE *pCheckpoint = NULL;
+
+
+static void usage()
+{
+	printf("usage: mocap_batch (-manifest file | -dir dir) -o outdir [-threads n] [-mem MB] [-tol deg] [-postol units]\n");
+	printf("                   [-maxgap n] [-step n] [-interp linear|catmullrom] [-footlock] [-rate hz]\n");
+	printf("                   [-resume]\n");
+}
+
+static bool has_extension(fs::path const& path, char const *pExt)
+{
+	std::string ext = path.extension().string();
+	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+	return ext == pExt;
+}
+
+static void add_job(std::vector<BatchJob> &jobs, std::string const& asf, std::string const& amc)
+{
+	BatchJob job;
+	job.asf = asf;
+	job.amc = amc;
+	job.name = fs::path(amc).stem().string();
+	job.bDone = false;
+	job.nFrames = job.nKeyFrames = 0;
+	job.rmsError = job.maxError = 0;
+	job.rmsPosError = job.maxPosError = 0;
+	for (int s = 0; s < NUM_STAGES; s++)
+		job.seconds[s] = 0;
+	jobs.push_back(job);
+}
+
+static int read_manifest(char const *filename, std::vector<BatchJob> &jobs)
+{
+	FILE *pFile = fopen(filename, "r");
+	if (pFile == NULL)
+	{
+		printf("Cannot open manifest '%s'\n", filename);
+		return -1;
+	}
+	fs::path dir = fs::path(filename).parent_path();
+
+	char line[2*MAX_CHAR];
+	while (fgets(line, sizeof(line), pFile) != NULL)
+	{
+		line[strcspn(line, "\r\n")] = '\0';
+		char *pStart = line + strspn(line, " \t");
+		if (*pStart == '\0' || *pStart == '#')
+			continue;
+
+		char *pSplit = strchr(pStart, '\t');
+		if (pSplit == NULL)
+			pSplit = strchr(pStart, ' ');
+		if (pSplit == NULL)
+		{
+			printf("Manifest line without an amc file: %s\n", pStart);
+			continue;
+		}
+		*pSplit = '\0';
+		char *pAmc = pSplit + 1 + strspn(pSplit + 1, " \t");
+
+		fs::path asf(pStart), amc(pAmc);
+		if (asf.is_relative()) asf = dir / asf;
+		if (amc.is_relative()) amc = dir / amc;
+		add_job(jobs, asf.string(), amc.string());
+	}
+	fclose(pFile);
+	return 0;
+}
+
+static int scan_directory(char const *dirname, std::vector<BatchJob> &jobs)
+{
+	std::error_code ec;
+	std::vector<fs::path> asfFiles, amcFiles;
+	for (fs::directory_iterator it(dirname, ec), end; !ec && it != end; it.increment(ec))
+	{
+		if (has_extension(it->path(), ".asf")) asfFiles.push_back(it->path());
+		if (has_extension(it->path(), ".amc")) amcFiles.push_back(it->path());
+	}
+	if (ec)
+	{
+		printf("Cannot read directory '%s'\n", dirname);
+		return -1;
+	}
+	std::sort(amcFiles.begin(), amcFiles.end());
+
+	for (int i = 0; i < (int)amcFiles.size(); i++)
+	{
+		std::string file = amcFiles[i].filename().string();
+		std::string subject = file.substr(0, file.find('.'));
+
+		fs::path asf;
+		for (int a = 0; a < (int)asfFiles.size(); a++)
+			if (asfFiles[a].stem().string() == subject)
+				asf = asfFiles[a];
+		if (asf.empty() && asfFiles.size() == 1)
+			asf = asfFiles[0];
+		if (asf.empty())
+		{
+			printf("No skeleton for '%s'\n", amcFiles[i].string().c_str());
+			continue;
+		}
+		add_job(jobs, asf.string(), amcFiles[i].string());
+	}
+	return 0;
+}
+
+//Number of frames of an AMC file: lines that hold only a frame number
+static int count_amc_frames(char const *filename)
+{
+	FILE *pFile = fopen(filename, "rb");
+	if (pFile == NULL)
+		return -1;
+
+	int nFrames = 0;
+	char line[2*MAX_CHAR];
+	while (fgets(line, sizeof(line), pFile) != NULL)
+	{
+		char *p = line;
+		while (*p >= '0' && *p <= '9')
+			p++;
+		if (p != line && (*p == '\n' || *p == '\r' || *p == '\0'))
+			nFrames++;
+	}
+	fclose(pFile);
+	return nFrames;
+}
+
+static void read_checkpoint(std::string const& filename, std::set<std::string> &done)
+{
+	FILE *pFile = fopen(filename.c_str(), "r");
+	if (pFile == NULL)
+		return;
+
+	char line[2*MAX_CHAR];
+	while (fgets(line, sizeof(line), pFile) != NULL)
+	{
+		line[strcspn(line, "\r\n")] = '\0';
+		//"done <tab> amc file"; a line cut short by a crash matches no job
+		if (strncmp(line, "done\t", 5) == 0)
+			done.insert(line + 5);
+	}
+	fclose(pFile);
+}
+
+static void write_checkpoint(BatchJob const& job)
+{
+	std::lock_guard<std::mutex> lock(checkpointMutex);
+	fprintf(pCheckpoint, "done\t%s\n", job.amc.c_str());
+	fflush(pCheckpoint);
+#ifdef WIN32
+	_commit(_fileno(pCheckpoint));
+#else
+	fsync(fileno(pCheckpoint));
+#endif
+}
+
+static void process(BatchJob &job, BatchOptions const& options)
+{
+	auto t0 = std::chrono::steady_clock::now();
+	auto lap = [&](Stage stage)
+	{
+		auto t1 = std::chrono::steady_clock::now();
+		job.seconds[stage] = std::chrono::duration<double>(t1 - t0).count();
+		t0 = t1;
+	};
+
+	//the original, the keyframes and the interpolated motion are in memory at the same time
+	int nFrames = count_amc_frames(job.amc.c_str());
+	if (nFrames <= 0)
+	{
+		job.error = "cannot read the motion";
+		return;
+	}
+	if (options.fRate > MOCAP_FRAME_RATE)
+		nFrames = (int)(nFrames*(double)options.fRate/MOCAP_FRAME_RATE) + 1;
+	double need = 3.0*nFrames*sizeof(Posture) + (double)nFrames*MAX_CHANNELS*sizeof(float);
+	if (need > options.memLimit)
+	{
+		char str[MAX_CHAR];
+		sprintf(str, "needs %.0f MB, over the limit of %.0f MB", need/1e6, options.memLimit/1e6);
+		job.error = str;
+		return;
+	}
+
+	Skeleton *pActor;
+	{
+		std::lock_guard<std::mutex> lock(asfMutex);
+		pActor = new Skeleton((char *)job.asf.c_str(), MOCAP_SCALE);
+	}
+	Motion *pMotion = new Motion((char *)job.amc.c_str(), MOCAP_SCALE, pActor);
+	job.nFrames = pMotion->m_NumFrames;
+	lap(STAGE_LOAD);
+	if (pMotion->m_NumFrames <= 0)
+	{
+		job.error = "cannot read the motion";
+		delete pMotion;
+		delete pActor;
+		return;
+	}
+
+	if (options.fRate > 0)
+	{
+		MotionResampler resampler(pActor, pMotion->m_FrameRate, options.fRate);
+		Motion *pResampled = resampler.Resample(pMotion);
+		delete pMotion;
+		pMotion = pResampled;
+	}
+	lap(STAGE_RESAMPLE);
+
+	FootContacts const *pContacts = pMotion->GetContacts();
+	lap(STAGE_CONTACTS);
+
+	int *pFrameNums = new int [pMotion->m_NumFrames];
+	if (options.nStep > 0)
+		job.nKeyFrames = SelectUniformKeyFrames(pMotion, options.nStep, pFrameNums);
+	else
+		job.nKeyFrames = SelectKeyFrames(pMotion, options.fAngleTolerance, options.fPosTolerance, options.nMaxGap, pFrameNums);
+	Motion *pSampled = ExtractKeyFrames(pMotion, pFrameNums, job.nKeyFrames);
+	lap(STAGE_REDUCE);
+
+	Interpolator interpolator(pSampled, pFrameNums);
+	interpolator.SetInterpType(options.interp);
+	Motion *pInterp = NULL;
+	interpolator.Interpolate(pInterp);
+	if (pInterp != NULL && pContacts != NULL && options.bFootLock)
+	{
+		FootLocker locker(pActor);
+		locker.Apply(pInterp, pContacts);
+	}
+	lap(STAGE_INTERPOLATE);
+
+	if (pInterp == NULL)
+	{
+		char str[MAX_CHAR];
+		interpolator.GetErrorString(str);
+		str[strcspn(str, "\n")] = '\0';
+		job.error = str;
+	}
+	else
+	{
+		MotionError error(pActor);
+		error.Compare(pMotion, pInterp);
+		job.rmsError = error.GetSummary(ERROR_ANGLE).rms;
+		job.maxError = error.GetSummary(ERROR_ANGLE).max;
+		job.rmsPosError = error.GetSummary(ERROR_POSITION).rms;
+		job.maxPosError = error.GetSummary(ERROR_POSITION).max;
+		lap(STAGE_ERROR);
+
+		std::string base = (fs::path(options.outDir) / job.name).string();
+		std::string keysFile = base + ".keys.amc", offsetFile = base + "_offset.txt", interpFile = base + ".interp.amc";
+		std::string errorFile = base + ".error.json", resampledFile = base + ".resampled.amc", contactsFile = base + ".contacts";
+		if ((options.fRate > 0 && pMotion->writeAMCfile((char *)resampledFile.c_str(), MOCAP_SCALE) != 0) ||
+			pContacts == NULL || pContacts->Write(contactsFile.c_str()) != 0 ||
+			pSampled->writeAMCfile((char *)keysFile.c_str(), MOCAP_SCALE) != 0 ||
+			WriteOffsetFile((char *)offsetFile.c_str(), pFrameNums, job.nKeyFrames) != 0 ||
+			pInterp->writeAMCfile((char *)interpFile.c_str(), MOCAP_SCALE) != 0 ||
+			error.WriteJSON((char *)errorFile.c_str(), job.amc.c_str(), interpFile.c_str(), false) != 0)
+			job.error = "cannot write the output files";
+		else
+			job.bDone = true;
+		lap(STAGE_EXPORT);
+		delete pInterp;
+	}
+
+	delete pSampled;
+	delete [] pFrameNums;
+	delete pMotion;
+	delete pActor;
+}
+
+static void write_report(std::vector<BatchJob> const& jobs, std::vector<int> const& run, double wallSeconds, int nThreads)
+{
+	double total[NUM_STAGES] = { 0 };
+	long long nFrames = 0;
+	int nFailed = 0;
+	for (int i = 0; i < (int)run.size(); i++)
+	{
+		BatchJob const& job = jobs[run[i]];
+		for (int s = 0; s < NUM_STAGES; s++)
+			total[s] += job.seconds[s];
+		nFrames += job.nFrames;
+		if (!job.bDone)
+			nFailed++;
+	}
+
+	printf("\n%-32s %7s %6s", "file", "frames", "keys");
+	for (int s = 0; s < NUM_STAGES; s++)
+		printf(" %8s", stageNames[s]);
+	printf(" %8s %8s %8s %8s\n", "rms", "max", "pos rms", "pos max");
+	for (int i = 0; i < (int)run.size(); i++)
+	{
+		BatchJob const& job = jobs[run[i]];
+		printf("%-32s %7d %6d", job.name.c_str(), job.nFrames, job.nKeyFrames);
+		for (int s = 0; s < NUM_STAGES; s++)
+			printf(" %8.4f", job.seconds[s]);
+		if (job.bDone)
+			printf(" %8.3f %8.3f %8.4f %8.4f\n", job.rmsError, job.maxError, job.rmsPosError, job.maxPosError);
+		else
+			printf("  FAILED: %s\n", job.error.c_str());
+	}
+	printf("\n%d files (%d failed), %lld frames in %.2f s on %d workers, %.0f frames/s\n",
+		(int)run.size(), nFailed, nFrames, wallSeconds, nThreads, wallSeconds > 0 ? nFrames/wallSeconds : 0.0);
+	printf("time per stage (s):");
+	for (int s = 0; s < NUM_STAGES; s++)
+		printf(" %s %.3f", stageNames[s], total[s]);
+	printf("\n");
+}
+
+static void append_report(std::string const& filename, std::vector<BatchJob> const& jobs, std::vector<int> const& run)
+{
+	FILE *pFile = fopen(filename.c_str(), "a");
+	if (pFile == NULL)
+		return;
+
+	for (int i = 0; i < (int)run.size(); i++)
+	{
+		BatchJob const& job = jobs[run[i]];
+		fprintf(pFile, "%s\t%s\t%d\t%d", job.bDone ? "done" : "failed", job.amc.c_str(), job.nFrames, job.nKeyFrames);
+		for (int s = 0; s < NUM_STAGES; s++)
+			fprintf(pFile, "\t%s=%.6f", stageNames[s], job.seconds[s]);
+		if (job.bDone)
+			fprintf(pFile, "\trms=%.6f\tmax=%.6f\tpos_rms=%.6f\tpos_max=%.6f\n", job.rmsError, job.maxError, job.rmsPosError, job.maxPosError);
+		else
+			fprintf(pFile, "\terror=%s\n", job.error.c_str());
+	}
+	fclose(pFile);
+}
+
+
+int main(int argc, char **argv)
+{
+	char const *pManifest = NULL, *pDir = NULL, *pOut = NULL;
+	int nThreads = 0;
+	bool bResume = false;
+	float fPosTolerance = -1;
+
+	BatchOptions options;
+	options.memLimit = 512e6;
+	options.fAngleTolerance = 1;
+	options.nMaxGap = 30;
+	options.nStep = 0;
+	options.interp = LINEAR;
+	options.bFootLock = false;
+	options.fRate = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-manifest") == 0 && i + 1 < argc) pManifest = argv[++i];
+		else if (strcmp(argv[i], "-dir") == 0 && i + 1 < argc) pDir = argv[++i];
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) pOut = argv[++i];
+		else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc) nThreads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-mem") == 0 && i + 1 < argc) options.memLimit = atof(argv[++i])*1e6;
+		else if (strcmp(argv[i], "-tol") == 0 && i + 1 < argc) options.fAngleTolerance = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "-postol") == 0 && i + 1 < argc) fPosTolerance = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "-maxgap") == 0 && i + 1 < argc) options.nMaxGap = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-step") == 0 && i + 1 < argc) options.nStep = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-interp") == 0 && i + 1 < argc)
+		{
+			i++;
+			if (strcmp(argv[i], "linear") == 0) options.interp = LINEAR;
+			else if (strcmp(argv[i], "catmullrom") == 0) options.interp = CATMULL_ROM;
+			else
+			{
+				usage();
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "-footlock") == 0) options.bFootLock = true;
+		else if (strcmp(argv[i], "-rate") == 0 && i + 1 < argc) options.fRate = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "-resume") == 0) bResume = true;
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+	if ((pManifest == NULL) == (pDir == NULL) || pOut == NULL)
+	{
+		usage();
+		return 1;
+	}
+	options.fPosTolerance = fPosTolerance >= 0 ? fPosTolerance : options.fAngleTolerance*MOCAP_SCALE;
+	options.outDir = pOut;
+
+	std::vector<BatchJob> jobs;
+	if ((pManifest != NULL ? read_manifest(pManifest, jobs) : scan_directory(pDir, jobs)) != 0)
+		return 1;
+
+	std::error_code ec;
+	fs::create_directories(pOut, ec);
+	std::string checkpointFile = (fs::path(pOut) / CHECKPOINT_FILE).string();
+	std::string reportFile = (fs::path(pOut) / REPORT_FILE).string();
+
+	std::set<std::string> done;
+	if (bResume)
+		read_checkpoint(checkpointFile, done);
+	else
+		remove(reportFile.c_str());
+
+	std::vector<int> run;
+	for (int i = 0; i < (int)jobs.size(); i++)
+		if (done.count(jobs[i].amc) == 0)
+			run.push_back(i);
+	printf("%d motions, %d already done, %d to process\n", (int)jobs.size(), (int)(jobs.size() - run.size()), (int)run.size());
+
+	pCheckpoint = fopen(checkpointFile.c_str(), bResume ? "a" : "w");
+	if (pCheckpoint == NULL)
+	{
+		printf("Cannot write '%s'\n", checkpointFile.c_str());
+		return 1;
+	}
+
+	//one file per task, taken in turn by the workers as they finish the previous one
+	ThreadPool pool(nThreads);
+	auto start = std::chrono::steady_clock::now();
+	pool.ParallelFor(0, (int)run.size(), [&](int nBegin, int nEnd, int nThread)
+	{
+		for (int i = nBegin; i < nEnd; i++)
+		{
+			BatchJob &job = jobs[run[i]];
+			process(job, options);
+			if (job.bDone)
+				write_checkpoint(job);
+		}
+	});
+	double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	fclose(pCheckpoint);
+
+	write_report(jobs, run, wallSeconds, pool.GetNumThreads());
+	append_report(reportFile, jobs, run);
+
+	for (int i = 0; i < (int)run.size(); i++)
+		if (!jobs[run[i]].bDone)
+			return 1;
+	return 0;
+}
@@ -0,0 +1,786 @@
+/*
+	mocap_bench.cxx
+
+	Benchmarks of the hot paths, for tracking performance over time.
+
+	mocap_bench <asf file> <amc file>... [-tile n] [-repeat n] [-json file] [-trace file] [-tmp dir]
+		-tile       every motion is also timed played n times in a row (default 20), 0 for none
+		-repeat     runs of every benchmark, the best one is reported (default 5)
+		-json       writes the results to file
+		-trace      records the instrumented hot paths (see profiler.h) while the benchmarks run,
+		            then writes them to file as a Chrome trace
+		-tmp        directory for the files written (default: the system temporary directory)
+	mocap_bench -compare old.json new.json [-threshold percent]
+		prints the change of every benchmark of both files and flags those more than percent
+		slower (default 10); returns 1 if any is, if a benchmark of the old file is missing from
+		the new one or if a file holds no results
+
+	Benchmarks: ASF parsing, then for every motion and its lengthened version AMC parsing,
+	copying the postures, Skeleton::setPosture, Skeleton::computeJointPositions, MotionKinematics,
+	linear and Catmull-Rom interpolation from every 10th frame, writeAMCfile, mrdplot and CSV
+	export (see export.h) and, when built with OpenGL and EGL, Display::show in an offscreen
+	640x480 buffer and reading its pixels back. For each: ns per item (frame or file), MB/s of
+	the data read or written, and operator new calls per item.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <new>
+#include <fcntl.h>
+#ifdef WIN32
+#include <io.h>
+#define NULL_DEVICE "NUL"
+#else
+#include <unistd.h>
+#define NULL_DEVICE "/dev/null"
+#endif
+
+#include "skeleton.h"
+#include "motion.h"
+#include "posture.h"
+#include "kinematics.h"
+#include "interpolator.h"
+#include "keyframes.h"
+#include "export.h"
+#include "threadpool.h"
+#include "profiler.h"
+
+#ifdef MOCAP_BENCH_RENDER
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#include <GL/glu.h>
+#include "display.h"
+
+#define RENDER_WIDTH 640
+#define RENDER_HEIGHT 480
+#define RENDER_FRAMES 600					// rendered frames of a motion at most
+#endif
+
+#define KEY_STEP 10
+
+
+/************************ Allocation counting **********************************/
+static std::atomic<long long> numAllocations(0);
+
+// gcc sees free() of memory from operator new once both are inlined into a caller
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void *operator new(size_t nSize)
+{
+	numAllocations++;
+	void *p = malloc(nSize > 0 ? nSize : 1);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+void *operator new[](size_t nSize)
+{
+	return operator new(nSize);
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+	operator delete(p);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+
+/************************ Measurement **********************************/
+struct BenchResult
+{
+	std::string name, input, unit;
+	long long items;
+	double nsPerItem, mbPerSecond, allocsPerItem;
+};
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//The parsers print every bone and frame count: stdout goes to the null device meanwhile
+static int quiet_begin()
+{
+	fflush(stdout);
+	int fd = dup(1), nul = open(NULL_DEVICE, O_WRONLY);
+	if (nul >= 0)
+	{
+		dup2(nul, 1);
+		close(nul);
+	}
+	return fd;
+}
+
+static void quiet_end(int fd)
+{
+	fflush(stdout);
+	if (fd >= 0)
+	{
+		dup2(fd, 1);
+		close(fd);
+	}
+}
+
+//Best of nRepeat calls of run, which returns the bytes it read or wrote (0 if that means nothing)
+template <typename Run>
+static void measure(std::vector<BenchResult> &results, char const *pName, std::string const& input, char const *pUnit,
+	long long nItems, int nRepeat, Run run)
+{
+	double best = 0, bytes = 0;
+	long long nAllocations = 0;
+	for (int r = 0; r < nRepeat; r++)
+	{
+		long long nBefore = numAllocations;
+		auto start = std::chrono::steady_clock::now();
+		double b = run();
+		double seconds = seconds_since(start);
+		if (r == 0 || seconds < best)
+		{
+			best = seconds;
+			bytes = b;
+			nAllocations = numAllocations - nBefore;
+		}
+	}
+
+	BenchResult result;
+	result.name = pName;
+	result.input = input;
+	result.unit = pUnit;
+	result.items = nItems;
+	result.nsPerItem = best/std::max(nItems, 1LL)*1e9;
+	result.mbPerSecond = bytes > 0 && best > 0 ? bytes/best*1e-6 : 0;
+	result.allocsPerItem = (double)nAllocations/std::max(nItems, 1LL);
+	results.push_back(result);
+	printf("%-18s %-30s %8lld %-5s %12.1f ns %9.1f MB/s %9.3f allocs\n", pName, input.c_str(), nItems, pUnit,
+		result.nsPerItem, result.mbPerSecond, result.allocsPerItem);
+}
+
+static double file_size(std::string const& filename)
+{
+	std::error_code error;
+	std::uintmax_t nSize = std::filesystem::file_size(filename, error);
+	return error ? 0.0 : (double)nSize;
+}
+
+
+/************************ Offscreen rendering **********************************/
+#ifdef MOCAP_BENCH_RENDER
+//A pbuffer of a headless EGL display (Mesa's surfaceless platform when there is one)
+static bool create_offscreen_context()
+{
+	EGLDisplay display = EGL_NO_DISPLAY;
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	char const *pExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	if (getPlatformDisplay != NULL && pExtensions != NULL && strstr(pExtensions, "EGL_MESA_platform_surfaceless") != NULL)
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL) || !eglBindAPI(EGL_OPENGL_API))
+		return false;
+
+	EGLint configAttributes[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_DEPTH_SIZE, 24, EGL_NONE };
+	EGLint surfaceAttributes[] = { EGL_WIDTH, RENDER_WIDTH, EGL_HEIGHT, RENDER_HEIGHT, EGL_NONE };
+	EGLConfig config;
+	EGLint nConfigs = 0;
+	if (!eglChooseConfig(display, configAttributes, &config, 1, &nConfigs) || nConfigs < 1)
+		return false;
+	EGLSurface surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+	EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, NULL);
+	if (surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT || !eglMakeCurrent(display, surface, surface, context))
+		return false;
+
+	//the camera and lights of the player
+	GLfloat lightPosition[] = { -25., 25., 25., 0. }, white[] = { 1., 1., 1., 1. };
+	glLightfv(GL_LIGHT0, GL_POSITION, lightPosition);
+	glLightfv(GL_LIGHT0, GL_DIFFUSE, white);
+	glEnable(GL_LIGHT0);
+	glEnable(GL_LIGHTING);
+	glEnable(GL_NORMALIZE);
+	glEnable(GL_DEPTH_TEST);
+	glViewport(0, 0, RENDER_WIDTH, RENDER_HEIGHT);
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	gluPerspective(45., (double)RENDER_WIDTH/RENDER_HEIGHT, .1, 50.);
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+	return true;
+}
+
+static void render_frame(Display &display, Skeleton *pActor, Posture const& posture)
+{
+	pActor->setPosture(posture);
+	glClearColor(0, 0, 0, 0);
+	glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+	glPushMatrix();
+	//follow the root, seen from 5 units away
+	glTranslatef(0., 0., -5.);
+	glRotatef(15., 1., 0., 0.);
+	glRotatef(-25., 0., 1., 0.);
+	glTranslatef(-posture.root_pos.p[0], -posture.root_pos.p[1], -posture.root_pos.p[2]);
+	display.show();
+	glPopMatrix();
+	glFinish();
+}
+#endif
+
+
+/************************ Benchmarks **********************************/
+static void bench_motion(std::vector<BenchResult> &results, Skeleton *pActor, Motion *pMotion,
+	std::string const& label, std::string const& tmpDir, int nRepeat, void *pDisplay)
+{
+	int n = pMotion->m_NumFrames;
+	std::string amcFile = tmpDir + "/bench.amc", exportFile = tmpDir + "/bench.export";
+
+	//written first, so that it can be parsed back
+	measure(results, "write_amc", label, "frame", n, nRepeat, [&]()
+	{
+		int fd = quiet_begin();
+		int nWritten = pMotion->writeAMCfile((char *)amcFile.c_str(), MOCAP_SCALE);
+		quiet_end(fd);
+		return nWritten == 0 ? file_size(amcFile) : 0.0;
+	});
+	measure(results, "amc_parse", label, "frame", n, nRepeat, [&]()
+	{
+		int fd = quiet_begin();
+		Motion *pRead = new Motion((char *)amcFile.c_str(), MOCAP_SCALE, pActor);
+		quiet_end(fd);
+		delete pRead;
+		return file_size(amcFile);
+	});
+
+	std::vector<Posture> copies(n);
+	measure(results, "posture_copy", label, "frame", n, nRepeat, [&]()
+	{
+		for (int f = 0; f < n; f++)
+			copies[f] = pMotion->m_pPostures[f];
+		return (double)n*sizeof(Posture);
+	});
+	measure(results, "set_posture", label, "frame", n, nRepeat, [&]()
+	{
+		for (int f = 0; f < n; f++)
+			pActor->setPosture(pMotion->m_pPostures[f]);
+		return 0.0;
+	});
+
+	std::vector< ::vector> joints(pActor->NUM_BONES_IN_ASF_FILE);
+	measure(results, "fk_skeleton", label, "frame", n, nRepeat, [&]()
+	{
+		for (int f = 0; f < n; f++)
+			pActor->computeJointPositions(pMotion->m_pPostures[f], joints.data());
+		return 0.0;
+	});
+	measure(results, "fk_kinematics", label, "frame", n, nRepeat, [&]()
+	{
+		MotionKinematics kinematics(pActor);
+		kinematics.Compute(pMotion);
+		return 0.0;
+	});
+
+	std::vector<int> frameNums(n);
+	int nKeys = SelectUniformKeyFrames(pMotion, KEY_STEP, frameNums.data());
+	Motion *pSampled = ExtractKeyFrames(pMotion, frameNums.data(), nKeys);
+	for (int t = 0; t < 2; t++)
+		measure(results, t == 0 ? "interp_linear" : "interp_catmullrom", label, "frame", n, nRepeat, [&]()
+		{
+			Interpolator interpolator(pSampled, frameNums.data());
+			interpolator.SetInterpType(t == 0 ? LINEAR : CATMULL_ROM);
+			Motion *pInterp = NULL;
+			interpolator.Interpolate(pInterp);
+			delete pInterp;
+			return 0.0;
+		});
+	delete pSampled;
+
+	MotionExporter exporter(pActor);
+	exporter.SelectAll();
+	for (int e = 0; e < 2; e++)
+		measure(results, e == 0 ? "export_mrdplot" : "export_csv", label, "frame", n, nRepeat, [&]()
+		{
+			return exporter.Write(pMotion, exportFile.c_str(), e == 0 ? EXPORT_MRDPLOT : EXPORT_CSV) == 0 ?
+				(double)exporter.GetNumBytes() : 0.0;
+		});
+
+#ifdef MOCAP_BENCH_RENDER
+	if (pDisplay != NULL)
+	{
+		Display &display = *(Display *)pDisplay;
+		int nRender = std::min(n, RENDER_FRAMES);
+		measure(results, "render", label, "frame", nRender, nRepeat, [&]()
+		{
+			for (int f = 0; f < nRender; f++)
+				render_frame(display, pActor, pMotion->m_pPostures[f]);
+			return 0.0;
+		});
+		std::vector<unsigned char> pixels(RENDER_WIDTH*RENDER_HEIGHT*3);
+		measure(results, "read_pixels", label, "frame", nRender, nRepeat, [&]()
+		{
+			for (int f = 0; f < nRender; f++)
+				glReadPixels(0, 0, RENDER_WIDTH, RENDER_HEIGHT, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+			return (double)nRender*pixels.size();
+		});
+	}
+#endif
+
+	std::error_code error;
+	std::filesystem::remove(amcFile, error);
+	std::filesystem::remove(exportFile, error);
+}
+
+static std::string json_escape(std::string const& str)
+{
+	std::string out;
+	for (char c : str)
+	{
+		if (c == '"' || c == '\\')
+			out += '\\';
+		out += c;
+	}
+	return out;
+}
+
+static int write_json(char const *filename, std::vector<BenchResult> const& results)
+{
+	FILE *pFile = fopen(filename, "w");
+	if (pFile == NULL)
+	{
+		printf("cannot create %s\n", filename);
+		return -1;
+	}
+	fprintf(pFile, "{\n  \"version\": 1,\n  \"threads\": %d,\n  \"results\": [\n", ThreadPool::GetDefault().GetNumThreads());
+	for (int i = 0; i < (int)results.size(); i++)
+	{
+		BenchResult const& r = results[i];
+		fprintf(pFile, "    {\"name\": \"%s\", \"input\": \"%s\", \"unit\": \"%s\", \"items\": %lld, \"ns_per_item\": %.3f, "
+			"\"mb_per_s\": %.3f, \"allocs_per_item\": %.4f}%s\n", json_escape(r.name).c_str(), json_escape(r.input).c_str(),
+			r.unit.c_str(), r.items, r.nsPerItem, r.mbPerSecond, r.allocsPerItem, i + 1 < (int)results.size() ? "," : "");
+	}
+	fprintf(pFile, "  ]\n}\n");
+	return fclose(pFile) == 0 ? 0 : -1;
+}
+
+
+/************************ Comparison **********************************/
+//Reader of JSON text, enough for the results files whatever their layout (reformatted by jq,
+//minified, ...): objects, arrays, strings, numbers and literals
+struct JsonReader
+{
+	char const *p;
+	bool bError;
+
+	void SkipSpace()
+	{
+		while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+			p++;
+	}
+
+	bool Expect(char c)
+	{
+		SkipSpace();
+		if (*p != c)
+		{
+			bError = true;
+			return false;
+		}
+		p++;
+		return true;
+	}
+
+	//String at p, escapes resolved (\u escapes to UTF-8)
+	std::string String()
+	{
+		std::string value;
+		if (!Expect('"'))
+			return value;
+		while (*p != '"')
+		{
+			if (*p == '\0')
+			{
+				bError = true;
+				return value;
+			}
+			if (*p == '\\' && p[1] != '\0')
+			{
+				p++;
+				switch (*p)
+				{
+					case 'n': value += '\n'; break;
+					case 't': value += '\t'; break;
+					case 'r': value += '\r'; break;
+					case 'b': value += '\b'; break;
+					case 'f': value += '\f'; break;
+					case 'u':
+						AppendUTF8(value, CodePoint());
+						continue;
+					default: value += *p;
+				}
+				p++;
+			}
+			else
+				value += *p++;
+		}
+		p++;
+		return value;
+	}
+
+	//Code point of the \u escape at p (on the u), of a surrogate pair too; p is moved past it
+	unsigned int CodePoint()
+	{
+		unsigned int nCode = Hex4(p + 1);
+		p += 5;
+		if (nCode >= 0xD800 && nCode < 0xDC00 && p[0] == '\\' && p[1] == 'u')
+		{
+			unsigned int nLow = Hex4(p + 2);
+			if (nLow >= 0xDC00 && nLow < 0xE000)
+			{
+				nCode = 0x10000 + ((nCode - 0xD800) << 10) + (nLow - 0xDC00);
+				p += 6;
+			}
+		}
+		return nCode;
+	}
+
+	unsigned int Hex4(char const *pHex)
+	{
+		unsigned int nValue = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			if (!isxdigit((unsigned char)pHex[i]))
+			{
+				bError = true;
+				return 0xFFFD;
+			}
+			nValue = nValue*16 + (isdigit((unsigned char)pHex[i]) ? pHex[i] - '0' : (tolower((unsigned char)pHex[i]) - 'a' + 10));
+		}
+		return nValue;
+	}
+
+	static void AppendUTF8(std::string &str, unsigned int nCode)
+	{
+		if (nCode < 0x80)
+			str += (char)nCode;
+		else if (nCode < 0x800)
+		{
+			str += (char)(0xC0 | (nCode >> 6));
+			str += (char)(0x80 | (nCode & 0x3F));
+		}
+		else if (nCode < 0x10000)
+		{
+			str += (char)(0xE0 | (nCode >> 12));
+			str += (char)(0x80 | ((nCode >> 6) & 0x3F));
+			str += (char)(0x80 | (nCode & 0x3F));
+		}
+		else
+		{
+			str += (char)(0xF0 | (nCode >> 18));
+			str += (char)(0x80 | ((nCode >> 12) & 0x3F));
+			str += (char)(0x80 | ((nCode >> 6) & 0x3F));
+			str += (char)(0x80 | (nCode & 0x3F));
+		}
+	}
+
+	//Value at p: a string is unquoted, a number or literal is its text, an object or array is skipped
+	std::string Value()
+	{
+		SkipSpace();
+		if (*p == '"')
+			return String();
+		if (*p == '{' || *p == '[')
+		{
+			char open = *p, close = *p == '{' ? '}' : ']';
+			p++;
+			SkipSpace();
+			if (*p == close)
+			{
+				p++;
+				return "";
+			}
+			do
+			{
+				if (open == '{')
+				{
+					String();
+					Expect(':');
+				}
+				Value();
+				SkipSpace();
+			} while (!bError && *p++ == ',');
+			if (!bError && p[-1] != close)
+				bError = true;
+			return "";
+		}
+		char const *pStart = p;
+		while (*p != '\0' && *p != ',' && *p != '}' && *p != ']' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+			p++;
+		if (p == pStart)
+			bError = true;
+		return std::string(pStart, p);
+	}
+};
+
+//Results of a file written by write_json, by "name input". Returns 0, -1 if the file cannot be read,
+//is not JSON or holds no result
+static int read_json(char const *filename, std::vector<std::string> &keys, std::map<std::string, BenchResult> &results)
+{
+	FILE *pFile = fopen(filename, "rb");
+	if (pFile == NULL)
+	{
+		printf("cannot open %s\n", filename);
+		return -1;
+	}
+	std::string text;
+	char str[4096];
+	size_t nRead;
+	while ((nRead = fread(str, 1, sizeof(str), pFile)) > 0)
+		text.append(str, nRead);
+	fclose(pFile);
+
+	//{ ..., "results": [ { "name": ..., ... }, ... ], ... }
+	JsonReader reader = { text.c_str(), false };
+	if (reader.Expect('{'))
+	{
+		reader.SkipSpace();
+		while (!reader.bError && *reader.p != '}')
+		{
+			std::string key = reader.String();
+			reader.Expect(':');
+			reader.SkipSpace();
+			if (key != "results" || *reader.p != '[')
+				reader.Value();
+			else
+			{
+				reader.p++;
+				reader.SkipSpace();
+				while (!reader.bError && *reader.p != ']')
+				{
+					std::map<std::string, std::string> fields;
+					reader.Expect('{');
+					reader.SkipSpace();
+					while (!reader.bError && *reader.p != '}')
+					{
+						std::string field = reader.String();
+						reader.Expect(':');
+						fields[field] = reader.Value();
+						reader.SkipSpace();
+						if (*reader.p == ',')
+							reader.p++;
+						reader.SkipSpace();
+					}
+					reader.Expect('}');
+					reader.SkipSpace();
+					if (*reader.p == ',')
+						reader.p++;
+					reader.SkipSpace();
+					if (reader.bError || fields.find("ns_per_item") == fields.end())
+						continue;
+
+					BenchResult r;
+					r.name = fields["name"];
+					r.input = fields["input"];
+					r.unit = fields["unit"];
+					r.items = atoll(fields["items"].c_str());
+					r.nsPerItem = atof(fields["ns_per_item"].c_str());
+					r.mbPerSecond = atof(fields["mb_per_s"].c_str());
+					r.allocsPerItem = atof(fields["allocs_per_item"].c_str());
+					std::string name = r.name + " " + r.input;
+					if (results.find(name) == results.end())
+						keys.push_back(name);
+					results[name] = r;
+				}
+				reader.Expect(']');
+			}
+			reader.SkipSpace();
+			if (*reader.p == ',')
+				reader.p++;
+			reader.SkipSpace();
+		}
+	}
+	if (reader.bError)
+	{
+		printf("%s is not valid JSON (at byte %d)\n", filename, (int)(reader.p - text.c_str()));
+		return -1;
+	}
+	if (results.empty())
+	{
+		printf("%s holds no benchmark results\n", filename);
+		return -1;
+	}
+	return 0;
+}
+
+static int compare(char const *pOld, char const *pNew, double fThreshold)
+{
+	std::vector<std::string> oldKeys, newKeys;
+	std::map<std::string, BenchResult> oldResults, newResults;
+	if (read_json(pOld, oldKeys, oldResults) != 0 || read_json(pNew, newKeys, newResults) != 0)
+		return 1;
+
+	int nRegressions = 0;
+	printf("%-18s %-30s %12s %12s %8s %14s\n", "benchmark", "input", "old ns", "new ns", "change", "allocs");
+	for (int i = 0; i < (int)newKeys.size(); i++)
+	{
+		BenchResult const& r = newResults[newKeys[i]];
+		std::map<std::string, BenchResult>::const_iterator old = oldResults.find(newKeys[i]);
+		if (old == oldResults.end())
+		{
+			printf("%-18s %-30s %12s %12.1f %8s\n", r.name.c_str(), r.input.c_str(), "-", r.nsPerItem, "new");
+			continue;
+		}
+		double fChange = old->second.nsPerItem > 0 ? r.nsPerItem/old->second.nsPerItem - 1 : 0;
+		bool bRegression = fChange > fThreshold/100;
+		if (bRegression)
+			nRegressions++;
+		char allocs[64];
+		snprintf(allocs, sizeof(allocs), "%.3f>%.3f", old->second.allocsPerItem, r.allocsPerItem);
+		printf("%-18s %-30s %12.1f %12.1f %+7.1f%% %14s%s\n", r.name.c_str(), r.input.c_str(), old->second.nsPerItem,
+			r.nsPerItem, fChange*100, r.allocsPerItem != old->second.allocsPerItem ? allocs : "same",
+			bRegression ? "  REGRESSION" : "");
+	}
+	int nGone = 0;
+	for (int i = 0; i < (int)oldKeys.size(); i++)
+		if (newResults.find(oldKeys[i]) == newResults.end())
+		{
+			printf("%-18s %-30s %12.1f %12s %8s\n", oldResults[oldKeys[i]].name.c_str(), oldResults[oldKeys[i]].input.c_str(),
+				oldResults[oldKeys[i]].nsPerItem, "-", "gone");
+			nGone++;
+		}
+	printf("%d regressions of more than %.1f%%, %d benchmarks gone\n", nRegressions, fThreshold, nGone);
+	return nRegressions > 0 || nGone > 0 ? 1 : 0;
+}
+
+
+int main(int argc, char **argv)
+{
+	if (argc >= 4 && strcmp(argv[1], "-compare") == 0)
+	{
+		double fThreshold = 10;
+		if (argc >= 6 && strcmp(argv[4], "-threshold") == 0)
+			fThreshold = atof(argv[5]);
+		return compare(argv[2], argv[3], fThreshold);
+	}
+
+	std::vector<char *> amcFiles;
+	char const *pJson = NULL;
+	char const *pTrace = NULL;
+	std::string tmpDir;
+	int nTile = 20, nRepeat = 5;
+	for (int i = 2; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-tile") == 0 && i + 1 < argc) nTile = std::max(0, atoi(argv[++i]));
+		else if (strcmp(argv[i], "-repeat") == 0 && i + 1 < argc) nRepeat = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "-json") == 0 && i + 1 < argc) pJson = argv[++i];
+		else if (strcmp(argv[i], "-trace") == 0 && i + 1 < argc) pTrace = argv[++i];
+		else if (strcmp(argv[i], "-tmp") == 0 && i + 1 < argc) tmpDir = argv[++i];
+		else amcFiles.push_back(argv[i]);
+	}
+	if (argc < 3 || amcFiles.empty())
+	{
+		printf("usage: mocap_bench <asf file> <amc file>... [-tile n] [-repeat n] [-json file] [-trace file] [-tmp dir]\n"
+			"       mocap_bench -compare old.json new.json [-threshold percent]\n");
+		return 1;
+	}
+	if (tmpDir.empty())
+	{
+		std::error_code error;
+		tmpDir = std::filesystem::temp_directory_path(error).string();
+		if (error)
+			tmpDir = ".";
+	}
+	if (pTrace != NULL)
+		Profiler::Get().Enable(true);
+
+	std::vector<BenchResult> results;
+	char const *pAsfName = strrchr(argv[1], '/') != NULL ? strrchr(argv[1], '/') + 1 : argv[1];
+	measure(results, "asf_parse", pAsfName, "file", 1, nRepeat, [&]()
+	{
+		int fd = quiet_begin();
+		Skeleton *pSkeleton = new Skeleton(argv[1], MOCAP_SCALE);
+		quiet_end(fd);
+		delete pSkeleton;
+		return file_size(argv[1]);
+	});
+
+	int fd = quiet_begin();
+	Skeleton *pActor = new Skeleton(argv[1], MOCAP_SCALE);
+	quiet_end(fd);
+
+	void *pDisplay = NULL;
+#ifdef MOCAP_BENCH_RENDER
+	Display display;
+	if (create_offscreen_context())
+	{
+		display.loadActor(pActor);
+		pDisplay = &display;
+	}
+	else
+		printf("no offscreen OpenGL context: render skipped\n");
+#endif
+
+	int nResult = 0;
+	for (int i = 0; i < (int)amcFiles.size(); i++)
+	{
+		fd = quiet_begin();
+		Motion *pMotion = new Motion(amcFiles[i], MOCAP_SCALE, pActor);
+		quiet_end(fd);
+		if (pMotion->m_NumFrames <= 0)
+		{
+			printf("cannot read %s\n", amcFiles[i]);
+			nResult = 1;
+			delete pMotion;
+			continue;
+		}
+		char const *pName = strrchr(amcFiles[i], '/') != NULL ? strrchr(amcFiles[i], '/') + 1 : amcFiles[i];
+		bench_motion(results, pActor, pMotion, pName, tmpDir, nRepeat, pDisplay);
+
+		if (nTile > 1)
+		{
+			Motion *pLong = new Motion(pMotion->m_NumFrames*nTile);
+			pLong->pActor = pActor;
+			for (int f = 0; f < pLong->m_NumFrames; f++)
+				pLong->m_pPostures[f] = pMotion->m_pPostures[f % pMotion->m_NumFrames];
+			bench_motion(results, pActor, pLong, std::string(pName) + " x" + std::to_string(nTile), tmpDir, nRepeat,
+				pDisplay);
+			delete pLong;
+		}
+		delete pMotion;
+	}
+
+	if (pJson != NULL && write_json(pJson, results) != 0)
+		nResult = 1;
+	if (pTrace != NULL && Profiler::Get().WriteChromeTrace(pTrace) != 0)
+		nResult = 1;
+	delete pActor;
+	return nResult;
+}
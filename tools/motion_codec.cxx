@@ -0,0 +1,181 @@
+/*
+	motion_codec.cxx
+
+	Benchmark of the lossy motion codec (see motioncodec.h).
+
+	motion_codec <asf file> <amc file>... [-tol t] [-block n] [-runs n] [-o dir]
+		For every motion: compressed size and ratio against the AMC text and against raw floats,
+		encode and decode speed (MB/s of raw float channels, best of -runs, default 5), time to
+		decode one frame by random access, and the forward kinematics error of the decoded motion.
+		-tol    joint position tolerance in skeleton units (default 0.01)
+		-block  frames per block (default 64)
+		-o      writes <dir>/<name>.mcmp
+		Fails if the position error exceeds the tolerance or random access decodes differently.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+
+#include "skeleton.h"
+#include "motion.h"
+#include "channels.h"
+#include "motioncodec.h"
+#include "motionerror.h"
+
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static long file_size(char const *filename)
+{
+	FILE *pFile = fopen(filename, "rb");
+	if (pFile == NULL)
+		return -1;
+	fseek(pFile, 0, SEEK_END);
+	long nSize = ftell(pFile);
+	fclose(pFile);
+	return nSize;
+}
+
+static std::string base_name(char const *pPath)
+{
+	std::string name(pPath);
+	size_t nSlash = name.find_last_of("/\\");
+	if (nSlash != std::string::npos)
+		name = name.substr(nSlash + 1);
+	size_t nDot = name.find_last_of('.');
+	return nDot == std::string::npos ? name : name.substr(0, nDot);
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<char *> amcFiles;
+	float fTolerance = 0.01f;
+	int nBlock = MOTION_CODEC_BLOCK, nRuns = 5;
+	char const *pOutDir = NULL;
+	for (int i = 2; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-tol") == 0 && i + 1 < argc) fTolerance = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "-block") == 0 && i + 1 < argc) nBlock = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-runs") == 0 && i + 1 < argc) nRuns = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) pOutDir = argv[++i];
+		else amcFiles.push_back(argv[i]);
+	}
+	if (argc < 3 || amcFiles.empty())
+	{
+		printf("usage: motion_codec <asf file> <amc file>... [-tol t] [-block n] [-runs n] [-o dir]\n");
+		return 1;
+	}
+
+	Skeleton *pActor = new Skeleton(argv[1], MOCAP_SCALE);
+	ChannelLayout layout(pActor);
+	MotionCodec codec(pActor);
+	codec.SetTolerance(fTolerance);
+	codec.SetBlockFrames(nBlock);
+	MotionError error(pActor);
+
+	printf("\ntolerance %g, %d frames per block, %d channels\n", fTolerance, nBlock, layout.m_NumChannels);
+	printf("%-28s %7s %9s %9s %7s %7s %9s %9s %9s %9s %9s\n", "motion", "frames", "amc KB", "packed KB", "x amc", "x float",
+		"enc MB/s", "dec MB/s", "frame us", "pos rms", "pos max");
+
+	int nResult = 0;
+	double totalAmc = 0, totalRaw = 0, totalPacked = 0, totalEncode = 0, totalDecode = 0;
+	for (int i = 0; i < (int)amcFiles.size(); i++)
+	{
+		Motion *pMotion = new Motion(amcFiles[i], MOCAP_SCALE, pActor);
+		if (pMotion->m_NumFrames <= 0)
+		{
+			nResult = 1;
+			delete pMotion;
+			continue;
+		}
+		double amcBytes = (double)file_size(amcFiles[i]);
+		double rawBytes = (double)pMotion->m_NumFrames*layout.m_NumChannels*sizeof(float);
+
+		std::vector<unsigned char> data;
+		double encodeSeconds = 1e30, decodeSeconds = 1e30;
+		for (int r = 0; r < nRuns; r++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			codec.Encode(pMotion, data);
+			encodeSeconds = std::min(encodeSeconds, seconds_since(start));
+		}
+
+		Motion *pDecoded = NULL;
+		if (codec.Open(data.data(), data.size()) != 0)
+		{
+			nResult = 1;
+			delete pMotion;
+			continue;
+		}
+		for (int r = 0; r < nRuns; r++)
+		{
+			delete pDecoded;
+			auto start = std::chrono::steady_clock::now();
+			pDecoded = codec.Decode();
+			decodeSeconds = std::min(decodeSeconds, seconds_since(start));
+		}
+
+		//random access: single frames spread over the motion, compared with the full decode
+		int nSamples = std::min(200, pMotion->m_NumFrames);
+		std::vector<float> a(layout.m_NumChannels), b(layout.m_NumChannels);
+		bool bSame = true;
+		Posture posture;
+		auto start = std::chrono::steady_clock::now();
+		for (int s = 0; s < nSamples; s++)
+		{
+			int nFrame = (int)((long long)s*7919 % pMotion->m_NumFrames);
+			codec.DecodeFrames(nFrame, 1, &posture);
+			layout.Gather(posture, a.data());
+			layout.Gather(pDecoded->m_pPostures[nFrame], b.data());
+			bSame = bSame && a == b;
+		}
+		double frameSeconds = seconds_since(start)/nSamples;
+
+		error.Compare(pMotion, pDecoded);
+		ErrorSummary const& position = error.GetSummary(ERROR_POSITION);
+
+		printf("%-28s %7d %9.1f %9.1f %7.1f %7.1f %9.1f %9.1f %9.1f %9.5f %9.5f\n", base_name(amcFiles[i]).c_str(),
+			pMotion->m_NumFrames, amcBytes/1024, data.size()/1024., amcBytes/data.size(), rawBytes/data.size(),
+			rawBytes/encodeSeconds/1e6, rawBytes/decodeSeconds/1e6, frameSeconds*1e6, position.rms, position.max);
+		if (position.max > fTolerance*1.001f || !bSame)
+		{
+			printf("  FAILED: %s\n", bSame ? "position error above the tolerance" : "random access differs from the full decode");
+			nResult = 1;
+		}
+
+		if (pOutDir != NULL)
+		{
+			std::string filename = std::string(pOutDir) + "/" + base_name(amcFiles[i]) + ".mcmp";
+			FILE *pFile = fopen(filename.c_str(), "wb");
+			if (pFile == NULL || fwrite(data.data(), 1, data.size(), pFile) != data.size() || fclose(pFile) != 0)
+			{
+				printf("Cannot write '%s'\n", filename.c_str());
+				nResult = 1;
+			}
+		}
+
+		totalAmc += amcBytes;
+		totalRaw += rawBytes;
+		totalPacked += data.size();
+		totalEncode += encodeSeconds;
+		totalDecode += decodeSeconds;
+		delete pDecoded;
+		delete pMotion;
+	}
+
+	if (totalPacked > 0)
+		printf("%-28s %7s %9.1f %9.1f %7.1f %7.1f %9.1f %9.1f\n", "total", "", totalAmc/1024, totalPacked/1024,
+			totalAmc/totalPacked, totalRaw/totalPacked, totalRaw/totalEncode/1e6, totalRaw/totalDecode/1e6);
+
+	delete pActor;
+	return nResult;
+}
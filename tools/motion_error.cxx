@@ -0,0 +1,85 @@
+/*
+	motion_error.cxx
+
+	Reconstruction error of a motion against the original (see motionerror.h).
+
+	motion_error <asf file> <reference amc> <test amc> [-json file] [-frames] [-bones]
+		Prints the angle and joint position error summaries of the whole motion.
+		-bones    also prints the summary of every bone
+		-json     writes the report to file (with -frames, the per frame errors too)
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+
+#include "skeleton.h"
+#include "motion.h"
+#include "motionerror.h"
+
+
+static void print_summary(char const *pName, ErrorSummary const& s)
+{
+	printf("%-12s %10.4f %10.4f %10.4f %10.4f %10.4f %10.4f %6d\n", pName, s.rms, s.p50, s.p90, s.p99, s.max, s.mean, s.maxFrame + 1);
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 4)
+	{
+		printf("usage: motion_error <asf file> <reference amc> <test amc> [-json file] [-frames] [-bones]\n");
+		return 1;
+	}
+
+	char *pJson = NULL;
+	bool bFrames = false, bBones = false;
+	for (int i = 4; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-json") == 0 && i + 1 < argc) pJson = argv[++i];
+		else if (strcmp(argv[i], "-frames") == 0) bFrames = true;
+		else if (strcmp(argv[i], "-bones") == 0) bBones = true;
+	}
+
+	Skeleton *pActor = new Skeleton(argv[1], MOCAP_SCALE);
+	Motion *pReference = new Motion(argv[2], MOCAP_SCALE, pActor);
+	Motion *pTest = new Motion(argv[3], MOCAP_SCALE, pActor);
+	if (pReference->m_NumFrames <= 0 || pTest->m_NumFrames <= 0)
+		return 1;
+	if (pReference->m_NumFrames != pTest->m_NumFrames)
+		printf("The motions have %d and %d frames, the first %d are compared\n",
+			pReference->m_NumFrames, pTest->m_NumFrames, pTest->m_NumFrames < pReference->m_NumFrames ? pTest->m_NumFrames : pReference->m_NumFrames);
+
+	MotionError error(pActor);
+	auto start = std::chrono::steady_clock::now();
+	error.Compare(pReference, pTest);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("\n%-12s %10s %10s %10s %10s %10s %10s %6s\n", "", "rms", "p50", "p90", "p99", "max", "mean", "frame");
+	print_summary("angle", error.GetSummary(ERROR_ANGLE));
+	print_summary("position", error.GetSummary(ERROR_POSITION));
+
+	if (bBones)
+	{
+		for (int k = 0; k < NUM_ERROR_KINDS; k++)
+		{
+			printf("\n%s error per bone\n", k == ERROR_ANGLE ? "angle" : "position");
+			for (int j = 0; j < error.GetNumBones(); j++)
+				if (error.IsMeasured((ErrorKind)k, j))
+					print_summary(pActor->idx2name(j), error.GetBoneSummary((ErrorKind)k, j));
+		}
+	}
+	printf("\n%d frames compared in %.2f ms\n", error.GetNumFrames(), seconds*1e3);
+
+	int result = 0;
+	if (pJson != NULL && error.WriteJSON(pJson, argv[2], argv[3], bFrames) != 0)
+	{
+		printf("Cannot write '%s'\n", pJson);
+		result = 1;
+	}
+
+	delete pTest;
+	delete pReference;
+	delete pActor;
+	return result;
+}
@@ -0,0 +1,241 @@
+/*
+	motion_export.cxx
+
+	Exports motions for plotting (see export.h) and times the writers.
+
+	motion_export <asf file> <amc file> -o file [-format mrdplot|csv|columns] [-select pattern]...
+	              [-scale s] [-tile n] [-repeat n]
+		-o          output file
+		-format     file format (default mrdplot)
+		-select     columns to write, e.g. "*.rx" or "rfoot.p*"; all of them by default
+		-scale      translations and positions are divided by s (default 1, skeleton units)
+		-tile       plays the motion n times in a row, for long clips (default 1)
+		-repeat     writes of the file for the timing (default 5)
+	Prints the columns, frames and bytes written, the time of a write and its MB/s, then reads
+	the file back and checks that every value is the one of the motion.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include "skeleton.h"
+#include "motion.h"
+#include "channels.h"
+#include "kinematics.h"
+#include "export.h"
+
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool read_file(char const *filename, std::vector<char> &data)
+{
+	FILE *pFile = fopen(filename, "rb");
+	if (pFile == NULL)
+		return false;
+	fseek(pFile, 0, SEEK_END);
+	data.resize(ftell(pFile));
+	fseek(pFile, 0, SEEK_SET);
+	bool bOk = fread(data.data(), 1, data.size(), pFile) == data.size();
+	fclose(pFile);
+	return bOk;
+}
+
+static float from_big_endian(char const *p)
+{
+	unsigned char const *b = (unsigned char const *)p;
+	uint32_t v = ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3];
+	float f;
+	memcpy(&f, &v, sizeof(f));
+	return f;
+}
+
+//The values of the file, frame by frame. Returns the number of columns, -1 if the file is not right
+static int read_back(char const *filename, ExportFormat format, int nFrames, std::vector<float> &values)
+{
+	std::vector<char> data;
+	if (!read_file(filename, data))
+		return -1;
+	data.push_back('\0');
+	char *p = data.data();
+	values.clear();
+
+	if (format == EXPORT_MRDPLOT)
+	{
+		long long nTotal;
+		int nColumns, nPoints, nRead = 0;
+		float fFrequency;
+		if (sscanf(p, "%lld %d %d %f%n", &nTotal, &nColumns, &nPoints, &fFrequency, &nRead) != 4 || nPoints != nFrames)
+			return -1;
+		p += nRead + 1;
+		for (int c = 0; c < nColumns; c++)
+			p = strchr(p, '\n') + 1;
+		p++;
+		if ((size_t)(p - data.data()) + nTotal*4 + 1 != data.size())
+			return -1;
+		for (long long i = 0; i < nTotal; i++)
+			values.push_back(from_big_endian(p + 4*i));
+		return nColumns;
+	}
+	if (format == EXPORT_CSV)
+	{
+		int nColumns = (int)std::count(p, strchr(p, '\n'), ',') - 1;
+		p = strchr(p, '\n') + 1;
+		for (int f = 0; f < nFrames; f++)
+		{
+			if (strtol(p, &p, 10) != f + 1)
+				return -1;
+			strtof(p + 1, &p);
+			for (int c = 0; c < nColumns; c++)
+				values.push_back(strtof(p + 1, &p));
+			if (*p++ != '\n')
+				return -1;
+		}
+		return *p == '\0' ? nColumns : -1;
+	}
+
+	ExportColumnsHeader header;
+	memcpy(&header, p, sizeof(header));
+	if (header.magic != EXPORT_COLUMNS_MAGIC || header.version != EXPORT_COLUMNS_VERSION || header.numFrames != nFrames)
+		return -1;
+	int S = header.numColumns;
+	ExportChunkInfo const *pDirectory = (ExportChunkInfo const *)(p + sizeof(header) + S*sizeof(ExportColumnInfo));
+	values.resize((size_t)nFrames*S);
+	for (int k = 0; k < header.numChunks; k++)
+		for (int s = 0; s < S; s++)
+		{
+			ExportChunkInfo const &chunk = pDirectory[(size_t)k*S + s];
+			int nStart = k*header.chunkFrames, nCount = std::min(header.chunkFrames, nFrames - nStart);
+			if (chunk.offset % 64 != 0 || chunk.offset + nCount*sizeof(float) > data.size() - 1)
+				return -1;
+			float const *pColumn = (float const *)(p + chunk.offset);
+			for (int i = 0; i < nCount; i++)
+			{
+				if (pColumn[i] < chunk.min || pColumn[i] > chunk.max)
+					return -1;
+				values[(size_t)(nStart + i)*S + s] = pColumn[i];
+			}
+		}
+	return S;
+}
+
+int main(int argc, char **argv)
+{
+	char const *pOut = NULL;
+	ExportFormat format = EXPORT_MRDPLOT;
+	std::vector<char const *> patterns;
+	float fScale = 1.0f;
+	int nTile = 1, nRepeat = 5;
+	bool bUsage = argc < 3;
+	for (int i = 3; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) pOut = argv[++i];
+		else if (strcmp(argv[i], "-format") == 0 && i + 1 < argc)
+		{
+			i++;
+			if (strcmp(argv[i], "mrdplot") == 0) format = EXPORT_MRDPLOT;
+			else if (strcmp(argv[i], "csv") == 0) format = EXPORT_CSV;
+			else if (strcmp(argv[i], "columns") == 0) format = EXPORT_COLUMNS;
+			else bUsage = true;
+		}
+		else if (strcmp(argv[i], "-select") == 0 && i + 1 < argc) patterns.push_back(argv[++i]);
+		else if (strcmp(argv[i], "-scale") == 0 && i + 1 < argc) fScale = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "-tile") == 0 && i + 1 < argc) nTile = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "-repeat") == 0 && i + 1 < argc) nRepeat = std::max(1, atoi(argv[++i]));
+		else bUsage = true;
+	}
+	if (bUsage || pOut == NULL || fScale <= 0)
+	{
+		printf("usage: motion_export <asf file> <amc file> -o file [-format mrdplot|csv|columns] [-select pattern]...\n"
+			"                     [-scale s] [-tile n] [-repeat n]\n");
+		return 1;
+	}
+
+	Skeleton *pActor = new Skeleton(argv[1], MOCAP_SCALE);
+	Motion *pRead = new Motion(argv[2], MOCAP_SCALE, pActor);
+	if (pRead->m_NumFrames <= 0)
+	{
+		delete pRead;
+		delete pActor;
+		return 1;
+	}
+	Motion *pMotion = new Motion(pRead->m_NumFrames*nTile);
+	pMotion->pActor = pActor;
+	for (int f = 0; f < pMotion->m_NumFrames; f++)
+		pMotion->m_pPostures[f] = pRead->m_pPostures[f % pRead->m_NumFrames];
+	delete pRead;
+
+	MotionExporter exporter(pActor, fScale);
+	for (int i = 0; i < (int)patterns.size(); i++)
+		exporter.Select(patterns[i]);
+	if (patterns.empty())
+		exporter.SelectAll();
+	int nResult = exporter.GetNumSelected() > 0 ? 0 : 1;
+
+	//the kinematics are computed once, outside the timing
+	pMotion->GetKinematics();
+	double seconds = 0;
+	for (int r = 0; r < nRepeat && nResult == 0; r++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		if (exporter.Write(pMotion, pOut, format) != 0)
+			nResult = 1;
+		seconds += seconds_since(start);
+	}
+	seconds /= nRepeat;
+	int n = pMotion->m_NumFrames, S = exporter.GetNumSelected();
+
+	//the values the file must hold
+	if (nResult == 0)
+	{
+		printf("%d columns, %d frames, %lld bytes: %.2f ms, %.0f MB/s, %.1f ns/frame\n", S, n, exporter.GetNumBytes(),
+			seconds*1e3, exporter.GetNumBytes()/seconds*1e-6, seconds/n*1e9);
+		ChannelLayout layout(pActor);
+		MotionKinematics const *pKinematics = pMotion->GetKinematics();
+		std::vector<float> values;
+		int nColumns = read_back(pOut, format, n, values);
+		long long nWrong = 0;
+		for (int s = 0; s < S && nColumns == S; s++)
+		{
+			char const *pName = exporter.GetSelectedName(s);
+			int nChannel = -1, nBone = -1, nAxis = 0;
+			char str[256];
+			for (int c = 0; c < layout.m_NumChannels && nChannel < 0; c++)
+			{
+				layout.GetName(c, str);
+				if (strcmp(str, pName) == 0)
+					nChannel = c;
+			}
+			if (nChannel < 0)
+			{
+				std::string bone(pName, strrchr(pName, '.') - pName);
+				nBone = pActor->name2idx((char *)bone.c_str());
+				nAxis = strrchr(pName, '.')[2] - 'x';
+			}
+			for (int f = 0; f < n; f++)
+			{
+				float v = nChannel >= 0 ? layout.GetValue(pMotion->m_pPostures[f], nChannel) :
+					pKinematics->GetPosition(f, nBone)[nAxis];
+				if (nChannel < 0 || !layout.IsAngle(nChannel))
+					v /= fScale;
+				if (values[(size_t)f*S + s] != v)
+					nWrong++;
+			}
+		}
+		printf("read back: %s\n", nColumns != S ? "WRONG FILE" : nWrong > 0 ? "WRONG VALUES" : "same values");
+		if (nColumns != S || nWrong > 0)
+			nResult = 1;
+	}
+
+	delete pMotion;
+	delete pActor;
+	return nResult;
+}
@@ -0,0 +1,180 @@
+/*
+	motion_graph.cxx
+
+	Builds a motion graph from clips of one skeleton and synthesizes a new motion from it
+	(see motiongraph.h).
+
+	motion_graph <asf file> <amc file>... -o <output amc> [-frames n] [-threshold t] [-blend n]
+	             [-path x,z;x,z;...] [-radius r] [-chance n] [-seed n]
+		The clips are added one at a time; the time taken and the edges made by each are reported.
+		-frames     length of the output (default 2400)
+		-threshold  largest pose distance of a transition (default: a quarter of the median
+		            distance between frames of the first clip)
+		-path       floor points to walk through, in the units of the AMC files; without it the
+		            edges are taken at random, one decision frame in -chance (default 20)
+		The output is written frame by frame as it is synthesized.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include "skeleton.h"
+#include "motion.h"
+#include "amcwriter.h"
+#include "distmatrix.h"
+#include "motiongraph.h"
+
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//"x,z;x,z;..." scaled as the motions are read
+static int parse_path(char const *pText, std::vector<float> &points)
+{
+	points.clear();
+	while (*pText != '\0')
+	{
+		float x, z;
+		int n = 0;
+		if (sscanf(pText, "%f,%f%n", &x, &z, &n) != 2)
+			return -1;
+		points.push_back(x*MOCAP_SCALE);
+		points.push_back(z*MOCAP_SCALE);
+		pText += n;
+		if (*pText == ';')
+			pText++;
+	}
+	return (int)points.size()/2;
+}
+
+static float default_threshold(Motion *pMotion)
+{
+	DistanceMatrix matrix;
+	matrix.SetMotions(pMotion, pMotion);
+	std::vector<float> sample;
+	int nStep = std::max(1, pMotion->m_NumFrames/64);
+	for (int i = 0; i < pMotion->m_NumFrames; i += nStep)
+		for (int j = 0; j < pMotion->m_NumFrames; j += nStep)
+			sample.push_back(matrix.GetDistance(i, j));
+	std::nth_element(sample.begin(), sample.begin() + sample.size()/2, sample.end());
+	return 0.25f*sample[sample.size()/2];
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<char *> amcFiles;
+	char const *pOutput = NULL;
+	int nFrames = 2400, nBlend = MOTION_GRAPH_DEFAULT_BLEND, nChance = 20;
+	unsigned int nSeed = 1;
+	float fThreshold = -1, fRadius = 20;
+	std::vector<float> path;
+	for (int i = 2; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) pOutput = argv[++i];
+		else if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc) nFrames = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-threshold") == 0 && i + 1 < argc) fThreshold = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "-blend") == 0 && i + 1 < argc) nBlend = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-radius") == 0 && i + 1 < argc) fRadius = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "-chance") == 0 && i + 1 < argc) nChance = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc) nSeed = (unsigned int)atoi(argv[++i]);
+		else if (strcmp(argv[i], "-path") == 0 && i + 1 < argc)
+		{
+			if (parse_path(argv[++i], path) <= 0)
+			{
+				printf("Bad path '%s'\n", argv[i]);
+				return 1;
+			}
+		}
+		else
+			amcFiles.push_back(argv[i]);
+	}
+	if (argc < 3 || amcFiles.empty() || pOutput == NULL)
+	{
+		printf("usage: motion_graph <asf file> <amc file>... -o <output amc> [-frames n] [-threshold t] [-blend n] [-path x,z;x,z;...] [-radius r] [-chance n] [-seed n]\n");
+		return 1;
+	}
+
+	Skeleton *pActor = new Skeleton(argv[1], MOCAP_SCALE);
+	std::vector<Motion *> clips;
+	for (int i = 0; i < (int)amcFiles.size(); i++)
+	{
+		Motion *pMotion = new Motion(amcFiles[i], MOCAP_SCALE, pActor);
+		if (pMotion->m_NumFrames <= nBlend)
+		{
+			printf("Skipping '%s': shorter than the blend\n", amcFiles[i]);
+			delete pMotion;
+			continue;
+		}
+		clips.push_back(pMotion);
+	}
+	if (clips.empty())
+		return 1;
+	if (fThreshold < 0)
+		fThreshold = default_threshold(clips[0]);
+
+	printf("\nthreshold %g, blend %d frames\n", fThreshold, nBlend);
+	MotionGraph graph(pActor, fThreshold, nBlend);
+	int nTotalFrames = 0;
+	for (int i = 0; i < (int)clips.size(); i++)
+	{
+		int nEdges = graph.GetNumEdges();
+		auto start = std::chrono::steady_clock::now();
+		graph.AddClip(clips[i]);
+		int nLive = graph.GetNumLiveEdges();
+		double seconds = seconds_since(start);
+		nTotalFrames += clips[i]->m_NumFrames;
+		printf("clip %d  %6d frames  %8.3f s  %5d new edges  %5d edges  %5d live\n", i, clips[i]->m_NumFrames, seconds,
+			graph.GetNumEdges() - nEdges, graph.GetNumEdges(), nLive);
+	}
+
+	//start at the first clip frame that can still leave
+	int nStartClip = 0;
+	while (nStartClip < graph.GetNumClips() && graph.GetLastExit(nStartClip) < 0)
+		nStartClip++;
+	if (nStartClip == graph.GetNumClips())
+	{
+		printf("No transitions below the threshold\n");
+		return 1;
+	}
+
+	MotionSynthesizer synthesizer(&graph, nSeed);
+	synthesizer.Start(nStartClip, 0);
+	synthesizer.SetRandomChance(nChance);
+	if (!path.empty())
+		synthesizer.SetPath(path.data(), (int)path.size()/2, fRadius*MOCAP_SCALE);
+
+	AMCWriter writer(pActor, MOCAP_SCALE);
+	if (writer.Open(pOutput) != 0)
+	{
+		printf("Cannot create '%s'\n", pOutput);
+		return 1;
+	}
+	Posture posture;
+	auto start = std::chrono::steady_clock::now();
+	int n = 0;
+	while (n < nFrames && synthesizer.NextFrame(&posture))
+	{
+		writer.WriteFrame(posture);
+		n++;
+	}
+	int nResult = writer.Close();
+	double seconds = seconds_since(start);
+
+	printf("%d frames in %.3f s (%.0f frames/s), %d transitions", n, seconds, n/seconds, synthesizer.GetNumTransitions());
+	if (!path.empty())
+		printf(", %d of %d path points reached", synthesizer.GetNumPointsReached(), (int)path.size()/2);
+	printf("\n");
+	if (n < nFrames)
+		printf("The walk ended in a dead end after %d frames\n", n);
+
+	for (int i = 0; i < (int)clips.size(); i++)
+		delete clips[i];
+	delete pActor;
+	return nResult == 0 ? 0 : 1;
+}
@@ -0,0 +1,155 @@
+/*
+	motion_pyramid.cxx
+
+	Times the multi-resolution summaries of motions (see pyramid.h) against reading every frame.
+
+	motion_pyramid <asf file> <amc file>... [-width px] [-tile n] [-repeat n]
+		-width      pixels of the timeline (default 1000)
+		-tile       plays every motion n times in a row, for long clips (default 1)
+		-repeat     runs of every timing (default 20)
+	For every motion: the time to build the pyramid, its levels and memory; then for the whole
+	motion and for a zoomed window of 4 frames per pixel in its middle, the time to summarize
+	every channel from the pyramid and from the frames (microseconds), the pixels whose min and
+	max are those of their frames, whether the whole range has the same min and max both ways,
+	and the level and time of the representative poses of the pixels.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include "skeleton.h"
+#include "motion.h"
+#include "channels.h"
+#include "pyramid.h"
+
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//Min and max of every pixel from the frames themselves
+static void summarize_frames(Motion *pMotion, ChannelLayout const& layout, int nChannel, int nFirst, int nLast, int nPixels,
+	float *pMin, float *pMax)
+{
+	int nCount = nLast - nFirst + 1;
+	for (int p = 0; p < nPixels; p++)
+	{
+		int a = nFirst + (int)((long long)p*nCount/nPixels);
+		int b = std::max(nFirst + (int)((long long)(p + 1)*nCount/nPixels) - 1, a);
+		pMin[p] = pMax[p] = layout.GetValue(pMotion->m_pPostures[a], nChannel);
+		for (int f = a + 1; f <= b; f++)
+		{
+			float v = layout.GetValue(pMotion->m_pPostures[f], nChannel);
+			pMin[p] = std::min(pMin[p], v);
+			pMax[p] = std::max(pMax[p], v);
+		}
+	}
+}
+
+static void compare_window(Motion *pMotion, MotionPyramid const *pPyramid, char const *pLabel, int nFirst, int nLast,
+	int nPixels, int nRepeat)
+{
+	ChannelLayout const& layout = pPyramid->GetLayout();
+	int C = layout.m_NumChannels;
+	std::vector<float> mins((size_t)C*nPixels), maxs((size_t)C*nPixels), means((size_t)C*nPixels);
+	std::vector<float> exactMins((size_t)C*nPixels), exactMaxs((size_t)C*nPixels);
+
+	auto start = std::chrono::steady_clock::now();
+	for (int r = 0; r < nRepeat; r++)
+		for (int c = 0; c < C; c++)
+			pPyramid->Summarize(c, nFirst, nLast, nPixels, &mins[(size_t)c*nPixels], &maxs[(size_t)c*nPixels],
+				&means[(size_t)c*nPixels]);
+	double seconds = seconds_since(start)/nRepeat;
+
+	start = std::chrono::steady_clock::now();
+	for (int r = 0; r < nRepeat; r++)
+		for (int c = 0; c < C; c++)
+			summarize_frames(pMotion, layout, c, nFirst, nLast, nPixels, &exactMins[(size_t)c*nPixels], &exactMaxs[(size_t)c*nPixels]);
+	double framesSeconds = seconds_since(start)/nRepeat;
+
+	std::vector<int> poses(nPixels);
+	start = std::chrono::steady_clock::now();
+	int nLevel = 0;
+	for (int r = 0; r < nRepeat; r++)
+		nLevel = pPyramid->SummarizePoses(nFirst, nLast, nPixels, poses.data());
+	double posesSeconds = seconds_since(start)/nRepeat;
+
+	long long nExact = 0;
+	bool bRange = true;
+	for (int c = 0; c < C; c++)
+	{
+		float const *m = &mins[(size_t)c*nPixels], *M = &maxs[(size_t)c*nPixels];
+		float const *e = &exactMins[(size_t)c*nPixels], *E = &exactMaxs[(size_t)c*nPixels];
+		for (int p = 0; p < nPixels; p++)
+			if (m[p] == e[p] && M[p] == E[p])
+				nExact++;
+		bRange = bRange && *std::min_element(m, m + nPixels) == *std::min_element(e, e + nPixels) &&
+			*std::max_element(M, M + nPixels) == *std::max_element(E, E + nPixels);
+	}
+	printf("  %-7s frames %7d .. %-7d pyramid %9.1f us  frames %10.1f us  exact pixels %5.1f%%  range %s  poses level %2d %7.1f us\n",
+		pLabel, nFirst, nLast, seconds*1e6, framesSeconds*1e6, 100.0*nExact/((double)C*nPixels), bRange ? "same" : "DIFF",
+		nLevel, posesSeconds*1e6);
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<char *> amcFiles;
+	int nWidth = 1000, nTile = 1, nRepeat = 20;
+	for (int i = 2; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-width") == 0 && i + 1 < argc) nWidth = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "-tile") == 0 && i + 1 < argc) nTile = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "-repeat") == 0 && i + 1 < argc) nRepeat = std::max(1, atoi(argv[++i]));
+		else amcFiles.push_back(argv[i]);
+	}
+	if (argc < 3 || amcFiles.empty())
+	{
+		printf("usage: motion_pyramid <asf file> <amc file>... [-width px] [-tile n] [-repeat n]\n");
+		return 1;
+	}
+
+	Skeleton *pActor = new Skeleton(argv[1], MOCAP_SCALE);
+	int nResult = 0;
+	for (int i = 0; i < (int)amcFiles.size(); i++)
+	{
+		Motion *pRead = new Motion(amcFiles[i], MOCAP_SCALE, pActor);
+		if (pRead->m_NumFrames <= 0)
+		{
+			nResult = 1;
+			delete pRead;
+			continue;
+		}
+		Motion *pMotion = new Motion(pRead->m_NumFrames*nTile);
+		pMotion->pActor = pActor;
+		for (int f = 0; f < pMotion->m_NumFrames; f++)
+			pMotion->m_pPostures[f] = pRead->m_pPostures[f % pRead->m_NumFrames];
+		delete pRead;
+
+		auto start = std::chrono::steady_clock::now();
+		MotionPyramid const *pPyramid = pMotion->GetPyramid();
+		double seconds = seconds_since(start);
+		if (pPyramid == NULL)
+		{
+			nResult = 1;
+			delete pMotion;
+			continue;
+		}
+
+		char const *pName = strrchr(amcFiles[i], '/') != NULL ? strrchr(amcFiles[i], '/') + 1 : amcFiles[i];
+		int n = pMotion->m_NumFrames;
+		printf("\n%s: %d frames, %d channels, built in %.2f ms, %d levels, %.2f MB\n", pName, n, pPyramid->GetNumChannels(),
+			seconds*1e3, pPyramid->GetNumLevels(), pPyramid->GetMemory()/1048576.0);
+		compare_window(pMotion, pPyramid, "whole", 0, n - 1, nWidth, nRepeat);
+		int nZoom = std::min(n, 4*nWidth);
+		compare_window(pMotion, pPyramid, "zoomed", (n - nZoom)/2, (n - nZoom)/2 + nZoom - 1, nWidth, nRepeat);
+		delete pMotion;
+	}
+
+	delete pActor;
+	return nResult;
+}
@@ -0,0 +1,119 @@
+/*
+	motion_query.cxx
+
+	Runs queries (see query.h) over a library of motions.
+
+	motion_query <asf file> <amc file>... [-q expression]... [-repeat n] [-show n] [-columns]
+		-q          a query, e.g. "rhand.py > head.py && root.speed < 0.5" (the default)
+		-repeat     runs of every query for the timing (default 20)
+		-show       prints the first n frame ranges of every query (default 10)
+		-columns    lists the columns that queries can use
+	For every query: the frame ranges and frames that match, the blocks decided by the zone maps
+	and the right sides skipped by && and ||, the time of Run and of the frame by frame RunScalar
+	(which must give the same ranges) in microseconds, and the frames per second of Run.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include "skeleton.h"
+#include "motion.h"
+#include "query.h"
+
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool same_ranges(std::vector<FrameRange> const& a, std::vector<FrameRange> const& b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (int i = 0; i < (int)a.size(); i++)
+		if (a[i].clip != b[i].clip || a[i].first != b[i].first || a[i].last != b[i].last)
+			return false;
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<char *> amcFiles;
+	std::vector<char const *> queries;
+	int nRepeat = 20, nShow = 10;
+	bool bColumns = false;
+	for (int i = 2; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-q") == 0 && i + 1 < argc) queries.push_back(argv[++i]);
+		else if (strcmp(argv[i], "-repeat") == 0 && i + 1 < argc) nRepeat = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "-show") == 0 && i + 1 < argc) nShow = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-columns") == 0) bColumns = true;
+		else amcFiles.push_back(argv[i]);
+	}
+	if (argc < 3 || amcFiles.empty())
+	{
+		printf("usage: motion_query <asf file> <amc file>... [-q expression]... [-repeat n] [-show n] [-columns]\n");
+		return 1;
+	}
+	if (queries.empty())
+		queries.push_back("rhand.py > head.py && root.speed < 0.5");
+
+	Skeleton *pActor = new Skeleton(argv[1], MOCAP_SCALE);
+	MotionLibrary library;
+	long long nFrames = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < (int)amcFiles.size(); i++)
+	{
+		Motion *pMotion = new Motion(amcFiles[i], MOCAP_SCALE, pActor);
+		char const *pName = strrchr(amcFiles[i], '/') != NULL ? strrchr(amcFiles[i], '/') + 1 : amcFiles[i];
+		if (library.AddClip(pName, pMotion) >= 0)
+			nFrames += pMotion->m_NumFrames;
+		delete pMotion;
+	}
+	printf("\n%d clips, %lld frames, %d columns, added in %.3f s\n", library.GetNumClips(), nFrames, library.GetNumColumns(),
+		seconds_since(start));
+	if (bColumns)
+		for (int c = 0; c < library.GetNumColumns(); c++)
+			printf("%s%s", library.GetColumnName(c), c % 8 == 7 || c == library.GetNumColumns() - 1 ? "\n" : " ");
+
+	int nResult = library.GetNumClips() > 0 ? 0 : 1;
+	for (int q = 0; q < (int)queries.size(); q++)
+	{
+		printf("\n%s\n", queries[q]);
+		MotionQuery query;
+		if (query.Compile(queries[q], library) != 0)
+		{
+			printf("  %s\n", query.GetError());
+			nResult = 1;
+			continue;
+		}
+
+		std::vector<FrameRange> ranges, scalar;
+		QueryStats stats;
+		start = std::chrono::steady_clock::now();
+		for (int r = 0; r < nRepeat; r++)
+			library.Run(query, ranges, &stats);
+		double seconds = seconds_since(start)/nRepeat;
+		start = std::chrono::steady_clock::now();
+		for (int r = 0; r < nRepeat; r++)
+			library.RunScalar(query, scalar);
+		double scalarSeconds = seconds_since(start)/nRepeat;
+		bool bSame = same_ranges(ranges, scalar);
+		if (!bSame)
+			nResult = 1;
+
+		printf("  %d ranges, %lld frames; %lld of %lld leaf blocks from zone maps, %lld sides skipped\n", (int)ranges.size(),
+			stats.matchingFrames, stats.zoneSkipped, stats.leafBlocks, stats.shortCircuited);
+		printf("  run %.1f us (%.0f Mframes/s), scalar %.1f us, %s\n", seconds*1e6, nFrames/seconds*1e-6, scalarSeconds*1e6,
+			bSame ? "same ranges" : "DIFFERENT RANGES");
+		for (int r = 0; r < (int)ranges.size() && r < nShow; r++)
+			printf("  %-28s %6d .. %d\n", library.GetClipName(ranges[r].clip), ranges[r].first, ranges[r].last);
+	}
+
+	delete pActor;
+	return nResult;
+}
@@ -0,0 +1,166 @@
+/*
+	motion_sample.cxx
+
+	Checks and times the sampling of motions between frames (see motionsampler.h).
+
+	motion_sample <asf file> <amc file>... [-step n]
+		For every motion and filter: the largest channel difference when sampling at the frame
+		times (angles modulo 360), the forward kinematics error of the motion rebuilt at 120 fps
+		from every n-th frame (default 4), and the time per sample at 4x the frame rate: one
+		sampler walking forward (channels, then postures) and the parallel batch call.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include "skeleton.h"
+#include "motion.h"
+#include "motionsampler.h"
+#include "motionerror.h"
+
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+	static const char *filterNames[4] = { "nearest", "linear", "catmull-rom", "quaternion" };
+	std::vector<char *> amcFiles;
+	int nStep = 4;
+	for (int i = 2; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-step") == 0 && i + 1 < argc) nStep = std::max(1, atoi(argv[++i]));
+		else amcFiles.push_back(argv[i]);
+	}
+	if (argc < 3 || amcFiles.empty())
+	{
+		printf("usage: motion_sample <asf file> <amc file>... [-step n]\n");
+		return 1;
+	}
+
+	Skeleton *pActor = new Skeleton(argv[1], MOCAP_SCALE);
+	MotionError error(pActor);
+
+	printf("\n%-28s %-12s %10s %10s %10s %9s %9s %9s\n", "motion", "filter", "frame diff", "fk rms", "fk max",
+		"ns/values", "ns/pose", "ns/batch");
+	int nResult = 0;
+	for (int i = 0; i < (int)amcFiles.size(); i++)
+	{
+		Motion *pMotion = new Motion(amcFiles[i], MOCAP_SCALE, pActor);
+		int nFrames = pMotion->m_NumFrames;
+		if (nFrames < 2)
+		{
+			nResult = 1;
+			delete pMotion;
+			continue;
+		}
+
+		//every nStep-th frame, at the lower frame rate
+		int nKept = (nFrames - 1)/nStep + 1;
+		Motion *pSparse = new Motion(nKept);
+		pSparse->pActor = pActor;
+		pSparse->m_FrameRate = pMotion->m_FrameRate/nStep;
+		for (int f = 0; f < nKept; f++)
+			pSparse->m_pPostures[f] = pMotion->m_pPostures[f*nStep];
+		int nCompared = (nKept - 1)*nStep + 1;
+
+		std::vector<float> frameTimes(nCompared), fineTimes(4*nFrames);
+		for (int f = 0; f < nCompared; f++)
+			frameTimes[f] = f/pMotion->m_FrameRate;
+		for (int f = 0; f < 4*nFrames; f++)
+			fineTimes[f] = f/(4*pMotion->m_FrameRate);
+
+		char const *pName = strrchr(amcFiles[i], '/') != NULL ? strrchr(amcFiles[i], '/') + 1 : amcFiles[i];
+		for (int nFilter = SAMPLE_NEAREST; nFilter <= SAMPLE_QUATERNION; nFilter++)
+		{
+			SampleFilter filter = (SampleFilter)nFilter;
+
+			//at the frames: the motion itself
+			MotionSampler sampler(pMotion, filter);
+			int nChannels = sampler.GetNumChannels();
+			std::vector<float> original(nChannels), values(nChannels);
+			double maxDiff = 0;
+			for (int f = 0; f < nFrames; f++)
+			{
+				sampler.GetLayout().Gather(pMotion->m_pPostures[f], original.data());
+				sampler.GetValues(f/pMotion->m_FrameRate, values.data());
+				for (int c = 0; c < nChannels; c++)
+				{
+					double d = fabs(values[c] - original[c]);
+					if (sampler.GetLayout().IsAngle(c))
+					{
+						d = fmod(d, 360.0);
+						d = std::min(d, 360.0 - d);
+					}
+					maxDiff = std::max(maxDiff, d);
+				}
+			}
+
+			//between the kept frames
+			MotionSampler sparse(pSparse, filter);
+			Motion *pRebuilt = new Motion(nCompared);
+			pRebuilt->pActor = pActor;
+			sparse.GetPostures(frameTimes.data(), nCompared, pRebuilt->m_pPostures);
+			error.Compare(pMotion, pRebuilt);
+			ErrorSummary const& summary = error.GetSummary(ERROR_POSITION);
+			delete pRebuilt;
+
+			//speed at 4x the frame rate
+			int nSamples = (int)fineTimes.size(), nRepeat = std::max(1, 200000/nSamples);
+			float fSum = 0;
+			auto start = std::chrono::steady_clock::now();
+			for (int r = 0; r < nRepeat; r++)
+			{
+				sampler.Invalidate();
+				for (int s = 0; s < nSamples; s++)
+				{
+					sampler.GetValues(fineTimes[s], values.data());
+					fSum += values[0];
+				}
+			}
+			double valuesNs = seconds_since(start)*1e9/((double)nRepeat*nSamples);
+
+			Posture posture;
+			start = std::chrono::steady_clock::now();
+			for (int r = 0; r < nRepeat; r++)
+			{
+				sampler.Invalidate();
+				for (int s = 0; s < nSamples; s++)
+				{
+					sampler.GetPosture(fineTimes[s], &posture);
+					fSum += posture.root_pos.p[0];
+				}
+			}
+			double postureNs = seconds_since(start)*1e9/((double)nRepeat*nSamples);
+
+			std::vector<float> batch((size_t)nSamples*nChannels);
+			start = std::chrono::steady_clock::now();
+			for (int r = 0; r < nRepeat; r++)
+			{
+				sampler.GetValues(fineTimes.data(), nSamples, batch.data());
+				fSum += batch[0];
+			}
+			double batchNs = seconds_since(start)*1e9/((double)nRepeat*nSamples);
+
+			printf("%-28s %-12s %10.5f %10.5f %10.5f %9.1f %9.1f %9.1f%s\n", pName, filterNames[nFilter], maxDiff, summary.rms,
+				summary.max, valuesNs, postureNs, batchNs, fSum == 12345.0f ? " " : "");
+			if (filter != SAMPLE_QUATERNION && maxDiff > 0.01)
+			{
+				printf("  FAILED: the frames are not reproduced\n");
+				nResult = 1;
+			}
+		}
+		delete pSparse;
+		delete pMotion;
+	}
+
+	delete pActor;
+	return nResult;
+}
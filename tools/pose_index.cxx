@@ -0,0 +1,197 @@
+/*
+	pose_index.cxx
+
+	Build and query a pose index (see poseindex.h).
+
+	pose_index build <asf file> <amc file> [<amc file> ...] -o index [-features joints|angles] [-leaf n]
+		Indexes every frame of the motions (all performed by the skeleton of the asf file).
+
+	pose_index query <index> <asf file> <amc file> [-k n] [-step n] [-checks n] [-show n]
+		Looks up every n-th frame (default 1) of the motion and reports the query latency,
+		the throughput of batched queries and the recall against brute force.
+		-checks limits the distance computations of a query (approximate search).
+		-show prints the matches of the first n queries.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include "skeleton.h"
+#include "motion.h"
+#include "poseindex.h"
+#include "threadpool.h"
+
+
+static void usage()
+{
+	printf("usage: pose_index build <asf file> <amc file> [<amc file> ...] -o index [-features joints|angles] [-leaf n]\n");
+	printf("       pose_index query <index> <asf file> <amc file> [-k n] [-step n] [-checks n] [-show n]\n");
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int build(std::vector<char *> &files, char const *pOut, PoseFeatureType type, int nLeafSize)
+{
+	Skeleton *pActor = new Skeleton(files[0], MOCAP_SCALE);
+	PoseFeatures features(pActor, type);
+	PoseIndex index;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 1; i < (int)files.size(); i++)
+	{
+		Motion *pMotion = new Motion(files[i], MOCAP_SCALE, pActor);
+		if (pMotion->m_NumFrames > 0)
+		{
+			float *pFeatures = new float [(size_t)pMotion->m_NumFrames*features.GetDimension()];
+			features.Compute(pMotion, pFeatures);
+			index.AddClip(files[i], pFeatures, pMotion->m_NumFrames, features.GetDimension(), type);
+			delete [] pFeatures;
+		}
+		delete pMotion;
+	}
+	double loadSeconds = seconds_since(start);
+
+	start = std::chrono::steady_clock::now();
+	index.Build(nLeafSize);
+	double buildSeconds = seconds_since(start);
+
+	int result = index.Save(pOut);
+	if (result != 0)
+		printf("Cannot write '%s'\n", pOut);
+	else
+		printf("%d frames of %d clips, %d features, indexed in %.3f s (loading %.3f s) into '%s'\n",
+			index.GetNumPoints(), index.GetNumClips(), index.GetDimension(), buildSeconds, loadSeconds, pOut);
+
+	delete pActor;
+	return result == 0 ? 0 : 1;
+}
+
+static int query(char const *pIndexFile, char *pAsf, char *pAmc, int k, int nStep, int nMaxChecks, int nShow)
+{
+	PoseIndex index;
+	auto start = std::chrono::steady_clock::now();
+	if (index.Load(pIndexFile) != 0)
+		return 1;
+	printf("Loaded %d frames of %d clips in %.3f s\n", index.GetNumPoints(), index.GetNumClips(), seconds_since(start));
+
+	Skeleton *pActor = new Skeleton(pAsf, MOCAP_SCALE);
+	Motion *pMotion = new Motion(pAmc, MOCAP_SCALE, pActor);
+	PoseFeatures features(pActor, index.GetFeatureType());
+	if (pMotion->m_NumFrames <= 0 || features.GetDimension() != index.GetDimension())
+	{
+		printf("The skeleton does not match the index\n");
+		return 1;
+	}
+
+	int nDim = features.GetDimension();
+	int nQueries = (pMotion->m_NumFrames + nStep - 1)/nStep;
+	std::vector<float> queries((size_t)nQueries*nDim);
+	for (int q = 0; q < nQueries; q++)
+		features.Compute(pMotion->m_pPostures[q*nStep], &queries[(size_t)q*nDim]);
+
+	//latency of single queries, one after the other
+	std::vector<PoseMatch> matches((size_t)nQueries*k), exact((size_t)nQueries*k);
+	std::vector<double> latency(nQueries);
+	for (int q = 0; q < nQueries; q++)
+	{
+		auto t0 = std::chrono::steady_clock::now();
+		index.Query(&queries[(size_t)q*nDim], k, &matches[(size_t)q*k], nMaxChecks);
+		latency[q] = seconds_since(t0)*1e6;
+	}
+
+	//throughput of a batch
+	start = std::chrono::steady_clock::now();
+	index.QueryBatch(queries.data(), nQueries, k, matches.data(), nMaxChecks);
+	double batchSeconds = seconds_since(start);
+
+	start = std::chrono::steady_clock::now();
+	for (int q = 0; q < nQueries; q++)
+		index.BruteForce(&queries[(size_t)q*nDim], k, &exact[(size_t)q*k]);
+	double bruteSeconds = seconds_since(start);
+
+	//recall: share of the returned frames that are among the exact k nearest.
+	//Frames at the same distance as the k-th are equally good (clips often repeat poses exactly)
+	long long nFound = 0, nTotal = 0;
+	int nExpected = std::min(k, index.GetNumPoints());
+	for (int q = 0; q < nQueries; q++)
+	{
+		float fBound = exact[(size_t)q*k + nExpected - 1].distance;
+		fBound += 1e-5f*fBound + 1e-6f;
+		for (int j = 0; j < nExpected; j++)
+			if (matches[(size_t)q*k + j].clip >= 0 && matches[(size_t)q*k + j].distance <= fBound)
+				nFound++;
+		nTotal += nExpected;
+	}
+
+	for (int q = 0; q < nShow && q < nQueries; q++)
+	{
+		printf("frame %d:", q*nStep + 1);
+		for (int i = 0; i < k && matches[(size_t)q*k + i].clip >= 0; i++)
+		{
+			PoseMatch const& m = matches[(size_t)q*k + i];
+			printf(" %s:%d (%.3f)", index.GetClipName(m.clip), m.frame + 1, m.distance);
+		}
+		printf("\n");
+	}
+
+	std::sort(latency.begin(), latency.end());
+	printf("\n%d queries, k = %d, %s\n", nQueries, k, nMaxChecks > 0 ? "approximate" : "exact");
+	printf("latency      p50 %.1f us, p99 %.1f us, max %.1f us\n",
+		latency[nQueries/2], latency[std::min(nQueries - 1, (int)(nQueries*0.99))], latency[nQueries - 1]);
+	printf("batch        %.0f queries/s on %d threads\n", nQueries/batchSeconds, ThreadPool::GetDefault().GetNumThreads());
+	printf("brute force  %.0f queries/s, %.1fx slower than the index\n", nQueries/bruteSeconds, bruteSeconds/batchSeconds);
+	printf("recall@%d    %.4f\n", k, nTotal > 0 ? (double)nFound/nTotal : 1.0);
+
+	delete pMotion;
+	delete pActor;
+	return 0;
+}
+
+
+int main(int argc, char **argv)
+{
+	if (argc < 3)
+	{
+		usage();
+		return 1;
+	}
+
+	char const *pOut = NULL;
+	PoseFeatureType type = POSE_FEATURE_JOINTS;
+	int nLeafSize = POSE_INDEX_DEFAULT_LEAF, k = 10, nStep = 1, nMaxChecks = 0, nShow = 0;
+	std::vector<char *> files;
+	for (int i = 2; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) pOut = argv[++i];
+		else if (strcmp(argv[i], "-features") == 0 && i + 1 < argc)
+			type = strcmp(argv[++i], "angles") == 0 ? POSE_FEATURE_ANGLES : POSE_FEATURE_JOINTS;
+		else if (strcmp(argv[i], "-leaf") == 0 && i + 1 < argc) nLeafSize = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) k = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-step") == 0 && i + 1 < argc) nStep = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-checks") == 0 && i + 1 < argc) nMaxChecks = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-show") == 0 && i + 1 < argc) nShow = atoi(argv[++i]);
+		else if (argv[i][0] != '-') files.push_back(argv[i]);
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+	if (k < 1) k = 1;
+	if (nStep < 1) nStep = 1;
+
+	if (strcmp(argv[1], "build") == 0 && files.size() >= 2 && pOut != NULL)
+		return build(files, pOut, type, nLeafSize);
+	if (strcmp(argv[1], "query") == 0 && files.size() == 3)
+		return query(files[0], files[1], files[2], k, nStep, nMaxChecks, nShow);
+
+	usage();
+	return 1;
+}
@@ -0,0 +1,241 @@
+/*
+	pose_receiver.cxx
+
+	Headless receiver for the player pose stream (see posestream.h).
+
+	pose_receiver <asf file> [-port n] [-actor n] [-frames n] [-o out.amc]
+		Subscribes to the player and decodes the frames of one actor into a Motion as they arrive.
+		Stops after n frames (default 1200) or when nothing arrives for POSE_STREAM_TIMEOUT seconds,
+		then writes the received motion to out.amc.
+
+	pose_receiver <asf file> <amc file> -loopback [-port n] [-joints]
+		Runs a sender and a receiver in this process and measures end-to-end latency
+		at increasing frame rates, and the highest rate that is sustained without loss.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+
+#include "skeleton.h"
+#include "motion.h"
+#include "channels.h"
+#include "posestream.h"
+
+
+static void usage()
+{
+	printf("usage: pose_receiver <asf file> [-port n] [-actor n] [-frames n] [-o out.amc]\n");
+	printf("       pose_receiver <asf file> <amc file> -loopback [-port n] [-joints]\n");
+}
+
+//Receive frames from the player and store them in a Motion
+static int receive(Skeleton *pActor, int nPort, int nActor, int nFrames, char *pOutFile)
+{
+	ChannelLayout layout(pActor);
+	PoseStreamReceiver receiver;
+	if (receiver.Open(nPort) != 0)
+		return 1;
+
+	Motion *pMotion = new Motion(nFrames);
+	pMotion->pActor = pActor;
+
+	unsigned char buffer[POSE_STREAM_MAX_PACKET];
+	PoseStreamHeader header;
+	int nStored = 0;
+	uint64_t lastPacket = PoseStreamClock();
+	double latencySum = 0;
+
+	printf("Waiting for frames on port %d ...\n", nPort);
+	while (nStored < nFrames)
+	{
+		int nSize = receiver.Receive(buffer, sizeof(buffer), 100);
+		uint64_t now = PoseStreamClock();
+		if (nSize <= 0)
+		{
+			if (now - lastPacket > (uint64_t)(POSE_STREAM_TIMEOUT*1e6))
+				break;
+			continue;
+		}
+		lastPacket = now;
+
+		Posture posture = pMotion->m_pPostures[nStored];
+		if (PoseStreamDecode(buffer, nSize, &header, layout, &posture, NULL) != 0)
+		{
+			printf("Bad packet (%d bytes); is the player streaming joint positions or another actor?\n", nSize);
+			continue;
+		}
+		if (header.actor != nActor)
+			continue;
+
+		pMotion->SetPosture(nStored, posture);
+		latencySum += now - header.timestamp;
+		nStored++;
+	}
+
+	printf("%d frames received, %u packets lost, mean latency %.1f us\n",
+		nStored, receiver.m_NumLost, nStored > 0 ? latencySum/nStored : 0.0);
+
+	if (pOutFile != NULL && nStored > 0)
+	{
+		pMotion->m_NumFrames = nStored;
+		pMotion->writeAMCfile(pOutFile, MOCAP_SCALE);
+	}
+	delete pMotion;
+	return 0;
+}
+
+//Send nPackets frames at nRate frames per second (0 = as fast as possible)
+static void send_frames(PoseStreamSender *pSender, Skeleton *pActor, Motion *pMotion, int nPackets, double nRate)
+{
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < nPackets; i++)
+	{
+		if (nRate > 0)
+			std::this_thread::sleep_until(start + std::chrono::microseconds((long long)(i*1e6/nRate)));
+		pSender->Publish(pActor, pMotion->m_pPostures[i % pMotion->m_NumFrames], 0, i);
+	}
+}
+
+//Measure latency and sustained rate with a sender and a receiver in this process
+static int loopback(Skeleton *pActor, Motion *pMotion, int nPort, PoseStreamMode mode)
+{
+	ChannelLayout layout(pActor);
+	PoseStreamSender sender;
+	PoseStreamReceiver receiver;
+	if (sender.Open(nPort, mode) != 0 || receiver.Open(nPort) != 0)
+		return 1;
+
+	//wait until the sender has seen the subscription
+	for (int i = 0; i < 100 && sender.m_NumSubscribers == 0; i++)
+	{
+		sender.Poll();
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	if (sender.m_NumSubscribers == 0)
+	{
+		printf("Loopback: subscription not received\n");
+		return 1;
+	}
+
+	static const double rates[] = { 120, 240, 480, 960, 1920, 3840, 7680, 15360, 30720, 61440, 0 };
+	const int nPackets = 4000;
+	unsigned char buffer[POSE_STREAM_MAX_PACKET];
+	PoseStreamHeader header;
+	Posture posture;
+	::vector jointPos[MAX_BONES_IN_ASF_FILE];
+	double maxSustained = 0;
+
+	printf("%10s %10s %8s %10s %10s %10s\n", "rate", "achieved", "lost", "p50 us", "p99 us", "max us");
+	for (int r = 0; r < (int)(sizeof(rates)/sizeof(rates[0])); r++)
+	{
+		int nPacketsAtRate = rates[r] > 0 ? std::min(nPackets, (int)(rates[r]*2)) : nPackets;
+		std::vector<double> latency;
+		latency.reserve(nPacketsAtRate);
+
+		uint32_t firstSequence = sender.m_Sequence;
+		auto start = std::chrono::steady_clock::now();
+		std::thread sendThread(send_frames, &sender, pActor, pMotion, nPacketsAtRate, rates[r]);
+
+		int nReceived = 0;
+		while (nReceived < nPacketsAtRate)
+		{
+			int nSize = receiver.Receive(buffer, sizeof(buffer), 200);
+			if (nSize <= 0)
+				break;
+			if (PoseStreamDecode(buffer, nSize, &header, layout, &posture, jointPos) != 0)
+				continue;
+			latency.push_back((double)(PoseStreamClock() - header.timestamp));
+			nReceived++;
+			if (header.sequence == firstSequence + nPacketsAtRate - 1)
+				break;
+		}
+		sendThread.join();
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		int nLost = nPacketsAtRate - nReceived;
+		double achieved = nReceived/seconds;
+		std::sort(latency.begin(), latency.end());
+		double p50 = latency.empty() ? 0 : latency[latency.size()/2];
+		double p99 = latency.empty() ? 0 : latency[(latency.size()*99)/100];
+		double pmax = latency.empty() ? 0 : latency.back();
+
+		if (rates[r] > 0)
+			printf("%10.0f %10.0f %8d %10.1f %10.1f %10.1f\n", rates[r], achieved, nLost, p50, p99, pmax);
+		else
+			printf("%10s %10.0f %8d %10.1f %10.1f %10.1f\n", "unpaced", achieved, nLost, p50, p99, pmax);
+
+		if (nLost == 0 && achieved > maxSustained)
+			maxSustained = achieved;
+
+		//let the queues drain before the next rate
+		while (receiver.Receive(buffer, sizeof(buffer), 50) > 0);
+	}
+
+	printf("Packet size %d bytes, max sustained rate %.0f frames/s without loss\n",
+		PoseStreamEncode(buffer, mode, layout, pActor, pMotion->m_pPostures[0], 0, 0, 0), maxSustained);
+	return 0;
+}
+
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		usage();
+		return 1;
+	}
+
+	int nPort = POSE_STREAM_DEFAULT_PORT;
+	int nActor = 0;
+	int nFrames = 1200;
+	char *pOutFile = NULL;
+	char *pAmcFile = NULL;
+	bool bLoopback = false;
+	PoseStreamMode mode = POSE_STREAM_DOFS;
+
+	for (int i = 2; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-port") == 0 && i + 1 < argc) nPort = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-actor") == 0 && i + 1 < argc) nActor = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc) nFrames = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) pOutFile = argv[++i];
+		else if (strcmp(argv[i], "-loopback") == 0) bLoopback = true;
+		else if (strcmp(argv[i], "-joints") == 0) mode = POSE_STREAM_JOINTS;
+		else if (argv[i][0] != '-') pAmcFile = argv[i];
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+	if (nFrames < 1)
+		nFrames = 1;
+
+	Skeleton *pActor = new Skeleton(argv[1], MOCAP_SCALE);
+	pActor->setBasePosture();
+
+	int result;
+	if (bLoopback)
+	{
+		if (pAmcFile == NULL)
+		{
+			usage();
+			return 1;
+		}
+		Motion *pMotion = new Motion(pAmcFile, MOCAP_SCALE, pActor);
+		if (pMotion->m_NumFrames <= 0)
+			return 1;
+		result = loopback(pActor, pMotion, nPort, mode);
+		delete pMotion;
+	}
+	else
+		result = receive(pActor, nPort, nActor, nFrames, pOutFile);
+
+	delete pActor;
+	return result;
+}
@@ -0,0 +1,206 @@
+/*
+	pose_shm.cxx
+
+	Headless publisher and reader for the shared memory pose region (see poseshm.h).
+
+	pose_shm publish <asf file> <amc file> [<amc file> ...] [-fps n] [-seconds n] [-joints] [-name name]
+		Plays every motion on its own actor (actor 0, 1, ...) and publishes the frames
+		at n frames per second (default 120; 0 = as fast as possible), looping the motions.
+
+	pose_shm read [<asf file>] [-seconds n] [-name name]
+		Attaches to the region and follows the latest frame of every actor, reporting once a second
+		the frames seen and missed, the publish-to-read latency and the cost of a read.
+		With an asf file the dof packets are also decoded into a Posture.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+#include "skeleton.h"
+#include "motion.h"
+#include "channels.h"
+#include "posestream.h"
+#include "poseshm.h"
+
+
+static void usage()
+{
+	printf("usage: pose_shm publish <asf file> <amc file> [<amc file> ...] [-fps n] [-seconds n] [-joints] [-name name]\n");
+	printf("       pose_shm read [<asf file>] [-seconds n] [-name name]\n");
+}
+
+static int publish_poses(Skeleton *pActor, std::vector<Motion *> &motions, char const *pName, PoseStreamMode mode,
+				   double fps, double seconds)
+{
+	PoseShmPublisher publisher;
+	if (publisher.Open(pName, mode) != 0)
+		return 1;
+
+	auto start = std::chrono::steady_clock::now();
+	long long nFrame = 0;
+	int nReport = 0;
+	for (;;)
+	{
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (seconds > 0 && elapsed >= seconds)
+			break;
+		if ((int)elapsed > nReport)
+		{
+			nReport = (int)elapsed;
+			printf("%lld frames published\n", nFrame);
+		}
+
+		for (int a = 0; a < (int)motions.size(); a++)
+		{
+			Motion *pMotion = motions[a];
+			int f = (int)(nFrame % pMotion->m_NumFrames);
+			publisher.Publish(pActor, pMotion->m_pPostures[f], a, f);
+		}
+		nFrame++;
+
+		if (fps > 0)
+			std::this_thread::sleep_until(start + std::chrono::microseconds((long long)(nFrame*1e6/fps)));
+	}
+	printf("%lld frames published for %d actors\n", nFrame, (int)motions.size());
+	return 0;
+}
+
+static int read_poses(Skeleton *pActor, char const *pName, double seconds)
+{
+	PoseShmReader reader;
+	for (int i = 0; reader.Open(pName) != 0; i++)
+	{
+		if (i == 0)
+			printf("Waiting for a publisher on '%s' ...\n", pName);
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+
+	ChannelLayout *pLayout = pActor != NULL ? new ChannelLayout(pActor) : NULL;
+	unsigned char buffer[POSE_STREAM_MAX_PACKET];
+	PoseStreamHeader header;
+	Posture posture;
+
+	uint64_t lastIndex[POSE_SHM_MAX_ACTORS];
+	for (int a = 0; a < POSE_SHM_MAX_ACTORS; a++)
+		lastIndex[a] = reader.GetCount(a);
+
+	auto start = std::chrono::steady_clock::now();
+	auto reportTime = start;
+	long long nSeen = 0, nMissed = 0, nReads = 0;
+	double latencySum = 0, readSum = 0;
+
+	for (;;)
+	{
+		auto now = std::chrono::steady_clock::now();
+		if (seconds > 0 && std::chrono::duration<double>(now - start).count() >= seconds)
+			break;
+
+		if (now - reportTime >= std::chrono::seconds(1))
+		{
+			printf("%d actors: %lld frames seen, %lld missed, latency %.1f us, read %.0f ns\n",
+				reader.GetNumActors(), nSeen, nMissed, nSeen > 0 ? latencySum/nSeen : 0.0,
+				nReads > 0 ? readSum/nReads : 0.0);
+			nSeen = nMissed = nReads = 0;
+			latencySum = readSum = 0;
+			reportTime = now;
+		}
+
+		bool bNew = false;
+		for (int a = 0; a < reader.GetNumActors(); a++)
+		{
+			uint64_t nCount = reader.GetCount(a);
+			if (nCount == lastIndex[a])
+				continue;
+
+			auto readStart = std::chrono::steady_clock::now();
+			int nSize = reader.ReadLatest(a, buffer);
+			readSum += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - readStart).count();
+			nReads++;
+			if (nSize <= 0)
+				continue;
+
+			if (pLayout != NULL)
+			{
+				if (PoseStreamDecode(buffer, nSize, &header, *pLayout, &posture, NULL) != 0)
+					continue;
+			}
+			else
+				memcpy(&header, buffer, sizeof(header));
+
+			latencySum += (double)(PoseStreamClock() - header.timestamp);
+			nSeen++;
+			nMissed += nCount - lastIndex[a] - 1;
+			lastIndex[a] = nCount;
+			bNew = true;
+		}
+
+		if (!bNew)
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+	}
+
+	if (pLayout != NULL)
+		delete pLayout;
+	return 0;
+}
+
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		usage();
+		return 1;
+	}
+
+	char const *pName = POSE_SHM_DEFAULT_NAME;
+	double fps = 120, seconds = 0;
+	PoseStreamMode mode = POSE_STREAM_DOFS;
+	std::vector<char *> files;
+
+	for (int i = 2; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-fps") == 0 && i + 1 < argc) fps = atof(argv[++i]);
+		else if (strcmp(argv[i], "-seconds") == 0 && i + 1 < argc) seconds = atof(argv[++i]);
+		else if (strcmp(argv[i], "-name") == 0 && i + 1 < argc) pName = argv[++i];
+		else if (strcmp(argv[i], "-joints") == 0) mode = POSE_STREAM_JOINTS;
+		else if (argv[i][0] != '-') files.push_back(argv[i]);
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+
+	int result = 1;
+	if (strcmp(argv[1], "publish") == 0 && files.size() >= 2)
+	{
+		Skeleton *pActor = new Skeleton(files[0], MOCAP_SCALE);
+		std::vector<Motion *> motions;
+		for (int i = 1; i < (int)files.size() && i <= POSE_SHM_MAX_ACTORS; i++)
+		{
+			Motion *pMotion = new Motion(files[i], MOCAP_SCALE, pActor);
+			if (pMotion->m_NumFrames > 0)
+				motions.push_back(pMotion);
+		}
+		if (!motions.empty())
+			result = publish_poses(pActor, motions, pName, mode, fps, seconds);
+		for (int i = 0; i < (int)motions.size(); i++)
+			delete motions[i];
+		delete pActor;
+	}
+	else if (strcmp(argv[1], "read") == 0)
+	{
+		Skeleton *pActor = files.empty() ? NULL : new Skeleton(files[0], MOCAP_SCALE);
+		result = read_poses(pActor, pName, seconds);
+		if (pActor != NULL)
+			delete pActor;
+	}
+	else
+		usage();
+
+	return result;
+}
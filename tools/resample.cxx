@@ -0,0 +1,124 @@
+/*
+	resample.cxx
+
+	Converts motions to another frame rate (see resample.h) and checks the result.
+
+	resample <asf file> <amc file>... -rate hz [-from hz] [-width n] [-o file]
+		-rate   output frame rate
+		-from   frame rate of the input (default MOCAP_FRAME_RATE)
+		-width  half width of the filter in frames of the slower rate (default RESAMPLE_HALF_WIDTH)
+		-o      writes the last motion at the new rate as AMC
+	For every motion: the fraction L/M used, frames in and out, the time of the parallel
+	conversion and of the stream (which must give the same frames), and the forward kinematics
+	error after converting back to the input rate (band limiting loses the fast parts when the
+	rate is lowered; raising it and back should be nearly exact).
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include "skeleton.h"
+#include "motion.h"
+#include "channels.h"
+#include "resample.h"
+#include "motionerror.h"
+
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<char *> amcFiles;
+	float fRate = 0, fFrom = MOCAP_FRAME_RATE;
+	int nWidth = RESAMPLE_HALF_WIDTH;
+	char *pOutput = NULL;
+	for (int i = 2; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-rate") == 0 && i + 1 < argc) fRate = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "-from") == 0 && i + 1 < argc) fFrom = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "-width") == 0 && i + 1 < argc) nWidth = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) pOutput = argv[++i];
+		else amcFiles.push_back(argv[i]);
+	}
+	if (argc < 3 || amcFiles.empty() || fRate <= 0 || fFrom <= 0)
+	{
+		printf("usage: resample <asf file> <amc file>... -rate hz [-from hz] [-width n] [-o file]\n");
+		return 1;
+	}
+
+	Skeleton *pActor = new Skeleton(argv[1], MOCAP_SCALE);
+	ChannelLayout layout(pActor);
+	MotionResampler resampler(pActor, fFrom, fRate, nWidth);
+	MotionResampler back(pActor, resampler.GetOutRate(), fFrom, nWidth);
+	MotionError error(pActor);
+
+	printf("\n%g Hz to %g Hz: L/M = %d/%d, %d input frames on each side\n", fFrom, resampler.GetOutRate(),
+		resampler.GetUpFactor(), resampler.GetDownFactor(), resampler.GetHalfWidth());
+	printf("%-28s %7s %7s %10s %10s %10s %10s %10s\n", "motion", "in", "out", "ms", "frames/s", "stream ms", "back rms", "back max");
+
+	int nResult = 0;
+	for (int i = 0; i < (int)amcFiles.size(); i++)
+	{
+		Motion *pMotion = new Motion(amcFiles[i], MOCAP_SCALE, pActor);
+		pMotion->m_FrameRate = fFrom;
+		if (pMotion->m_NumFrames <= 0)
+		{
+			nResult = 1;
+			delete pMotion;
+			continue;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		Motion *pResampled = resampler.Resample(pMotion);
+		double seconds = seconds_since(start);
+
+		std::vector<Posture> stream;
+		start = std::chrono::steady_clock::now();
+		for (int f = 0; f < pMotion->m_NumFrames; f++)
+			resampler.Push(pMotion->m_pPostures[f], stream);
+		resampler.Flush(stream);
+		double streamSeconds = seconds_since(start);
+
+		//the stream must give the same frames
+		bool bSame = (int)stream.size() == pResampled->m_NumFrames;
+		std::vector<float> a(layout.m_NumChannels), b(layout.m_NumChannels);
+		for (int f = 0; bSame && f < pResampled->m_NumFrames; f++)
+		{
+			layout.Gather(stream[f], a.data());
+			layout.Gather(pResampled->m_pPostures[f], b.data());
+			for (int c = 0; c < layout.m_NumChannels; c++)
+				if (fabs(a[c] - b[c]) > 1e-3f)
+					bSame = false;
+		}
+
+		Motion *pBack = back.Resample(pResampled);
+		error.Compare(pMotion, pBack);
+		ErrorSummary const& summary = error.GetSummary(ERROR_POSITION);
+
+		char const *pName = strrchr(amcFiles[i], '/') != NULL ? strrchr(amcFiles[i], '/') + 1 : amcFiles[i];
+		printf("%-28s %7d %7d %10.2f %10.0f %10.2f %10.5f %10.5f\n", pName, pMotion->m_NumFrames, pResampled->m_NumFrames,
+			seconds*1e3, pMotion->m_NumFrames/seconds, streamSeconds*1e3, summary.rms, summary.max);
+		if (!bSame)
+		{
+			printf("  FAILED: the stream differs from the whole motion\n");
+			nResult = 1;
+		}
+
+		if (pOutput != NULL && i + 1 == (int)amcFiles.size() && pResampled->writeAMCfile(pOutput, MOCAP_SCALE) != 0)
+			nResult = 1;
+		delete pBack;
+		delete pResampled;
+		delete pMotion;
+	}
+
+	delete pActor;
+	return nResult;
+}
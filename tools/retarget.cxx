@@ -0,0 +1,141 @@
+/*
+	retarget.cxx
+
+	Retargets a motion to another skeleton (see retarget.h).
+
+	retarget <source asf> <amc file> <target asf> [-o output amc] [-map file] [-repeat n]
+		Reports the conversion speed and, per bone, how far the world direction of the bone on the
+		target skeleton is from the one on the source skeleton (degrees, mean and max over frames).
+		-map     bone map file, one "target_bone source_bone" pair per line
+		-repeat  converts the motion n times over to time it
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include "skeleton.h"
+#include "motion.h"
+#include "retarget.h"
+#include "threadpool.h"
+
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//World direction of every bone (from the end of its parent to its end), zero if it has no length
+static void bone_directions(Skeleton *pSkeleton, Posture const& posture, int const *pParent, ::vector *pDir)
+{
+	::vector joints[MAX_BONES_IN_ASF_FILE];
+	pSkeleton->computeJointPositions(posture, joints);
+	for (int k = 1; k < pSkeleton->NUM_BONES_IN_ASF_FILE; k++)
+	{
+		::vector d = joints[k] - joints[pParent[k]];
+		float fLength = len(d);
+		pDir[k] = fLength > 1e-6f ? d/fLength : ::vector(0, 0, 0);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 4)
+	{
+		printf("usage: retarget <source asf> <amc file> <target asf> [-o output amc] [-map file] [-repeat n]\n");
+		return 1;
+	}
+
+	char *pOutput = NULL, *pMap = NULL;
+	int nRepeat = 1;
+	for (int i = 4; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) pOutput = argv[++i];
+		else if (strcmp(argv[i], "-map") == 0 && i + 1 < argc) pMap = argv[++i];
+		else if (strcmp(argv[i], "-repeat") == 0 && i + 1 < argc) nRepeat = std::max(1, atoi(argv[++i]));
+	}
+
+	Skeleton *pSource = new Skeleton(argv[1], MOCAP_SCALE);
+	Motion *pMotion = new Motion(argv[2], MOCAP_SCALE, pSource);
+	Skeleton *pTarget = new Skeleton(argv[3], MOCAP_SCALE);
+	if (pMotion->m_NumFrames <= 0)
+		return 1;
+
+	auto start = std::chrono::steady_clock::now();
+	Retargeter retargeter(pSource, pTarget);
+	if (pMap != NULL && retargeter.LoadBoneMap(pMap) != 0)
+		return 1;
+	printf("\nsetup %.3f ms, root scale %g, %d threads\n", seconds_since(start)*1e3, retargeter.GetRootScale(),
+		ThreadPool::GetDefault().GetNumThreads());
+
+	Motion *pRetargeted = NULL;
+	start = std::chrono::steady_clock::now();
+	for (int r = 0; r < nRepeat; r++)
+	{
+		delete pRetargeted;
+		pRetargeted = retargeter.Retarget(pMotion);
+	}
+	double seconds = seconds_since(start);
+	double nFrames = (double)pMotion->m_NumFrames*nRepeat;
+	printf("%.0f frames in %.3f s: %.0f frames/s, %.1f ns per bone\n", nFrames, seconds, nFrames/seconds,
+		seconds*1e9/nFrames/pTarget->NUM_BONES_IN_ASF_FILE);
+
+	//world bone directions, source against target
+	int sourceParent[MAX_BONES_IN_ASF_FILE], targetParent[MAX_BONES_IN_ASF_FILE];
+	for (int pass = 0; pass < 2; pass++)
+	{
+		Skeleton *pSkeleton = pass == 0 ? pSource : pTarget;
+		int *pParent = pass == 0 ? sourceParent : targetParent;
+		Bone *bone = pSkeleton->getRoot();
+		for (int i = 0; i < pSkeleton->NUM_BONES_IN_ASF_FILE; i++)
+			for (Bone *pChild = bone[i].child; pChild != NULL; pChild = pChild->sibling)
+				pParent[pChild->idx] = i;
+	}
+
+	std::vector<double> sum(pTarget->NUM_BONES_IN_ASF_FILE, 0), worst(pTarget->NUM_BONES_IN_ASF_FILE, 0);
+	for (int f = 0; f < pMotion->m_NumFrames; f++)
+	{
+		::vector sourceDir[MAX_BONES_IN_ASF_FILE], targetDir[MAX_BONES_IN_ASF_FILE];
+		bone_directions(pSource, pMotion->m_pPostures[f], sourceParent, sourceDir);
+		bone_directions(pTarget, pRetargeted->m_pPostures[f], targetParent, targetDir);
+		for (int k = 1; k < pTarget->NUM_BONES_IN_ASF_FILE; k++)
+		{
+			int s = retargeter.GetSourceBone(k);
+			if (s <= 0)
+				continue;
+			float fDot = std::max(-1.0f, std::min(1.0f, sourceDir[s] % targetDir[k]));
+			double fAngle = acos(fDot)*180./M_PI;
+			sum[k] += fAngle;
+			worst[k] = std::max(worst[k], fAngle);
+		}
+	}
+
+	double fMean = 0, fMax = 0;
+	int nBones = 0;
+	for (int k = 1; k < pTarget->NUM_BONES_IN_ASF_FILE; k++)
+		if (retargeter.GetSourceBone(k) > 0)
+		{
+			printf("  %-12s mean %7.3f  max %7.3f deg\n", pTarget->idx2name(k), sum[k]/pMotion->m_NumFrames, worst[k]);
+			fMean += sum[k]/pMotion->m_NumFrames;
+			fMax = std::max(fMax, worst[k]);
+			nBones++;
+		}
+	printf("bone directions: mean %.4f deg, max %.4f deg over %d bones\n", nBones > 0 ? fMean/nBones : 0., fMax, nBones);
+
+	int nResult = 0;
+	if (pOutput != NULL && pRetargeted->writeAMCfile(pOutput, MOCAP_SCALE) != 0)
+	{
+		printf("Cannot write '%s'\n", pOutput);
+		nResult = 1;
+	}
+
+	delete pRetargeted;
+	delete pMotion;
+	delete pTarget;
+	delete pSource;
+	return nResult;
+}
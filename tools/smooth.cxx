@@ -0,0 +1,287 @@
+/*
+	smooth.cxx
+
+	Smooths motions (see smoothing.h) and measures the filters.
+
+	smooth <asf file> <amc file>... [-filter butterworth|sg|oneeuro] [-cutoff hz] [-order n]
+	       [-width h] [-degree d] [-mincutoff hz] [-beta angle position] [-block n] [-noise deg] [-o file]
+		-filter     default butterworth (6 Hz, order 2); sg is Savitzky-Golay (h = 5, degree 2);
+		            oneeuro (1 Hz, beta 1 and 15)
+		-block      frames per Push call of the stream (default 64)
+		-noise      adds uniform noise of that amplitude to the angles (and noise*MOCAP_SCALE to the
+		            translations) first, and reports how much of it is left
+		-o          writes the last motion smoothed as AMC
+	For every motion: time of the whole motion and of the stream, the largest difference between
+	the two, the rms change of the angles, and their roughness (rms second difference) before and
+	after. A bone with three angle channels counts as one rotation, measured by the angle between
+	the two orientations (Euler channels jump near gimbal lock where the pose barely moves); the
+	angles of the other bones count one by one. The totals give the throughput over all motions.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include "skeleton.h"
+#include "motion.h"
+#include "channels.h"
+#include "smoothing.h"
+#include "transform.h"
+
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//Difference of two channel values, angles modulo 360
+static double channel_difference(ChannelLayout const& layout, int c, float a, float b)
+{
+	double d = a - b;
+	if (layout.IsAngle(c))
+		d -= 360.0*floor(d/360.0 + 0.5);
+	return d;
+}
+
+//Quaternion of a bone rotation
+static void bone_quaternion(Posture const& posture, int b, float q[4])
+{
+	euler_to_quaternion(posture.bone_rotation[b].p, q);
+}
+
+//Rotation from p to q (conj(p) q)
+static void relative_rotation(float const p[4], float const q[4], float r[4])
+{
+	r[0] = p[0]*q[0] + p[1]*q[1] + p[2]*q[2] + p[3]*q[3];
+	r[1] = p[0]*q[1] - p[1]*q[0] - p[2]*q[3] + p[3]*q[2];
+	r[2] = p[0]*q[2] + p[1]*q[3] - p[2]*q[0] - p[3]*q[1];
+	r[3] = p[0]*q[3] - p[1]*q[2] + p[2]*q[1] - p[3]*q[0];
+}
+
+//Angle in degrees between two orientations (atan2 stays exact for small angles, acos does not)
+static double rotation_angle(float const p[4], float const q[4])
+{
+	float r[4];
+	relative_rotation(p, q, r);
+	return 2*atan2(sqrt((double)r[1]*r[1] + (double)r[2]*r[2] + (double)r[3]*r[3]), fabs((double)r[0]))*180/M_PI;
+}
+
+//Bones measured as one rotation and the angle channels of the other bones
+struct AngleSet
+{
+	std::vector<int> bones, channels;
+
+	AngleSet(ChannelLayout const& layout)
+	{
+		int count[MAX_BONES_IN_ASF_FILE] = { 0 };
+		for (int c = 0; c < layout.m_NumChannels; c++)
+			if (layout.IsAngle(c))
+				count[layout.m_Channels[c].bone]++;
+		for (int b = 0; b < MAX_BONES_IN_ASF_FILE; b++)
+			if (count[b] == 3)
+				bones.push_back(b);
+		for (int c = 0; c < layout.m_NumChannels; c++)
+			if (layout.IsAngle(c) && count[layout.m_Channels[c].bone] != 3)
+				channels.push_back(c);
+	}
+};
+
+//rms of the second differences of the angles
+static double roughness(ChannelLayout const& layout, AngleSet const& set, Motion *pMotion)
+{
+	int C = layout.m_NumChannels;
+	std::vector<float> a(C), b(C), c(C);
+	double sum = 0;
+	long long n = 0;
+	for (int f = 2; f < pMotion->m_NumFrames; f++)
+	{
+		Posture const *p = &pMotion->m_pPostures[f - 2];
+		layout.Gather(p[0], a.data());
+		layout.Gather(p[1], b.data());
+		layout.Gather(p[2], c.data());
+		for (int i = 0; i < (int)set.channels.size(); i++)
+		{
+			int k = set.channels[i];
+			double d = channel_difference(layout, k, c[k], b[k]) - channel_difference(layout, k, b[k], a[k]);
+			sum += d*d;
+			n++;
+		}
+		//the change between the steps from f - 2 to f - 1 and from f - 1 to f
+		for (int i = 0; i < (int)set.bones.size(); i++)
+		{
+			float q[3][4], r1[4], r2[4];
+			for (int j = 0; j < 3; j++)
+				bone_quaternion(p[j], set.bones[i], q[j]);
+			relative_rotation(q[0], q[1], r1);
+			relative_rotation(q[1], q[2], r2);
+			double d = rotation_angle(r1, r2);
+			sum += d*d;
+			n++;
+		}
+	}
+	return n > 0 ? sqrt(sum/n) : 0.0;
+}
+
+//rms and max difference of the angles of two motions
+static void compare(ChannelLayout const& layout, AngleSet const& set, Motion *pA, Posture const *pB, double &rms, double &max)
+{
+	int C = layout.m_NumChannels;
+	std::vector<float> a(C), b(C);
+	double sum = 0;
+	long long n = 0;
+	max = 0;
+	for (int f = 0; f < pA->m_NumFrames; f++)
+	{
+		layout.Gather(pA->m_pPostures[f], a.data());
+		layout.Gather(pB[f], b.data());
+		for (int i = 0; i < (int)set.channels.size(); i++)
+		{
+			int k = set.channels[i];
+			double d = fabs(channel_difference(layout, k, a[k], b[k]));
+			sum += d*d;
+			max = std::max(max, d);
+			n++;
+		}
+		for (int i = 0; i < (int)set.bones.size(); i++)
+		{
+			float p[4], q[4];
+			bone_quaternion(pA->m_pPostures[f], set.bones[i], p);
+			bone_quaternion(pB[f], set.bones[i], q);
+			double d = rotation_angle(p, q);
+			sum += d*d;
+			max = std::max(max, d);
+			n++;
+		}
+	}
+	rms = n > 0 ? sqrt(sum/n) : 0.0;
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<char *> amcFiles;
+	char const *pFilter = "butterworth";
+	float fCutoff = 6, fMinCutoff = 1, fAngleBeta = 1, fPositionBeta = 15, fNoise = 0;
+	int nOrder = 2, nWidth = 5, nDegree = 2, nBlock = 64;
+	char *pOutput = NULL;
+	for (int i = 2; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-filter") == 0 && i + 1 < argc) pFilter = argv[++i];
+		else if (strcmp(argv[i], "-cutoff") == 0 && i + 1 < argc) fCutoff = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "-order") == 0 && i + 1 < argc) nOrder = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-width") == 0 && i + 1 < argc) nWidth = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-degree") == 0 && i + 1 < argc) nDegree = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-mincutoff") == 0 && i + 1 < argc) fMinCutoff = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "-beta") == 0 && i + 2 < argc)
+		{
+			fAngleBeta = (float)atof(argv[++i]);
+			fPositionBeta = (float)atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-block") == 0 && i + 1 < argc) nBlock = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "-noise") == 0 && i + 1 < argc) fNoise = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) pOutput = argv[++i];
+		else amcFiles.push_back(argv[i]);
+	}
+	if (argc < 3 || amcFiles.empty())
+	{
+		printf("usage: smooth <asf file> <amc file>... [-filter butterworth|sg|oneeuro] [-cutoff hz] [-order n]\n");
+		printf("              [-width h] [-degree d] [-mincutoff hz] [-beta angle position] [-block n] [-noise deg] [-o file]\n");
+		return 1;
+	}
+
+	Skeleton *pActor = new Skeleton(argv[1], MOCAP_SCALE);
+	ChannelLayout layout(pActor);
+	AngleSet angles(layout);
+	MotionSmoother smoother(pActor);
+	if (strcmp(pFilter, "sg") == 0)
+		smoother.SetSavitzkyGolay(nWidth, nDegree);
+	else if (strcmp(pFilter, "oneeuro") == 0)
+		smoother.SetOneEuro(fMinCutoff, fAngleBeta, fPositionBeta);
+	else
+		smoother.SetButterworth(fCutoff, nOrder);
+
+	printf("\nfilter %s, latency of the stream %d frames, blocks of %d frames\n", pFilter, smoother.GetLatency(), nBlock);
+	printf("%-28s %7s %10s %10s %10s %10s %10s %10s %10s\n", "motion", "frames", "frames/s", "stream f/s", "stream max",
+		"change rms", "rough in", "rough out", fNoise > 0 ? "noise left" : "");
+
+	double totalSeconds = 0, totalStream = 0;
+	long long nTotalFrames = 0;
+	int nResult = 0;
+	for (int i = 0; i < (int)amcFiles.size(); i++)
+	{
+		Motion *pMotion = new Motion(amcFiles[i], MOCAP_SCALE, pActor);
+		int nFrames = pMotion->m_NumFrames;
+		if (nFrames <= 0)
+		{
+			nResult = 1;
+			delete pMotion;
+			continue;
+		}
+		std::vector<Posture> clean(pMotion->m_pPostures, pMotion->m_pPostures + nFrames);
+		if (fNoise > 0)
+		{
+			std::vector<float> values(layout.m_NumChannels);
+			unsigned int nSeed = 4711;
+			for (int f = 0; f < nFrames; f++)
+			{
+				layout.Gather(pMotion->m_pPostures[f], values.data());
+				for (int c = 0; c < layout.m_NumChannels; c++)
+				{
+					nSeed = nSeed*1664525u + 1013904223u;
+					float r = ((nSeed >> 8)/(float)(1 << 24))*2 - 1;
+					values[c] += r*fNoise*(layout.IsAngle(c) ? 1.0f : MOCAP_SCALE);
+				}
+				layout.Scatter(values.data(), pMotion->m_pPostures[f]);
+			}
+		}
+		std::vector<Posture> input(pMotion->m_pPostures, pMotion->m_pPostures + nFrames);
+		double roughIn = roughness(layout, angles, pMotion);
+
+		std::vector<Posture> stream;
+		stream.reserve(nFrames);
+		auto start = std::chrono::steady_clock::now();
+		for (int f = 0; f < nFrames; f += nBlock)
+			smoother.Push(&input[f], std::min(nBlock, nFrames - f), stream);
+		smoother.Flush(stream);
+		double streamSeconds = seconds_since(start);
+
+		start = std::chrono::steady_clock::now();
+		smoother.Smooth(pMotion);
+		double seconds = seconds_since(start);
+
+		double streamRms, streamMax, changeRms, changeMax, noiseRms = 0, noiseMax;
+		if ((int)stream.size() != nFrames)
+		{
+			printf("  FAILED: the stream gave %d frames\n", (int)stream.size());
+			nResult = 1;
+			streamMax = -1;
+		}
+		else
+			compare(layout, angles, pMotion, stream.data(), streamRms, streamMax);
+		compare(layout, angles, pMotion, input.data(), changeRms, changeMax);
+		if (fNoise > 0)
+			compare(layout, angles, pMotion, clean.data(), noiseRms, noiseMax);
+
+		char const *pName = strrchr(amcFiles[i], '/') != NULL ? strrchr(amcFiles[i], '/') + 1 : amcFiles[i];
+		printf("%-28s %7d %10.0f %10.0f %10.5f %10.4f %10.4f %10.4f", pName, nFrames, nFrames/seconds, nFrames/streamSeconds,
+			streamMax, changeRms, roughIn, roughness(layout, angles, pMotion));
+		if (fNoise > 0)
+			printf(" %10.4f", noiseRms);
+		printf("\n");
+		totalSeconds += seconds;
+		totalStream += streamSeconds;
+		nTotalFrames += nFrames;
+
+		if (pOutput != NULL && i + 1 == (int)amcFiles.size() && pMotion->writeAMCfile(pOutput, MOCAP_SCALE) != 0)
+			nResult = 1;
+		delete pMotion;
+	}
+	printf("%lld frames: %.0f frames/s whole, %.0f frames/s streamed (%.1f MB/s of channels)\n", nTotalFrames,
+		nTotalFrames/totalSeconds, nTotalFrames/totalStream, nTotalFrames*layout.m_NumChannels*sizeof(float)/totalStream/1e6);
+
+	delete pActor;
+	return nResult;
+}
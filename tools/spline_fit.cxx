@@ -0,0 +1,169 @@
+/*
+	spline_fit.cxx
+
+	Fits motions with one cubic B-spline per channel (see splinefit.h) and measures the result.
+
+	spline_fit <asf file> <amc file>... [-angle degrees] [-pos units] [-o file]
+		For every motion: fitting time, spans and stored coefficients against the dense channel
+		values, the largest channel error at the frames (checked against the tolerances), the
+		forward kinematics error, and evaluation speed: all channels at 4x the frame rate with a
+		cursor, single channels at random times, and Posture linear interpolation for reference.
+		-angle, -pos  tolerances (defaults 0.5 degrees and 0.005)
+		-o            writes the last motion sampled at 4x the frame count as AMC
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include "skeleton.h"
+#include "motion.h"
+#include "channels.h"
+#include "splinefit.h"
+#include "motionerror.h"
+
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<char *> amcFiles;
+	float fAngle = 0.5f, fPosition = 0.005f;
+	char *pOutput = NULL;
+	for (int i = 2; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-angle") == 0 && i + 1 < argc) fAngle = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "-pos") == 0 && i + 1 < argc) fPosition = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) pOutput = argv[++i];
+		else amcFiles.push_back(argv[i]);
+	}
+	if (argc < 3 || amcFiles.empty())
+	{
+		printf("usage: spline_fit <asf file> <amc file>... [-angle degrees] [-pos units] [-o file]\n");
+		return 1;
+	}
+
+	Skeleton *pActor = new Skeleton(argv[1], MOCAP_SCALE);
+	ChannelLayout layout(pActor);
+	SplineMotion spline(pActor);
+	spline.SetTolerance(fAngle, fPosition);
+	MotionError error(pActor);
+	int nChannels = layout.m_NumChannels;
+
+	printf("\ntolerance %g degrees, %g units, %d channels\n", fAngle, fPosition, nChannels);
+	printf("%-28s %7s %8s %7s %9s %7s %9s %9s %9s %9s %9s %9s\n", "motion", "frames", "fit ms", "spans", "coeffs", "x dense",
+		"max deg", "max pos", "fk max", "ns/pose", "ns/chan", "lerp ns");
+
+	int nResult = 0;
+	for (int i = 0; i < (int)amcFiles.size(); i++)
+	{
+		Motion *pMotion = new Motion(amcFiles[i], MOCAP_SCALE, pActor);
+		int nFrames = pMotion->m_NumFrames;
+		if (nFrames <= 0)
+		{
+			nResult = 1;
+			delete pMotion;
+			continue;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		spline.Fit(pMotion);
+		double fitSeconds = seconds_since(start);
+		int nSpans = 0;
+		for (int c = 0; c < nChannels; c++)
+			nSpans += spline.GetNumSpans(c);
+
+		//channel errors at the frames (angles compared modulo 360)
+		std::vector<float> a(nChannels), b(nChannels);
+		double maxAngle = 0, maxPosition = 0;
+		SplineCursor cursor;
+		for (int f = 0; f < nFrames; f++)
+		{
+			layout.Gather(pMotion->m_pPostures[f], a.data());
+			spline.Evaluate((float)f, b.data(), &cursor);
+			for (int c = 0; c < nChannels; c++)
+			{
+				double d = fabs(b[c] - a[c]);
+				if (layout.IsAngle(c))
+				{
+					d = fmod(d, 360.0);
+					maxAngle = std::max(maxAngle, std::min(d, 360.0 - d));
+				}
+				else
+					maxPosition = std::max(maxPosition, d);
+			}
+		}
+
+		Motion *pSampled = spline.Sample(nFrames);
+		error.Compare(pMotion, pSampled);
+		double fkMax = error.GetSummary(ERROR_POSITION).max;
+		delete pSampled;
+
+		//all channels, 4 evaluations per frame, in order
+		int nEvaluations = 4*nFrames, nRepeat = std::max(1, 400000/nEvaluations);
+		float fSum = 0;
+		start = std::chrono::steady_clock::now();
+		for (int r = 0; r < nRepeat; r++)
+		{
+			SplineCursor sweep;
+			for (int e = 0; e < nEvaluations; e++)
+			{
+				spline.Evaluate(e*0.25f, b.data(), &sweep);
+				fSum += b[0];
+			}
+		}
+		double poseNs = seconds_since(start)*1e9/((double)nRepeat*nEvaluations);
+
+		//single channels at random times
+		unsigned int nSeed = 12345;
+		int nRandom = 1000000;
+		start = std::chrono::steady_clock::now();
+		for (int e = 0; e < nRandom; e++)
+		{
+			nSeed = nSeed*1664525u + 1013904223u;
+			fSum += spline.Evaluate((nSeed >> 8) % nChannels, (float)((nSeed >> 4) % (nFrames*16))/16.0f, NULL);
+		}
+		double channelNs = seconds_since(start)*1e9/nRandom;
+
+		//reference: linear interpolation of postures
+		Posture posture;
+		start = std::chrono::steady_clock::now();
+		for (int r = 0; r < nRepeat; r++)
+			for (int e = 0; e < nEvaluations; e++)
+			{
+				int f = std::min(e/4, nFrames - 2);
+				posture = LinearInterpolate((e%4)*0.25f, pMotion->m_pPostures[std::max(f, 0)], pMotion->m_pPostures[std::max(f + 1, 0)]);
+				fSum += posture.root_pos.p[0];
+			}
+		double lerpNs = seconds_since(start)*1e9/((double)nRepeat*nEvaluations);
+
+		char const *pName = strrchr(amcFiles[i], '/') != NULL ? strrchr(amcFiles[i], '/') + 1 : amcFiles[i];
+		printf("%-28s %7d %8.2f %7d %9d %7.1f %9.4f %9.5f %9.5f %9.1f %9.1f %9.1f%s\n", pName, nFrames, fitSeconds*1e3, nSpans,
+			spline.GetNumCoefficients(), (double)nFrames*nChannels/spline.GetNumCoefficients(), maxAngle, maxPosition, fkMax,
+			poseNs, channelNs, lerpNs, fSum == 12345.0f ? " " : "");
+		if (maxAngle > fAngle*1.001 + 1e-4 || maxPosition > fPosition*1.001 + 1e-6)
+		{
+			printf("  FAILED: error above the tolerance\n");
+			nResult = 1;
+		}
+
+		if (pOutput != NULL && i + 1 == (int)amcFiles.size())
+		{
+			Motion *pDense = spline.Sample(4*nFrames);
+			if (pDense->writeAMCfile(pOutput, MOCAP_SCALE) != 0)
+				nResult = 1;
+			delete pDense;
+		}
+		delete pMotion;
+	}
+
+	delete pActor;
+	return nResult;
+}
@@ -0,0 +1,182 @@
+/*
+	time_warp.cxx
+
+	Dynamic time warping of one motion onto another (see timewarp.h).
+
+	time_warp <asf file> <amc file A> <amc file B> [-band n] [-features joints|angles] [-o warped amc]
+	          [-path file] [-repeat n] [-check]
+		Aligns B to A and reports the cost, time, cells evaluated and memory used.
+		-band      half width of the Sakoe-Chiba band in frames (default 0: the whole matrix)
+		-o         writes B played on the time of A
+		-path      writes the warp path, one "frameA frameB" line per step (numbered from 1)
+		-repeat    tiles both motions n times to time longer clips
+		-check     compares with a plain full table computation (small inputs only)
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include "skeleton.h"
+#include "motion.h"
+#include "poseindex.h"
+#include "timewarp.h"
+
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::vector<float> features_of(Motion *pMotion, PoseFeatures const& features, int nRepeat)
+{
+	int nDim = features.GetDimension();
+	std::vector<float> values((size_t)pMotion->m_NumFrames*nDim*nRepeat);
+	features.Compute(pMotion, values.data());
+	for (int r = 1; r < nRepeat; r++)
+		std::copy(values.begin(), values.begin() + (size_t)pMotion->m_NumFrames*nDim, values.begin() + (size_t)r*pMotion->m_NumFrames*nDim);
+	return values;
+}
+
+//Plain O(nA nB) table in double, with the same band
+static double reference_cost(std::vector<float> const& a, int nA, std::vector<float> const& b, int nB, int nDim, int nBand)
+{
+	std::vector<double> table((size_t)nA*nB, DBL_MAX);
+	if (nBand > 0 && nA > 1)
+		nBand = std::max(nBand, (nB - 1 + nA - 2)/(nA - 1));
+	for (int i = 0; i < nA; i++)
+		for (int j = 0; j < nB; j++)
+		{
+			if (nBand > 0 && nA > 1)
+			{
+				long long n = (long long)i*(nB - 1);
+				if (j < n/(nA - 1) - nBand || j > (n + nA - 2)/(nA - 1) + nBand)
+					continue;
+			}
+			double sum = 0;
+			for (int d = 0; d < nDim; d++)
+				sum += (a[(size_t)i*nDim + d] - b[(size_t)j*nDim + d])*(a[(size_t)i*nDim + d] - b[(size_t)j*nDim + d]);
+			double best = (i == 0 && j == 0) ? 0 : DBL_MAX;
+			if (i > 0) best = std::min(best, table[(size_t)(i - 1)*nB + j]);
+			if (j > 0) best = std::min(best, table[(size_t)i*nB + j - 1]);
+			if (i > 0 && j > 0) best = std::min(best, table[(size_t)(i - 1)*nB + j - 1]);
+			if (best < DBL_MAX)
+				table[(size_t)i*nB + j] = best + sqrt(sum);
+		}
+	return table.back();
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 4)
+	{
+		printf("usage: time_warp <asf file> <amc file A> <amc file B> [-band n] [-features joints|angles] [-o warped amc] [-path file] [-repeat n] [-check]\n");
+		return 1;
+	}
+
+	int nBand = 0, nRepeat = 1;
+	bool bCheck = false;
+	PoseFeatureType type = POSE_FEATURE_JOINTS;
+	char *pOutput = NULL, *pPathFile = NULL;
+	for (int i = 4; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-band") == 0 && i + 1 < argc) nBand = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-features") == 0 && i + 1 < argc)
+			type = strcmp(argv[++i], "angles") == 0 ? POSE_FEATURE_ANGLES : POSE_FEATURE_JOINTS;
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) pOutput = argv[++i];
+		else if (strcmp(argv[i], "-path") == 0 && i + 1 < argc) pPathFile = argv[++i];
+		else if (strcmp(argv[i], "-repeat") == 0 && i + 1 < argc) nRepeat = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "-check") == 0) bCheck = true;
+	}
+
+	Skeleton *pActor = new Skeleton(argv[1], MOCAP_SCALE);
+	Motion *pA = new Motion(argv[2], MOCAP_SCALE, pActor);
+	Motion *pB = new Motion(argv[3], MOCAP_SCALE, pActor);
+	if (pA->m_NumFrames <= 0 || pB->m_NumFrames <= 0)
+		return 1;
+
+	PoseFeatures features(pActor, type);
+	int nDim = features.GetDimension();
+	std::vector<float> featuresA = features_of(pA, features, nRepeat), featuresB = features_of(pB, features, nRepeat);
+	int nA = pA->m_NumFrames*nRepeat, nB = pB->m_NumFrames*nRepeat;
+
+	TimeWarp warp(nBand);
+	warp.SetFeatures(featuresA.data(), nA, featuresB.data(), nB, nDim);
+	printf("\n%d x %d frames, band %d\n", nA, nB, nBand);
+
+	auto start = std::chrono::steady_clock::now();
+	float fCost = warp.GetCost();
+	double seconds = seconds_since(start);
+	printf("cost only   %8.3f s  %8.1f Mcells/s  cost %g\n", seconds, warp.GetNumCells()/seconds/1e6, fCost);
+
+	std::vector<WarpStep> path;
+	start = std::chrono::steady_clock::now();
+	float fPathCost = warp.Align(path);
+	seconds = seconds_since(start);
+	printf("with path   %8.3f s  %8.1f Mcells/s  cost %g, %d steps, largest table %.1f MB (full table %.1f MB)\n", seconds,
+		warp.GetNumCells()/seconds/1e6, fPathCost, (int)path.size(), warp.GetMaxTableCells()*sizeof(float)/1e6,
+		(double)nA*nB*sizeof(float)/1e6);
+
+	int nResult = 0;
+	bool bValid = path.size() > 0 && path[0].frameA == 0 && path[0].frameB == 0 &&
+		path.back().frameA == nA - 1 && path.back().frameB == nB - 1;
+	for (size_t s = 1; s < path.size() && bValid; s++)
+	{
+		int di = path[s].frameA - path[s - 1].frameA, dj = path[s].frameB - path[s - 1].frameB;
+		bValid = di >= 0 && dj >= 0 && di <= 1 && dj <= 1 && di + dj > 0;
+	}
+	if (!bValid || fabs(fPathCost - fCost) > 1e-3*fCost + 1e-3)
+	{
+		printf("The path is not valid or does not have the least cost\n");
+		nResult = 1;
+	}
+
+	if (bCheck)
+	{
+		if ((double)nA*nB > 1e8)
+			printf("Too large to check\n");
+		else
+		{
+			double reference = reference_cost(featuresA, nA, featuresB, nB, nDim, nBand);
+			printf("reference cost %g, relative difference %g\n", reference, fabs(reference - fCost)/std::max(reference, 1e-9));
+			if (fabs(reference - fCost) > 1e-3*reference)
+				nResult = 1;
+		}
+	}
+
+	if (pPathFile != NULL)
+	{
+		FILE *pFile = fopen(pPathFile, "w");
+		if (pFile == NULL)
+			printf("Cannot create '%s'\n", pPathFile);
+		else
+		{
+			for (size_t s = 0; s < path.size(); s++)
+				fprintf(pFile, "%d %d\n", path[s].frameA + 1, path[s].frameB + 1);
+			fclose(pFile);
+		}
+	}
+
+	if (pOutput != NULL)
+	{
+		if (nRepeat > 1)
+			printf("-o is ignored with -repeat\n");
+		else
+		{
+			Motion *pWarped = TimeWarp::Warp(pB, path, nA);
+			if (pWarped->writeAMCfile(pOutput, MOCAP_SCALE) != 0)
+				printf("Cannot write '%s'\n", pOutput);
+			delete pWarped;
+		}
+	}
+
+	delete pB;
+	delete pA;
+	delete pActor;
+	return nResult;
+}